@@ -49,6 +49,8 @@ int main(int argc, const char** argv) {
 
   // Argument variables
   const char* cmd = NULL;
+  const char* profile = NULL;
+  const char* memstats = NULL;
   bool debug = false;
   bool help = false;
   bool quiet = false;
@@ -64,6 +66,10 @@ int main(int argc, const char** argv) {
               "Don't print version and copyright statement on REPL startup.");
   ap_add_bool(parser, "version", 'v', &version, "Print version and exit.");
   ap_add_bool(parser, "ms", 'm', &millisecond, "Prints runtime millisecond.");
+  ap_add_str(parser, "profile", 'p', &profile,
+             "Profile the script and write the collapsed stacks to the file.");
+  ap_add_str(parser, "memstats", 's', &memstats,
+             "Track the allocations and write the report to the file.");
 
   // Parse arguments
   int script_idx = ap_parse(parser, argc, argv);
@@ -105,6 +111,12 @@ int main(int argc, const char** argv) {
 
   int exitcode = 0;
 
+  if (profile != NULL)
+    StartProfiler(vm, 0);
+
+  if (memstats != NULL)
+    StartMemoryTracking(vm);
+
   if (cmd != NULL) { // -c "print('foo')"
     Result result = RunString(vm, cmd);
     exitcode = (int) result;
@@ -138,6 +150,14 @@ int main(int argc, const char** argv) {
   if (millisecond)
     printf("runtime: %.4f ms\n", vm_time(vm));
 
+  if (profile != NULL && !StopProfiler(vm, profile)) {
+    fprintf(stderr, "Error: Cannot write the profile to \"%s\".\n", profile);
+  }
+
+  if (memstats != NULL && !StopMemoryTracking(vm, memstats)) {
+    fprintf(stderr, "Error: Cannot write the memory report to \"%s\".\n", memstats);
+  }
+
   // Cleanup
   FreeVM(vm);
   ap_free(parser);
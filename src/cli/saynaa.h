@@ -178,6 +178,9 @@ typedef enum VarType {
   vSTRING,
   vLIST,
   vMAP,
+  vSET,
+  vDEQUE,
+  vHEAP,
   vRANGE,
   vMODULE,
   vCLOSURE,
@@ -237,6 +240,15 @@ typedef struct Configuration {
   // If true stderr calls will use ansi color codes.
   bool use_ansi_escape;
 
+  // Garbage collector tuning. After a collection the next one is triggered
+  // once the heap grows [heap_fill_percent] percent of the live bytes, but
+  // not before it reaches [min_heap_size] bytes. If [max_heap_size] isn't
+  // zero a runtime error is raised when the live bytes exceed it. Zero
+  // values for the first two will use the defaults.
+  int heap_fill_percent;
+  size_t min_heap_size;
+  size_t max_heap_size;
+
   // User defined data associated with VM.
   void* user_data;
 
@@ -336,6 +348,24 @@ PUBLIC Result RunFile(VM* vm, const char* path);
 // time vm taked.
 PUBLIC double vm_time(VM* vm);
 
+// Start the sampling profiler. A sample of the running call stack will be
+// recorded once in every [interval] loop iterations and function calls, pass
+// 0 to use the default interval. Returns false if it's already running.
+PUBLIC bool StartProfiler(VM* vm, int interval);
+
+// Stop the profiler and write the samples to the file at [path] in the
+// collapsed stack format, which can be consumed by the flamegraph tools.
+// Returns false if the profiler isn't running or failed to write the file.
+PUBLIC bool StopProfiler(VM* vm, const char* path);
+
+// Start tracking the allocations of the VM by their object type and the
+// script call site. Returns false if it's already tracking.
+PUBLIC bool StartMemoryTracking(VM* vm);
+
+// Stop tracking the allocations and write the report to the file at [path].
+// Returns false if it isn't tracking or failed to write the file.
+PUBLIC bool StopMemoryTracking(VM* vm, const char* path);
+
 // FIXME:
 // Currently exit function will terminate the process which should exit from
 // the function and return to the caller.
@@ -450,6 +450,12 @@ struct Compiler {
   // meaningless).
   bool is_last_call;
 
+  // True while compiling an expression statement till its first prefix
+  // expression is parsed. If the statement is `name += expr` of a local or
+  // global variable, the result isn't used anywhere else but stored back to
+  // the variable, so it can be appended to a string builder in place.
+  bool is_statement;
+
   // Since the compiler manually call some builtin functions we need to cache
   // the index of the functions in order to prevent search for them each time.
   int bifn_list_join;
@@ -527,6 +533,7 @@ static void compilerInit(Compiler* compiler, VM* vm, const char* source,
   compiler->can_define = true;
   compiler->new_local = false;
   compiler->is_last_call = false;
+  compiler->is_statement = false;
 
   const char* source_path = "@??";
   if (module->path != NULL) {
@@ -1987,6 +1994,9 @@ static void exprName(Compiler* compiler) {
   int line = tkname.line;
   NameSearchResult result = compilerSearchName(compiler, start, length);
 
+  bool is_statement = compiler->is_statement;
+  compiler->is_statement = false;
+
   if (compiler->l_value && matchAssignment(compiler)) {
     _TokenType assignment = compiler->parser.previous.type;
     skipNewLines(compiler);
@@ -2036,14 +2046,30 @@ static void exprName(Compiler* compiler) {
         semanticError(compiler, tkname, "Name '%.*s' is not defined.", length, start);
       }
 
+      // The `name += expr` statement of a local or global variable will
+      // append to the string builder in place (see stringAppend()).
+      bool append = is_statement && assignment == TK_PLUSEQ
+                    && (name_type == NAME_LOCAL_VAR || name_type == NAME_GLOBAL_VAR);
+
       // Push the named value.
-      emitPushValue(compiler, name_type, index);
+      if (append) {
+        emitOpcode(compiler, (name_type == NAME_LOCAL_VAR) ? OP_PUSH_LOCAL_BLDR
+                                                         : OP_PUSH_GLOBAL_BLDR);
+        emitByte(compiler, index);
+      } else {
+        emitPushValue(compiler, name_type, index);
+      }
 
       // Compile the RHS of the assigned operation.
       compileExpression(compiler);
 
       // Do the arithmatic operation of the assignment.
-      emitAssignedOp(compiler, assignment);
+      if (append) {
+        emitOpcode(compiler, OP_ADD);
+        emitByte(compiler, 2);
+      } else {
+        emitAssignedOp(compiler, assignment);
+      }
     }
 
     // If it's a new local we don't have to store it, it's already at it's
@@ -2530,8 +2556,10 @@ static void parsePrecedence(Compiler* compiler, Precedence precedence) {
   // Inside an expression no new difinition is allowed. We make a "backup"
   // here to prevent such and reset it once we're done.
   bool can_define = compiler->can_define;
-  if (prefix != exprName)
+  if (prefix != exprName) {
     compiler->can_define = false;
+    compiler->is_statement = false;
+  }
 
   compiler->l_value = precedence <= PREC_LOWEST;
   prefix(compiler);
@@ -3623,6 +3651,7 @@ static void compileStatement(Compiler* compiler) {
 
   } else {
     compiler->new_local = false;
+    compiler->is_statement = !compiler->parser.repl_mode;
     compileExpression(compiler);
     consumeEndStatement(compiler);
 
@@ -121,6 +121,10 @@ Configuration NewConfiguration() {
 #endif
   config.load_script_fn = loadScript;
 
+  config.heap_fill_percent = HEAP_FILL_PERCENT;
+  config.min_heap_size = MIN_HEAP_SIZE;
+  config.max_heap_size = 0;
+
   return config;
 }
 
@@ -140,8 +144,13 @@ VM* NewVM(Configuration* config) {
       NULL, sizeof(Object*) * vm->working_set_capacity, NULL);
   vm->next_gc = INITIAL_GC_SIZE;
   vm->collecting_garbage = false;
-  vm->min_heap_size = MIN_HEAP_SIZE;
-  vm->heap_fill_percent = HEAP_FILL_PERCENT;
+  vm->min_heap_size = (config->min_heap_size > 0) ? config->min_heap_size : MIN_HEAP_SIZE;
+  vm->heap_fill_percent = (config->heap_fill_percent > 0) ? config->heap_fill_percent
+                                                          : HEAP_FILL_PERCENT;
+  vm->max_heap_size = config->max_heap_size;
+  if (vm->max_heap_size != 0 && vm->next_gc > vm->max_heap_size)
+    vm->next_gc = vm->max_heap_size;
+  vm->gc_stats.start_time = nanotime();
 
   vm->modules = newMap(vm);
   vm->search_paths = newList(vm, 8);
@@ -150,6 +159,10 @@ VM* NewVM(Configuration* config) {
   vm->builtins_count = 0;
   vm->time = 0;
 
+#if OPCODE_STATS
+  opstatsInit(vm);
+#endif
+
   // This is necessary to prevent garbage collection skip the entry in this
   // array while we're building it.
   for (int i = 0; i < vINSTANCE; i++) {
@@ -170,6 +183,26 @@ void FreeVM(VM* vm) {
   cleanupLibs(vm);
 #endif
 
+  // Discard the samples if the profiler is still running.
+  if (vm->profiler != NULL)
+    profilerStop(vm, NULL);
+
+  if (vm->memtrack != NULL)
+    memtrackStop(vm, NULL);
+
+#if OPCODE_STATS
+  // Instrumented builds report the opcode statistics at the shutdown.
+  if (vm->config.stderr_write != NULL) {
+    ByteBuffer bb;
+    ByteBufferInit(&bb);
+    opstatsDump(vm, &bb);
+    ByteBufferWrite(&bb, vm, '\0');
+    vm->config.stderr_write(vm, (const char*) bb.data);
+    ByteBufferClear(&bb, vm);
+  }
+  opstatsFree(vm);
+#endif
+
   Object* obj = vm->first;
   while (obj != NULL) {
     Object* next = obj->next;
@@ -179,6 +212,8 @@ void FreeVM(VM* vm) {
 
   vm->working_set = (Object**) vm->config.realloc_fn(vm->working_set, 0,
                                                      vm->config.user_data);
+  if (vm->views != NULL)
+    vm->config.realloc_fn(vm->views, 0, vm->config.user_data);
 
   // Validate that all handles have been released by the host application.
   // If handles remain, it indicates a resource leak in the host's usage of the VM.
@@ -377,6 +412,24 @@ double vm_time(VM* vm) {
   return vm->time;
 }
 
+bool StartProfiler(VM* vm, int interval) {
+  return profilerStart(vm, interval);
+}
+
+bool StopProfiler(VM* vm, const char* path) {
+  CHECK_ARG_NULL(path);
+  return profilerStop(vm, path);
+}
+
+bool StartMemoryTracking(VM* vm) {
+  return memtrackStart(vm);
+}
+
+bool StopMemoryTracking(VM* vm, const char* path) {
+  CHECK_ARG_NULL(path);
+  return memtrackStop(vm, path);
+}
+
 Result RunString(VM* vm, const char* source) {
   Result result = RESULT_SUCCESS;
 
@@ -728,8 +781,10 @@ bool ValidateSlotString(VM* vm, int slot, const char** value, uint32_t* length)
     return false;
   }
   String* str = (String*) AS_OBJ(val);
-  if (value)
+  if (value) {
+    stringMaterialize(vm, str);
     *value = str->data;
+  }
   if (length)
     *length = str->length;
   return true;
@@ -811,9 +866,11 @@ const char* GetSlotString(VM* vm, int index, uint32_t* length) {
   VALIDATE_SLOT_INDEX(index);
   Var value = SLOT(index);
   ASSERT(IS_OBJ_TYPE(value, OBJ_STRING), "Slot value wasn't a String.");
+  String* str = (String*) AS_OBJ(value);
+  stringMaterialize(vm, str);
   if (length != NULL)
-    *length = ((String*) AS_OBJ(value))->length;
-  return ((String*) AS_OBJ(value))->data;
+    *length = str->length;
+  return str->data;
 }
 
 void* GetSlotPointer(VM* vm, int index, void* native_ptr, Destructor destructor) {
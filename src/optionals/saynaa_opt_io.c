@@ -6,6 +6,17 @@
 #include "saynaa_optionals.h"
 
 #include <math.h>
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef S_ISREG
+#define S_ISREG(mode) (((mode) & S_IFMT) == S_IFREG)
+#endif
 
 saynaa_function(
     _ioWrite, "io.write(stream:Var, bytes:String) -> Null",
@@ -93,10 +104,22 @@ typedef enum {
 
 } FileAccessMode;
 
+// The size of the read buffer of a file, it's grown for longer lines.
+#define FILE_BUFFER_SIZE (64 * 1024)
+
 typedef struct {
   FILE* fp;            // C file poinnter.
   FileAccessMode mode; // Access mode of the file.
   bool closed;         // True if the file isn't cl
+
+  // The lines are split in this buffer which is read from the file in large
+  // chunks, the bytes between [start] and [end] are read from the file but
+  // not consumed yet. It's dropped (see _fileSync()) before any other access
+  // to the file pointer.
+  char* buffer;
+  uint32_t capacity;
+  uint32_t start;
+  uint32_t end;
 } File;
 
 void* _fileNew(VM* vm) {
@@ -105,9 +128,22 @@ void* _fileNew(VM* vm) {
   file->closed = true;
   file->mode = FMODE_NONE;
   file->fp = NULL;
+  file->buffer = NULL;
+  file->capacity = 0;
+  file->start = 0;
+  file->end = 0;
   return file;
 }
 
+static void _fileFreeBuffer(VM* vm, File* file) {
+  if (file->buffer != NULL)
+    Realloc(vm, file->buffer, 0);
+  file->buffer = NULL;
+  file->capacity = 0;
+  file->start = 0;
+  file->end = 0;
+}
+
 void _fileDelete(VM* vm, void* ptr) {
   File* file = (File*) ptr;
   if (!file->closed) {
@@ -121,9 +157,117 @@ void _fileDelete(VM* vm, void* ptr) {
     ASSERT(file->fp == NULL, OOPS);
   }
 
+  _fileFreeBuffer(vm, file);
   Realloc(vm, file, 0);
 }
 
+// Move the file position back to the first byte which isn't consumed from
+// the read buffer and drop the buffer, so the file pointer can be used
+// directly. Returns false and set an error if the position can't be moved
+// (ex: pipes), the buffered bytes are kept then.
+static bool _fileSync(VM* vm, File* file) {
+  if (file->start < file->end) {
+    if (fseek(file->fp, -(long) (file->end - file->start), SEEK_CUR) != 0) {
+      REPORT_ERRNO(fseek);
+      return false;
+    }
+  }
+  file->start = 0;
+  file->end = 0;
+  return true;
+}
+
+// Read the next chunk of the file at the end of the read buffer. Returns the
+// number of bytes read, 0 at the end of the file and -1 on error.
+static int64_t _fileFill(VM* vm, File* file) {
+  if (file->start > 0) {
+    if (file->start < file->end)
+      memmove(file->buffer, file->buffer + file->start, file->end - file->start);
+    file->end -= file->start;
+    file->start = 0;
+  }
+
+  if (file->capacity - file->end < FILE_BUFFER_SIZE / 2) {
+    uint32_t capacity = file->capacity * 2;
+    if (capacity < FILE_BUFFER_SIZE)
+      capacity = FILE_BUFFER_SIZE;
+    file->buffer = Realloc(vm, file->buffer, capacity);
+    file->capacity = capacity;
+  }
+
+  size_t count = fread(file->buffer + file->end, 1, file->capacity - file->end, file->fp);
+  if (count == 0 && ferror(file->fp)) {
+    REPORT_ERRNO(fread);
+    return -1;
+  }
+  file->end += (uint32_t) count;
+  return (int64_t) count;
+}
+
+// Read the next line including the new line character to the slot 0.
+// Returns false at the end of the file or on error.
+static bool _fileReadLine(VM* vm, File* file) {
+  uint32_t scanned = file->start;
+  while (true) {
+    const char* nl = NULL;
+    if (scanned < file->end) // The buffer is NULL till the first fill.
+      nl = memchr(file->buffer + scanned, '\n', file->end - scanned);
+    if (nl != NULL) {
+      uint32_t length = (uint32_t) (nl - (file->buffer + file->start)) + 1;
+      setSlotStringLength(vm, 0, file->buffer + file->start, length);
+      file->start += length;
+      return true;
+    }
+
+    scanned = file->end - file->start; // Relative to the compacted buffer.
+    int64_t count = _fileFill(vm, file);
+    if (count < 0)
+      return false;
+
+    if (count == 0) {
+      if (file->start == file->end)
+        return false;
+      setSlotStringLength(vm, 0, file->buffer + file->start, file->end - file->start);
+      file->start = file->end;
+      return true;
+    }
+  }
+}
+
+static bool _fileCheckRead(VM* vm, File* file) {
+  if (file->closed) {
+    SetRuntimeError(vm, "Cannot read from a closed file.");
+    return false;
+  }
+
+  if (!(file->mode & FMODE_READ) && !(_FMODE_EXT & file->mode)) {
+    SetRuntimeError(vm, "File is not readable.");
+    return false;
+  }
+
+  return true;
+}
+
+bool ioGetFile(VM* vm, Var value, bool write, FILE** fp) {
+  File* file = getNativeInstanceOf(value, _fileDelete);
+  if (file == NULL)
+    return false;
+
+  *fp = NULL;
+  if (file->closed) {
+    SetRuntimeError(vm, write ? "Cannot write to a closed file."
+                              : "Cannot read from a closed file.");
+  } else if (write && !(file->mode & FMODE_WRITE) && !(file->mode & FMODE_APPEND)
+             && !(file->mode & _FMODE_EXT)) {
+    SetRuntimeError(vm, "File is not writable.");
+  } else if (!write && !(file->mode & FMODE_READ) && !(file->mode & _FMODE_EXT)) {
+    SetRuntimeError(vm, "File is not readable.");
+  } else if (_fileSync(vm, file)) {
+    *fp = file->fp;
+  }
+  return true;
+}
+
 /*****************************************************************************/
 /* FILE MODULE FUNCTIONS                                                     */
 /*****************************************************************************/
@@ -261,115 +405,144 @@ saynaa_function(
   }
 
   File* file = (File*) GetThis(vm);
-
-  if (file->closed) {
-    SetRuntimeError(vm, "Cannot read from a closed file.");
+  if (!_fileCheckRead(vm, file))
     return;
-  }
 
-  if (!(file->mode & FMODE_READ) && !(_FMODE_EXT & file->mode)) {
-    SetRuntimeError(vm, "File is not readable.");
-    return;
-  }
+  // The buffered bytes are read first and the rest is read from the file
+  // directly into the string.
+  uint32_t buffered = file->end - file->start;
 
   if (count == -1) {
-    // Get the source length. In windows the ftell will includes the cariage
-    // return when using ftell with fseek. But that's not an issue since
-    // we'll be allocating more memory than needed for fread().
-    long current = ftell(file->fp);
-    fseek(file->fp, 0, SEEK_END);
-    count = ftell(file->fp);
-    fseek(file->fp, current, SEEK_SET);
+    struct stat st;
+    long position = ftell(file->fp);
+    if (fstat(fileno(file->fp), &st) != 0 || !S_ISREG(st.st_mode) || position < 0) {
+      // Not a regular file, read the chunks till the end.
+      while (true) {
+        int64_t read = _fileFill(vm, file);
+        if (read < 0)
+          return;
+        if (read == 0)
+          break;
+      }
+      setSlotStringLength(vm, 0, file->buffer + file->start, file->end - file->start);
+      file->start = file->end = 0;
+      return;
+    }
+    count = (long) buffered + ((st.st_size > position) ? (long) (st.st_size - position) : 0);
   }
 
-  // Allocate string + 1 for the NULL terminator.
-  char* buff = Realloc(vm, NULL, (size_t) count + 1);
-  ASSERT(buff != NULL, "Realloc failed.");
+  if ((uint64_t) count > UINT32_MAX) {
+    SetRuntimeError(vm, "Cannot read more than 4GB into a string.");
+    return;
+  }
 
-  clearerr(file->fp);
-  size_t read = fread(buff, sizeof(char), count, file->fp);
+  String* str = newStringLength(vm, NULL, (uint32_t) count);
+  vm->fiber->ret[0] = VAR_OBJ(str);
 
-  if (ferror(file->fp)) {
-    REPORT_ERRNO(fread);
-    goto L_done;
+  uint32_t length = ((uint32_t) count < buffered) ? (uint32_t) count : buffered;
+  if (length > 0) // The buffer is NULL till the first buffered read.
+    memcpy(str->data, file->buffer + file->start, length);
+  file->start += length;
+
+  if (length < (uint32_t) count) {
+    clearerr(file->fp);
+    length += (uint32_t) fread(str->data + length, 1, (size_t) count - length, file->fp);
+    if (ferror(file->fp)) {
+      REPORT_ERRNO(fread);
+      return;
+    }
   }
 
-  bool is_read_failed = read > count;
-  if (!is_read_failed)
-    buff[read] = '\0';
+  // In text mode on Windows the file size includes the carriage returns,
+  // or the file is shorter than the count.
+  str->length = length;
+  str->data[length] = '\0';
+}
 
-  // If EOF is already reached it won't read anymore bytes.
-  if (read == 0) {
-    setSlotStringLength(vm, 0, "", 0);
-    goto L_done;
+saynaa_function(
+    _fileReadInto, "io.File.readinto(buffer:ByteBuffer, count:Number=65536) -> Number",
+    "Reads up to [count] bytes from the file at the end of the [buffer] and "
+    "returns the number of bytes read, which is 0 at the end of the file. "
+    "The bytes are read directly into the buffer, so reading a large file in "
+    "chunks reuses the same memory if the buffer is cleared between them.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  ByteBuffer* buff = typesGetByteBuffer(vm->fiber->ret[1]);
+  if (buff == NULL) {
+    SetRuntimeErrorFmt(vm, "Expected a types.ByteBuffer, instead got type '%s'.",
+                       varTypeName(vm->fiber->ret[1]));
+    return;
   }
 
-  if (is_read_failed) {
-    SetRuntimeError(vm, "C.fread() failed.");
-    goto L_done;
+  int32_t count = FILE_BUFFER_SIZE;
+  if (argc == 2) {
+    if (!ValidateSlotInteger(vm, 2, &count))
+      return;
+    if (count < 0) {
+      SetRuntimeError(vm, "Read bytes count should be >= 0.");
+      return;
+    }
   }
 
-  // TODO: maybe I should check if the [read] length is larger for uint32_t.
-  setSlotStringLength(vm, 0, buff, (uint32_t) read);
-  goto L_done;
+  File* file = (File*) GetThis(vm);
+  if (!_fileCheckRead(vm, file))
+    return;
 
-L_done:
-  Realloc(vm, buff, 0);
-  return;
+  ByteBufferReserve(buff, vm, (size_t) buff->count + count);
+
+  uint32_t buffered = file->end - file->start;
+  uint32_t length = ((uint32_t) count < buffered) ? (uint32_t) count : buffered;
+  if (length > 0)
+    memcpy(buff->data + buff->count, file->buffer + file->start, length);
+  file->start += length;
+
+  if (length < (uint32_t) count) {
+    clearerr(file->fp);
+    length += (uint32_t) fread(buff->data + buff->count + length, 1,
+                               (size_t) count - length, file->fp);
+    if (ferror(file->fp)) {
+      REPORT_ERRNO(fread);
+      return;
+    }
+  }
+
+  buff->count += length;
+  setSlotNumber(vm, 0, (double) length);
 }
 
-// Note that fgetline is not standard in older version of C. so we're defining
-// something similler.
 saynaa_function(
     _fileGetLine, "io.File.getline() -> String",
     "Reads a line from the file and return it as string. This function "
     "can only "
     "be used for files that are opened with text mode.") {
   File* file = (File*) GetThis(vm);
-
-  if (file->closed) {
-    SetRuntimeError(vm, "Cannot read from a closed file.");
-    return;
-  }
-
-  if (!(file->mode & FMODE_READ) && !(_FMODE_EXT & file->mode)) {
-    SetRuntimeError(vm, "File is not readable.");
+  if (!_fileCheckRead(vm, file))
     return;
-  }
 
   if (file->mode & _FMODE_BIN) {
     SetRuntimeError(vm, "Cannot getline binary files.");
     return;
   }
 
-  // TODO: Optimize line reading (use fgets or buffered read).
-  ByteBuffer buff;
-  ByteBufferInit(&buff);
-  char c;
-  do {
-    c = (char) fgetc(file->fp);
-
-    // End of file or error.
-    if (c == EOF) {
-      if (ferror(file->fp)) {
-        REPORT_ERRNO(fgetc);
-        goto L_done;
-      }
-      break; // EOF is reached.
-    }
-
-    ByteBufferWrite(&buff, vm, (uint8_t) c);
-    if (c == '\n')
-      break;
+  if (!_fileReadLine(vm, file) && !VM_HAS_ERROR(vm))
+    setSlotStringLength(vm, 0, "", 0);
+}
 
-  } while (true);
+// The iterator of the for loop is the last line, the lines are read from
+// the file so it can only be iterated once.
+saynaa_function(_fileNext, "io.File._next(iterator:Var) -> String", "") {
+  File* file = (File*) GetThis(vm);
+  if (!_fileCheckRead(vm, file))
+    return;
 
-  // A null byte '\0' will be added.
-  setSlotStringLength(vm, 0, buff.data, buff.count);
+  if (!_fileReadLine(vm, file))
+    setSlotNull(vm, 0);
+}
 
-L_done:
-  ByteBufferClear(&buff, vm);
-  return;
+saynaa_function(_fileValue, "io.File._value(iterator:String) -> String", "") {
+  vm->fiber->ret[0] = vm->fiber->ret[1];
 }
 
 saynaa_function(
@@ -394,6 +567,8 @@ saynaa_function(
     return;
   }
 
+  if (!_fileSync(vm, file))
+    return;
   clearerr(file->fp);
   fwrite(text, sizeof(char), (size_t) length, file->fp);
   if (ferror(file->fp)) {
@@ -411,6 +586,7 @@ saynaa_function(_fileClose, "io.File.close()", "Closes the opend file.") {
     return;
   }
 
+  _fileFreeBuffer(vm, file);
   if (fclose(file->fp) != 0) {
     REPORT_ERRNO(fclose);
     return;
@@ -451,6 +627,8 @@ saynaa_function(
     return;
   }
 
+  if (!_fileSync(vm, file))
+    return;
   if (fseek(file->fp, offset, whence) != 0) {
     REPORT_ERRNO(fseek);
     return;
@@ -467,7 +645,267 @@ saynaa_function(_fileTell, "io.File.tell() -> Number",
   }
 
   // C.ftell() doesn't "throw" any error right?
-  setSlotNumber(vm, 0, (double) ftell(file->fp));
+  long buffered = (long) (file->end - file->start);
+  setSlotNumber(vm, 0, (double) (ftell(file->fp) - buffered));
+}
+
+/*****************************************************************************/
+/* MAPPED FILE                                                               */
+/*****************************************************************************/
+
+// A read only file mapped to the memory with io.mmap(). The pages are loaded
+// by the OS when they're accessed, so opening it doesn't depend on the size of
+// the file. A slice of it is a view which shares the mapping and keeps its
+// owner alive.
+typedef struct {
+  const char* data;
+  uint64_t length;
+
+  Handle* owner; // The mapped file of a view, NULL if this owns the mapping.
+} Mapped;
+
+// A reference to the Mapped class to create the views.
+static Handle* _cls_mapped = NULL;
+
+static void* _mappedNew(VM* vm) {
+  Mapped* mapped = Realloc(vm, NULL, sizeof(Mapped));
+  memset(mapped, 0, sizeof(Mapped));
+  return mapped;
+}
+
+static void _mappedDelete(VM* vm, void* ptr) {
+  Mapped* mapped = (Mapped*) ptr;
+  if (mapped->owner != NULL) {
+    releaseHandle(vm, mapped->owner);
+  } else if (mapped->length > 0) {
+#if !defined(_WIN32)
+    munmap((void*) mapped->data, (size_t) mapped->length);
+#endif
+  }
+  Realloc(vm, mapped, 0);
+}
+
+bool ioGetMapped(Var value, const char** data, uint64_t* length) {
+  Mapped* mapped = getNativeInstanceOf(value, _mappedDelete);
+  if (mapped == NULL)
+    return false;
+  *data = mapped->data;
+  *length = mapped->length;
+  return true;
+}
+
+// Validate the offset at the [slot] for reading [size] bytes of the mapped
+// file.
+static bool _mappedOffset(VM* vm, Mapped* mapped, int slot, uint64_t size,
+                          uint64_t* offset) {
+  double value;
+  if (!ValidateSlotNumber(vm, slot, &value))
+    return false;
+
+  if (floor(value) != value || value < 0 || value + (double) size > (double) mapped->length) {
+    SetRuntimeErrorFmt(vm, "Offset %g is out of the bounds of the mapped file.", value);
+    return false;
+  }
+
+  *offset = (uint64_t) value;
+  return true;
+}
+
+saynaa_function(_ioMmap, "io.mmap(path:String) -> Mapped",
+                "Map the file at the [path] to the memory for reading. The file "
+                "isn't read till its bytes are accessed, and they're only copied "
+                "when it's converted to a String or a ByteBuffer.") {
+  const char* path;
+  if (!ValidateSlotString(vm, 1, &path, NULL))
+    return;
+
+#if defined(_WIN32)
+  SetRuntimeError(vm, "io.mmap() isn't supported on this platform.");
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    REPORT_ERRNO(open);
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    REPORT_ERRNO(fstat);
+    close(fd);
+    return;
+  }
+
+  // An empty file can't be mapped, it's an empty buffer.
+  void* data = NULL;
+  if (st.st_size > 0) {
+    data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      REPORT_ERRNO(mmap);
+      close(fd);
+      return;
+    }
+  }
+  close(fd); // The mapping doesn't need the file descriptor.
+
+  setSlotHandle(vm, 0, _cls_mapped);
+  if (!NewInstance(vm, 0, 0, 0, 0)) {
+    if (data != NULL)
+      munmap(data, (size_t) st.st_size);
+    return;
+  }
+
+  Mapped* mapped = GetSlotNativeInstance(vm, 0);
+  mapped->data = (const char*) data;
+  mapped->length = (uint64_t) st.st_size;
+#endif
+}
+
+saynaa_function(_mappedGetter, "io.Mapped._getter(name:String) -> Var", "") {
+  const char* name;
+  uint32_t length;
+  if (!ValidateSlotString(vm, 1, &name, &length))
+    return;
+
+  Mapped* mapped = GetThis(vm);
+  if (length == 6 && strncmp(name, "length", length) == 0) {
+    setSlotNumber(vm, 0, (double) mapped->length);
+  }
+}
+
+saynaa_function(_mappedSubscriptGet, "io.Mapped.[](index:Number) -> Number",
+                "Returns the byte at the [index].") {
+  Mapped* mapped = GetThis(vm);
+  uint64_t offset;
+  if (!_mappedOffset(vm, mapped, 1, 1, &offset))
+    return;
+  setSlotNumber(vm, 0, (double) (uint8_t) mapped->data[offset]);
+}
+
+saynaa_function(_mappedSlice, "io.Mapped.slice(offset:Number, length:Number) -> Mapped",
+                "Returns a view of [length] bytes from the [offset] which shares "
+                "the mapping. If the [length] isn't given it's till the end.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  Mapped* mapped = GetThis(vm);
+  uint64_t offset, length;
+  if (!_mappedOffset(vm, mapped, 1, 0, &offset))
+    return;
+
+  length = mapped->length - offset;
+  if (argc == 2) {
+    double value;
+    if (!ValidateSlotNumber(vm, 2, &value))
+      return;
+    if (floor(value) != value || value < 0 || value > (double) length) {
+      SetRuntimeErrorFmt(vm, "Length %g is out of the bounds of the mapped file.", value);
+      return;
+    }
+    length = (uint64_t) value;
+  }
+
+  // The owner of a view is the owner of the mapping, so a view of a view
+  // doesn't keep the intermediate one alive.
+  Handle* owner = (mapped->owner != NULL) ? vmNewHandle(vm, mapped->owner->value)
+                                          : vmNewHandle(vm, vm->fiber->thiz);
+  const char* data = mapped->data;
+
+  setSlotHandle(vm, 0, _cls_mapped);
+  if (!NewInstance(vm, 0, 0, 0, 0)) {
+    releaseHandle(vm, owner);
+    return;
+  }
+
+  Mapped* view = GetSlotNativeInstance(vm, 0);
+  view->data = data + offset;
+  view->length = length;
+  view->owner = owner;
+}
+
+// Define the methods which read a little endian number of [m_type] at an
+// offset, the bytes of a float are read as the integer of the same size.
+#define MAPPED_READ(m_name, m_type, m_size, m_float, m_doc)                                \
+  saynaa_function(_mappedRead_##m_name, "io.Mapped." #m_name "(offset:Number) -> Number",  \
+                  m_doc) {                                                                 \
+    Mapped* mapped = GetThis(vm);                                                          \
+    uint64_t offset;                                                                       \
+    if (!_mappedOffset(vm, mapped, 1, m_size, &offset))                                    \
+      return;                                                                              \
+    uint64_t bits = 0;                                                                     \
+    const uint8_t* bytes = (const uint8_t*) mapped->data + offset;                         \
+    for (int i = m_size - 1; i >= 0; i--)                                                  \
+      bits = (bits << 8) | bytes[i];                                                       \
+    m_type value;                                                                          \
+    if (m_float) {                                                                         \
+      uint32_t bits32 = (uint32_t) bits;                                                   \
+      memcpy(&value, (m_size == 4) ? (void*) &bits32 : (void*) &bits, m_size);             \
+    } else {                                                                               \
+      value = (m_type) bits;                                                               \
+    }                                                                                      \
+    setSlotNumber(vm, 0, (double) value);                                                  \
+  }
+
+MAPPED_READ(u8, uint8_t, 1, false, "Returns the unsigned byte at the [offset].")
+MAPPED_READ(i8, int8_t, 1, false, "Returns the signed byte at the [offset].")
+MAPPED_READ(u16, uint16_t, 2, false, "Returns the little endian uint16 at the [offset].")
+MAPPED_READ(i16, int16_t, 2, false, "Returns the little endian int16 at the [offset].")
+MAPPED_READ(u32, uint32_t, 4, false, "Returns the little endian uint32 at the [offset].")
+MAPPED_READ(i32, int32_t, 4, false, "Returns the little endian int32 at the [offset].")
+MAPPED_READ(f32, float, 4, true, "Returns the little endian float32 at the [offset].")
+MAPPED_READ(f64, double, 8, true, "Returns the little endian float64 at the [offset].")
+
+#undef MAPPED_READ
+
+saynaa_function(_mappedFind, "io.Mapped.find(sub:String, start:Number=0) -> Number",
+                "Returns the first offset of [sub] from the [start] or -1 if "
+                "it's not found.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  const char* sub;
+  uint32_t sub_length;
+  if (!ValidateSlotString(vm, 1, &sub, &sub_length))
+    return;
+
+  Mapped* mapped = GetThis(vm);
+  uint64_t start = 0;
+  if (argc == 2 && !_mappedOffset(vm, mapped, 2, 0, &start))
+    return;
+
+  const char* match = utilMemMem(mapped->data + start, (size_t) (mapped->length - start),
+                                 sub, sub_length);
+  setSlotNumber(vm, 0, (match == NULL) ? -1 : (double) (match - mapped->data));
+}
+
+saynaa_function(_mappedString, "io.Mapped.string() -> String",
+                "Returns a copy of the bytes as a String.") {
+  Mapped* mapped = GetThis(vm);
+  if (mapped->length > UINT32_MAX) {
+    SetRuntimeError(vm, "Cannot copy more than 4GB into a string.");
+    return;
+  }
+  setSlotStringLength(vm, 0, mapped->data, (uint32_t) mapped->length);
+}
+
+saynaa_function(_mappedByteBuffer, "io.Mapped.bytebuffer() -> ByteBuffer",
+                "Returns a copy of the bytes as a types.ByteBuffer.") {
+  Mapped* mapped = GetThis(vm);
+  if (mapped->length > UINT32_MAX) {
+    SetRuntimeError(vm, "Cannot copy more than 4GB into a buffer.");
+    return;
+  }
+
+  if (!ImportModule(vm, "types", 0))
+    return;
+  if (!GetAttribute(vm, 0, "ByteBuffer", 0))
+    return;
+  if (!NewInstance(vm, 0, 0, 0, 0))
+    return;
+
+  ByteBuffer* buff = typesGetByteBuffer(vm->fiber->ret[0]);
+  ByteBufferAddString(buff, vm, mapped->data, (uint32_t) mapped->length);
 }
 
 // TODO: The docstring is copyied from io.File.open() this violates DRY.
@@ -530,18 +968,39 @@ void registerModuleIO(VM* vm) {
   REGISTER_FN(io, "write", _ioWrite, 2);
   REGISTER_FN(io, "flush", _ioFlush, 0);
   REGISTER_FN(io, "getc", _ioGetc, 0);
+  REGISTER_FN(io, "mmap", _ioMmap, 1);
 
   Handle* cls_file = NewClass(vm, "File", NULL, io, _fileNew, _fileDelete, "A simple file type.");
 
   ADD_METHOD(cls_file, "open", _fileOpen, -1);
   ADD_METHOD(cls_file, "read", _fileRead, -1);
   ADD_METHOD(cls_file, "write", _fileWrite, 1);
+  ADD_METHOD(cls_file, "readinto", _fileReadInto, -1);
   ADD_METHOD(cls_file, "getline", _fileGetLine, 0);
   ADD_METHOD(cls_file, "close", _fileClose, 0);
   ADD_METHOD(cls_file, "seek", _fileSeek, -1);
   ADD_METHOD(cls_file, "tell", _fileTell, 0);
+  ADD_METHOD(cls_file, "_next", _fileNext, 1);
+  ADD_METHOD(cls_file, "_value", _fileValue, 1);
   releaseHandle(vm, cls_file);
 
+  _cls_mapped = NewClass(vm, "Mapped", NULL, io, _mappedNew, _mappedDelete,
+                         "A read only file mapped to the memory, see io.mmap().");
+  ADD_METHOD(_cls_mapped, "_getter", _mappedGetter, 1);
+  ADD_METHOD(_cls_mapped, "[]", _mappedSubscriptGet, 1);
+  ADD_METHOD(_cls_mapped, "slice", _mappedSlice, -1);
+  ADD_METHOD(_cls_mapped, "u8", _mappedRead_u8, 1);
+  ADD_METHOD(_cls_mapped, "i8", _mappedRead_i8, 1);
+  ADD_METHOD(_cls_mapped, "u16", _mappedRead_u16, 1);
+  ADD_METHOD(_cls_mapped, "i16", _mappedRead_i16, 1);
+  ADD_METHOD(_cls_mapped, "u32", _mappedRead_u32, 1);
+  ADD_METHOD(_cls_mapped, "i32", _mappedRead_i32, 1);
+  ADD_METHOD(_cls_mapped, "f32", _mappedRead_f32, 1);
+  ADD_METHOD(_cls_mapped, "f64", _mappedRead_f64, 1);
+  ADD_METHOD(_cls_mapped, "find", _mappedFind, -1);
+  ADD_METHOD(_cls_mapped, "string", _mappedString, 0);
+  ADD_METHOD(_cls_mapped, "bytebuffer", _mappedByteBuffer, 0);
+
   // A convinent function to read file by io.readfile(path).
   ModuleAddSource(vm, io,
                   "function readfile(filepath)\n"
@@ -555,4 +1014,10 @@ void registerModuleIO(VM* vm) {
 
   registerModule(vm, io);
   releaseHandle(vm, io);
-}
\ No newline at end of file
+}
+
+void cleanupModuleIO(VM* vm) {
+  if (_cls_mapped)
+    releaseHandle(vm, _cls_mapped);
+  _cls_mapped = NULL;
+}
@@ -5,197 +5,882 @@
 
 #include "saynaa_optionals.h"
 
-#include "json/saynaa_json.h"
+#include "../utils/saynaa_simd.h"
 #include <math.h>
 
-// TODO:
-// Convert a saynaa_json object into variable. Note that the depth shouldn't
-// exceed MAX_TEMP_REFERENCE of the VM and we should throw error if the dept
-// is too much (saynaa_json complain at depth 1000), add depth as a parameter.
-static Var _cJsonToSaynaa(VM* vm, saynaa_json* item) {
-  switch ((item->type) & 0xFF) {
-    case SAYNAA_JSON_NULL:
-      return VAR_NULL;
+/*****************************************************************************/
+/* PARSER                                                                    */
+/*****************************************************************************/
 
-    case SAYNAA_JSON_FALSE:
-      return VAR_FALSE;
+// The parser builds the values directly in the VM heap in a single pass. It's
+// not recursive, the open containers are kept in an explicit stack so the
+// nesting depth is only limited by the memory.
 
-    case SAYNAA_JSON_TRUE:
-      return VAR_TRUE;
+// The number of the recent object keys which are reused instead of
+// allocating a new string for each of them, since the objects of a json
+// array usually have the same keys. Should be a power of 2.
+#define JSON_KEY_CACHE 256
 
-    case SAYNAA_JSON_NUMBER:
-      return VAR_NUM(item->valuedouble);
+// The longest integer which is parsed without strtod(), any integer of 15
+// digits is exactly representable by a double.
+#define JSON_FAST_DIGITS 15
 
-    case SAYNAA_JSON_STRING:
-      {
-        const char* s = item->valuestring ? item->valuestring : "";
-        return VAR_OBJ(newString(vm, s));
-      }
+typedef struct {
+  VM* vm;
+  const char* source;  //< Start of the json (for the error position).
+  const char* current; //< The current character.
+  const char* end;     //< End of the json.
 
-    case SAYNAA_JSON_ARRAY:
-      {
-        List* list = newList(vm, 8);
-        vmPushTempRef(vm, &list->_super); // list.
-
-        saynaa_json* elem = item->child;
-        while (elem != NULL) {
-          Var v = _cJsonToSaynaa(vm, elem);
-          if (IS_OBJ(v))
-            vmPushTempRef(vm, AS_OBJ(v)); // v.
-          listAppend(vm, list, v);
-          if (IS_OBJ(v))
-            vmPopTempRef(vm); // v.
-          elem = elem->next;
-        }
-        vmPopTempRef(vm); // list.
-        return VAR_OBJ(list);
-      }
+  // The values of the open lists and maps (the keys and the values of a map
+  // are interleaved), each container is built when it's closed with the
+  // exact number of its elements. It's a list to keep the values reachable
+  // by the garbage collector.
+  List* values;
 
-    case SAYNAA_JSON_OBJECT:
-      {
-        Map* map = newMap(vm);
-        vmPushTempRef(vm, &map->_super); // map.
-        saynaa_json* elem = item->child;
-        while (elem != NULL) {
-          String* key = newString(vm, elem->key);
-          vmPushTempRef(vm, &key->_super); // key.
-          {
-            Var value = _cJsonToSaynaa(vm, elem);
-            if (IS_OBJ(value))
-              vmPushTempRef(vm, AS_OBJ(value)); // value.
-            mapSet(vm, map, VAR_OBJ(key), value);
-            if (IS_OBJ(value))
-              vmPopTempRef(vm); // value.
-          }
-          vmPopTempRef(vm); // key.
-          elem = elem->next;
-        }
-        vmPopTempRef(vm); // map.
-        return VAR_OBJ(map);
-      }
+  // The open containers as the index of their first value in the [values],
+  // shifted left by 1 and or-ed with 1 if it's a map.
+  UintBuffer frames;
 
-    default:
-      UNREACHABLE();
+  List* keys;        //< Recent object keys, at their hash modulo the size.
+  ByteBuffer buffer; //< Scratch buffer of the escaped strings and numbers.
+} JsonParser;
+
+// Set an error with the position of the current character and return false.
+static bool _jsonError(JsonParser* p, const char* message) {
+  int line = 1;
+  const char* line_start = p->source;
+  for (const char* c = p->source; c < p->current; c++) {
+    if (*c == '\n') {
+      line++;
+      line_start = c + 1;
+    }
   }
+  SetRuntimeErrorFmt(p->vm, "Invalid json string, %s at line %d column %d.", message,
+                     line, (int) (p->current - line_start) + 1);
+  return false;
+}
+
+// Skip the white spaces and return false at the end of the json.
+static inline bool _jsonSkipSpace(JsonParser* p) {
+  if (p->current >= p->end)
+    return false;
 
-  UNREACHABLE();
+  char c = *p->current;
+  if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    p->current += simdSkipJsonSpace(p->current, p->end - p->current);
+  }
+  return p->current < p->end;
 }
 
-static saynaa_json* _saynaaToCJson(VM* vm, Var item) {
-  VarType vt = getVarType(item);
-  switch (vt) {
-    case vNULL:
-      return saynaa_json_create_null();
+// Push the [value] to the value stack of the parser.
+static void _jsonPush(JsonParser* p, Var value) {
+  VarBuffer* values = &p->values->elements;
+  if (values->count < values->capacity) {
+    values->data[values->count++] = value;
+    return;
+  }
 
-    case vBOOL:
-      return saynaa_json_create_bool(AS_BOOL(item));
+  if (IS_OBJ(value))
+    vmPushTempRef(p->vm, AS_OBJ(value)); // value.
+  VarBufferWrite(values, p->vm, value);
+  if (IS_OBJ(value))
+    vmPopTempRef(p->vm); // value.
+}
 
-    case vNUMBER:
-      return saynaa_json_create_number(AS_NUM(item));
+// Parse the 4 hex digits of a \u escape.
+static bool _jsonParseHex(JsonParser* p, uint32_t* code) {
+  if (p->end - p->current < 4)
+    return false;
 
-    case vSTRING:
-      return saynaa_json_create_string(((String*) AS_OBJ(item))->data);
+  *code = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = *p->current++;
+    *code <<= 4;
+    if (c >= '0' && c <= '9')
+      *code |= (uint32_t) (c - '0');
+    else if (c >= 'a' && c <= 'f')
+      *code |= (uint32_t) (c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      *code |= (uint32_t) (c - 'A' + 10);
+    else
+      return false;
+  }
+  return true;
+}
 
-    case vLIST:
-      {
-        List* list = (List*) AS_OBJ(item);
-        saynaa_json* arr = saynaa_json_create_array();
+// Write the UTF-8 bytes of the \u escape (after the backslash) to the
+// buffer, which could be a surrogate pair of 2 escapes.
+static bool _jsonParseUnicode(JsonParser* p) {
+  uint32_t code;
+  if (!_jsonParseHex(p, &code))
+    return _jsonError(p, "invalid unicode escape");
 
-        bool err = false;
-        for (uint32_t i = 0; i < list->elements.count; i++) {
-          saynaa_json* elem = _saynaaToCJson(vm, list->elements.data[i]);
-          if (elem == NULL) {
-            err = true;
-            break;
-          };
-          saynaa_json_add_item_to_array(arr, elem);
-        }
+  if (code >= 0xd800 && code <= 0xdbff) {
+    uint32_t low;
+    if (p->end - p->current < 2 || p->current[0] != '\\' || p->current[1] != 'u')
+      return _jsonError(p, "invalid unicode surrogate pair");
+    p->current += 2;
+    if (!_jsonParseHex(p, &low) || low < 0xdc00 || low > 0xdfff)
+      return _jsonError(p, "invalid unicode surrogate pair");
+    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
 
-        if (err) {
-          saynaa_json_delete(arr);
+  } else if (code >= 0xdc00 && code <= 0xdfff) {
+    return _jsonError(p, "invalid unicode surrogate pair");
+  }
+
+  uint8_t bytes[4];
+  int count = utf8_encodeValue((int) code, bytes);
+  ByteBufferAddString(&p->buffer, p->vm, (const char*) bytes, (uint32_t) count);
+  return true;
+}
+
+// Returns the string for the [length] bytes of a key, reusing the one of the
+// key cache if it's the same.
+static String* _jsonKey(JsonParser* p, const char* data, uint32_t length) {
+  uint32_t hash = utilHashString(data, length);
+  Var* cached = &p->keys->elements.data[hash & (JSON_KEY_CACHE - 1)];
+
+  if (IS_OBJ(*cached)) {
+    String* key = (String*) AS_OBJ(*cached);
+    if (key->hash == hash && IS_CSTR_EQ(key, data, length))
+      return key;
+  }
+
+  String* key = newStringLength(p->vm, data, length);
+  key->hash = hash;
+  *cached = VAR_OBJ(key);
+  return key;
+}
+
+// Parse a string from the opening quote at the current character, which is
+// looked up in the key cache if it's an object [key]. Returns NULL on error.
+static String* _jsonParseString(JsonParser* p, bool key) {
+  const char* start = ++p->current;
+  size_t run = simdFindJsonSpecial(start, p->end - start);
+  p->current += run;
+
+  // The common case of a string without any escape.
+  if (p->current < p->end && *p->current == '"') {
+    p->current++;
+    if (key)
+      return _jsonKey(p, start, (uint32_t) run);
+    return newStringLength(p->vm, start, (uint32_t) run);
+  }
+
+  p->buffer.count = 0;
+  ByteBufferAddString(&p->buffer, p->vm, start, (uint32_t) run);
+
+  while (true) {
+    if (p->current >= p->end) {
+      _jsonError(p, "unterminated string");
+      return NULL;
+    }
+
+    char c = *p->current++;
+    if (c == '"')
+      break;
+
+    if (c != '\\') {
+      p->current--;
+      _jsonError(p, "control character in string");
+      return NULL;
+    }
+
+    if (p->current >= p->end) {
+      _jsonError(p, "unterminated string");
+      return NULL;
+    }
+
+    char escaped;
+    switch (*p->current++) {
+      case '"':
+        escaped = '"';
+        break;
+      case '\\':
+        escaped = '\\';
+        break;
+      case '/':
+        escaped = '/';
+        break;
+      case 'b':
+        escaped = '\b';
+        break;
+      case 'f':
+        escaped = '\f';
+        break;
+      case 'n':
+        escaped = '\n';
+        break;
+      case 'r':
+        escaped = '\r';
+        break;
+      case 't':
+        escaped = '\t';
+        break;
+      case 'u':
+        if (!_jsonParseUnicode(p))
           return NULL;
-        }
+        escaped = '\0';
+        break;
+      default:
+        p->current--;
+        _jsonError(p, "invalid escape character");
+        return NULL;
+    }
+    if (escaped != '\0')
+      ByteBufferWrite(&p->buffer, p->vm, (uint8_t) escaped);
 
-        return arr;
-      }
+    run = simdFindJsonSpecial(p->current, p->end - p->current);
+    ByteBufferAddString(&p->buffer, p->vm, p->current, (uint32_t) run);
+    p->current += run;
+  }
 
-    case vMAP:
-      {
-        Map* map = (Map*) AS_OBJ(item);
-        saynaa_json* obj = saynaa_json_create_object();
-
-        bool err = false;
-        MapEntry* e = map->entries;
-        for (; e < map->entries + map->capacity; e++) {
-          if (IS_UNDEF(e->key))
-            continue;
-
-          if (!IS_OBJ_TYPE(e->key, OBJ_STRING)) {
-            SetRuntimeErrorFmt(vm,
-                               "Expected string as json object key, "
-                               "instead got type '%s'.",
-                               varTypeName(e->key));
-            err = true;
-            break;
-          }
+  if (key)
+    return _jsonKey(p, (const char*) p->buffer.data, p->buffer.count);
+  return newStringLength(p->vm, (const char*) p->buffer.data, p->buffer.count);
+}
+
+// Parse a number at the current character. The integers are accumulated
+// directly and the others (with a fraction or an exponent) are converted by
+// strtod().
+static bool _jsonParseNumber(JsonParser* p, double* value) {
+  const char* start = p->current;
+  const char* c = start;
+  const char* end = p->end;
+
+  bool negative = (*c == '-');
+  if (negative)
+    c++;
+
+  const char* digits = c;
+  int64_t integer = 0;
+  if (c < end && *c == '0') {
+    c++;
+  } else if (c < end && *c >= '1' && *c <= '9') {
+    while (c < end && *c >= '0' && *c <= '9') {
+      integer = integer * 10 + (*c - '0');
+      c++;
+      if (c - digits > JSON_FAST_DIGITS)
+        integer = -1;
+    }
+  } else {
+    p->current = c;
+    return _jsonError(p, "invalid number");
+  }
+  bool fast = (c - digits <= JSON_FAST_DIGITS);
+
+  if (c < end && *c == '.') {
+    c++;
+    if (c >= end || *c < '0' || *c > '9') {
+      p->current = c;
+      return _jsonError(p, "invalid number");
+    }
+    while (c < end && *c >= '0' && *c <= '9')
+      c++;
+    fast = false;
+  }
+
+  if (c < end && (*c == 'e' || *c == 'E')) {
+    c++;
+    if (c < end && (*c == '+' || *c == '-'))
+      c++;
+    if (c >= end || *c < '0' || *c > '9') {
+      p->current = c;
+      return _jsonError(p, "invalid number");
+    }
+    while (c < end && *c >= '0' && *c <= '9')
+      c++;
+    fast = false;
+  }
+
+  p->current = c;
+  if (fast) {
+    *value = negative ? -(double) integer : (double) integer;
+    return true;
+  }
+
+  // The json isn't null terminated if it's a view of another string.
+  p->buffer.count = 0;
+  ByteBufferAddString(&p->buffer, p->vm, start, (uint32_t) (c - start));
+  ByteBufferWrite(&p->buffer, p->vm, '\0');
+  *value = strtod((const char*) p->buffer.data, NULL);
+  return true;
+}
+
+// Parse an object key with the colon after it and push it to the value
+// stack.
+static bool _jsonParseKey(JsonParser* p) {
+  if (!_jsonSkipSpace(p))
+    return _jsonError(p, "unexpected end");
+  if (*p->current != '"')
+    return _jsonError(p, "expected a string key");
+
+  String* key = _jsonParseString(p, true);
+  if (key == NULL)
+    return false;
+  _jsonPush(p, VAR_OBJ(key));
+
+  if (!_jsonSkipSpace(p))
+    return _jsonError(p, "unexpected end");
+  if (*p->current != ':')
+    return _jsonError(p, "expected ':'");
+  p->current++;
+  return true;
+}
 
-          saynaa_json* value = _saynaaToCJson(vm, e->value);
-          if (value == NULL) {
-            err = true;
+// Match the [literal] (true, false or null) at the current character.
+static bool _jsonParseLiteral(JsonParser* p, const char* literal, uint32_t length) {
+  if ((uint32_t) (p->end - p->current) < length
+      || memcmp(p->current, literal, length) != 0) {
+    return _jsonError(p, "invalid literal");
+  }
+  p->current += length;
+  return true;
+}
+
+// Build the container of the innermost open frame from its values at the top
+// of the value stack, which are replaced with it.
+static void _jsonCloseFrame(JsonParser* p) {
+  VM* vm = p->vm;
+  VarBuffer* values = &p->values->elements;
+  uint32_t frame = p->frames.data[--p->frames.count];
+  uint32_t start = frame >> 1;
+  uint32_t count = values->count - start;
+  Var* elements = values->data + start;
+
+  Var container;
+  if (frame & 1) {
+    Map* map = newMap(vm);
+    vmPushTempRef(vm, &map->_super); // map.
+    for (uint32_t i = 0; i < count; i += 2) {
+      mapSet(vm, map, elements[i], elements[i + 1]);
+    }
+    vmPopTempRef(vm); // map.
+    container = VAR_OBJ(map);
+
+  } else {
+    // The list is allocated with the exact size, the elements are still
+    // reachable from the value stack.
+    List* list = newList(vm, count);
+    if (count > 0) // The data of an empty list is NULL.
+      memcpy(list->elements.data, elements, count * sizeof(Var));
+    list->elements.count = count;
+    for (uint32_t i = 0; i < count; i++) {
+      LIST_TRACK_KIND(list, list->elements.data[i]);
+    }
+    container = VAR_OBJ(list);
+  }
+
+  values->count = start;
+  _jsonPush(p, container);
+}
+
+// Parse the json value and write it to the [result].
+static bool _jsonParseValue(JsonParser* p, Var* result) {
+  VM* vm = p->vm;
+
+  while (true) {
+    if (!_jsonSkipSpace(p))
+      return _jsonError(p, "unexpected end");
+
+    char c = *p->current;
+    switch (c) {
+      case '{':
+      case '[':
+        {
+          bool is_map = (c == '{');
+          p->current++;
+          UintBufferWrite(&p->frames, vm, (p->values->elements.count << 1) | is_map);
+          if (!_jsonSkipSpace(p))
+            return _jsonError(p, "unexpected end");
+
+          if (*p->current == (is_map ? '}' : ']')) {
+            p->current++;
+            _jsonCloseFrame(p);
             break;
           }
+          if (is_map && !_jsonParseKey(p))
+            return false;
+          continue;
+        }
 
-          saynaa_json_add_item_to_object(obj, ((String*) AS_OBJ(e->key))->data, value);
+      case '"':
+        {
+          String* str = _jsonParseString(p, false);
+          if (str == NULL)
+            return false;
+          _jsonPush(p, VAR_OBJ(str));
         }
+        break;
 
-        if (err) {
-          saynaa_json_delete(obj);
-          return NULL;
+      case 't':
+        if (!_jsonParseLiteral(p, "true", 4))
+          return false;
+        _jsonPush(p, VAR_TRUE);
+        break;
+
+      case 'f':
+        if (!_jsonParseLiteral(p, "false", 5))
+          return false;
+        _jsonPush(p, VAR_FALSE);
+        break;
+
+      case 'n':
+        if (!_jsonParseLiteral(p, "null", 4))
+          return false;
+        _jsonPush(p, VAR_NULL);
+        break;
+
+      default:
+        {
+          if (c != '-' && (c < '0' || c > '9'))
+            return _jsonError(p, "unexpected character");
+          double number;
+          if (!_jsonParseNumber(p, &number))
+            return false;
+          _jsonPush(p, VAR_NUM(number));
         }
+        break;
+    }
 
-        return obj;
+    // After a value, continue with the next value of the innermost container
+    // or close the containers which end after it.
+    while (true) {
+      if (p->frames.count == 0) {
+        *result = p->values->elements.data[0];
+        return true;
       }
 
-    default:
-      {
-        SetRuntimeErrorFmt(vm,
-                           "Object of type '%s' cannot be serialized "
-                           "to json.",
-                           varTypeName(item));
-        return NULL;
+      bool is_map = p->frames.data[p->frames.count - 1] & 1;
+      if (!_jsonSkipSpace(p))
+        return _jsonError(p, "unexpected end");
+
+      c = *p->current;
+      if (c == ',') {
+        p->current++;
+        if (is_map && !_jsonParseKey(p))
+          return false;
+        break;
       }
+
+      if (c != (is_map ? '}' : ']'))
+        return _jsonError(p, is_map ? "expected ',' or '}'" : "expected ',' or ']'");
+
+      p->current++;
+      _jsonCloseFrame(p);
+    }
+  }
+}
+
+// Parse the [length] bytes of the [json] and write the value to the
+// [result], on error it sets a runtime error and returns false.
+static bool _jsonParseText(VM* vm, const char* json, uint32_t length, Var* result) {
+  JsonParser parser;
+  parser.vm = vm;
+  parser.source = json;
+  parser.current = json;
+  parser.end = json + length;
+  ByteBufferInit(&parser.buffer);
+
+  UintBufferInit(&parser.frames);
+  parser.values = newList(vm, 64);
+  vmPushTempRef(vm, &parser.values->_super); // values.
+  parser.keys = newList(vm, JSON_KEY_CACHE);
+  vmPushTempRef(vm, &parser.keys->_super); // keys.
+  VarBufferFill(&parser.keys->elements, vm, VAR_NULL, JSON_KEY_CACHE);
+
+  bool ok = _jsonParseValue(&parser, result);
+  if (ok && _jsonSkipSpace(&parser)) {
+    ok = _jsonError(&parser, "unexpected character after the value");
   }
 
-  UNREACHABLE();
-  return NULL;
+  vmPopTempRef(vm); // keys.
+  vmPopTempRef(vm); // values.
+  UintBufferClear(&parser.frames, vm);
+  ByteBufferClear(&parser.buffer, vm);
+  return ok;
 }
 
-saynaa_function(_jsonParse, "json.parse(json_str:String) -> Var",
-                "Parse a json string into language object.") {
-  const char* string;
-  if (!ValidateSlotString(vm, 1, &string, NULL))
-    return;
+/*****************************************************************************/
+/* WRITER                                                                    */
+/*****************************************************************************/
+
+// The writer serializes the values directly to a byte buffer. Like the parser
+// it's not recursive, the open containers are kept in an explicit stack.
+
+// When writing to a file the buffer is flushed once it reaches this size, so
+// the extra memory doesn't depend on the size of the output.
+#define JSON_FLUSH_SIZE (64 * 1024)
+
+// A deleted entry of the path set (a NULL entry is empty).
+#define JSON_PATH_DELETED ((const Object*) 1)
+
+typedef struct {
+  const Object* container; //< The list or the map.
+  uint32_t index;          //< Index of the next element or entry.
+  bool empty;              //< True if no element is written yet.
+} JsonFrame;
+
+typedef struct {
+  VM* vm;
+  ByteBuffer* out; //< The output buffer.
+  FILE* fp;        //< The output is flushed to it if not NULL.
+  bool pretty;     //< Write new lines and indentations.
+
+  JsonFrame* frames; //< The open containers.
+  uint32_t depth;    //< Number of the open containers.
+  uint32_t frames_capacity;
+
+  // The open containers in a hash set of their addresses to detect the
+  // cycles. The [path_used] includes the deleted entries.
+  const Object** path;
+  uint32_t path_capacity;
+  uint32_t path_count;
+  uint32_t path_used;
+} JsonWriter;
+
+static inline uint32_t _jsonPathHash(const Object* obj) {
+  return (uint32_t) (((uintptr_t) obj >> 4) * 2654435761u);
+}
+
+// Rebuild the path set with the [capacity], which drops the deleted entries.
+static void _jsonPathResize(JsonWriter* w, uint32_t capacity) {
+  const Object** old = w->path;
+  uint32_t old_capacity = w->path_capacity;
+
+  w->path = Realloc(w->vm, NULL, capacity * sizeof(const Object*));
+  memset(w->path, 0, capacity * sizeof(const Object*));
+  w->path_capacity = capacity;
+  w->path_used = w->path_count;
+
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    if (old[i] == NULL || old[i] == JSON_PATH_DELETED)
+      continue;
+    uint32_t index = _jsonPathHash(old[i]) & (capacity - 1);
+    while (w->path[index] != NULL)
+      index = (index + 1) & (capacity - 1);
+    w->path[index] = old[i];
+  }
+  if (old != NULL)
+    Realloc(w->vm, old, 0);
+}
+
+// Add the [container] to the path, returns false if it's already there.
+static bool _jsonPathAdd(JsonWriter* w, const Object* container) {
+  if ((w->path_used + 1) * 4 > w->path_capacity * 3) {
+    uint32_t capacity = 16;
+    while (capacity < (w->path_count + 1) * 4)
+      capacity *= 2;
+    _jsonPathResize(w, capacity);
+  }
+
+  uint32_t mask = w->path_capacity - 1;
+  uint32_t index = _jsonPathHash(container) & mask;
+  while (w->path[index] != NULL) {
+    if (w->path[index] == container)
+      return false;
+    index = (index + 1) & mask;
+  }
+  w->path[index] = container;
+  w->path_count++;
+  w->path_used++;
+  return true;
+}
+
+static void _jsonPathRemove(JsonWriter* w, const Object* container) {
+  uint32_t mask = w->path_capacity - 1;
+  uint32_t index = _jsonPathHash(container) & mask;
+  while (w->path[index] != container)
+    index = (index + 1) & mask;
+  w->path[index] = JSON_PATH_DELETED;
+  w->path_count--;
+}
+
+static inline void _jsonWrite(JsonWriter* w, const char* data, uint32_t length) {
+  ByteBufferAddString(w->out, w->vm, data, length);
+}
+
+// Write a new line and the indentation of the current depth.
+static void _jsonWriteIndent(JsonWriter* w) {
+  ByteBufferWrite(w->out, w->vm, '\n');
+  ByteBufferFill(w->out, w->vm, '\t', (int) w->depth);
+}
+
+// Write the buffer to the file if it's large enough (or at the [end]).
+static bool _jsonFlush(JsonWriter* w, bool end) {
+  if (w->fp == NULL || (!end && w->out->count < JSON_FLUSH_SIZE))
+    return true;
+
+  VM* vm = w->vm;
+  size_t count = fwrite(w->out->data, 1, w->out->count, w->fp);
+  if (count != w->out->count) {
+    REPORT_ERRNO(fwrite);
+    return false;
+  }
+  w->out->count = 0;
+  return true;
+}
+
+// Write the [length] bytes of [data] as a json string. The runs of the bytes
+// which don't need to be escaped are found with SIMD and copied at once.
+static void _jsonWriteString(JsonWriter* w, const char* data, uint32_t length) {
+  static const char hex[] = "0123456789abcdef";
+
+  ByteBufferReserve(w->out, w->vm, (size_t) w->out->count + length + 2);
+  ByteBufferWrite(w->out, w->vm, '"');
+
+  while (true) {
+    size_t run = simdFindJsonSpecial(data, length);
+    _jsonWrite(w, data, (uint32_t) run);
+    data += run;
+    length -= (uint32_t) run;
+    if (length == 0)
+      break;
+
+    char c = *data++;
+    length--;
+    switch (c) {
+      case '"':
+        _jsonWrite(w, "\\\"", 2);
+        break;
+      case '\\':
+        _jsonWrite(w, "\\\\", 2);
+        break;
+      case '\b':
+        _jsonWrite(w, "\\b", 2);
+        break;
+      case '\f':
+        _jsonWrite(w, "\\f", 2);
+        break;
+      case '\n':
+        _jsonWrite(w, "\\n", 2);
+        break;
+      case '\r':
+        _jsonWrite(w, "\\r", 2);
+        break;
+      case '\t':
+        _jsonWrite(w, "\\t", 2);
+        break;
+      default:
+        {
+          char escape[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf]};
+          _jsonWrite(w, escape, 6);
+        }
+        break;
+    }
+  }
+
+  ByteBufferWrite(w->out, w->vm, '"');
+}
+
+// Write the [value] with the least of 15, 16 or 17 significant digits which
+// gives back the same double, the integers are written directly. A nan or an infinity isn't
+// valid json and is written as null.
+static void _jsonWriteNumber(JsonWriter* w, double value) {
+  char buff[32];
+  int length;
 
-  saynaa_json* tree = saynaa_json_parse(string);
+  if (isnan(value) || isinf(value)) {
+    _jsonWrite(w, "null", 4);
+    return;
+  }
 
-  if (tree == NULL) {
-    // TODO: Print the position.
-    // const char* position = cJSON_GetErrorPtr();
-    // if (position != NULL) ...
-    SetRuntimeError(vm, "Invalid json string");
+  if (value == floor(value) && fabs(value) < 1e15) {
+    int64_t integer = (int64_t) value;
+    uint64_t digits = (uint64_t) (integer < 0 ? -integer : integer);
+    char* end = buff + sizeof(buff);
+    char* c = end;
+    do {
+      *--c = (char) ('0' + digits % 10);
+      digits /= 10;
+    } while (digits != 0);
+    if (integer < 0 || signbit(value))
+      *--c = '-';
+    _jsonWrite(w, c, (uint32_t) (end - c));
     return;
   }
 
-  Var obj = _cJsonToSaynaa(vm, tree);
-  saynaa_json_delete(tree);
+  length = snprintf(buff, sizeof(buff), "%.15g", value);
+  if (strtod(buff, NULL) != value) {
+    length = snprintf(buff, sizeof(buff), "%.16g", value);
+    if (strtod(buff, NULL) != value)
+      length = snprintf(buff, sizeof(buff), "%.17g", value);
+  }
+  _jsonWrite(w, buff, (uint32_t) length);
+}
+
+// Write the [value] if it's a scalar, or write the opening of a list or a
+// map and push it to the stack of the writer.
+static bool _jsonWriteValue(JsonWriter* w, Var value) {
+  VM* vm = w->vm;
+
+  if (IS_NULL(value)) {
+    _jsonWrite(w, "null", 4);
+    return true;
+  }
+  if (IS_BOOL(value)) {
+    if (AS_BOOL(value))
+      _jsonWrite(w, "true", 4);
+    else
+      _jsonWrite(w, "false", 5);
+    return true;
+  }
+  if (IS_NUM(value)) {
+    _jsonWriteNumber(w, AS_NUM(value));
+    return true;
+  }
+
+  if (IS_OBJ_TYPE(value, OBJ_STRING)) {
+    const String* str = (const String*) AS_OBJ(value);
+    _jsonWriteString(w, str->data, str->length);
+    return true;
+  }
+
+  if (!IS_OBJ_TYPE(value, OBJ_LIST) && !IS_OBJ_TYPE(value, OBJ_MAP)) {
+    SetRuntimeErrorFmt(vm, "Object of type '%s' cannot be serialized to json.",
+                       varTypeName(value));
+    return false;
+  }
+
+  const Object* container = AS_OBJ(value);
+  if (!_jsonPathAdd(w, container)) {
+    SetRuntimeError(vm, "Cannot serialize a recursive value to json.");
+    return false;
+  }
 
-  // Json is a standard libray "std_json" and has the direct access
-  // to the vm's internal stack.
-  vm->fiber->ret[0] = obj;
+  if (w->depth == w->frames_capacity) {
+    uint32_t capacity = (w->frames_capacity == 0) ? 16 : w->frames_capacity * 2;
+    w->frames = Realloc(vm, w->frames, capacity * sizeof(JsonFrame));
+    w->frames_capacity = capacity;
+  }
+  JsonFrame* frame = &w->frames[w->depth++];
+  frame->container = container;
+  frame->index = 0;
+  frame->empty = true;
+
+  ByteBufferWrite(w->out, vm, (container->type == OBJ_LIST) ? '[' : '{');
+  return true;
+}
+
+// Write the element separator and the indentation before an element of the
+// innermost container.
+static void _jsonWriteSeparator(JsonWriter* w, JsonFrame* frame) {
+  if (!frame->empty)
+    ByteBufferWrite(w->out, w->vm, ',');
+  frame->empty = false;
+  if (w->pretty)
+    _jsonWriteIndent(w);
+}
+
+// Serialize the [value] to the writer's buffer.
+static bool _jsonWriteAll(JsonWriter* w, Var value) {
+  VM* vm = w->vm;
+  if (!_jsonWriteValue(w, value))
+    return false;
+
+  while (w->depth > 0) {
+    JsonFrame* frame = &w->frames[w->depth - 1];
+    bool is_list = (frame->container->type == OBJ_LIST);
+
+    if (is_list) {
+      const List* list = (const List*) frame->container;
+      if (frame->index < list->elements.count) {
+        _jsonWriteSeparator(w, frame);
+        // The frame could be reallocated by the value.
+        Var element = list->elements.data[frame->index++];
+        if (!_jsonWriteValue(w, element))
+          return false;
+        if (!_jsonFlush(w, false))
+          return false;
+        continue;
+      }
+
+    } else {
+      const Map* map = (const Map*) frame->container;
+      while (frame->index < map->capacity && IS_UNDEF(map->entries[frame->index].key)) {
+        frame->index++;
+      }
+
+      if (frame->index < map->capacity) {
+        const MapEntry* entry = &map->entries[frame->index++];
+        if (!IS_OBJ_TYPE(entry->key, OBJ_STRING)) {
+          SetRuntimeErrorFmt(vm,
+                             "Expected string as json object key, "
+                             "instead got type '%s'.",
+                             varTypeName(entry->key));
+          return false;
+        }
+
+        _jsonWriteSeparator(w, frame);
+        const String* key = (const String*) AS_OBJ(entry->key);
+        _jsonWriteString(w, key->data, key->length);
+        if (w->pretty)
+          _jsonWrite(w, ": ", 2);
+        else
+          ByteBufferWrite(w->out, vm, ':');
+
+        Var entry_value = entry->value;
+        if (!_jsonWriteValue(w, entry_value))
+          return false;
+        if (!_jsonFlush(w, false))
+          return false;
+        continue;
+      }
+    }
+
+    // Close the container.
+    bool empty = frame->empty;
+    _jsonPathRemove(w, frame->container);
+    w->depth--;
+    if (w->pretty && !empty)
+      _jsonWriteIndent(w);
+    ByteBufferWrite(w->out, vm, is_list ? ']' : '}');
+  }
+
+  return _jsonFlush(w, true);
+}
+
+// Serialize the [value] to the [out] buffer, which is flushed to the [fp] if
+// it's not NULL. On error it sets a runtime error and returns false.
+static bool _jsonDump(VM* vm, Var value, ByteBuffer* out, FILE* fp, bool pretty) {
+  JsonWriter writer;
+  memset(&writer, 0, sizeof(JsonWriter));
+  writer.vm = vm;
+  writer.out = out;
+  writer.fp = fp;
+  writer.pretty = pretty;
+
+  bool ok = _jsonWriteAll(&writer, value);
+
+  if (writer.frames != NULL)
+    Realloc(vm, writer.frames, 0);
+  if (writer.path != NULL)
+    Realloc(vm, writer.path, 0);
+  return ok;
+}
+
+/*****************************************************************************/
+/* MODULE FUNCTIONS                                                          */
+/*****************************************************************************/
+
+saynaa_function(_jsonParse, "json.parse(json_str:String) -> Var",
+                "Parse a json string into language object.") {
+  if (!ValidateSlotString(vm, 1, NULL, NULL))
+    return;
+
+  // The string isn't materialized since the parser doesn't need a null
+  // terminator, a view of a larger string is parsed in place.
+  String* json = (String*) AS_OBJ(vm->fiber->ret[1]);
+  Var value;
+  if (_jsonParseText(vm, json->data, json->length, &value)) {
+    // Json is a standard libray "std_json" and has the direct access
+    // to the vm's internal stack.
+    vm->fiber->ret[0] = value;
+  }
 }
 
 saynaa_function(
-    _jsonPrint, "json.print(value:Var, pretty:Bool=false)",
+    _jsonPrint, "json.print(value:Var, pretty:Bool=false) -> String",
     "Render a value into text. Takes an optional argument pretty, if "
     "true it'll pretty print the output.") {
   int argc = GetArgc(vm);
@@ -208,23 +893,558 @@ saynaa_function(
       return;
   }
 
+  ByteBuffer buff;
+  ByteBufferInit(&buff);
+  if (_jsonDump(vm, vm->fiber->ret[1], &buff, NULL, pretty)) {
+    setSlotStringLength(vm, 0, (const char*) buff.data, buff.count);
+  }
+  ByteBufferClear(&buff, vm);
+}
+
+saynaa_function(
+    _jsonDumpTo, "json.dump(value:Var, target:ByteBuffer|File, pretty:Bool=false) -> Null",
+    "Serialize the value to json at the end of the [target], which is a "
+    "types.ByteBuffer or an io.File opened for writing. It's written to a file "
+    "in chunks, so the memory used doesn't depend on the size of the json.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 2, 3))
+    return;
+
+  bool pretty = false;
+  if (argc == 3) {
+    if (!ValidateSlotBool(vm, 3, &pretty))
+      return;
+  }
+
   Var value = vm->fiber->ret[1];
-  saynaa_json* json = _saynaaToCJson(vm, value);
+  Var target = vm->fiber->ret[2];
 
-  // A runtime error already set.
-  if (json == NULL)
+  ByteBuffer* buff = typesGetByteBuffer(target);
+  if (buff != NULL) {
+    // Don't leave a partial json in the buffer on error.
+    uint32_t count = buff->count;
+    if (!_jsonDump(vm, value, buff, NULL, pretty))
+      buff->count = count;
     return;
+  }
 
-  char* string = (pretty) ? saynaa_json_print(json) : saynaa_json_print_unformatted(json);
-  saynaa_json_delete(json);
+  FILE* fp;
+  if (ioGetFile(vm, target, true, &fp)) {
+    if (fp == NULL)
+      return;
 
-  if (string == NULL) {
-    SetRuntimeError(vm, "Failed to print json.");
+    ByteBuffer chunk;
+    ByteBufferInit(&chunk);
+    _jsonDump(vm, value, &chunk, fp, pretty);
+    ByteBufferClear(&chunk, vm);
     return;
   }
 
-  setSlotString(vm, 0, string);
-  free(string);
+  SetRuntimeErrorFmt(vm, "Expected a types.ByteBuffer or an io.File as the target, "
+                         "instead got type '%s'.",
+                     varTypeName(target));
+}
+
+/*****************************************************************************/
+/* READER                                                                    */
+/*****************************************************************************/
+
+// The reader pulls the json from its source in chunks and parses a single
+// value at a time, the consumed bytes are dropped from its buffer so the
+// memory used is bounded by the largest value read at once and not by the
+// size of the source. The structure can also be walked as a stream of events
+// to skip the values which aren't needed without building them.
+
+// The number of bytes read from a file at once.
+#define JSON_READ_CHUNK (64 * 1024)
+
+// What the reader expects next in the source.
+typedef enum {
+  JSON_EXPECT_VALUE,        //< A top level value or the end of the source.
+  JSON_EXPECT_ITEM_OR_END,  //< The first element of a list or ']'.
+  JSON_EXPECT_ITEM,         //< A list element after a comma.
+  JSON_EXPECT_KEY_OR_END,   //< The first key of a map or '}'.
+  JSON_EXPECT_KEY,          //< A map key after a comma.
+  JSON_EXPECT_MAP_VALUE,    //< The value of a key (the colon is consumed).
+  JSON_EXPECT_COMMA_OR_END, //< A comma or the end of the open container.
+} JsonExpect;
+
+typedef enum {
+  JSON_EVENT_ERROR = -1,
+  JSON_EVENT_NONE, // The end of the source.
+  JSON_EVENT_START_MAP,
+  JSON_EVENT_END_MAP,
+  JSON_EVENT_START_LIST,
+  JSON_EVENT_END_LIST,
+  JSON_EVENT_MAP_KEY,
+  JSON_EVENT_VALUE,
+} JsonEvent;
+
+static const char* _json_event_names[] = {
+  NULL, "start_map", "end_map", "start_list", "end_list", "map_key", "value",
+};
+
+typedef struct {
+  Handle* source;  //< The io.File, the String or the function.
+  Handle* current; //< The value of the current iteration.
+
+  char* data;        //< The buffered json (a String source's own data).
+  uint32_t start;    //< Start of the bytes which aren't consumed yet.
+  uint32_t end;      //< End of the buffered bytes.
+  uint32_t capacity; //< Capacity of the buffer, 0 if it's a String's data.
+  bool eof;          //< True if there is nothing more to read from the source.
+
+  ByteBuffer frames; //< The open containers, '[' or '{'.
+  JsonExpect expect;
+} JsonReader;
+
+static void _readerReserve(VM* vm, JsonReader* r, uint32_t size) {
+  if (r->capacity - r->end >= size)
+    return;
+  uint32_t capacity = r->capacity * 2;
+  if (capacity < r->end + size)
+    capacity = r->end + size;
+  r->data = Realloc(vm, r->data, capacity);
+  r->capacity = capacity;
+}
+
+// Read more of the source to the buffer. Returns false if there is nothing
+// more to read or on error (check VM_HAS_ERROR()). The unconsumed bytes are
+// moved to the start of the buffer, so the pointers to it are invalidated.
+static bool _readerFill(VM* vm, JsonReader* r) {
+  if (r->eof)
+    return false;
+
+  if (r->start > 0) {
+    memmove(r->data, r->data + r->start, r->end - r->start);
+    r->end -= r->start;
+    r->start = 0;
+  }
+
+  Var source = r->source->value;
+  FILE* fp;
+  if (ioGetFile(vm, source, false, &fp)) {
+    if (fp == NULL)
+      return false;
+
+    _readerReserve(vm, r, JSON_READ_CHUNK);
+    size_t count = fread(r->data + r->end, 1, r->capacity - r->end, fp);
+    if (count == 0) {
+      if (ferror(fp)) {
+        REPORT_ERRNO(fread);
+        return false;
+      }
+      r->eof = true;
+      return false;
+    }
+    r->end += (uint32_t) count;
+    return true;
+  }
+
+  // The source is a function which returns the chunks, an empty string is
+  // skipped and null is the end of the source.
+  while (true) {
+    Var chunk;
+    if (vmCallFunction(vm, (Closure*) AS_OBJ(source), 0, NULL, &chunk) != RESULT_SUCCESS)
+      return false;
+
+    if (IS_NULL(chunk)) {
+      r->eof = true;
+      return false;
+    }
+
+    if (!IS_OBJ_TYPE(chunk, OBJ_STRING)) {
+      SetRuntimeErrorFmt(vm, "Expected a String or null from the json source, "
+                             "instead got type '%s'.",
+                         varTypeName(chunk));
+      return false;
+    }
+
+    String* str = (String*) AS_OBJ(chunk);
+    if (str->length == 0)
+      continue;
+
+    vmPushTempRef(vm, &str->_super); // str.
+    _readerReserve(vm, r, str->length);
+    vmPopTempRef(vm); // str.
+
+    memcpy(r->data + r->end, str->data, str->length);
+    r->end += str->length;
+    return true;
+  }
+}
+
+// Skip the white spaces and return the next character without consuming it,
+// -1 if it's the end of the source or on error.
+static int _readerPeek(VM* vm, JsonReader* r) {
+  while (true) {
+    if (r->start < r->end) {
+      r->start += (uint32_t) simdSkipJsonSpace(r->data + r->start, r->end - r->start);
+      if (r->start < r->end)
+        return (unsigned char) r->data[r->start];
+    }
+    if (!_readerFill(vm, r))
+      return -1;
+  }
+}
+
+static bool _readerUnexpectedEnd(VM* vm) {
+  if (!VM_HAS_ERROR(vm))
+    SetRuntimeError(vm, "Invalid json stream, unexpected end of the source.");
+  return false;
+}
+
+// Find the length of the value at the start of the buffer, reading more of
+// the source till it's complete. Only the strings and the nesting are
+// tracked, the value is validated by the parser.
+static bool _readerScan(VM* vm, JsonReader* r, uint32_t* length) {
+  char first = r->data[r->start];
+  bool scalar = first != '{' && first != '[' && first != '"';
+  bool in_string = first == '"';
+  uint32_t depth = (scalar || in_string) ? 0 : 1, i = 1;
+
+  while (true) {
+    const char* data = r->data + r->start;
+    uint32_t size = r->end - r->start;
+
+    while (i < size) {
+      if (in_string) {
+        i += (uint32_t) simdFindJsonSpecial(data + i, size - i);
+        if (i >= size)
+          break;
+
+        if (data[i] == '\\') {
+          if (i + 1 >= size)
+            break; // Read the escaped character first.
+          i += 2;
+          continue;
+        }
+
+        if (data[i] == '"') {
+          in_string = false;
+          if (depth == 0) {
+            *length = i + 1;
+            return true;
+          }
+        }
+        i++; // A control character is reported by the parser.
+        continue;
+      }
+
+      char c = data[i];
+      if (scalar) {
+        if (c == ',' || c == ']' || c == '}' || c == ' ' || c == '\n' || c == '\r'
+            || c == '\t') {
+          *length = i;
+          return true;
+        }
+      } else if (c == '"') {
+        in_string = true;
+      } else if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) {
+          *length = i + 1;
+          return true;
+        }
+      }
+      i++;
+    }
+
+    if (!_readerFill(vm, r)) {
+      if (scalar && !VM_HAS_ERROR(vm)) {
+        *length = i;
+        return true;
+      }
+      return _readerUnexpectedEnd(vm);
+    }
+  }
+}
+
+// Consume the value at the start of the buffer, it's parsed to [value]
+// unless it's NULL.
+static bool _readerConsume(VM* vm, JsonReader* r, Var* value) {
+  uint32_t length;
+  if (!_readerScan(vm, r, &length))
+    return false;
+  if (value != NULL && !_jsonParseText(vm, r->data + r->start, length, value))
+    return false;
+  r->start += length;
+  return true;
+}
+
+static inline char _readerFrame(const JsonReader* r) {
+  return (r->frames.count == 0) ? '\0' : (char) r->frames.data[r->frames.count - 1];
+}
+
+static inline void _readerValueDone(JsonReader* r) {
+  r->expect = (r->frames.count == 0) ? JSON_EXPECT_VALUE : JSON_EXPECT_COMMA_OR_END;
+}
+
+// Consume the closing character of the open container.
+static JsonEvent _readerClose(JsonReader* r) {
+  char frame = _readerFrame(r);
+  r->start++;
+  r->frames.count--;
+  _readerValueDone(r);
+  return (frame == '{') ? JSON_EVENT_END_MAP : JSON_EVENT_END_LIST;
+}
+
+static JsonEvent _readerNextEvent(VM* vm, JsonReader* r, Var* value) {
+  while (true) {
+    int c = _readerPeek(vm, r);
+    if (c < 0) {
+      if (r->expect == JSON_EXPECT_VALUE && !VM_HAS_ERROR(vm))
+        return JSON_EVENT_NONE;
+      _readerUnexpectedEnd(vm);
+      return JSON_EVENT_ERROR;
+    }
+
+    switch (r->expect) {
+      case JSON_EXPECT_COMMA_OR_END: {
+        char frame = _readerFrame(r);
+        if (c == ',') {
+          r->start++;
+          r->expect = (frame == '{') ? JSON_EXPECT_KEY : JSON_EXPECT_ITEM;
+          continue;
+        }
+        if (c == ((frame == '{') ? '}' : ']'))
+          return _readerClose(r);
+        SetRuntimeErrorFmt(vm, "Invalid json stream, expected ',' or '%c'.",
+                           (frame == '{') ? '}' : ']');
+        return JSON_EVENT_ERROR;
+      }
+
+      case JSON_EXPECT_KEY_OR_END:
+      case JSON_EXPECT_KEY:
+        if (c == '}' && r->expect == JSON_EXPECT_KEY_OR_END)
+          return _readerClose(r);
+        if (c != '"') {
+          SetRuntimeError(vm, "Invalid json stream, expected a string key.");
+          return JSON_EVENT_ERROR;
+        }
+        if (!_readerConsume(vm, r, value))
+          return JSON_EVENT_ERROR;
+        if (_readerPeek(vm, r) != ':') {
+          if (!VM_HAS_ERROR(vm))
+            SetRuntimeError(vm, "Invalid json stream, expected ':'.");
+          return JSON_EVENT_ERROR;
+        }
+        r->start++;
+        r->expect = JSON_EXPECT_MAP_VALUE;
+        return JSON_EVENT_MAP_KEY;
+
+      case JSON_EXPECT_ITEM_OR_END:
+        if (c == ']')
+          return _readerClose(r);
+        // Fall through.
+
+      default:
+        if (c == '{' || c == '[') {
+          r->start++;
+          ByteBufferWrite(&r->frames, vm, (uint8_t) c);
+          r->expect = (c == '{') ? JSON_EXPECT_KEY_OR_END : JSON_EXPECT_ITEM_OR_END;
+          return (c == '{') ? JSON_EVENT_START_MAP : JSON_EVENT_START_LIST;
+        }
+        if (!_readerConsume(vm, r, value))
+          return JSON_EVENT_ERROR;
+        _readerValueDone(r);
+        return JSON_EVENT_VALUE;
+    }
+  }
+}
+
+// Read the next whole value to [value] (skip it if NULL). Returns 1 if there
+// was a value, 0 if it's the end of the source or the end of the open list
+// (which isn't consumed) and -1 on error.
+static int _readerNextValue(VM* vm, JsonReader* r, Var* value) {
+  int c = _readerPeek(vm, r);
+  if (c < 0) {
+    if (r->expect == JSON_EXPECT_VALUE && !VM_HAS_ERROR(vm))
+      return 0;
+    _readerUnexpectedEnd(vm);
+    return -1;
+  }
+
+  switch (r->expect) {
+    case JSON_EXPECT_KEY_OR_END:
+    case JSON_EXPECT_KEY:
+      SetRuntimeError(vm, "Cannot read a map key as a value, use event() instead.");
+      return -1;
+
+    case JSON_EXPECT_COMMA_OR_END:
+      if (_readerFrame(r) == '{') {
+        SetRuntimeError(vm, "Cannot read a map key as a value, use event() instead.");
+        return -1;
+      }
+      if (c == ']')
+        return 0;
+      if (c != ',') {
+        SetRuntimeError(vm, "Invalid json stream, expected ',' or ']'.");
+        return -1;
+      }
+      r->start++;
+      r->expect = JSON_EXPECT_ITEM;
+      if ((c = _readerPeek(vm, r)) < 0) {
+        _readerUnexpectedEnd(vm);
+        return -1;
+      }
+      break;
+
+    case JSON_EXPECT_ITEM_OR_END:
+      if (c == ']')
+        return 0;
+      break;
+
+    default:
+      break;
+  }
+
+  if (!_readerConsume(vm, r, value))
+    return -1;
+  _readerValueDone(r);
+  return 1;
+}
+
+static void* _readerNew(VM* vm) {
+  JsonReader* reader = Realloc(vm, NULL, sizeof(JsonReader));
+  memset(reader, 0, sizeof(JsonReader));
+  ByteBufferInit(&reader->frames);
+  return reader;
+}
+
+static void _readerDelete(VM* vm, void* ptr) {
+  JsonReader* reader = (JsonReader*) ptr;
+  if (reader->source != NULL)
+    releaseHandle(vm, reader->source);
+  if (reader->current != NULL)
+    releaseHandle(vm, reader->current);
+  if (reader->capacity > 0)
+    Realloc(vm, reader->data, 0);
+  ByteBufferClear(&reader->frames, vm);
+  Realloc(vm, reader, 0);
+}
+
+static JsonReader* _readerThis(VM* vm) {
+  JsonReader* reader = GetThis(vm);
+  if (reader->source == NULL) {
+    SetRuntimeError(vm, "The json reader has no source.");
+    return NULL;
+  }
+  return reader;
+}
+
+saynaa_function(_readerInit, "json.Reader._init(source:File|String|Function) -> Null",
+                "Create a reader of the json values in [source], which is an "
+                "io.File opened for reading, a String or a function which returns "
+                "the json in chunks of String and null at the end.") {
+  Var source = vm->fiber->ret[1];
+
+  FILE* fp;
+  bool is_file = ioGetFile(vm, source, false, &fp);
+  if (is_file && fp == NULL)
+    return;
+
+  if (!is_file && !IS_OBJ_TYPE(source, OBJ_STRING) && !IS_OBJ_TYPE(source, OBJ_CLOSURE)) {
+    SetRuntimeErrorFmt(vm, "Expected an io.File, a String or a function as the "
+                           "json source, instead got type '%s'.",
+                       varTypeName(source));
+    return;
+  }
+
+  JsonReader* reader = GetThis(vm);
+  if (reader->source != NULL) {
+    SetRuntimeError(vm, "The json reader is already initialized.");
+    return;
+  }
+
+  reader->source = GetSlotHandle(vm, 1);
+  reader->current = vmNewHandle(vm, VAR_NULL);
+  if (IS_OBJ_TYPE(source, OBJ_STRING)) {
+    // The string is immutable, the reader uses its data as the buffer.
+    String* str = (String*) AS_OBJ(source);
+    reader->data = str->data;
+    reader->end = str->length;
+    reader->eof = true;
+  }
+}
+
+saynaa_function(_readerRead, "json.Reader.read() -> Var",
+                "Read the next value, which is the next top level value of the "
+                "source, the next element of the list or the value of the "
+                "key when it's walked with event().") {
+  JsonReader* reader = _readerThis(vm);
+  if (reader == NULL)
+    return;
+
+  Var value;
+  int result = _readerNextValue(vm, reader, &value);
+  if (result == 0)
+    SetRuntimeError(vm, "There is no json value to read.");
+  else if (result > 0)
+    vm->fiber->ret[0] = value;
+}
+
+saynaa_function(_readerSkip, "json.Reader.skip() -> Null",
+                "Skip the next value (same as read()) without building it.") {
+  JsonReader* reader = _readerThis(vm);
+  if (reader == NULL)
+    return;
+
+  if (_readerNextValue(vm, reader, NULL) == 0)
+    SetRuntimeError(vm, "There is no json value to skip.");
+}
+
+saynaa_function(_readerEvent, "json.Reader.event() -> List",
+                "Returns the next event as a list of [name, value] or null at "
+                "the end of the source. The name is one of 'start_map', "
+                "'end_map', 'start_list', 'end_list', 'map_key' and 'value', "
+                "the value is the key or the value, otherwise null.") {
+  JsonReader* reader = _readerThis(vm);
+  if (reader == NULL)
+    return;
+
+  Var value = VAR_NULL;
+  JsonEvent event = _readerNextEvent(vm, reader, &value);
+  if (event <= JSON_EVENT_NONE)
+    return;
+
+  if (IS_OBJ(value))
+    vmPushTempRef(vm, AS_OBJ(value)); // value.
+  List* list = newList(vm, 2);
+  vmPushTempRef(vm, &list->_super); // list.
+  listAppend(vm, list, VAR_OBJ(newString(vm, _json_event_names[event])));
+  listAppend(vm, list, value);
+  vmPopTempRef(vm); // list.
+  if (IS_OBJ(value))
+    vmPopTempRef(vm); // value.
+
+  vm->fiber->ret[0] = VAR_OBJ(list);
+}
+
+// The reader iterates over the top level values of the source, or the
+// elements of a list if it's just started with event(), in which case the
+// end of the list is left for the next event() to return as 'end_list'.
+saynaa_function(_readerNext, "json.Reader._next(iterator:Var) -> Bool", "") {
+  JsonReader* reader = _readerThis(vm);
+  if (reader == NULL)
+    return;
+
+  Var value;
+  int result = _readerNextValue(vm, reader, &value);
+  if (result > 0) {
+    reader->current->value = value;
+    vm->fiber->ret[0] = VAR_TRUE;
+    return;
+  }
+
+  reader->current->value = VAR_NULL;
+  vm->fiber->ret[0] = VAR_NULL;
+}
+
+saynaa_function(_readerValue, "json.Reader._value(iterator:Var) -> Var", "") {
+  JsonReader* reader = GetThis(vm);
+  vm->fiber->ret[0] = (reader->current != NULL) ? reader->current->value : VAR_NULL;
 }
 
 /*****************************************************************************/
@@ -236,6 +1456,18 @@ void registerModuleJson(VM* vm) {
 
   REGISTER_FN(json, "parse", _jsonParse, 1);
   REGISTER_FN(json, "print", _jsonPrint, -1);
+  REGISTER_FN(json, "dump", _jsonDumpTo, -1);
+
+  Handle* cls_reader = NewClass(vm, "Reader", NULL, json, _readerNew, _readerDelete,
+                                "An incremental reader of json values from a file, "
+                                "a string or a function returning chunks.");
+  ADD_METHOD(cls_reader, "_init", _readerInit, 1);
+  ADD_METHOD(cls_reader, "read", _readerRead, 0);
+  ADD_METHOD(cls_reader, "skip", _readerSkip, 0);
+  ADD_METHOD(cls_reader, "event", _readerEvent, 0);
+  ADD_METHOD(cls_reader, "_next", _readerNext, 1);
+  ADD_METHOD(cls_reader, "_value", _readerValue, 1);
+  releaseHandle(vm, cls_reader);
 
   registerModule(vm, json);
   releaseHandle(vm, json);
@@ -53,6 +53,20 @@
 #include <unistd.h>
 #endif
 
+// Child processes are spawned with posix_spawn(), see the SUBPROCESS section.
+#if !defined(_OS_WIN_) && !defined(_OS_WEB_)
+#define OS_HAS_SPAWN
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
 // The maximum path size that default import system supports
 // including the null terminator. To be able to support more characters
 // override the functions from the host application. Since this is very much
@@ -163,41 +177,6 @@ saynaa_function(_osFileSize, "os.filesize(path:String) -> Number",
   setSlotNumber(vm, 0, path_stat.st_size);
 }
 
-#if defined(__linux__)
-saynaa_function(_osExec, "os.exec(cmd:String) -> String",
-                "Execute the command and return "
-                "output.") {
-  const char* cmd;
-  if (!ValidateSlotString(vm, 1, &cmd, NULL))
-    return;
-
-  FILE* fp;
-  char* result = NULL;
-  char buffer[128];
-
-  fp = popen(cmd, "r"); // Add the mode "r" to open the pipe for reading
-  if (fp == NULL) {
-    // printf("Failed to execute the command.\n");
-    setSlotNull(vm, 0);
-    return;
-  }
-
-  // Read the output of the command
-  if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-    // Allocate memory for the result and copy the output
-    result = strdup(buffer);
-    // Remove the trailing newline character, if present
-    size_t len = strlen(result);
-    if (len > 0 && result[len - 1] == '\n') {
-      result[len - 1] = '\0';
-    }
-  }
-
-  pclose(fp);
-  setSlotString(vm, 0, result);
-}
-#endif
-
 saynaa_function(
     _osSystem, "os.system(cmd:String) -> Number",
     "Execute the command in a subprocess, Returns the exit code of the child "
@@ -276,6 +255,581 @@ List* Arguments(VM* vm) {
   return list;
 }
 
+/*****************************************************************************/
+/* SUBPROCESS                                                                */
+/*****************************************************************************/
+
+#if defined(OS_HAS_SPAWN)
+
+// The size of the chunks read from the pipes of a process.
+#define PROCESS_CHUNK_SIZE (64 * 1024)
+
+// A child process spawned with posix_spawn() and connected to the parent with
+// pipes for its stdin, stdout and stderr. The pipes are read and written
+// incrementally, and a read can return immediately if the output isn't ready
+// yet, so a fiber can yield to the others while the process is running.
+typedef struct {
+  pid_t pid;     // Process id, -1 if it's not spawned.
+  int fds[3];    // The parent's ends of stdin, stdout and stderr or -1.
+  bool exited;   // True if the process is waited.
+  int exit_code; // Exit code, or the negative signal number which killed it.
+} Process;
+
+static void* _processNew(VM* vm) {
+  Process* proc = Realloc(vm, NULL, sizeof(Process));
+  proc->pid = -1;
+  proc->fds[0] = proc->fds[1] = proc->fds[2] = -1;
+  proc->exited = false;
+  proc->exit_code = 0;
+  return proc;
+}
+
+static void _processCloseFd(Process* proc, int index) {
+  if (proc->fds[index] >= 0)
+    close(proc->fds[index]);
+  proc->fds[index] = -1;
+}
+
+static void _processSetStatus(Process* proc, int status) {
+  proc->exited = true;
+  if (WIFSIGNALED(status))
+    proc->exit_code = -WTERMSIG(status);
+  else
+    proc->exit_code = WEXITSTATUS(status);
+}
+
+// Update the exit status of the process if it has exited, or wait for it if
+// [block] is true. Returns false on error.
+static bool _processReap(VM* vm, Process* proc, bool block) {
+  if (proc->exited || proc->pid < 0)
+    return true;
+
+  int status;
+  pid_t pid;
+  do {
+    pid = waitpid(proc->pid, &status, block ? 0 : WNOHANG);
+  } while (pid < 0 && errno == EINTR);
+
+  if (pid < 0) {
+    REPORT_ERRNO(waitpid);
+    return false;
+  }
+  if (pid == proc->pid)
+    _processSetStatus(proc, status);
+  return true;
+}
+
+static void _processDelete(VM* vm, void* ptr) {
+  Process* proc = (Process*) ptr;
+  for (int i = 0; i < 3; i++)
+    _processCloseFd(proc, i);
+
+  // Reap the process if it's already exited, a running process isn't killed
+  // since it could be meant to outlive the handle.
+  if (!proc->exited && proc->pid > 0) {
+    int status;
+    waitpid(proc->pid, &status, WNOHANG);
+  }
+  Realloc(vm, proc, 0);
+}
+
+// Returns the number of bytes which can be read from [fd] without blocking
+// (at least 1, or 0 if nothing is ready and [block] is false), -1 on error.
+static int _processReady(VM* vm, int fd, bool block) {
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  int rc;
+  do {
+    rc = poll(&pfd, 1, block ? -1 : 0);
+  } while (rc < 0 && errno == EINTR);
+  if (rc < 0) {
+    REPORT_ERRNO(poll);
+    return -1;
+  }
+  return rc;
+}
+
+// Read up to [count] bytes of the pipe at [index] to the end of [buff].
+// Returns the number of bytes read, 0 at the end of the pipe (which closes
+// it) and -1 on error.
+static int64_t _processReadTo(VM* vm, Process* proc, int index, ByteBuffer* buff,
+                              uint32_t count) {
+  ByteBufferReserve(buff, vm, (size_t) buff->count + count);
+
+  ssize_t n;
+  do {
+    n = read(proc->fds[index], buff->data + buff->count, count);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0) {
+    REPORT_ERRNO(read);
+    return -1;
+  }
+  if (n == 0)
+    _processCloseFd(proc, index);
+  buff->count += (uint32_t) n;
+  return (int64_t) n;
+}
+
+// Write the [data] to the stdin of the process. A closed pipe is an error and
+// not a SIGPIPE which would terminate the interpreter.
+static bool _processWriteAll(VM* vm, Process* proc, const char* data, size_t length) {
+  void (*handler)(int) = signal(SIGPIPE, SIG_IGN);
+  bool success = true;
+
+  while (length > 0) {
+    ssize_t n = write(proc->fds[0], data, length);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      REPORT_ERRNO(write);
+      success = false;
+      break;
+    }
+    data += n;
+    length -= (size_t) n;
+  }
+
+  signal(SIGPIPE, handler);
+  return success;
+}
+
+// Spawn the process of [argv] (a NULL terminated array) with the [envp] or
+// the environment of the parent if it's NULL.
+static bool _processSpawn(VM* vm, Process* proc, char** argv, char** envp) {
+  int pipes[3][2] = { { -1, -1 }, { -1, -1 }, { -1, -1 } };
+  for (int i = 0; i < 3; i++) {
+    if (pipe(pipes[i]) != 0) {
+      REPORT_ERRNO(pipe);
+      for (int j = 0; j < i; j++) {
+        close(pipes[j][0]);
+        close(pipes[j][1]);
+      }
+      return false;
+    }
+  }
+
+  // The child's ends are 0 of stdin and 1 of stdout, stderr.
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, pipes[0][0], 0);
+  posix_spawn_file_actions_adddup2(&actions, pipes[1][1], 1);
+  posix_spawn_file_actions_adddup2(&actions, pipes[2][1], 2);
+  for (int i = 0; i < 3; i++) {
+    posix_spawn_file_actions_addclose(&actions, pipes[i][0]);
+    posix_spawn_file_actions_addclose(&actions, pipes[i][1]);
+  }
+
+  // The parent's ends shouldn't be inherited by the other children.
+  int parent_fds[3] = { pipes[0][1], pipes[1][0], pipes[2][0] };
+  for (int i = 0; i < 3; i++)
+    fcntl(parent_fds[i], F_SETFD, FD_CLOEXEC);
+
+  pid_t pid;
+  int rc = posix_spawnp(&pid, argv[0], &actions, NULL, argv,
+                        (envp != NULL) ? envp : environ);
+  posix_spawn_file_actions_destroy(&actions);
+
+  close(pipes[0][0]);
+  close(pipes[1][1]);
+  close(pipes[2][1]);
+
+  if (rc != 0) {
+    for (int i = 0; i < 3; i++)
+      close(parent_fds[i]);
+    SetRuntimeErrorFmt(vm, "Cannot spawn '%s': %s.", argv[0], strerror(rc));
+    return false;
+  }
+
+  proc->pid = pid;
+  for (int i = 0; i < 3; i++)
+    proc->fds[i] = parent_fds[i];
+  return true;
+}
+
+// Write the [input] to the process while reading its stdout and stderr to
+// the buffers, without blocking on one of them while the process waits for
+// the other, and wait for it to exit.
+static bool _processExchange(VM* vm, Process* proc, const char* input,
+                                size_t input_length, ByteBuffer* out, ByteBuffer* err) {
+  void (*handler)(int) = signal(SIGPIPE, SIG_IGN);
+  bool success = true;
+
+  if (input_length == 0)
+    _processCloseFd(proc, 0);
+
+  while (success && (proc->fds[0] >= 0 || proc->fds[1] >= 0 || proc->fds[2] >= 0)) {
+    struct pollfd pfds[3];
+    int nfds = 0;
+    for (int i = 0; i < 3; i++) {
+      if (proc->fds[i] < 0)
+        continue;
+      pfds[nfds].fd = proc->fds[i];
+      pfds[nfds].events = (i == 0) ? POLLOUT : POLLIN;
+      pfds[nfds].revents = 0;
+      nfds++;
+    }
+
+    if (poll(pfds, (nfds_t) nfds, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      REPORT_ERRNO(poll);
+      success = false;
+      break;
+    }
+
+    for (int i = 0; i < nfds && success; i++) {
+      if (pfds[i].revents == 0)
+        continue;
+
+      if (pfds[i].fd == proc->fds[0]) {
+        // A pipe is writable if a write of PIPE_BUF bytes doesn't block.
+        size_t size = (input_length < PIPE_BUF) ? input_length : PIPE_BUF;
+        ssize_t n = write(proc->fds[0], input, size);
+        if (n < 0 && errno != EINTR && errno != EAGAIN) {
+          // The process doesn't read the rest of the input (EPIPE).
+          _processCloseFd(proc, 0);
+        } else if (n > 0) {
+          input += n;
+          input_length -= (size_t) n;
+          if (input_length == 0)
+            _processCloseFd(proc, 0);
+        }
+
+      } else {
+        int index = (pfds[i].fd == proc->fds[1]) ? 1 : 2;
+        if (_processReadTo(vm, proc, index, (index == 1) ? out : err,
+                           PROCESS_CHUNK_SIZE) < 0)
+          success = false;
+      }
+    }
+  }
+
+  signal(SIGPIPE, handler);
+  return success && _processReap(vm, proc, true);
+}
+
+// Convert the list of arguments or the map of the environment at the [slot]
+// to a NULL terminated array of strings allocated in a single block.
+static char** _processStrings(VM* vm, int slot, bool env) {
+  Var value = vm->fiber->ret[slot];
+  uint32_t count = 0;
+  size_t size = 0;
+
+  if (!env) {
+    if (!IS_OBJ_TYPE(value, OBJ_LIST) || ((List*) AS_OBJ(value))->elements.count == 0) {
+      SetRuntimeError(vm, "Expected a non empty list of the command arguments.");
+      return NULL;
+    }
+    List* list = (List*) AS_OBJ(value);
+    for (uint32_t i = 0; i < list->elements.count; i++) {
+      Var arg = list->elements.data[i];
+      if (!IS_OBJ_TYPE(arg, OBJ_STRING)) {
+        SetRuntimeErrorFmt(vm, "Expected a String argument, instead got type '%s'.",
+                           varTypeName(arg));
+        return NULL;
+      }
+      size += ((String*) AS_OBJ(arg))->length + 1;
+      count++;
+    }
+
+  } else {
+    if (!IS_OBJ_TYPE(value, OBJ_MAP)) {
+      SetRuntimeErrorFmt(vm, "Expected a Map of the environment, instead got type '%s'.",
+                         varTypeName(value));
+      return NULL;
+    }
+    Map* map = (Map*) AS_OBJ(value);
+    for (uint32_t i = 0; i < map->capacity; i++) {
+      MapEntry* entry = &map->entries[i];
+      if (IS_UNDEF(entry->key))
+        continue;
+      if (!IS_OBJ_TYPE(entry->key, OBJ_STRING) || !IS_OBJ_TYPE(entry->value, OBJ_STRING)) {
+        SetRuntimeError(vm, "Expected String names and values of the environment.");
+        return NULL;
+      }
+      size += ((String*) AS_OBJ(entry->key))->length
+              + ((String*) AS_OBJ(entry->value))->length + 2;
+      count++;
+    }
+  }
+
+  // The pointers followed by the characters.
+  char** strings = Realloc(vm, NULL, sizeof(char*) * (count + 1) + size);
+  char* chars = (char*) (strings + count + 1);
+  uint32_t index = 0;
+
+  if (!env) {
+    List* list = (List*) AS_OBJ(value);
+    for (uint32_t i = 0; i < list->elements.count; i++) {
+      String* arg = (String*) AS_OBJ(list->elements.data[i]);
+      strings[index++] = chars;
+      memcpy(chars, arg->data, arg->length);
+      chars += arg->length;
+      *chars++ = '\0';
+    }
+
+  } else {
+    Map* map = (Map*) AS_OBJ(value);
+    for (uint32_t i = 0; i < map->capacity; i++) {
+      if (IS_UNDEF(map->entries[i].key))
+        continue;
+      String* name = (String*) AS_OBJ(map->entries[i].key);
+      String* val = (String*) AS_OBJ(map->entries[i].value);
+      strings[index++] = chars;
+      memcpy(chars, name->data, name->length);
+      chars += name->length;
+      *chars++ = '=';
+      memcpy(chars, val->data, val->length);
+      chars += val->length;
+      *chars++ = '\0';
+    }
+  }
+
+  strings[index] = NULL;
+  return strings;
+}
+
+saynaa_function(_processInit, "os.Process._init(argv:List, env:Map=null) -> Null",
+                "Spawn a process of the [argv] where the first argument is the "
+                "program, which is searched in the PATH if it doesn't contain a "
+                "slash. The [env] is a map of the environment, by default it's "
+                "the environment of the interpreter.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  Process* proc = GetThis(vm);
+  if (proc->pid >= 0) {
+    SetRuntimeError(vm, "The process is already spawned.");
+    return;
+  }
+
+  char** argv = _processStrings(vm, 1, false);
+  if (argv == NULL)
+    return;
+
+  char** envp = NULL;
+  if (argc == 2 && !IS_NULL(vm->fiber->ret[2])) {
+    envp = _processStrings(vm, 2, true);
+    if (envp == NULL) {
+      Realloc(vm, argv, 0);
+      return;
+    }
+  }
+
+  _processSpawn(vm, proc, argv, envp);
+
+  Realloc(vm, argv, 0);
+  if (envp != NULL)
+    Realloc(vm, envp, 0);
+}
+
+saynaa_function(_processGetter, "os.Process._getter(name:String) -> Var", "") {
+  const char* name;
+  uint32_t length;
+  if (!ValidateSlotString(vm, 1, &name, &length))
+    return;
+
+  Process* proc = GetThis(vm);
+  if (length == 3 && strncmp(name, "pid", length) == 0) {
+    setSlotNumber(vm, 0, (double) proc->pid);
+  } else if (length == 10 && strncmp(name, "returncode", length) == 0) {
+    if (proc->exited)
+      setSlotNumber(vm, 0, (double) proc->exit_code);
+    else
+      setSlotNull(vm, 0);
+  }
+}
+
+saynaa_function(_processWrite, "os.Process.write(data:String) -> Null",
+                "Write the [data] to the stdin of the process.") {
+  const char* data;
+  uint32_t length;
+  if (!ValidateSlotString(vm, 1, &data, &length))
+    return;
+
+  Process* proc = GetThis(vm);
+  if (proc->fds[0] < 0) {
+    SetRuntimeError(vm, "The stdin of the process is closed.");
+    return;
+  }
+  _processWriteAll(vm, proc, data, length);
+}
+
+saynaa_function(_processCloseInput, "os.Process.closeinput() -> Null",
+                "Close the stdin of the process, which is the end of its input.") {
+  _processCloseFd(GetThis(vm), 0);
+}
+
+// Read a chunk of the stdout or stderr of the process for read() and readerr().
+static void _processReadChunk(VM* vm, int index) {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 0, 2))
+    return;
+
+  int32_t count = PROCESS_CHUNK_SIZE;
+  bool wait = true;
+  if (argc >= 1) {
+    if (!ValidateSlotInteger(vm, 1, &count))
+      return;
+    if (count <= 0) {
+      SetRuntimeError(vm, "Read bytes count should be > 0.");
+      return;
+    }
+  }
+  if (argc == 2 && !ValidateSlotBool(vm, 2, &wait))
+    return;
+
+  Process* proc = GetThis(vm);
+  if (proc->fds[index] < 0) {
+    setSlotNull(vm, 0);
+    return;
+  }
+
+  int ready = _processReady(vm, proc->fds[index], wait);
+  if (ready <= 0) {
+    if (ready == 0)
+      setSlotStringLength(vm, 0, "", 0);
+    return;
+  }
+
+  ByteBuffer buff;
+  ByteBufferInit(&buff);
+  int64_t n = _processReadTo(vm, proc, index, &buff, (uint32_t) count);
+  if (n > 0)
+    setSlotStringLength(vm, 0, (const char*) buff.data, buff.count);
+  else if (n == 0)
+    setSlotNull(vm, 0);
+  ByteBufferClear(&buff, vm);
+}
+
+saynaa_function(
+    _processRead, "os.Process.read(count:Number=65536, wait:Bool=true) -> String",
+    "Read up to [count] bytes of the stdout of the process, which is null "
+    "at the end of the output. If [wait] is false it doesn't wait for the "
+    "output and returns an empty string if there is nothing to read yet, so a "
+    "fiber can yield and read the other processes meanwhile.") {
+  _processReadChunk(vm, 1);
+}
+
+saynaa_function(_processReadErr,
+                "os.Process.readerr(count:Number=65536, wait:Bool=true) -> String",
+                "Same as read() for the stderr of the process.") {
+  _processReadChunk(vm, 2);
+}
+
+saynaa_function(_processCommunicate,
+                "os.Process.communicate(input:String=null) -> List",
+                "Write the [input] to the process and close its stdin, read "
+                "all of its stdout and stderr and wait for it to exit. Returns "
+                "the list of [stdout, stderr]. The outputs are read in parallel "
+                "so the process never blocks on a full pipe.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 0, 1))
+    return;
+
+  const char* input = NULL;
+  uint32_t input_length = 0;
+  if (argc == 1 && !IS_NULL(vm->fiber->ret[1])) {
+    if (!ValidateSlotString(vm, 1, &input, &input_length))
+      return;
+  }
+
+  Process* proc = GetThis(vm);
+  if (input_length > 0 && proc->fds[0] < 0) {
+    SetRuntimeError(vm, "The stdin of the process is closed.");
+    return;
+  }
+
+  ByteBuffer out, err;
+  ByteBufferInit(&out);
+  ByteBufferInit(&err);
+  if (_processExchange(vm, proc, input, input_length, &out, &err)) {
+    reserveSlots(vm, 3);
+    NewList(vm, 0);
+    setSlotStringLength(vm, 1, (const char*) out.data, out.count);
+    ListInsert(vm, 0, -1, 1);
+    setSlotStringLength(vm, 1, (const char*) err.data, err.count);
+    ListInsert(vm, 0, -1, 1);
+  }
+  ByteBufferClear(&out, vm);
+  ByteBufferClear(&err, vm);
+}
+
+saynaa_function(_processPoll, "os.Process.poll() -> Number",
+                "Returns the exit code of the process if it has exited, "
+                "otherwise null without waiting for it.") {
+  Process* proc = GetThis(vm);
+  if (!_processReap(vm, proc, false))
+    return;
+  if (proc->exited)
+    setSlotNumber(vm, 0, (double) proc->exit_code);
+  else
+    setSlotNull(vm, 0);
+}
+
+saynaa_function(_processWait, "os.Process.wait() -> Number",
+                "Wait for the process to exit and returns its exit code, or the "
+                "negative number of the signal which terminated it. The output "
+                "which isn't read yet stays in the pipes, a process with a large "
+                "output should be read to the end or use communicate().") {
+  Process* proc = GetThis(vm);
+  if (!_processReap(vm, proc, true))
+    return;
+  setSlotNumber(vm, 0, (double) proc->exit_code);
+}
+
+saynaa_function(_processKill, "os.Process.kill(signal:Number=15) -> Null",
+                "Send the [signal] to the process, SIGTERM by default.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 0, 1))
+    return;
+
+  int32_t sig = SIGTERM;
+  if (argc == 1 && !ValidateSlotInteger(vm, 1, &sig))
+    return;
+
+  Process* proc = GetThis(vm);
+  if (proc->exited || proc->pid < 0)
+    return;
+  if (kill(proc->pid, sig) != 0)
+    REPORT_ERRNO(kill);
+}
+
+saynaa_function(_osExec, "os.exec(cmd:String) -> String",
+                "Execute the command with the shell and returns its output, "
+                "without the trailing new line.") {
+  const char* cmd;
+  if (!ValidateSlotString(vm, 1, &cmd, NULL))
+    return;
+
+  const char* argv[] = { "/bin/sh", "-c", cmd, NULL };
+  Process proc = { -1, { -1, -1, -1 }, false, 0 };
+  if (!_processSpawn(vm, &proc, (char**) argv, NULL))
+    return;
+
+  ByteBuffer out, err;
+  ByteBufferInit(&out);
+  ByteBufferInit(&err);
+  if (_processExchange(vm, &proc, NULL, 0, &out, &err)) {
+    uint32_t length = out.count;
+    if (length > 0 && out.data[length - 1] == '\n')
+      length--;
+    setSlotStringLength(vm, 0, (const char*) out.data, length);
+  }
+
+  // The errors of the command aren't captured, like a shell's.
+  if (err.count > 0)
+    fwrite(err.data, 1, err.count, stderr);
+  ByteBufferClear(&out, vm);
+  ByteBufferClear(&err, vm);
+
+  for (int i = 0; i < 3; i++)
+    _processCloseFd(&proc, i);
+}
+
+#endif // OS_HAS_SPAWN
+
 /*****************************************************************************/
 /* MODULE REGISTER                                                           */
 /*****************************************************************************/
@@ -301,12 +855,29 @@ void registerModuleOS(VM* vm) {
   REGISTER_FN(os, "filesize", _osFileSize, 1);
   REGISTER_FN(os, "system", _osSystem, 1);
 #if defined(__linux__)
-  REGISTER_FN(os, "exec", _osExec, 1);
   REGISTER_FN(os, "setenv", _osSetenv, 2);
 #endif
   REGISTER_FN(os, "getenv", _osGetenv, 1);
   REGISTER_FN(os, "exepath", _osExepath, 0);
 
+#if defined(OS_HAS_SPAWN)
+  REGISTER_FN(os, "exec", _osExec, 1);
+
+  Handle* cls_process = NewClass(vm, "Process", NULL, os, _processNew, _processDelete,
+                                 "A child process connected with pipes.");
+  ADD_METHOD(cls_process, "_init", _processInit, -1);
+  ADD_METHOD(cls_process, "_getter", _processGetter, 1);
+  ADD_METHOD(cls_process, "write", _processWrite, 1);
+  ADD_METHOD(cls_process, "closeinput", _processCloseInput, 0);
+  ADD_METHOD(cls_process, "read", _processRead, -1);
+  ADD_METHOD(cls_process, "readerr", _processReadErr, -1);
+  ADD_METHOD(cls_process, "communicate", _processCommunicate, -1);
+  ADD_METHOD(cls_process, "poll", _processPoll, 0);
+  ADD_METHOD(cls_process, "wait", _processWait, 0);
+  ADD_METHOD(cls_process, "kill", _processKill, -1);
+  releaseHandle(vm, cls_process);
+#endif
+
   registerModule(vm, os);
   releaseHandle(vm, os);
 }
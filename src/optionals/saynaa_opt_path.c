@@ -30,6 +30,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/syscall.h>
+#endif
+
 // The maximum path size that default import system supports
 // including the null terminator. To be able to support more characters
 // override the functions from the host application. Since this is very much
@@ -409,6 +414,288 @@ saynaa_function(_pathListDir, "path.listdir(path:String='.') -> List",
   }
 }
 
+/*****************************************************************************/
+/* WALKER                                                                    */
+/*****************************************************************************/
+
+// path.walk() iterates over the files of a directory tree one at a time, the
+// directories are read lazily while iterating. The type of an entry is taken
+// from the directory entry (d_type) if the file system provides it, so the
+// files aren't stat()ed. On Linux the entries are read with getdents64() in
+// large batches instead of one readdir() call each.
+
+#if defined(__linux__)
+#define WALK_GETDENTS
+
+// The entries of getdents64(), which isn't declared by older libc headers.
+struct WalkDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// The size of the buffer the entries are read into at once.
+#define WALK_BUFFER_SIZE (32 * 1024)
+#endif
+
+typedef struct {
+  // The directories to be read after the current one (a stack, so the tree
+  // is walked depth first), allocated with Realloc().
+  char** pending;
+  uint32_t pending_count;
+  uint32_t pending_capacity;
+
+  // The path of the current directory followed by a separator, the name of
+  // an entry is appended to it after [dir_length].
+  ByteBuffer path;
+  uint32_t dir_length;
+
+#if defined(WALK_GETDENTS)
+  int fd; // The current directory or -1.
+  char* entries;
+  uint32_t position;
+  uint32_t end;
+#else
+  DIR* dir; // The current directory or NULL.
+#endif
+
+  // The extension of the files to yield including the dot, NULL for all.
+  char* ext;
+  uint32_t ext_length;
+} PathWalker;
+
+// A reference to the Walker class to create the iterators.
+static Handle* _cls_path_walker = NULL;
+
+static void* _walkerNew(VM* vm) {
+  PathWalker* walker = Realloc(vm, NULL, sizeof(PathWalker));
+  memset(walker, 0, sizeof(PathWalker));
+  ByteBufferInit(&walker->path);
+#if defined(WALK_GETDENTS)
+  walker->fd = -1;
+#endif
+  return walker;
+}
+
+static void _walkerCloseDir(PathWalker* walker) {
+#if defined(WALK_GETDENTS)
+  if (walker->fd >= 0)
+    close(walker->fd);
+  walker->fd = -1;
+  walker->position = walker->end = 0;
+#else
+  if (walker->dir != NULL)
+    closedir(walker->dir);
+  walker->dir = NULL;
+#endif
+}
+
+static void _walkerDelete(VM* vm, void* ptr) {
+  PathWalker* walker = (PathWalker*) ptr;
+  _walkerCloseDir(walker);
+  for (uint32_t i = 0; i < walker->pending_count; i++)
+    Realloc(vm, walker->pending[i], 0);
+  if (walker->pending != NULL)
+    Realloc(vm, walker->pending, 0);
+#if defined(WALK_GETDENTS)
+  if (walker->entries != NULL)
+    Realloc(vm, walker->entries, 0);
+#endif
+  if (walker->ext != NULL)
+    Realloc(vm, walker->ext, 0);
+  ByteBufferClear(&walker->path, vm);
+  Realloc(vm, walker, 0);
+}
+
+static void _walkerPush(VM* vm, PathWalker* walker, const char* path, uint32_t length) {
+  if (walker->pending_count == walker->pending_capacity) {
+    uint32_t capacity = (walker->pending_capacity == 0) ? 8 : walker->pending_capacity * 2;
+    walker->pending = Realloc(vm, walker->pending, sizeof(char*) * capacity);
+    walker->pending_capacity = capacity;
+  }
+
+  char* copy = Realloc(vm, NULL, length + 1);
+  memcpy(copy, path, length);
+  copy[length] = '\0';
+  walker->pending[walker->pending_count++] = copy;
+}
+
+// Open the directory at the [path] as the current one. Returns false if it
+// can't be read, it's skipped like a directory removed while walking.
+static bool _walkerOpenDir(VM* vm, PathWalker* walker, const char* path) {
+#if defined(WALK_GETDENTS)
+  walker->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (walker->fd < 0)
+    return false;
+  if (walker->entries == NULL)
+    walker->entries = Realloc(vm, NULL, WALK_BUFFER_SIZE);
+#else
+  walker->dir = opendir(path);
+  if (walker->dir == NULL)
+    return false;
+#endif
+
+  uint32_t length = (uint32_t) strlen(path);
+  walker->path.count = 0;
+  ByteBufferAddString(&walker->path, vm, path, length);
+  char sep = saynaa_path_separator();
+  if (length > 0 && path[length - 1] != '/' && path[length - 1] != sep)
+    ByteBufferWrite(&walker->path, vm, (uint8_t) sep);
+  walker->dir_length = walker->path.count;
+  return true;
+}
+
+// Read the next entry of the current directory. Returns false at the end of
+// it. [is_dir] is set from the entry type, or with a stat() if the file
+// system doesn't provide it. Symbolic links aren't followed.
+static bool _walkerReadEntry(VM* vm, PathWalker* walker, const char** name, bool* is_dir) {
+  while (true) {
+#if defined(WALK_GETDENTS)
+    if (walker->position >= walker->end) {
+      long count = syscall(SYS_getdents64, walker->fd, walker->entries, WALK_BUFFER_SIZE);
+      if (count <= 0)
+        return false;
+      walker->position = 0;
+      walker->end = (uint32_t) count;
+    }
+
+    struct WalkDirent64* ent = (struct WalkDirent64*) (walker->entries + walker->position);
+    walker->position += ent->d_reclen;
+    unsigned char type = ent->d_type;
+#else
+    struct dirent* ent = readdir(walker->dir);
+    if (ent == NULL)
+      return false;
+#if defined(DT_DIR)
+    unsigned char type = ent->d_type;
+#endif
+#endif
+
+    const char* entry = ent->d_name;
+    if (entry[0] == '.' && (entry[1] == '\0' || (entry[1] == '.' && entry[2] == '\0')))
+      continue;
+
+    *name = entry;
+#if defined(WALK_GETDENTS)
+    if (type != DT_UNKNOWN) {
+      *is_dir = (type == DT_DIR);
+    } else {
+      struct stat st;
+      *is_dir = fstatat(walker->fd, entry, &st, AT_SYMLINK_NOFOLLOW) == 0
+                && S_ISDIR(st.st_mode);
+    }
+#else
+#if defined(DT_DIR)
+    if (type != DT_UNKNOWN) {
+      *is_dir = (type == DT_DIR);
+      return true;
+    }
+#endif
+    walker->path.count = walker->dir_length;
+    ByteBufferAddString(&walker->path, vm, entry, (uint32_t) strlen(entry));
+    ByteBufferWrite(&walker->path, vm, '\0');
+    *is_dir = pathIsDir((const char*) walker->path.data);
+#endif
+    return true;
+  }
+}
+
+saynaa_function(_walkerNext, "path.Walker._next(iterator:Var) -> String", "") {
+  PathWalker* walker = GetThis(vm);
+
+  while (true) {
+#if defined(WALK_GETDENTS)
+    bool is_open = walker->fd >= 0;
+#else
+    bool is_open = walker->dir != NULL;
+#endif
+
+    if (!is_open) {
+      if (walker->pending_count == 0) {
+        setSlotNull(vm, 0);
+        return;
+      }
+      char* dir = walker->pending[--walker->pending_count];
+      _walkerOpenDir(vm, walker, dir);
+      Realloc(vm, dir, 0);
+      continue;
+    }
+
+    const char* name;
+    bool is_dir;
+    if (!_walkerReadEntry(vm, walker, &name, &is_dir)) {
+      _walkerCloseDir(walker);
+      continue;
+    }
+
+    uint32_t length = (uint32_t) strlen(name);
+    walker->path.count = walker->dir_length;
+    ByteBufferAddString(&walker->path, vm, name, length);
+
+    if (is_dir) {
+      _walkerPush(vm, walker, (const char*) walker->path.data, walker->path.count);
+      continue;
+    }
+
+    if (walker->ext != NULL
+        && (length < walker->ext_length
+            || memcmp(name + length - walker->ext_length, walker->ext, walker->ext_length) != 0))
+      continue;
+
+    setSlotStringLength(vm, 0, (const char*) walker->path.data, walker->path.count);
+    return;
+  }
+}
+
+saynaa_function(_walkerValue, "path.Walker._value(iterator:String) -> String", "") {
+  vm->fiber->ret[0] = vm->fiber->ret[1];
+}
+
+saynaa_function(_pathWalk, "path.walk(root:String, ext:String=null) -> Walker",
+                "Returns an iterator over the paths of the files in the "
+                "directory tree at the [root], which are found while iterating. "
+                "If [ext] is given only the files with the extension are "
+                "yielded. Symbolic links aren't followed and the order of the "
+                "files is the order of the file system.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  const char* root;
+  if (!ValidateSlotString(vm, 1, &root, NULL))
+    return;
+
+  const char* ext = NULL;
+  uint32_t ext_length = 0;
+  if (argc == 2 && !IS_NULL(vm->fiber->ret[2])) {
+    if (!ValidateSlotString(vm, 2, &ext, &ext_length))
+      return;
+  }
+
+  if (!pathIsDir(root)) {
+    SetRuntimeErrorFmt(vm, "Path '%s' isn't a directory.", root);
+    return;
+  }
+
+  setSlotHandle(vm, 0, _cls_path_walker);
+  if (!NewInstance(vm, 0, 0, 0, 0))
+    return;
+
+  PathWalker* walker = GetSlotNativeInstance(vm, 0);
+  _walkerPush(vm, walker, root, (uint32_t) strlen(root));
+
+  if (ext != NULL) {
+    // The extension is matched with the dot, "sa" is the same as ".sa".
+    bool dot = ext_length > 0 && ext[0] == '.';
+    walker->ext_length = ext_length + (dot ? 0 : 1);
+    walker->ext = Realloc(vm, NULL, walker->ext_length);
+    walker->ext[0] = '.';
+    memcpy(walker->ext + (dot ? 0 : 1), ext, ext_length);
+  }
+}
+
 /*****************************************************************************/
 /* MODULE REGISTER                                                           */
 /*****************************************************************************/
@@ -473,10 +760,23 @@ void registerModulePath(VM* vm) {
   REGISTER_FN(path, "isfile", _pathIsFile, 1);
   REGISTER_FN(path, "isdir", _pathIsDir, 1);
   REGISTER_FN(path, "listdir", _pathListDir, -1);
+  REGISTER_FN(path, "walk", _pathWalk, -1);
+
+  _cls_path_walker = NewClass(vm, "Walker", NULL, path, _walkerNew, _walkerDelete,
+                              "An iterator over the files of a directory tree, "
+                              "created with path.walk().");
+  ADD_METHOD(_cls_path_walker, "_next", _walkerNext, 1);
+  ADD_METHOD(_cls_path_walker, "_value", _walkerValue, 1);
 
   registerModule(vm, path);
   releaseHandle(vm, path);
 }
 
+void cleanupModulePath(VM* vm) {
+  if (_cls_path_walker)
+    releaseHandle(vm, _cls_path_walker);
+  _cls_path_walker = NULL;
+}
+
 #undef MAX_PATH_LEN
 #undef MAX_JOIN_PATHS
\ No newline at end of file
@@ -19,96 +19,214 @@ void setRegexError(VM* vm, int errornumber) {
   SetRuntimeErrorFmt(vm, "Regex Error: %s", (char*) buffer);
 }
 
-// Helper to compile regex
-static pcre2_code* compileRegex(VM* vm, const char* pattern) {
+#define SLOT(n) (vm->fiber->ret[n])
+
+// Maximum number of compiled patterns in the cache, when it's full the least
+// recently used one is evicted.
+#define RE_CACHE_SIZE 64
+
+// Size of the JIT stack, the default 32K machine stack of pcre2 is too small
+// for patterns with nested repetitions on long subjects.
+#define RE_JIT_STACK_START (32 * 1024)
+#define RE_JIT_STACK_MAX (1024 * 1024)
+
+typedef struct {
+  char* pattern;     //< Copy of the pattern string (NULL if unused).
+  uint32_t length;   //< Length of the pattern.
+  uint32_t hash;     //< Hash of the pattern.
+  uint32_t options;  //< Compile options of the pattern.
+  uint64_t used;     //< Tick of the last lookup, for the LRU eviction.
+  pcre2_code* code;  //< The compiled (and JIT compiled if supported) pattern.
+} RegexCacheEntry;
+
+// Compiled patterns are cached since scripts use the same few patterns over
+// and over (ex: scanning a log line by line), and the match data and the
+// JIT stack are shared by all the matches since none of the functions call
+// back to a script while matching. The context belongs to a VM (vm->regex)
+// with the handles of the classes of the module, so the VMs (which can be in
+// different threads) don't share any of them.
+struct RegexContext {
+  RegexCacheEntry entries[RE_CACHE_SIZE];
+  uint64_t tick;
+
+  pcre2_match_data* match_data; //< Shared match data (NULL if not created).
+  uint32_t match_pairs;         //< Number of ovector pairs of the match data.
+  pcre2_match_context* match_context;
+  pcre2_jit_stack* jit_stack;
+
+  Handle* cls_pattern; //< The Pattern class.
+  Handle* cls_matches; //< The Matches class.
+};
+
+// Remove all the compiled patterns from the cache.
+static void _reCachePurge(RegexContext* ctx) {
+  for (int i = 0; i < RE_CACHE_SIZE; i++) {
+    RegexCacheEntry* entry = &ctx->entries[i];
+    if (entry->pattern == NULL)
+      continue;
+    free(entry->pattern);
+    pcre2_code_free(entry->code);
+    entry->pattern = NULL;
+    entry->code = NULL;
+  }
+}
+
+// Compile the [pattern] with the [options] and JIT compile it. If the JIT
+// isn't available the pattern is still usable by the interpreter.
+static pcre2_code* _reCompile(VM* vm, const char* pattern, uint32_t length,
+                              uint32_t options) {
   int errornumber;
   PCRE2_SIZE erroroffset;
-  pcre2_code* re = pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED, 0,
-                                 &errornumber, &erroroffset, NULL);
+  pcre2_code* re = pcre2_compile((PCRE2_SPTR) pattern, length, options, &errornumber,
+                                 &erroroffset, NULL);
   if (!re) {
     setRegexError(vm, errornumber);
     return NULL;
   }
+  pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
   return re;
 }
 
-saynaa_function(
-    _reMatch, "re.match(pattern: String, text: String) -> String|Null",
-    "Match a regular expression pattern to the beginning of a string.") {
+// Returns the compiled pattern of the string at the [slot] with the compile
+// [options] from the cache, compiling it on a miss. Returns NULL and set an
+// error if the pattern is invalid. The returned code is owned by the cache
+// and valid till the next call.
+static pcre2_code* compileRegex(VM* vm, int slot, uint32_t options) {
   const char* pattern;
-  const char* text;
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
-    return;
-  if (!ValidateSlotString(vm, 2, &text, NULL))
-    return;
-
-  pcre2_code* re = compileRegex(vm, pattern);
-  if (!re)
-    return;
+  uint32_t length;
+  if (!ValidateSlotString(vm, slot, &pattern, &length))
+    return NULL;
+  uint32_t hash = STRING_HASH((String*) AS_OBJ(SLOT(slot)));
+
+  RegexContext* ctx = vm->regex;
+  RegexCacheEntry* victim = NULL;
+  for (int i = 0; i < RE_CACHE_SIZE; i++) {
+    RegexCacheEntry* entry = &ctx->entries[i];
+    if (entry->pattern == NULL) {
+      if (victim == NULL || victim->pattern != NULL)
+        victim = entry;
+      continue;
+    }
+    if (entry->hash == hash && entry->length == length && entry->options == options
+        && memcmp(entry->pattern, pattern, length) == 0) {
+      entry->used = ++ctx->tick;
+      return entry->code;
+    }
+    if (victim == NULL || (victim->pattern != NULL && entry->used < victim->used))
+      victim = entry;
+  }
 
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
-  int rc = pcre2_match(re, (PCRE2_SPTR) text, strlen(text), 0, PCRE2_ANCHORED,
-                       match_data, NULL);
+  pcre2_code* re = _reCompile(vm, pattern, length, options);
+  if (re == NULL)
+    return NULL;
 
-  if (rc >= 0) {
-    PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
-    setSlotStringLength(vm, 0, text + ovector[0], ovector[1] - ovector[0]);
-  } else {
-    setSlotNull(vm, 0);
+  if (victim->pattern != NULL) {
+    free(victim->pattern);
+    pcre2_code_free(victim->code);
+    victim->code = NULL;
   }
-
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  victim->pattern = malloc(length + 1);
+  if (victim->pattern == NULL) {
+    pcre2_code_free(re);
+    SetRuntimeError(vm, "Out of memory.");
+    return NULL;
+  }
+  memcpy(victim->pattern, pattern, length);
+  victim->pattern[length] = '\0';
+  victim->length = length;
+  victim->hash = hash;
+  victim->options = options;
+  victim->used = ++ctx->tick;
+  victim->code = re;
+  return re;
 }
 
-saynaa_function(_reFullMatch, "re.fullmatch(pattern: String, text: String) -> String|Null",
-                "Match a regular expression pattern to all of a string.") {
-  const char* pattern;
-  const char* text;
-  uint32_t len32 = 0;
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
-    return;
-  if (!ValidateSlotString(vm, 2, &text, &len32))
-    return;
-  size_t len = (size_t) len32;
+// Returns the shared match data, with enough room for the captures of [re].
+static pcre2_match_data* _reMatchData(VM* vm, const pcre2_code* re) {
+  RegexContext* ctx = vm->regex;
+  uint32_t captures = 0;
+  pcre2_pattern_info(re, PCRE2_INFO_CAPTURECOUNT, &captures);
+  if (ctx->match_data == NULL || ctx->match_pairs < captures + 1) {
+    if (ctx->match_data != NULL)
+      pcre2_match_data_free(ctx->match_data);
+    // Rounded up so a few capture groups more won't reallocate.
+    uint32_t pairs = captures + 1 < 16 ? 16 : captures + 1;
+    ctx->match_data = pcre2_match_data_create(pairs, NULL);
+    ctx->match_pairs = (ctx->match_data != NULL) ? pairs : 0;
+  }
+  return ctx->match_data;
+}
 
-  pcre2_code* re = compileRegex(vm, pattern);
-  if (!re)
-    return;
+// Returns the shared match context, which has the JIT stack assigned.
+static pcre2_match_context* _reMatchContext(VM* vm) {
+  RegexContext* ctx = vm->regex;
+  if (ctx->match_context == NULL) {
+    ctx->match_context = pcre2_match_context_create(NULL);
+    ctx->jit_stack = pcre2_jit_stack_create(RE_JIT_STACK_START, RE_JIT_STACK_MAX, NULL);
+    if (ctx->match_context != NULL && ctx->jit_stack != NULL)
+      pcre2_jit_stack_assign(ctx->match_context, NULL, ctx->jit_stack);
+  }
+  return ctx->match_context;
+}
 
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
-  int rc = pcre2_match(re, (PCRE2_SPTR) text, len, 0, PCRE2_ANCHORED, match_data, NULL);
+// Match [re] against the [text] starting at the [offset] with the shared
+// match data, and returns the result of pcre2_match().
+static int _reExec(VM* vm, const pcre2_code* re, const char* text, size_t length,
+                   PCRE2_SIZE offset, pcre2_match_data* match_data) {
+  return pcre2_match(re, (PCRE2_SPTR) text, length, offset, 0, match_data,
+                     _reMatchContext(vm));
+}
 
-  if (rc >= 0) {
-    PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
-    if (ovector[0] == 0 && ovector[1] == len) {
-      setSlotStringLength(vm, 0, text, len);
-    } else {
-      setSlotNull(vm, 0);
+// The flags of re.compile(), which are pcre2 compile options.
+#define RE_FLAGS (PCRE2_CASELESS | PCRE2_MULTILINE | PCRE2_DOTALL | PCRE2_EXTENDED)
+
+// Get the text to match at the [slot], which is a String or an io.Mapped
+// file which is matched in place without copying it.
+static bool _reSlotText(VM* vm, int slot, const char** text, uint32_t* length) {
+  uint64_t mapped_length;
+  if (ioGetMapped(SLOT(slot), text, &mapped_length)) {
+    if (mapped_length > UINT32_MAX) {
+      SetRuntimeError(vm, "Cannot match a mapped file larger than 4GB.");
+      return false;
     }
-  } else {
-    setSlotNull(vm, 0);
+    *length = (uint32_t) mapped_length;
+    return true;
   }
-
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  return ValidateSlotString(vm, slot, text, length);
 }
 
-saynaa_function(_reSearch, "re.search(pattern: String, text: String) -> String|Null",
-                "Returns the first matching substring.") {
-  const char* pattern;
-  const char* text;
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
-    return;
-  if (!ValidateSlotString(vm, 2, &text, NULL))
-    return;
+/*****************************************************************************/
+/* MATCHING                                                                  */
+/*****************************************************************************/
 
-  pcre2_code* re = compileRegex(vm, pattern);
-  if (!re)
-    return;
+// The functions below are shared by the module functions (which get the
+// pattern from the cache) and the methods of Pattern. The [text] should be
+// kept alive by the caller (it's an argument) and they set the return value.
+// If the [text] is the data of the [source] string, the matched substrings
+// are views of it instead of copies.
+
+// Returns the String at the [slot] or NULL if it's a mapped file, which is
+// validated by _reSlotText().
+static String* _reSlotSource(VM* vm, int slot) {
+  return IS_OBJ_TYPE(SLOT(slot), OBJ_STRING) ? (String*) AS_OBJ(SLOT(slot)) : NULL;
+}
 
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
-  int rc = pcre2_match(re, (PCRE2_SPTR) text, strlen(text), 0, 0, match_data, NULL);
+// Append the substring of the [group] of a match to the [list].
+static void _reAppendGroup(VM* vm, List* list, String* source, const char* text,
+                           const PCRE2_SIZE* ovector, int group) {
+  uint32_t start = (uint32_t) ovector[2 * group];
+  uint32_t length = (uint32_t) (ovector[2 * group + 1] - ovector[2 * group]);
+  String* str = (source != NULL) ? newStringView(vm, source, start, length)
+                                 : newStringLength(vm, text + start, length);
+  vmPushTempRef(vm, &str->_super); // str.
+  listAppend(vm, list, VAR_OBJ(str));
+  vmPopTempRef(vm); // str.
+}
+
+// Returns the first match of [re] in the [text] or null.
+static void _reFirst(VM* vm, const pcre2_code* re, const char* text, uint32_t len) {
+  pcre2_match_data* match_data = _reMatchData(vm, re);
+  int rc = _reExec(vm, re, text, len, 0, match_data);
 
   if (rc >= 0) {
     PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
@@ -116,44 +234,82 @@ saynaa_function(_reSearch, "re.search(pattern: String, text: String) -> String|N
   } else {
     setSlotNull(vm, 0);
   }
+}
+
+// Returns the list of the first match and its groups or null.
+static void _reGroups(VM* vm, const pcre2_code* re, String* source,
+                      const char* text, uint32_t len) {
+  pcre2_match_data* match_data = _reMatchData(vm, re);
+  int rc = _reExec(vm, re, text, len, 0, match_data);
+  if (rc < 0) {
+    setSlotNull(vm, 0);
+    return;
+  }
 
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
+  List* list = newList(vm, rc);
+  vmPushTempRef(vm, &list->_super); // list.
+  for (int i = 0; i < rc; i++) {
+    _reAppendGroup(vm, list, source, text, ovector, i);
+  }
+  vmPopTempRef(vm); // list.
+  RET(VAR_OBJ(list));
 }
 
-saynaa_function(_reSplit, "re.split(pattern: String, text: String, maxsplit: Int) -> List",
-                "Split a string by the occurrences of a pattern.") {
-  const char* pattern;
-  const char* text;
-  uint32_t len32 = 0;
-  int maxsplit = 0;
+// Returns the list of all the non-overlapping matches, or the list of the
+// groups of each match if the pattern has groups.
+static void _reAll(VM* vm, const pcre2_code* re, String* source,
+                   const char* text, uint32_t len32) {
+  List* list = newList(vm, 0);
+  vmPushTempRef(vm, &list->_super); // list.
 
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
-    return;
-  if (!ValidateSlotString(vm, 2, &text, &len32))
-    return;
-  size_t len = (size_t) len32;
+  pcre2_match_data* match_data = _reMatchData(vm, re);
+  PCRE2_SIZE offset = 0;
+  PCRE2_SIZE len = (PCRE2_SIZE) len32;
 
-  int argc = GetArgc(vm);
-  if (argc > 3)
-    maxsplit = (int) GetSlotNumber(vm, 3);
-  else if (argc == 3 && GetSlotType(vm, 3) == vNUMBER)
-    maxsplit = (int) GetSlotNumber(vm, 3);
+  while (offset < len) {
+    int rc = _reExec(vm, re, text, len, offset, match_data);
+    if (rc < 0)
+      break;
 
-  pcre2_code* re = compileRegex(vm, pattern);
-  if (!re)
-    return;
+    PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
 
-  NewList(vm, 0);
+    if (rc == 1) {
+      _reAppendGroup(vm, list, source, text, ovector, 0);
+    } else {
+      List* groups = newList(vm, rc - 1);
+      vmPushTempRef(vm, &groups->_super); // groups.
+      for (int i = 1; i < rc; i++) {
+        _reAppendGroup(vm, groups, source, text, ovector, i);
+      }
+      listAppend(vm, list, VAR_OBJ(groups));
+      vmPopTempRef(vm); // groups.
+    }
+    offset = ovector[1];
+    if (ovector[0] == ovector[1])
+      offset++;
+  }
 
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
+  vmPopTempRef(vm); // list.
+  RET(VAR_OBJ(list));
+}
+
+// Returns the list of the [text] split by the matches of [re] (and the
+// groups of the matches), at most [maxsplit] times if it's greater than 0.
+static void _reSplitText(VM* vm, const pcre2_code* re, String* source,
+                         const char* text, uint32_t len32, int maxsplit) {
+  List* list = newList(vm, 0);
+  vmPushTempRef(vm, &list->_super); // list.
+
+  pcre2_match_data* match_data = _reMatchData(vm, re);
+  PCRE2_SIZE len = (PCRE2_SIZE) len32;
   PCRE2_SIZE start_offset = 0;
   PCRE2_SIZE last_end = 0;
 
   int splits = 0;
 
   while (start_offset <= len && (maxsplit <= 0 || splits < maxsplit)) {
-    int rc = pcre2_match(re, (PCRE2_SPTR) text, len, start_offset, 0, match_data, NULL);
+    int rc = _reExec(vm, re, text, len, start_offset, match_data);
     if (rc < 0)
       break;
 
@@ -170,139 +326,194 @@ saynaa_function(_reSplit, "re.split(pattern: String, text: String, maxsplit: Int
       }
     }
 
-    setSlotStringLength(vm, 1, text + last_end, match_start - last_end);
-    ListInsert(vm, 0, -1, 1);
+    PCRE2_SIZE piece[2] = {last_end, match_start};
+    _reAppendGroup(vm, list, source, text, piece, 0);
     splits++;
 
-    if (rc > 1) {
-      for (int i = 1; i < rc; i++) {
-        setSlotStringLength(vm, 1, text + ovector[2 * i],
-                            ovector[2 * i + 1] - ovector[2 * i]);
-        ListInsert(vm, 0, -1, 1);
-      }
+    for (int i = 1; i < rc; i++) {
+      _reAppendGroup(vm, list, source, text, ovector, i);
     }
 
     last_end = match_end;
     start_offset = match_end;
   }
 
-  setSlotStringLength(vm, 1, text + last_end, len - last_end);
-  ListInsert(vm, 0, -1, 1);
+  PCRE2_SIZE rest[2] = {last_end, len};
+  _reAppendGroup(vm, list, source, text, rest, 0);
 
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  vmPopTempRef(vm); // list.
+  RET(VAR_OBJ(list));
 }
 
-saynaa_function(_reSub, "re.sub(pattern: String, repl: String, text: String) -> String",
-                "Substitute occurrences of a pattern found in a string.") {
-  const char* pattern;
-  const char* repl;
-  const char* text;
-  uint32_t text_len32 = 0;
-
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
-    return;
-  if (!ValidateSlotString(vm, 2, &repl, NULL))
-    return;
-  if (!ValidateSlotString(vm, 3, &text, &text_len32))
-    return;
-
+// Substitute all the matches of [re] in the [text] with [repl] and write the
+// result to the slot [dst]. Returns the number of substitutions or -1 and
+// set an error.
+static int _reSubstitute(VM* vm, const pcre2_code* re, const char* repl,
+                         uint32_t repl_len, const char* text, uint32_t text_len32,
+                         int dst) {
   size_t text_len = (size_t) text_len32;
 
-  pcre2_code* re = compileRegex(vm, pattern);
-  if (!re)
-    return;
-
   PCRE2_SIZE outlen = text_len * 2 + 100;
   PCRE2_UCHAR* output = malloc(outlen);
+  if (output == NULL) {
+    SetRuntimeError(vm, "Out of memory.");
+    return -1;
+  }
 
   int options = PCRE2_SUBSTITUTE_GLOBAL | PCRE2_SUBSTITUTE_OVERFLOW_LENGTH
                 | PCRE2_SUBSTITUTE_EXTENDED;
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
+  pcre2_match_data* match_data = _reMatchData(vm, re);
 
   int rc = pcre2_substitute(re, (PCRE2_SPTR) text, text_len, 0, options, match_data,
-                            NULL, (PCRE2_SPTR) repl, strlen(repl), output, &outlen);
+                            _reMatchContext(vm), (PCRE2_SPTR) repl, repl_len, output,
+                            &outlen);
 
   if (rc == PCRE2_ERROR_NOMEMORY) {
     free(output);
     output = malloc(outlen);
+    if (output == NULL) {
+      SetRuntimeError(vm, "Out of memory.");
+      return -1;
+    }
     rc = pcre2_substitute(re, (PCRE2_SPTR) text, text_len, 0, options, match_data,
-                          NULL, (PCRE2_SPTR) repl, strlen(repl), output, &outlen);
+                          _reMatchContext(vm), (PCRE2_SPTR) repl, repl_len, output,
+                          &outlen);
   }
 
   if (rc >= 0) {
-    setSlotStringLength(vm, 0, (char*) output, outlen);
+    setSlotStringLength(vm, dst, (char*) output, outlen);
   } else {
     setRegexError(vm, rc);
+    rc = -1;
   }
 
   free(output);
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  return rc;
 }
 
-saynaa_function(_reSubn, "re.subn(pattern: String, repl: String, text: String) -> List",
-                "Same as sub, but returns [new_string, count].") {
-  const char* pattern;
-  const char* repl;
+// Returns the maxsplit argument of split() at the [slot] or 0 if it's not
+// given.
+static int _reMaxSplit(VM* vm, int slot) {
+  if (GetArgc(vm) >= slot && GetSlotType(vm, slot) == vNUMBER)
+    return (int) GetSlotNumber(vm, slot);
+  return 0;
+}
+
+/*****************************************************************************/
+/* MODULE FUNCTIONS                                                          */
+/*****************************************************************************/
+
+saynaa_function(
+    _reMatch, "re.match(pattern: String, text: String) -> String|Null",
+    "Match a regular expression pattern to the beginning of a string.") {
   const char* text;
-  uint32_t text_len32 = 0;
+  uint32_t len = 0;
 
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
+  // PCRE2_ANCHORED is a compile option here since the JIT doesn't support
+  // it as a match option.
+  pcre2_code* re = compileRegex(vm, 1, PCRE2_ANCHORED);
+  if (!re)
     return;
-  if (!ValidateSlotString(vm, 2, &repl, NULL))
+  if (!_reSlotText(vm, 2, &text, &len))
     return;
-  if (!ValidateSlotString(vm, 3, &text, &text_len32))
+
+  _reFirst(vm, re, text, len);
+}
+
+saynaa_function(_reFullMatch, "re.fullmatch(pattern: String, text: String) -> String|Null",
+                "Match a regular expression pattern to all of a string.") {
+  const char* text;
+  uint32_t len = 0;
+
+  pcre2_code* re = compileRegex(vm, 1, PCRE2_ANCHORED | PCRE2_ENDANCHORED);
+  if (!re)
+    return;
+  if (!_reSlotText(vm, 2, &text, &len))
     return;
 
-  size_t text_len = (size_t) text_len32;
+  _reFirst(vm, re, text, len);
+}
+
+saynaa_function(_reSearch, "re.search(pattern: String, text: String) -> String|Null",
+                "Returns the first matching substring.") {
+  const char* text;
+  uint32_t len = 0;
 
-  pcre2_code* re = compileRegex(vm, pattern);
+  pcre2_code* re = compileRegex(vm, 1, 0);
   if (!re)
     return;
+  if (!_reSlotText(vm, 2, &text, &len))
+    return;
 
-  PCRE2_SIZE outlen = text_len * 2 + 100;
-  PCRE2_UCHAR* output = malloc(outlen);
+  _reFirst(vm, re, text, len);
+}
 
-  int options = PCRE2_SUBSTITUTE_GLOBAL | PCRE2_SUBSTITUTE_OVERFLOW_LENGTH
-                | PCRE2_SUBSTITUTE_EXTENDED;
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
+saynaa_function(_reSplit, "re.split(pattern: String, text: String, maxsplit: Int) -> List",
+                "Split a string by the occurrences of a pattern.") {
+  const char* text;
+  uint32_t len = 0;
 
-  int rc = pcre2_substitute(re, (PCRE2_SPTR) text, text_len, 0, options, match_data,
-                            NULL, (PCRE2_SPTR) repl, strlen(repl), output, &outlen);
+  pcre2_code* re = compileRegex(vm, 1, 0);
+  if (!re)
+    return;
+  if (!_reSlotText(vm, 2, &text, &len))
+    return;
 
-  if (rc == PCRE2_ERROR_NOMEMORY) {
-    free(output);
-    output = malloc(outlen);
-    rc = pcre2_substitute(re, (PCRE2_SPTR) text, text_len, 0, options, match_data,
-                          NULL, (PCRE2_SPTR) repl, strlen(repl), output, &outlen);
-  }
+  _reSplitText(vm, re, _reSlotSource(vm, 2), text, len, _reMaxSplit(vm, 3));
+}
 
-  if (rc >= 0) {
-    NewList(vm, 0);
-    setSlotStringLength(vm, 1, (char*) output, outlen);
-    ListInsert(vm, 0, -1, 1);
+// Substitute the matches of the pattern at slot 1 with the replacement at
+// slot 2 in the text at slot 3, and write the result to the slot [dst].
+static int _reSubArgs(VM* vm, int dst) {
+  const char* repl;
+  const char* text;
+  uint32_t repl_len = 0, text_len = 0;
 
-    // Use slot 1 for int count
-    setSlotNumber(vm, 1, (double) rc);
-    ListInsert(vm, 0, -1, 1);
-  } else {
-    setRegexError(vm, rc);
-  }
+  pcre2_code* re = compileRegex(vm, 1, 0);
+  if (!re)
+    return -1;
+  if (!ValidateSlotString(vm, 2, &repl, &repl_len))
+    return -1;
+  if (!_reSlotText(vm, 3, &text, &text_len))
+    return -1;
 
-  free(output);
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  return _reSubstitute(vm, re, repl, repl_len, text, text_len, dst);
+}
+
+saynaa_function(_reSub, "re.sub(pattern: String, repl: String, text: String) -> String",
+                "Substitute occurrences of a pattern found in a string.") {
+  _reSubArgs(vm, 0);
+}
+
+saynaa_function(_reSubn, "re.subn(pattern: String, repl: String, text: String) -> List",
+                "Same as sub, but returns [new_string, count].") {
+  // The result string is written to slot 3 (the text) since slot 0 will be
+  // the returned list.
+  int count = _reSubArgs(vm, 3);
+  if (count < 0)
+    return;
+
+  NewList(vm, 0);
+  ListInsert(vm, 0, -1, 3);
+
+  // Use slot 1 for int count
+  setSlotNumber(vm, 1, (double) count);
+  ListInsert(vm, 0, -1, 1);
 }
 
 saynaa_function(_reEscape, "re.escape(pattern: String) -> String",
                 "Backslash all non-alphanumerics in a string.") {
   const char* pattern;
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
+  uint32_t len32 = 0;
+  if (!ValidateSlotString(vm, 1, &pattern, &len32))
     return;
 
-  size_t len = strlen(pattern);
+  size_t len = (size_t) len32;
   char* result = malloc(len * 2 + 1);
+  if (result == NULL) {
+    SetRuntimeError(vm, "Out of memory.");
+    return;
+  }
   size_t j = 0;
   for (size_t i = 0; i < len; i++) {
     char c = pattern[i];
@@ -314,105 +525,406 @@ saynaa_function(_reEscape, "re.escape(pattern: String) -> String",
     }
     result[j++] = c;
   }
-  result[j] = '\0';
-  setSlotString(vm, 0, result);
+  setSlotStringLength(vm, 0, result, (uint32_t) j);
   free(result);
 }
 
 saynaa_function(_rePurge, "re.purge() -> Null", "Clear the regular expression cache.") {
+  _reCachePurge(vm->regex);
   setSlotNull(vm, 0);
 }
 
 saynaa_function(_reExtract, "re.extract(pattern: String, text: String) -> List|Null",
                 "Returns a list of captured groups.") {
-  const char* pattern;
   const char* text;
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
+  uint32_t len = 0;
+
+  pcre2_code* re = compileRegex(vm, 1, 0);
+  if (!re)
     return;
-  if (!ValidateSlotString(vm, 2, &text, NULL))
+  if (!_reSlotText(vm, 2, &text, &len))
     return;
 
-  pcre2_code* re = compileRegex(vm, pattern);
+  _reGroups(vm, re, _reSlotSource(vm, 2), text, len);
+}
+
+saynaa_function(_reFindAll, "re.findall(pattern: String, text: String) -> List",
+                "Returns all non-overlapping matches.") {
+  const char* text;
+  uint32_t len = 0;
+
+  pcre2_code* re = compileRegex(vm, 1, 0);
   if (!re)
     return;
+  if (!_reSlotText(vm, 2, &text, &len))
+    return;
 
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
-  int rc = pcre2_match(re, (PCRE2_SPTR) text, strlen(text), 0, 0, match_data, NULL);
+  _reAll(vm, re, _reSlotSource(vm, 2), text, len);
+}
 
-  if (rc >= 0) {
-    NewList(vm, 0);
-    PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
-    for (int i = 0; i < rc; i++) {
-      setSlotStringLength(vm, 1, text + ovector[2 * i],
-                          ovector[2 * i + 1] - ovector[2 * i]);
-      ListInsert(vm, 0, -1, 1);
-    }
-  } else {
-    setSlotNull(vm, 0);
+saynaa_function(_reCompilePattern, "re.compile(pattern: String, flags: Number = 0) -> Pattern",
+                "Compile the regular expression [pattern] to a Pattern object, "
+                "the [flags] are the bitwise or of re.IGNORECASE, re.MULTILINE, "
+                "re.DOTALL and re.VERBOSE.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  setSlotHandle(vm, 0, vm->regex->cls_pattern);
+  NewInstance(vm, 0, 0, argc, 1);
+}
+
+/*****************************************************************************/
+/* PATTERN                                                                   */
+/*****************************************************************************/
+
+// A compiled pattern owns its code, so the methods don't look it up in the
+// cache. The anchored variants for match() and fullmatch() are compiled
+// when they're first used.
+typedef struct {
+  char* pattern;       //< Copy of the pattern string.
+  uint32_t length;     //< Length of the pattern.
+  uint32_t flags;      //< Compile options of the pattern.
+  pcre2_code* code;    //< The compiled pattern.
+  pcre2_code* match;   //< Compiled with PCRE2_ANCHORED or NULL.
+  pcre2_code* full;    //< Compiled with PCRE2_ANCHORED | PCRE2_ENDANCHORED or NULL.
+} RegexPattern;
+
+// The iterator returned by Pattern.finditer(), it keeps the pattern and the
+// text alive and finds the next match when the for loop asks for it, so a
+// large text is scanned without collecting all the matches.
+typedef struct {
+  Handle* pattern; //< The Pattern instance.
+  Handle* text;    //< The String being scanned.
+} RegexMatches;
+
+static void* _rePatternNew(VM* vm) {
+  RegexPattern* pattern = Realloc(vm, NULL, sizeof(RegexPattern));
+  memset(pattern, 0, sizeof(RegexPattern));
+  return pattern;
+}
+
+static void _rePatternDelete(VM* vm, void* ptr) {
+  RegexPattern* pattern = (RegexPattern*) ptr;
+  if (pattern->pattern != NULL)
+    Realloc(vm, pattern->pattern, 0);
+  if (pattern->code != NULL)
+    pcre2_code_free(pattern->code);
+  if (pattern->match != NULL)
+    pcre2_code_free(pattern->match);
+  if (pattern->full != NULL)
+    pcre2_code_free(pattern->full);
+  Realloc(vm, pattern, 0);
+}
+
+// Returns the code of the [pattern] compiled with the extra [options]
+// (compiled to [code] if it's not yet), or NULL if the compilation failed.
+static pcre2_code* _rePatternCode(VM* vm, RegexPattern* pattern, pcre2_code** code,
+                                  uint32_t options) {
+  if (*code == NULL)
+    *code = _reCompile(vm, pattern->pattern, pattern->length, pattern->flags | options);
+  return *code;
+}
+
+saynaa_function(_rePatternInit, "re.Pattern._init(pattern: String, flags: Number = 0)",
+                "Compile the regular expression [pattern] with the [flags].") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
+    return;
+
+  const char* str;
+  uint32_t length;
+  if (!ValidateSlotString(vm, 1, &str, &length))
+    return;
+
+  int32_t flags = 0;
+  if (argc == 2 && !ValidateSlotInteger(vm, 2, &flags))
+    return;
+  if ((flags & ~RE_FLAGS) != 0) {
+    SetRuntimeErrorFmt(vm, "Invalid regex flags %i.", flags);
+    return;
   }
 
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  RegexPattern* pattern = GetThis(vm);
+  pcre2_code* code = _reCompile(vm, str, length, (uint32_t) flags);
+  if (code == NULL)
+    return;
+
+  pattern->pattern = Realloc(vm, NULL, length + 1);
+  memcpy(pattern->pattern, str, length);
+  pattern->pattern[length] = '\0';
+  pattern->length = length;
+  pattern->flags = (uint32_t) flags;
+  pattern->code = code;
 }
 
-saynaa_function(_reFindAll, "re.findall(pattern: String, text: String) -> List",
+saynaa_function(_rePatternGetter, "re.Pattern._getter()", "") {
+  const char* name;
+  uint32_t length;
+  if (!ValidateSlotString(vm, 1, &name, &length))
+    return;
+
+  RegexPattern* pattern = GetThis(vm);
+  if (length == 7 && strncmp(name, "pattern", 7) == 0) {
+    setSlotStringLength(vm, 0, pattern->pattern, pattern->length);
+  } else if (length == 5 && strncmp(name, "flags", 5) == 0) {
+    setSlotNumber(vm, 0, (double) pattern->flags);
+  }
+}
+
+saynaa_function(_rePatternSearch, "re.Pattern.search(text: String) -> String|Null",
+                "Returns the first matching substring.") {
+  RegexPattern* pattern = GetThis(vm);
+  const char* text;
+  uint32_t len = 0;
+  if (!_reSlotText(vm, 1, &text, &len))
+    return;
+  _reFirst(vm, pattern->code, text, len);
+}
+
+saynaa_function(_rePatternMatch, "re.Pattern.match(text: String) -> String|Null",
+                "Match the pattern to the beginning of the [text].") {
+  RegexPattern* pattern = GetThis(vm);
+  const char* text;
+  uint32_t len = 0;
+  if (!_reSlotText(vm, 1, &text, &len))
+    return;
+
+  pcre2_code* re = _rePatternCode(vm, pattern, &pattern->match, PCRE2_ANCHORED);
+  if (re != NULL)
+    _reFirst(vm, re, text, len);
+}
+
+saynaa_function(_rePatternFullMatch, "re.Pattern.fullmatch(text: String) -> String|Null",
+                "Match the pattern to all of the [text].") {
+  RegexPattern* pattern = GetThis(vm);
+  const char* text;
+  uint32_t len = 0;
+  if (!_reSlotText(vm, 1, &text, &len))
+    return;
+
+  pcre2_code* re = _rePatternCode(vm, pattern, &pattern->full,
+                                  PCRE2_ANCHORED | PCRE2_ENDANCHORED);
+  if (re != NULL)
+    _reFirst(vm, re, text, len);
+}
+
+saynaa_function(_rePatternExtract, "re.Pattern.extract(text: String) -> List|Null",
+                "Returns a list of the first match and its captured groups.") {
+  RegexPattern* pattern = GetThis(vm);
+  const char* text;
+  uint32_t len = 0;
+  if (!_reSlotText(vm, 1, &text, &len))
+    return;
+  _reGroups(vm, pattern->code, _reSlotSource(vm, 1), text, len);
+}
+
+saynaa_function(_rePatternFindAll, "re.Pattern.findall(text: String) -> List",
                 "Returns all non-overlapping matches.") {
-  const char* pattern;
+  RegexPattern* pattern = GetThis(vm);
   const char* text;
-  if (!ValidateSlotString(vm, 1, &pattern, NULL))
+  uint32_t len = 0;
+  if (!_reSlotText(vm, 1, &text, &len))
     return;
-  if (!ValidateSlotString(vm, 2, &text, NULL))
+  _reAll(vm, pattern->code, _reSlotSource(vm, 1), text, len);
+}
+
+saynaa_function(_rePatternSplit, "re.Pattern.split(text: String, maxsplit: Int) -> List",
+                "Split the [text] by the occurrences of the pattern.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 2))
     return;
 
-  pcre2_code* re = compileRegex(vm, pattern);
-  if (!re)
+  RegexPattern* pattern = GetThis(vm);
+  const char* text;
+  uint32_t len = 0;
+  if (!_reSlotText(vm, 1, &text, &len))
     return;
+  _reSplitText(vm, pattern->code, _reSlotSource(vm, 1), text, len,
+               _reMaxSplit(vm, 2));
+}
 
-  NewList(vm, 0);
-  pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(re, NULL);
-  PCRE2_SIZE offset = 0;
-  PCRE2_SIZE len = strlen(text);
+saynaa_function(_rePatternSub, "re.Pattern.sub(repl: String, text: String) -> String",
+                "Substitute the occurrences of the pattern in the [text].") {
+  RegexPattern* pattern = GetThis(vm);
+  const char *repl, *text;
+  uint32_t repl_len = 0, text_len = 0;
+  if (!ValidateSlotString(vm, 1, &repl, &repl_len))
+    return;
+  if (!_reSlotText(vm, 2, &text, &text_len))
+    return;
+  _reSubstitute(vm, pattern->code, repl, repl_len, text, text_len, 0);
+}
 
-  while (offset < len) {
-    int rc = pcre2_match(re, (PCRE2_SPTR) text, len, offset, 0, match_data, NULL);
-    if (rc < 0)
-      break;
+saynaa_function(_rePatternFindIter, "re.Pattern.finditer(text: String) -> Matches",
+                "Returns an iterator over the non-overlapping matches in the "
+                "[text]. The matches are found one at a time while iterating "
+                "and yielded as views of the [text], without copying it.") {
+  if (!ValidateSlotString(vm, 1, NULL, NULL))
+    return;
 
-    PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
+  setSlotHandle(vm, 0, vm->regex->cls_matches);
+  if (!NewInstance(vm, 0, 0, 0, 0))
+    return;
 
-    if (rc == 1) {
-      setSlotStringLength(vm, 1, text + ovector[0], ovector[1] - ovector[0]);
-      ListInsert(vm, 0, -1, 1);
-    } else {
-      NewList(vm, 1);
-      for (int i = 1; i < rc; i++) {
-        setSlotStringLength(vm, 2, text + ovector[2 * i],
-                            ovector[2 * i + 1] - ovector[2 * i]);
-        ListInsert(vm, 1, -1, 2);
-      }
-      ListInsert(vm, 0, -1, 1);
-    }
-    offset = ovector[1];
-    if (ovector[0] == ovector[1])
+  RegexMatches* matches = GetSlotNativeInstance(vm, 0);
+  matches->pattern = vmNewHandle(vm, vm->fiber->thiz);
+  matches->text = GetSlotHandle(vm, 1);
+}
+
+/*****************************************************************************/
+/* MATCHES                                                                   */
+/*****************************************************************************/
+
+static void* _reMatchesNew(VM* vm) {
+  RegexMatches* matches = Realloc(vm, NULL, sizeof(RegexMatches));
+  memset(matches, 0, sizeof(RegexMatches));
+  return matches;
+}
+
+static void _reMatchesDelete(VM* vm, void* ptr) {
+  RegexMatches* matches = (RegexMatches*) ptr;
+  if (matches->pattern != NULL)
+    releaseHandle(vm, matches->pattern);
+  if (matches->text != NULL)
+    releaseHandle(vm, matches->text);
+  Realloc(vm, matches, 0);
+}
+
+// The iterator of the for loop is the range of the last match (null at the
+// start, end exclusive), the next match is searched from its end.
+saynaa_function(_reMatchesNext, "re.Matches._next(iterator: Range|Null) -> Range|Null",
+                "") {
+  RegexMatches* matches = GetThis(vm);
+  if (matches->pattern == NULL) {
+    SetRuntimeError(vm, "Matches should be created with Pattern.finditer().");
+    return;
+  }
+
+  const RegexPattern* pattern = ((Instance*) AS_OBJ(matches->pattern->value))->native;
+  const String* text = (const String*) AS_OBJ(matches->text->value);
+
+  PCRE2_SIZE offset = 0;
+  Var iterator = SLOT(1);
+  if (IS_OBJ_TYPE(iterator, OBJ_RANGE)) {
+    const Range* last = (const Range*) AS_OBJ(iterator);
+    offset = (PCRE2_SIZE) last->to;
+    // Skip a character after an empty match, like findall().
+    if (last->from == last->to)
       offset++;
   }
+  if (offset >= text->length) {
+    setSlotNull(vm, 0);
+    return;
+  }
+
+  pcre2_match_data* match_data = _reMatchData(vm, pattern->code);
+  int rc = _reExec(vm, pattern->code, text->data, text->length, offset,
+                   match_data);
+  if (rc < 0) {
+    setSlotNull(vm, 0);
+    return;
+  }
 
-  pcre2_match_data_free(match_data);
-  pcre2_code_free(re);
+  PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
+  NewRange(vm, 0, (double) ovector[0], (double) ovector[1]);
+}
+
+saynaa_function(_reMatchesValue, "re.Matches._value(iterator: Range) -> String", "") {
+  RegexMatches* matches = GetThis(vm);
+  if (matches->pattern == NULL) {
+    SetRuntimeError(vm, "Matches should be created with Pattern.finditer().");
+    return;
+  }
+  if (!IS_OBJ_TYPE(SLOT(1), OBJ_RANGE)) {
+    SetRuntimeErrorFmt(vm, "Expected a Range, got %s.", varTypeName(SLOT(1)));
+    return;
+  }
+
+  String* text = (String*) AS_OBJ(matches->text->value);
+  const Range* range = (const Range*) AS_OBJ(SLOT(1));
+  if (!(0 <= range->from && range->from <= range->to && range->to <= text->length)) {
+    SetRuntimeError(vm, "The range is out of the bounds of the text.");
+    return;
+  }
+
+  uint32_t start = (uint32_t) range->from;
+  RET(VAR_OBJ(newStringView(vm, text, start, (uint32_t) range->to - start)));
 }
 
 void registerModuleRegex(VM* vm) {
+  // The context is allocated with the host allocator since it isn't a part of
+  // the heap of the VM, and without it the module isn't registered.
+  vm->regex = vm->config.realloc_fn(NULL, sizeof(RegexContext),
+                                    vm->config.user_data);
+  if (vm->regex == NULL)
+    return;
+  memset(vm->regex, 0, sizeof(RegexContext));
+
   Handle* re = NewModule(vm, "re");
-  ModuleAddFunction(vm, re, "match", _reMatch, 2, NULL);
-  ModuleAddFunction(vm, re, "fullmatch", _reFullMatch, 2, NULL);
-  ModuleAddFunction(vm, re, "search", _reSearch, 2, NULL);
-  ModuleAddFunction(vm, re, "sub", _reSub, -1, NULL);
-  ModuleAddFunction(vm, re, "subn", _reSubn, -1, NULL);
-  ModuleAddFunction(vm, re, "split", _reSplit, -1, NULL);
-  ModuleAddFunction(vm, re, "extract", _reExtract, 2, NULL);
-  ModuleAddFunction(vm, re, "findall", _reFindAll, 2, NULL);
-  ModuleAddFunction(vm, re, "escape", _reEscape, 1, NULL);
-  ModuleAddFunction(vm, re, "purge", _rePurge, 0, NULL);
+  REGISTER_FN(re, "match", _reMatch, 2);
+  REGISTER_FN(re, "fullmatch", _reFullMatch, 2);
+  REGISTER_FN(re, "search", _reSearch, 2);
+  REGISTER_FN(re, "sub", _reSub, -1);
+  REGISTER_FN(re, "subn", _reSubn, -1);
+  REGISTER_FN(re, "split", _reSplit, -1);
+  REGISTER_FN(re, "extract", _reExtract, 2);
+  REGISTER_FN(re, "findall", _reFindAll, 2);
+  REGISTER_FN(re, "escape", _reEscape, 1);
+  REGISTER_FN(re, "purge", _rePurge, 0);
+  REGISTER_FN(re, "compile", _reCompilePattern, -1);
+
+  Module* module = (Module*) AS_OBJ(re->value);
+  moduleSetGlobal(vm, module, "IGNORECASE", 10, VAR_NUM(PCRE2_CASELESS));
+  moduleSetGlobal(vm, module, "MULTILINE", 9, VAR_NUM(PCRE2_MULTILINE));
+  moduleSetGlobal(vm, module, "DOTALL", 6, VAR_NUM(PCRE2_DOTALL));
+  moduleSetGlobal(vm, module, "VERBOSE", 7, VAR_NUM(PCRE2_EXTENDED));
+
+  Handle* cls_pattern = NewClass(vm, "Pattern", NULL, re, _rePatternNew,
+                                 _rePatternDelete,
+                                 "A compiled regular expression, created with "
+                                 "re.compile().");
+  ADD_METHOD(cls_pattern, "_init", _rePatternInit, -1);
+  ADD_METHOD(cls_pattern, "_getter", _rePatternGetter, 1);
+  ADD_METHOD(cls_pattern, "search", _rePatternSearch, 1);
+  ADD_METHOD(cls_pattern, "match", _rePatternMatch, 1);
+  ADD_METHOD(cls_pattern, "fullmatch", _rePatternFullMatch, 1);
+  ADD_METHOD(cls_pattern, "extract", _rePatternExtract, 1);
+  ADD_METHOD(cls_pattern, "findall", _rePatternFindAll, 1);
+  ADD_METHOD(cls_pattern, "split", _rePatternSplit, -1);
+  ADD_METHOD(cls_pattern, "sub", _rePatternSub, 2);
+  ADD_METHOD(cls_pattern, "finditer", _rePatternFindIter, 1);
+
+  Handle* cls_matches = NewClass(vm, "Matches", NULL, re, _reMatchesNew,
+                                 _reMatchesDelete,
+                                 "An iterator over the matches of a pattern, "
+                                 "created with Pattern.finditer().");
+  ADD_METHOD(cls_matches, "_next", _reMatchesNext, 1);
+  ADD_METHOD(cls_matches, "_value", _reMatchesValue, 1);
+
+  vm->regex->cls_pattern = cls_pattern;
+  vm->regex->cls_matches = cls_matches;
+
   registerModule(vm, re);
   releaseHandle(vm, re);
 }
+
+void cleanupModuleRegex(VM* vm) {
+  RegexContext* ctx = vm->regex;
+  if (ctx == NULL)
+    return;
+
+  if (ctx->cls_pattern != NULL)
+    releaseHandle(vm, ctx->cls_pattern);
+  if (ctx->cls_matches != NULL)
+    releaseHandle(vm, ctx->cls_matches);
+  _reCachePurge(ctx);
+  if (ctx->match_data != NULL)
+    pcre2_match_data_free(ctx->match_data);
+  if (ctx->match_context != NULL)
+    pcre2_match_context_free(ctx->match_context);
+  if (ctx->jit_stack != NULL)
+    pcre2_jit_stack_free(ctx->jit_stack);
+  vm->config.realloc_fn(ctx, 0, vm->config.user_data);
+  vm->regex = NULL;
+}
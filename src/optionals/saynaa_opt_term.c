@@ -5,6 +5,8 @@
 
 #include "saynaa_optionals.h"
 
+#include <math.h>
+
 #ifdef _WIN32
 #include <fcntl.h>
 #include <windows.h>
@@ -83,6 +85,206 @@ static void _termCtxWriteFmt(VM* vm, const char* fmt, ...) {
   _sTermCtx.count += len;
 }
 
+// ----------------------------------------------------------------------------
+// GRID BUFFERS
+// ----------------------------------------------------------------------------
+
+// Scripts draw into the back buffer with term.put() and term.fill() and
+// term.flush() only emits the cells which differ from the front buffer (what
+// the terminal is currently showing), then copies them over.
+
+// Cell attribute bits, exposed to scripts as term.ATTR_*.
+#define TERM_ATTR_BOLD          0x01
+#define TERM_ATTR_DIM           0x02
+#define TERM_ATTR_ITALIC        0x04
+#define TERM_ATTR_UNDERLINE     0x08
+#define TERM_ATTR_INVERSE       0x10
+#define TERM_ATTR_HIDDEN        0x20
+#define TERM_ATTR_STRIKETHROUGH 0x40
+#define TERM_ATTR_MASK          0x7f
+
+// A cell color is either the default color (0), a palette index tagged with
+// TERM_COLOR_INDEX or a 24 bit rgb value tagged with TERM_COLOR_RGB (the
+// latter is what term.rgb() returns to the script).
+#define TERM_COLOR_DEFAULT 0
+#define TERM_COLOR_INDEX   0x1000000
+#define TERM_COLOR_RGB     0x2000000
+
+// Unchanged cells shorter than this between two changed cells of the same
+// row are re-emitted instead of moving the cursor over them.
+#define TERM_GRID_BRIDGE 4
+
+typedef struct {
+  uint32_t ch;
+  uint32_t fg;
+  uint32_t bg;
+  uint32_t attr;
+} TermCell;
+
+typedef struct {
+  TermCell* front;
+  TermCell* back;
+  int width;
+  int height;
+  bool full; // Clear the screen and redraw everything on the next flush.
+} TermGrid;
+
+static TermGrid _sTermGrid;
+
+static const TermCell _blankCell = {' ', TERM_COLOR_DEFAULT, TERM_COLOR_DEFAULT, 0};
+
+static inline bool _termCellEq(const TermCell* a, const TermCell* b) {
+  return a->ch == b->ch && a->fg == b->fg && a->bg == b->bg && a->attr == b->attr;
+}
+
+static inline bool _termCellStyleEq(const TermCell* a, const TermCell* b) {
+  return a->fg == b->fg && a->bg == b->bg && a->attr == b->attr;
+}
+
+static void _termGridFree(VM* vm) {
+  if (_sTermGrid.back != NULL) {
+    Realloc(vm, _sTermGrid.back, 0);
+    Realloc(vm, _sTermGrid.front, 0);
+  }
+  _sTermGrid.back = NULL;
+  _sTermGrid.front = NULL;
+  _sTermGrid.width = 0;
+  _sTermGrid.height = 0;
+  _sTermGrid.full = false;
+}
+
+static void _termGridFill(TermCell* cells, size_t count, TermCell cell) {
+  for (size_t i = 0; i < count; i++)
+    cells[i] = cell;
+}
+
+// Append the parameters of a color to the SGR sequence in [buff], [base] is
+// 30 for the foreground and 40 for the background.
+static int _termSgrColor(char* buff, uint32_t color, int base) {
+  if (color == TERM_COLOR_DEFAULT)
+    return sprintf(buff, ";%d", base + 9);
+  if (color & TERM_COLOR_INDEX) {
+    int index = color & 0xff;
+    if (index < 8)
+      return sprintf(buff, ";%d", base + index);
+    return sprintf(buff, ";%d;5;%d", base + 8, index);
+  }
+  return sprintf(buff, ";%d;2;%d;%d;%d", base + 8, (color >> 16) & 0xff,
+                 (color >> 8) & 0xff, color & 0xff);
+}
+
+// Emit a single SGR sequence which changes the [pen] to the style of [cell].
+// If the pen is unknown, or an attribute has to be turned off, it's reset
+// first since the "off" codes of bold and dim are shared.
+static void _termSgr(VM* vm, TermCell* pen, bool* pen_known, const TermCell* cell) {
+  static const int codes[] = {1, 2, 3, 4, 7, 8, 9};
+
+  char buff[96];
+  int len = 0;
+  uint32_t attr = cell->attr;
+  bool reset = !*pen_known || (pen->attr & ~cell->attr) != 0;
+  if (reset) {
+    len += sprintf(buff + len, ";0");
+    pen->fg = TERM_COLOR_DEFAULT;
+    pen->bg = TERM_COLOR_DEFAULT;
+  } else {
+    attr &= ~pen->attr;
+  }
+
+  for (int i = 0; i < 7; i++) {
+    if (attr & (1 << i))
+      len += sprintf(buff + len, ";%d", codes[i]);
+  }
+  if (cell->fg != pen->fg)
+    len += _termSgrColor(buff + len, cell->fg, 30);
+  if (cell->bg != pen->bg)
+    len += _termSgrColor(buff + len, cell->bg, 40);
+
+  *pen = *cell;
+  *pen_known = true;
+  if (len == 0)
+    return;
+
+  // Skip the leading ';' of the parameters.
+  _termCtxWrite(vm, "\x1b[", 2);
+  _termCtxWrite(vm, buff + 1, len - 1);
+  _termCtxWrite(vm, "m", 1);
+}
+
+static void _termWriteCellChar(VM* vm, const TermCell* cell) {
+  if (cell->ch < 0x80) {
+    char c = (char) cell->ch;
+    _termCtxWrite(vm, &c, 1);
+    return;
+  }
+  uint8_t bytes[4];
+  int count = utf8_encodeValue((int) cell->ch, bytes);
+  _termCtxWrite(vm, (const char*) bytes, count);
+}
+
+// Append the escape sequences which bring the terminal from the front buffer
+// to the back buffer into the output buffer.
+static void _termGridDiff(VM* vm) {
+  TermGrid* grid = &_sTermGrid;
+  if (grid->back == NULL)
+    return;
+
+  int width = grid->width;
+  TermCell pen = _blankCell;
+  bool pen_known = false;
+  int cx = -1, cy = -1; // Cursor position, -1 if unknown.
+
+  if (grid->full) {
+    _termCtxWrite(vm, "\x1b[0m\x1b[H\x1b[2J", 11);
+    _termGridFill(grid->front, (size_t) width * grid->height, _blankCell);
+    pen_known = true;
+    cx = 0, cy = 0;
+    grid->full = false;
+  }
+
+  for (int y = 0; y < grid->height; y++) {
+    TermCell* back = grid->back + (size_t) y * width;
+    TermCell* front = grid->front + (size_t) y * width;
+
+    for (int x = 0; x < width; x++) {
+      if (_termCellEq(&back[x], &front[x]))
+        continue;
+
+      if (cy == y && cx >= 0 && cx < x) {
+        bool bridge = pen_known && (x - cx) < TERM_GRID_BRIDGE;
+        for (int i = cx; bridge && i < x; i++) {
+          bridge = _termCellStyleEq(&back[i], &pen) && back[i].ch < 0x80;
+        }
+        if (bridge) {
+          for (int i = cx; i < x; i++)
+            _termWriteCellChar(vm, &back[i]);
+        } else {
+          _termCtxWriteFmt(vm, "\x1b[%dC", x - cx);
+        }
+
+      } else if (x == 0 && cy >= 0 && y == cy + 1) {
+        _termCtxWrite(vm, "\r\n", 2);
+
+      } else if (cy != y || cx != x) {
+        _termCtxWriteFmt(vm, "\x1b[%d;%dH", y + 1, x + 1);
+      }
+
+      if (!pen_known || !_termCellStyleEq(&back[x], &pen))
+        _termSgr(vm, &pen, &pen_known, &back[x]);
+      _termWriteCellChar(vm, &back[x]);
+      front[x] = back[x];
+
+      // Writing the last column leaves the cursor in a pending wrap state
+      // which terminals handle differently, only the row is known there.
+      cx = (x + 1 < width) ? x + 1 : -1;
+      cy = y;
+    }
+  }
+
+  if (pen_known && !_termCellStyleEq(&pen, &_blankCell))
+    _termCtxWrite(vm, "\x1b[0m", 4);
+}
+
 // ----------------------------------------------------------------------------
 
 static void _setSlotVector(VM* vm, int slot, int tmp, double x, double y) {
@@ -311,6 +513,21 @@ void _registerEnums(VM* vm, Handle* term) {
   setAttribute(vm, 0, "EVENT_MOUSE_DRAG", 1);
   setSlotNumber(vm, 1, TERM_ET_MOUSE_SCROLL);
   setAttribute(vm, 0, "EVENT_MOUSE_SCROLL", 1);
+
+  setSlotNumber(vm, 1, TERM_ATTR_BOLD);
+  setAttribute(vm, 0, "ATTR_BOLD", 1);
+  setSlotNumber(vm, 1, TERM_ATTR_DIM);
+  setAttribute(vm, 0, "ATTR_DIM", 1);
+  setSlotNumber(vm, 1, TERM_ATTR_ITALIC);
+  setAttribute(vm, 0, "ATTR_ITALIC", 1);
+  setSlotNumber(vm, 1, TERM_ATTR_UNDERLINE);
+  setAttribute(vm, 0, "ATTR_UNDERLINE", 1);
+  setSlotNumber(vm, 1, TERM_ATTR_INVERSE);
+  setAttribute(vm, 0, "ATTR_INVERSE", 1);
+  setSlotNumber(vm, 1, TERM_ATTR_HIDDEN);
+  setAttribute(vm, 0, "ATTR_HIDDEN", 1);
+  setSlotNumber(vm, 1, TERM_ATTR_STRIKETHROUGH);
+  setAttribute(vm, 0, "ATTR_STRIKETHROUGH", 1);
 }
 
 saynaa_function(_termInit, "term.init(capture_events:Bool) -> Null",
@@ -328,9 +545,13 @@ saynaa_function(_termCleanup, "term.cleanup() -> Null",
   term_cleanup();
   _sTermCtx.done = false;
   _termCtxFree(vm);
+  _termGridFree(vm);
 }
 
-saynaa_function(_termFlush, "term.flush() -> Null", "Flush the internal buffer to stdout.") {
+saynaa_function(_termFlush, "term.flush() -> Null",
+                "Flush the internal buffer to stdout, followed by the cells of "
+                "the grid which were changed since the last flush.") {
+  _termGridDiff(vm);
   if (_sTermCtx.count > 0) {
     fwrite(_sTermCtx.data, 1, _sTermCtx.count, stdout);
     fflush(stdout);
@@ -551,6 +772,223 @@ saynaa_function(_termEndColorDefault, "term.end_color_default() -> Null", "") {
   _termCtxWrite(vm, "\x1b[49m", 5);
 }
 
+// -----------------------------------------------------------------------------
+// CELL GRID
+// -----------------------------------------------------------------------------
+
+// Validate an optional color argument, null means the default color.
+static bool _termValidateColor(VM* vm, int slot, uint32_t* color) {
+  if (GetSlotType(vm, slot) == vNULL) {
+    *color = TERM_COLOR_DEFAULT;
+    return true;
+  }
+
+  double value;
+  if (!ValidateSlotNumber(vm, slot, &value))
+    return false;
+
+  if (floor(value) == value && value >= 0 && value < 256) {
+    *color = TERM_COLOR_INDEX | (uint32_t) value;
+    return true;
+  }
+  if (floor(value) == value && value >= TERM_COLOR_RGB && value <= (TERM_COLOR_RGB | 0xffffff)) {
+    *color = (uint32_t) value;
+    return true;
+  }
+
+  SetRuntimeErrorFmt(vm, "Invalid color %g, expected a palette index (0-255) "
+                         "or a value returned by term.rgb().", value);
+  return false;
+}
+
+// Validate the optional (fg, bg, attr) arguments starting at [slot].
+static bool _termValidateCell(VM* vm, int argc, int slot, TermCell* cell) {
+  *cell = _blankCell;
+  if (argc >= slot && !_termValidateColor(vm, slot, &cell->fg))
+    return false;
+  if (argc >= slot + 1 && !_termValidateColor(vm, slot + 1, &cell->bg))
+    return false;
+  if (argc >= slot + 2) {
+    int32_t attr;
+    if (!ValidateSlotInteger(vm, slot + 2, &attr))
+      return false;
+    cell->attr = (uint32_t) attr & TERM_ATTR_MASK;
+  }
+  return true;
+}
+
+static bool _termCheckGrid(VM* vm) {
+  if (_sTermGrid.back == NULL) {
+    SetRuntimeError(vm, "The cell grid wasn't created, call term.grid() first.");
+    return false;
+  }
+  return true;
+}
+
+saynaa_function(_termGrid, "term.grid(width:Number, height:Number) -> Null",
+                "Create the cell grid of [width] x [height] cells which is drawn "
+                "with term.put() and term.fill() and written by term.flush(). "
+                "Resizing clears the grid and calling it again with the same "
+                "size keeps the cells but redraws the whole screen on the next "
+                "flush.") {
+  int32_t width, height;
+  if (!ValidateSlotInteger(vm, 1, &width))
+    return;
+  if (!ValidateSlotInteger(vm, 2, &height))
+    return;
+
+  if (width <= 0 || height <= 0) {
+    SetRuntimeErrorFmt(vm, "Invalid grid size %dx%d.", width, height);
+    return;
+  }
+
+  TermGrid* grid = &_sTermGrid;
+  if (grid->width != width || grid->height != height) {
+    _termGridFree(vm);
+    size_t count = (size_t) width * height;
+    grid->back = Realloc(vm, NULL, sizeof(TermCell) * count);
+    grid->front = Realloc(vm, NULL, sizeof(TermCell) * count);
+    _termGridFill(grid->back, count, _blankCell);
+    grid->width = width;
+    grid->height = height;
+  }
+  grid->full = true;
+}
+
+saynaa_function(_termPut,
+                "term.put(x:Number, y:Number, text:String, fg:Number=null, "
+                "bg:Number=null, attr:Number=0) -> Number",
+                "Write the characters of [text] into the grid from the cell at "
+                "(x, y), clipped to the row. The colors are palette indexes or "
+                "term.rgb() values (null for the default) and [attr] is a "
+                "combination of term.ATTR_* flags. Returns the column after the "
+                "last character.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 3, 6))
+    return;
+  if (!_termCheckGrid(vm))
+    return;
+
+  int32_t x, y;
+  const char* text;
+  uint32_t length;
+  TermCell cell;
+  if (!ValidateSlotInteger(vm, 1, &x))
+    return;
+  if (!ValidateSlotInteger(vm, 2, &y))
+    return;
+  if (!ValidateSlotString(vm, 3, &text, &length))
+    return;
+  if (!_termValidateCell(vm, argc, 4, &cell))
+    return;
+
+  TermGrid* grid = &_sTermGrid;
+  const uint8_t* c = (const uint8_t*) text;
+  const uint8_t* end = c + length;
+
+  while (c < end) {
+    int ch = *c, count = 1;
+    if (ch >= 0x80) {
+      count = utf8_decodeBytesCount(*c);
+      if (count > end - c || utf8_decodeBytes((uint8_t*) c, &ch) == 0 || ch < 0) {
+        ch = '?', count = 1;
+      }
+    }
+    c += count;
+
+    // Control characters would move the cursor behind our back.
+    if (ch < 0x20 || ch == 0x7f)
+      ch = ' ';
+
+    if (y >= 0 && y < grid->height && x >= 0 && x < grid->width) {
+      cell.ch = (uint32_t) ch;
+      grid->back[(size_t) y * grid->width + x] = cell;
+    }
+    x++;
+  }
+
+  setSlotNumber(vm, 0, (double) x);
+}
+
+saynaa_function(_termFill,
+                "term.fill(x:Number, y:Number, width:Number, height:Number, "
+                "ch:String=' ', fg:Number=null, bg:Number=null, attr:Number=0) "
+                "-> Null",
+                "Fill a rectangle of the grid with the character [ch] and the "
+                "given style, clipped to the grid.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 4, 8))
+    return;
+  if (!_termCheckGrid(vm))
+    return;
+
+  int32_t x, y, width, height;
+  TermCell cell;
+  if (!ValidateSlotInteger(vm, 1, &x))
+    return;
+  if (!ValidateSlotInteger(vm, 2, &y))
+    return;
+  if (!ValidateSlotInteger(vm, 3, &width))
+    return;
+  if (!ValidateSlotInteger(vm, 4, &height))
+    return;
+  if (!_termValidateCell(vm, argc, 6, &cell))
+    return;
+
+  if (argc >= 5) {
+    const char* ch;
+    uint32_t length;
+    if (!ValidateSlotString(vm, 5, &ch, &length))
+      return;
+
+    int value = (length > 0) ? (uint8_t) ch[0] : -1;
+    if (value >= 0x80) {
+      int count = utf8_decodeBytesCount((uint8_t) ch[0]);
+      if (count > (int) length || utf8_decodeBytes((uint8_t*) ch, &value) != (int) length)
+        value = -1;
+    } else if (length != 1) {
+      value = -1;
+    }
+    if (value < 0x20 || value == 0x7f) {
+      SetRuntimeError(vm, "Expected a single printable character.");
+      return;
+    }
+    cell.ch = (uint32_t) value;
+  }
+
+  TermGrid* grid = &_sTermGrid;
+  int x0 = (x > 0) ? x : 0, y0 = (y > 0) ? y : 0;
+  int x1 = (x + width < grid->width) ? x + width : grid->width;
+  int y1 = (y + height < grid->height) ? y + height : grid->height;
+  for (int row = y0; row < y1; row++) {
+    TermCell* cells = grid->back + (size_t) row * grid->width;
+    for (int col = x0; col < x1; col++)
+      cells[col] = cell;
+  }
+}
+
+saynaa_function(_termRgb, "term.rgb(r:Number, g:Number, b:Number) -> Number",
+                "Returns a 24 bit color for the grid functions.") {
+  int32_t r, g, b;
+  if (!ValidateSlotInteger(vm, 1, &r))
+    return;
+  if (!ValidateSlotInteger(vm, 2, &g))
+    return;
+  if (!ValidateSlotInteger(vm, 3, &b))
+    return;
+  uint32_t color = ((uint32_t) (r & 0xff) << 16) | ((uint32_t) (g & 0xff) << 8) | (b & 0xff);
+  setSlotNumber(vm, 0, (double) (TERM_COLOR_RGB | color));
+}
+
+saynaa_function(_termRender, "term.render() -> String",
+                "Returns what term.flush() would write (the buffered output "
+                "followed by the changes of the grid) and clears the buffer "
+                "instead of writing it to stdout.") {
+  _termGridDiff(vm);
+  setSlotStringLength(vm, 0, _sTermCtx.data, _sTermCtx.count);
+  _sTermCtx.count = 0;
+}
+
 // -----------------------------------------------------------------------------
 // MAIN LOOP
 // -----------------------------------------------------------------------------
@@ -697,6 +1135,7 @@ saynaa_function(_termRun, "term.run(config:Config) -> Null", "Run the main loop.
 
   term_cleanup();
   _termCtxFree(vm);
+  _termGridFree(vm);
 
   releaseHandle(vm, config);
 }
@@ -848,6 +1287,13 @@ void registerModuleTerm(VM* vm) {
   REGISTER_FN(term, "start_color_functionault", _termColorDefault, 0);
   REGISTER_FN(term, "end_color_functionault", _termEndColorDefault, 0);
 
+  // Cell grid
+  REGISTER_FN(term, "grid", _termGrid, 2);
+  REGISTER_FN(term, "put", _termPut, -1);
+  REGISTER_FN(term, "fill", _termFill, -1);
+  REGISTER_FN(term, "rgb", _termRgb, 3);
+  REGISTER_FN(term, "render", _termRender, 0);
+
   REGISTER_FN(term, "run", _termRun, 1);
 
   _cls_term_event = NewClass(vm, "Event", NULL, term, _termEventNew, _termEventDelete,
@@ -869,4 +1315,5 @@ void cleanupModuleTerm(VM* vm) {
   if (_cls_term_config)
     releaseHandle(vm, _cls_term_config);
   _termCtxFree(vm);
+  _termGridFree(vm);
 }
@@ -7,6 +7,10 @@
 
 #include <math.h>
 
+#include "../utils/saynaa_simd.h"
+
+#define SLOT(n) (vm->fiber->ret[n])
+
 saynaa_function(_typesHashable, "types.hashable(value:Var) -> Bool",
                 "Returns true if the [value] is hashable.") {
   // Get argument 1 directly.
@@ -31,6 +35,14 @@ saynaa_function(_typesHash, "types.hash(value:Var) -> Number", "Returns the hash
     return;
   }
 
+  // Scripts could have stored the hash of a string so it's the FNV-1a hash,
+  // not the one the VM uses internally which could change.
+  if (IS_OBJ_TYPE(value, OBJ_STRING)) {
+    String* str = (String*) AS_OBJ(value);
+    setSlotNumber(vm, 0, utilHashStringFNV(str->data, str->length));
+    return;
+  }
+
   setSlotNumber(vm, 0, varHashValue(value));
 }
 
@@ -45,6 +57,7 @@ static void* _bytebuffNew(VM* vm) {
 }
 
 static void _bytebuffDelete(VM* vm, void* buff) {
+  ByteBufferClear((ByteBuffer*) buff, vm);
   Realloc(vm, buff, 0);
 }
 
@@ -200,6 +213,10 @@ saynaa_function(_bytebuffSubscriptSet,
   thiz->data[(uint32_t) index] = (uint8_t) value;
 }
 
+ByteBuffer* typesGetByteBuffer(Var value) {
+  return getNativeInstanceOf(value, _bytebuffDelete);
+}
+
 saynaa_function(_bytebuffString, "types.ByteBuffer.string() -> String",
                 "Returns the buffered values as String.") {
   ByteBuffer* thiz = GetThis(vm);
@@ -317,6 +334,702 @@ saynaa_function(_vectorRepr, "types.Vector._repr()", "") {
   setSlotStringFmt(vm, 0, "[%g, %g, %g]", vec->x, vec->y, vec->z);
 }
 
+/*****************************************************************************/
+/* TYPED ARRAYS                                                              */
+/*****************************************************************************/
+
+// Float64Array, Float32Array, Int32Array and Uint8Array are fixed length
+// arrays of numbers stored contiguously, they're subclasses of TypedArray
+// which implements their methods. An array either owns its elements or is a
+// view over the bytes of a ByteBuffer. A view keeps a handle of the buffer so
+// it stays alive, and locates its elements again on every access since
+// writing to the buffer could reallocate (or clearing it shrink) the bytes.
+
+typedef enum {
+  TYPED_FLOAT64,
+  TYPED_FLOAT32,
+  TYPED_INT32,
+  TYPED_UINT8,
+} TypedArrayKind;
+
+static const char* _typed_names[] = {"Float64Array", "Float32Array", "Int32Array",
+                                     "Uint8Array"};
+
+static const uint32_t _typed_sizes[] = {sizeof(double), sizeof(float), sizeof(int32_t),
+                                        sizeof(uint8_t)};
+
+typedef struct {
+  TypedArrayKind kind;
+  uint32_t length; //< Number of elements.
+  void* data;      //< The elements if it's not a view.
+  Handle* buffer;  //< The ByteBuffer instance of a view, otherwise NULL.
+  uint32_t offset; //< Byte offset of a view's elements in the buffer.
+} TypedArray;
+
+static void* _typedNew(VM* vm, TypedArrayKind kind) {
+  TypedArray* arr = Realloc(vm, NULL, sizeof(TypedArray));
+  memset(arr, 0, sizeof(TypedArray));
+  arr->kind = kind;
+  return arr;
+}
+
+static void* _float64ArrayNew(VM* vm) {
+  return _typedNew(vm, TYPED_FLOAT64);
+}
+
+static void* _float32ArrayNew(VM* vm) {
+  return _typedNew(vm, TYPED_FLOAT32);
+}
+
+static void* _int32ArrayNew(VM* vm) {
+  return _typedNew(vm, TYPED_INT32);
+}
+
+static void* _uint8ArrayNew(VM* vm) {
+  return _typedNew(vm, TYPED_UINT8);
+}
+
+// Release the elements (or the buffer of a view) of the array.
+static void _typedRelease(VM* vm, TypedArray* arr) {
+  if (arr->buffer != NULL)
+    releaseHandle(vm, arr->buffer);
+  if (arr->data != NULL)
+    Realloc(vm, arr->data, 0);
+  arr->length = 0;
+  arr->data = NULL;
+  arr->buffer = NULL;
+  arr->offset = 0;
+}
+
+static void _typedDelete(VM* vm, void* arr) {
+  _typedRelease(vm, (TypedArray*) arr);
+  Realloc(vm, arr, 0);
+}
+
+// Set [data] to the elements of the array. Returns false with a runtime error
+// if it's a view which doesn't fit in its buffer anymore.
+static bool _typedData(VM* vm, TypedArray* arr, void** data) {
+  if (arr->buffer == NULL) {
+    *data = arr->data;
+    return true;
+  }
+
+  ByteBuffer* buff = ((Instance*) AS_OBJ(arr->buffer->value))->native;
+  uint64_t end = arr->offset + (uint64_t) arr->length * _typed_sizes[arr->kind];
+  if (end > buff->count) {
+    SetRuntimeError(vm, "The ByteBuffer is smaller than the view.");
+    return false;
+  }
+
+  *data = buff->data + arr->offset;
+  return true;
+}
+
+static inline double _typedGet(TypedArrayKind kind, const void* data, uint32_t index) {
+  switch (kind) {
+    case TYPED_FLOAT64:
+      return ((const double*) data)[index];
+    case TYPED_FLOAT32:
+      return ((const float*) data)[index];
+    case TYPED_INT32:
+      return ((const int32_t*) data)[index];
+    case TYPED_UINT8:
+      return ((const uint8_t*) data)[index];
+  }
+  UNREACHABLE();
+  return 0;
+}
+
+// Numbers stored to the integer arrays are truncated and wrapped around to
+// the range of the element type (like a C cast to an unsigned type), NaN and
+// the infinities are stored as 0.
+static inline uint32_t _typedWrap(double value, double modulo) {
+  if (value >= 0 && value < modulo)
+    return (uint32_t) value;
+  if (!isfinite(value))
+    return 0;
+  double wrapped = fmod(trunc(value), modulo);
+  if (wrapped < 0)
+    wrapped += modulo;
+  return (uint32_t) wrapped;
+}
+
+static inline void _typedSet(TypedArrayKind kind, void* data, uint32_t index, double value) {
+  switch (kind) {
+    case TYPED_FLOAT64:
+      ((double*) data)[index] = value;
+      return;
+    case TYPED_FLOAT32:
+      ((float*) data)[index] = (float) value;
+      return;
+    case TYPED_INT32:
+      if (value > INT32_MIN - 1.0 && value < INT32_MAX + 1.0)
+        ((int32_t*) data)[index] = (int32_t) value;
+      else
+        ((int32_t*) data)[index] = (int32_t) _typedWrap(value, 4294967296.0);
+      return;
+    case TYPED_UINT8:
+      ((uint8_t*) data)[index] = (uint8_t) _typedWrap(value, 256.0);
+      return;
+  }
+  UNREACHABLE();
+}
+
+// Validate that the slot is a non negative integer and set [value] to it.
+static bool _typedValidateCount(VM* vm, int slot, uint32_t* value) {
+  double number;
+  if (!ValidateSlotNumber(vm, slot, &number))
+    return false;
+  if (floor(number) != number || number < 0 || number > UINT32_MAX) {
+    SetRuntimeError(vm, "Expected a non negative integer.");
+    return false;
+  }
+  *value = (uint32_t) number;
+  return true;
+}
+
+// Allocate [length] zeroed elements for the array.
+static void _typedAllocate(VM* vm, TypedArray* arr, uint32_t length) {
+  size_t size = (size_t) length * _typed_sizes[arr->kind];
+  arr->length = length;
+  if (size > 0) {
+    arr->data = Realloc(vm, NULL, size);
+    memset(arr->data, 0, size);
+  }
+}
+
+// Make the array a view over the ByteBuffer at the slot 1, the optional byte
+// offset and the length are at the slots 2 and 3.
+static void _typedInitView(VM* vm, TypedArray* arr, ByteBuffer* buff) {
+  uint32_t size = _typed_sizes[arr->kind];
+  int argc = GetArgc(vm);
+
+  uint32_t offset = 0;
+  if (argc >= 2 && !_typedValidateCount(vm, 2, &offset))
+    return;
+  if (offset % size != 0) {
+    SetRuntimeErrorFmt(vm, "The offset of a %s should be a multiple of %i.",
+                       _typed_names[arr->kind], (int) size);
+    return;
+  }
+  if (offset > buff->count) {
+    SetRuntimeError(vm, "The offset is out of the ByteBuffer.");
+    return;
+  }
+
+  uint32_t length = (buff->count - offset) / size;
+  if (argc == 3) {
+    if (!_typedValidateCount(vm, 3, &length))
+      return;
+    if ((uint64_t) length * size > buff->count - offset) {
+      SetRuntimeError(vm, "The view is out of the ByteBuffer.");
+      return;
+    }
+  }
+
+  arr->buffer = GetSlotHandle(vm, 1);
+  arr->offset = offset;
+  arr->length = length;
+}
+
+saynaa_function(
+    _typedInit,
+    "types.TypedArray._init(from:Number|List|TypedArray|ByteBuffer "
+    "[, offset:Number, length:Number])",
+    "Create an array of [from] zeros if it's a number, or with the elements "
+    "of [from] if it's a list or a typed array. If [from] is a ByteBuffer the "
+    "array is a view over its bytes from the byte [offset] (a multiple of the "
+    "element size) with [length] elements, by default all the elements which "
+    "fit in the buffer.") {
+  int argc = GetArgc(vm);
+  if (!CheckArgcRange(vm, argc, 1, 3))
+    return;
+
+  // Not using GetThis() since a TypedArray instance doesn't have a native.
+  TypedArray* arr = getNativeInstanceOf(vm->fiber->thiz, _typedDelete);
+  if (arr == NULL) {
+    SetRuntimeError(vm, "TypedArray cannot be instantiated, use one of its subclasses.");
+    return;
+  }
+  _typedRelease(vm, arr);
+
+  Var from = SLOT(1);
+
+  ByteBuffer* buff = getNativeInstanceOf(from, _bytebuffDelete);
+  if (buff != NULL) {
+    _typedInitView(vm, arr, buff);
+    return;
+  }
+
+  if (argc != 1) {
+    SetRuntimeError(vm, "Offset and length are only expected with a ByteBuffer.");
+    return;
+  }
+
+  if (IS_NUM(from)) {
+    uint32_t length;
+    if (!_typedValidateCount(vm, 1, &length))
+      return;
+    _typedAllocate(vm, arr, length);
+    return;
+  }
+
+  if (IS_OBJ_TYPE(from, OBJ_LIST)) {
+    List* list = (List*) AS_OBJ(from);
+    for (uint32_t i = 0; i < list->elements.count; i++) {
+      if (!IS_NUM(list->elements.data[i])) {
+        SetRuntimeErrorFmt(vm, "Expected a list of numbers, got %s at index %i.",
+                           varTypeName(list->elements.data[i]), (int) i);
+        return;
+      }
+    }
+
+    _typedAllocate(vm, arr, list->elements.count);
+    for (uint32_t i = 0; i < arr->length; i++)
+      _typedSet(arr->kind, arr->data, i, AS_NUM(list->elements.data[i]));
+    return;
+  }
+
+  TypedArray* other = getNativeInstanceOf(from, _typedDelete);
+  if (other != NULL) {
+    void* src;
+    if (!_typedData(vm, other, &src))
+      return;
+    _typedAllocate(vm, arr, other->length);
+    if (arr->length == 0)
+      return;
+
+    if (other->kind == arr->kind) {
+      memcpy(arr->data, src, (size_t) arr->length * _typed_sizes[arr->kind]);
+    } else {
+      for (uint32_t i = 0; i < arr->length; i++)
+        _typedSet(arr->kind, arr->data, i, _typedGet(other->kind, src, i));
+    }
+    return;
+  }
+
+  SetRuntimeErrorFmt(vm, "Cannot create a %s from %s.", _typed_names[arr->kind],
+                     varTypeName(from));
+}
+
+// Validate the index at [slot] and set [index] to it. Like lists negative
+// indexes are from the end of the array.
+static bool _typedValidateIndex(VM* vm, TypedArray* arr, int slot, uint32_t* index) {
+  double number;
+  if (!ValidateSlotNumber(vm, slot, &number))
+    return false;
+  if (floor(number) != number) {
+    SetRuntimeError(vm, "Expected an integer but got number.");
+    return false;
+  }
+
+  if (number < 0)
+    number += arr->length;
+  if (number < 0 || number >= arr->length) {
+    SetRuntimeError(vm, "Index out of bound");
+    return false;
+  }
+
+  *index = (uint32_t) number;
+  return true;
+}
+
+saynaa_function(_typedSubscriptGet, "types.TypedArray.[](index:Number) -> Number", "") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  uint32_t index;
+  if (!_typedValidateIndex(vm, arr, 1, &index) || !_typedData(vm, arr, &data))
+    return;
+  setSlotNumber(vm, 0, _typedGet(arr->kind, data, index));
+}
+
+saynaa_function(_typedSubscriptSet,
+                "types.TypedArray.[]=(index:Number, value:Number)", "") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  uint32_t index;
+  double value;
+  if (!_typedValidateIndex(vm, arr, 1, &index) || !ValidateSlotNumber(vm, 2, &value))
+    return;
+  if (!_typedData(vm, arr, &data))
+    return;
+  _typedSet(arr->kind, data, index, value);
+}
+
+saynaa_function(_typedGetter, "types.TypedArray._getter()", "") {
+  const char* name;
+  uint32_t length;
+  if (!ValidateSlotString(vm, 1, &name, &length))
+    return;
+
+  TypedArray* arr = GetThis(vm);
+  if (length == 6 && strncmp(name, "length", 6) == 0) {
+    setSlotNumber(vm, 0, arr->length);
+    return;
+  }
+}
+
+saynaa_function(_typedRepr, "types.TypedArray._repr()", "") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  if (!_typedData(vm, arr, &data))
+    return;
+
+  ByteBuffer buff;
+  ByteBufferInit(&buff);
+  ByteBufferAddStringFmt(&buff, vm, "%s([", _typed_names[arr->kind]);
+  for (uint32_t i = 0; i < arr->length; i++) {
+    if (i > 0)
+      ByteBufferAddString(&buff, vm, ", ", 2);
+    ByteBufferAddStringFmt(&buff, vm, DOUBLE_FMT, _typedGet(arr->kind, data, i));
+  }
+  ByteBufferAddString(&buff, vm, "])", 2);
+  setSlotStringLength(vm, 0, (const char*) buff.data, buff.count);
+  ByteBufferClear(&buff, vm);
+}
+
+saynaa_function(_typedList, "types.TypedArray.list() -> List",
+                "Returns a list of the elements of the array.") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  if (!_typedData(vm, arr, &data))
+    return;
+
+  List* list = newList(vm, arr->length);
+  for (uint32_t i = 0; i < arr->length; i++)
+    list->elements.data[i] = VAR_NUM(_typedGet(arr->kind, data, i));
+  list->elements.count = arr->length;
+  RET(VAR_OBJ(list));
+}
+
+saynaa_function(_typedFill, "types.TypedArray.fill(value:Number) -> TypedArray",
+                "Set all the elements of the array to [value] and returns the "
+                "array.") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  double value;
+  if (!ValidateSlotNumber(vm, 1, &value) || !_typedData(vm, arr, &data))
+    return;
+
+  if (arr->kind == TYPED_UINT8) {
+    memset(data, (int) _typedWrap(value, 256.0), arr->length);
+  } else {
+    for (uint32_t i = 0; i < arr->length; i++)
+      _typedSet(arr->kind, data, i, value);
+  }
+  PlaceThis(vm, 0);
+}
+
+// Apply [op] to the [length] elements of [a] and the ones of [b] (which is of
+// the same kind), or the [scalar] if [b] is NULL, with the SIMD kernel of the
+// kind. Returns false if there isn't a kernel that gives the same results as
+// computing with doubles and converting back.
+static bool _typedArithSIMD(TypedArrayKind kind, void* out, void* a, void* b,
+                            double scalar, uint32_t length, char op) {
+  switch (kind) {
+    case TYPED_FLOAT64:
+      if (b == NULL)
+        simdArithScalarDoubles(out, a, scalar, length, op);
+      else
+        simdArithDoubles(out, a, b, length, op);
+      return true;
+
+    case TYPED_FLOAT32:
+      if (b == NULL)
+        simdArithScalarFloats(out, a, scalar, length, op);
+      else
+        simdArithFloats(out, a, b, length, op);
+      return true;
+
+    case TYPED_INT32:
+    case TYPED_UINT8: {
+      // Only the exact sums wrap around the same as the integer additions, a
+      // product of int32s may not fit in a double.
+      if (op != '+' && op != '-')
+        return false;
+      if (b != NULL) {
+        if (kind == TYPED_INT32)
+          simdAddInt32s(out, a, b, length, op == '-');
+        else
+          simdAddBytes(out, a, b, length, op == '-');
+        return true;
+      }
+
+      if (trunc(scalar) != scalar || fabs(scalar) > INT32_MAX)
+        return false;
+      uint32_t addend = (uint32_t) (int32_t) ((op == '-') ? -scalar : scalar);
+      if (kind == TYPED_INT32)
+        simdAddScalarInt32s(out, a, addend, length);
+      else
+        simdAddScalarBytes(out, a, (uint8_t) addend, length);
+      return true;
+    }
+  }
+  UNREACHABLE();
+  return false;
+}
+
+// Apply the arithmetic operator [op] to the elements of [arr] and the number
+// or the typed array at the slot 1, and store the results to [dst] which is
+// of the same kind and length as [arr].
+static void _typedArith(VM* vm, TypedArray* dst, TypedArray* arr, char op) {
+  Var operand = SLOT(1);
+  TypedArray* other = NULL;
+  if (!IS_NUM(operand)) {
+    other = getNativeInstanceOf(operand, _typedDelete);
+    if (other == NULL) {
+      SetRuntimeErrorFmt(vm, "Expected a Number or a TypedArray, got %s.",
+                         varTypeName(operand));
+      return;
+    }
+    if (other->length != arr->length) {
+      SetRuntimeErrorFmt(vm, "Expected an array of length %i, got %i.",
+                         (int) arr->length, (int) other->length);
+      return;
+    }
+  }
+
+  void *a, *b = NULL, *out;
+  if (!_typedData(vm, arr, &a) || !_typedData(vm, dst, &out))
+    return;
+  if (other != NULL && !_typedData(vm, other, &b))
+    return;
+  if (arr->length == 0)
+    return;
+
+  if (other == NULL || other->kind == arr->kind) {
+    double scalar = (other == NULL) ? AS_NUM(operand) : 0;
+    if (_typedArithSIMD(arr->kind, out, a, b, scalar, arr->length, op))
+      return;
+  }
+
+  // The mixed kinds (and the rest of the operators of the integer arrays) are
+  // computed as doubles and converted back.
+  for (uint32_t i = 0; i < arr->length; i++) {
+    double x = _typedGet(arr->kind, a, i);
+    double y = (other == NULL) ? AS_NUM(operand) : _typedGet(other->kind, b, i);
+    double result;
+    switch (op) {
+      case '+':
+        result = x + y;
+        break;
+      case '-':
+        result = x - y;
+        break;
+      case '*':
+        result = x * y;
+        break;
+      default:
+        result = x / y;
+        break;
+    }
+    _typedSet(arr->kind, out, i, result);
+  }
+}
+
+// The arithmetic methods update the array in place and return it.
+static void _typedArithInPlace(VM* vm, char op) {
+  TypedArray* arr = GetThis(vm);
+  _typedArith(vm, arr, arr, op);
+  if (!VM_HAS_ERROR(vm))
+    PlaceThis(vm, 0);
+}
+
+// The arithmetic operators return a new array of the same class.
+static void _typedArithNew(VM* vm, char op) {
+  TypedArray* arr = GetThis(vm);
+
+  reserveSlots(vm, 4);
+  PlaceThis(vm, 2);
+  GetClass(vm, 2, 2);
+  setSlotNumber(vm, 3, arr->length);
+  if (!NewInstance(vm, 2, 0, 1, 3))
+    return;
+
+  _typedArith(vm, GetSlotNativeInstance(vm, 0), arr, op);
+}
+
+saynaa_function(_typedAdd, "types.TypedArray.add(other:Number|TypedArray) -> TypedArray",
+                "Add [other] (a number or an array of the same length) to the "
+                "elements of the array in place and returns the array.") {
+  _typedArithInPlace(vm, '+');
+}
+
+saynaa_function(_typedSub, "types.TypedArray.sub(other:Number|TypedArray) -> TypedArray",
+                "Subtract [other] (a number or an array of the same length) from "
+                "the elements of the array in place and returns the array.") {
+  _typedArithInPlace(vm, '-');
+}
+
+saynaa_function(_typedMul, "types.TypedArray.mul(other:Number|TypedArray) -> TypedArray",
+                "Multiply the elements of the array by [other] (a number or an "
+                "array of the same length) in place and returns the array.") {
+  _typedArithInPlace(vm, '*');
+}
+
+saynaa_function(_typedDiv, "types.TypedArray.div(other:Number|TypedArray) -> TypedArray",
+                "Divide the elements of the array by [other] (a number or an "
+                "array of the same length) in place and returns the array.") {
+  _typedArithInPlace(vm, '/');
+}
+
+saynaa_function(_typedAddNew, "types.TypedArray.+(other:Number|TypedArray) -> TypedArray",
+                "") {
+  _typedArithNew(vm, '+');
+}
+
+saynaa_function(_typedSubNew, "types.TypedArray.-(other:Number|TypedArray) -> TypedArray",
+                "") {
+  _typedArithNew(vm, '-');
+}
+
+saynaa_function(_typedMulNew, "types.TypedArray.*(other:Number|TypedArray) -> TypedArray",
+                "") {
+  _typedArithNew(vm, '*');
+}
+
+saynaa_function(_typedDivNew, "types.TypedArray./(other:Number|TypedArray) -> TypedArray",
+                "") {
+  _typedArithNew(vm, '/');
+}
+
+// Returns the dot product of [a] and [b] of the same [kind].
+static double _typedDotSIMD(TypedArrayKind kind, const void* a, const void* b,
+                            uint32_t length) {
+  switch (kind) {
+    case TYPED_FLOAT64:
+      return simdDotDoubles(a, b, length);
+    case TYPED_FLOAT32:
+      return simdDotFloats(a, b, length);
+    case TYPED_INT32:
+      return simdDotInt32s(a, b, length);
+    case TYPED_UINT8:
+      return (double) simdDotBytes(a, b, length);
+  }
+  UNREACHABLE();
+  return 0;
+}
+
+saynaa_function(_typedDot, "types.TypedArray.dot(other:TypedArray) -> Number",
+                "Returns the dot product of the array and [other] which should be "
+                "of the same length.") {
+  TypedArray* arr = GetThis(vm);
+  TypedArray* other = getNativeInstanceOf(SLOT(1), _typedDelete);
+  if (other == NULL) {
+    SetRuntimeErrorFmt(vm, "Expected a TypedArray, got %s.", varTypeName(SLOT(1)));
+    return;
+  }
+  if (other->length != arr->length) {
+    SetRuntimeErrorFmt(vm, "Expected an array of length %i, got %i.",
+                       (int) arr->length, (int) other->length);
+    return;
+  }
+
+  void *a, *b;
+  if (!_typedData(vm, arr, &a) || !_typedData(vm, other, &b))
+    return;
+
+  if (other->kind == arr->kind) {
+    setSlotNumber(vm, 0, _typedDotSIMD(arr->kind, a, b, arr->length));
+    return;
+  }
+
+  double total = 0;
+  for (uint32_t i = 0; i < arr->length; i++)
+    total += _typedGet(arr->kind, a, i) * _typedGet(other->kind, b, i);
+  setSlotNumber(vm, 0, total);
+}
+
+saynaa_function(_typedSum, "types.TypedArray.sum() -> Number",
+                "Returns the sum of the elements of the array.") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  if (!_typedData(vm, arr, &data))
+    return;
+
+  double total = 0;
+  switch (arr->kind) {
+    case TYPED_FLOAT64:
+      total = simdSumDoubles(data, arr->length);
+      break;
+    case TYPED_FLOAT32:
+      total = simdSumFloats(data, arr->length);
+      break;
+    case TYPED_INT32:
+      total = simdSumInt32s(data, arr->length);
+      break;
+    case TYPED_UINT8:
+      total = (double) simdSumBytes(data, arr->length);
+      break;
+  }
+  setSlotNumber(vm, 0, total);
+}
+
+// Implements min() and max().
+static void _typedMinMax(VM* vm, bool max) {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  if (!_typedData(vm, arr, &data))
+    return;
+
+  if (arr->length == 0) {
+    SetRuntimeErrorFmt(vm, "%s() of an empty array.", max ? "max" : "min");
+    return;
+  }
+
+  double result = 0;
+  switch (arr->kind) {
+    case TYPED_FLOAT64:
+      result = simdMinMaxDoubles(data, arr->length, max);
+      break;
+    case TYPED_FLOAT32:
+      result = simdMinMaxFloats(data, arr->length, max);
+      break;
+    case TYPED_INT32:
+      result = simdMinMaxInt32s(data, arr->length, max);
+      break;
+    case TYPED_UINT8:
+      result = simdMinMaxBytes(data, arr->length, max);
+      break;
+  }
+  setSlotNumber(vm, 0, result);
+}
+
+saynaa_function(_typedMin, "types.TypedArray.min() -> Number",
+                "Returns the minimum element of the array.") {
+  _typedMinMax(vm, false);
+}
+
+saynaa_function(_typedMax, "types.TypedArray.max() -> Number",
+                "Returns the maximum element of the array.") {
+  _typedMinMax(vm, true);
+}
+
+saynaa_function(_typedCumsum, "types.TypedArray.cumsum() -> TypedArray",
+                "Replace each element of the array with the sum of the elements "
+                "up to (and including) it, and returns the array.") {
+  TypedArray* arr = GetThis(vm);
+  void* data;
+  if (!_typedData(vm, arr, &data))
+    return;
+
+  // A prefix sum is sequential, the vectorized ones add in a different order
+  // which changes the rounding of the floats.
+  if (arr->kind == TYPED_FLOAT64) {
+    double* values = data;
+    for (uint32_t i = 1; i < arr->length; i++)
+      values[i] += values[i - 1];
+  } else {
+    // Sum as doubles so the sums are wrapped (or rounded) only once.
+    double total = 0;
+    for (uint32_t i = 0; i < arr->length; i++) {
+      total += _typedGet(arr->kind, data, i);
+      _typedSet(arr->kind, data, i, total);
+    }
+  }
+  PlaceThis(vm, 0);
+}
+
 /*****************************************************************************/
 /* MODULE REGISTER                                                           */
 /*****************************************************************************/
@@ -356,6 +1069,51 @@ void registerModuleTypes(VM* vm) {
 
   releaseHandle(vm, cls_vector);
 
+  Handle* cls_typed_array = NewClass(
+      vm, "TypedArray", NULL, types, NULL, NULL,
+      "The base class of the typed arrays, which are fixed length arrays of "
+      "numbers stored contiguously.");
+
+  ADD_METHOD(cls_typed_array, "_init", _typedInit, -1);
+  ADD_METHOD(cls_typed_array, "_getter", _typedGetter, 1);
+  ADD_METHOD(cls_typed_array, "_repr", _typedRepr, 0);
+  ADD_METHOD(cls_typed_array, "[]", _typedSubscriptGet, 1);
+  ADD_METHOD(cls_typed_array, "[]=", _typedSubscriptSet, 2);
+  ADD_METHOD(cls_typed_array, "+", _typedAddNew, 1);
+  ADD_METHOD(cls_typed_array, "-", _typedSubNew, 1);
+  ADD_METHOD(cls_typed_array, "*", _typedMulNew, 1);
+  ADD_METHOD(cls_typed_array, "/", _typedDivNew, 1);
+  ADD_METHOD(cls_typed_array, "add", _typedAdd, 1);
+  ADD_METHOD(cls_typed_array, "sub", _typedSub, 1);
+  ADD_METHOD(cls_typed_array, "mul", _typedMul, 1);
+  ADD_METHOD(cls_typed_array, "div", _typedDiv, 1);
+  ADD_METHOD(cls_typed_array, "dot", _typedDot, 1);
+  ADD_METHOD(cls_typed_array, "sum", _typedSum, 0);
+  ADD_METHOD(cls_typed_array, "min", _typedMin, 0);
+  ADD_METHOD(cls_typed_array, "max", _typedMax, 0);
+  ADD_METHOD(cls_typed_array, "cumsum", _typedCumsum, 0);
+  ADD_METHOD(cls_typed_array, "fill", _typedFill, 1);
+  ADD_METHOD(cls_typed_array, "list", _typedList, 0);
+
+  Handle* cls_float64_array =
+      NewClass(vm, "Float64Array", cls_typed_array, types, _float64ArrayNew,
+               _typedDelete, "An array of 64 bit floating point numbers.");
+  Handle* cls_float32_array =
+      NewClass(vm, "Float32Array", cls_typed_array, types, _float32ArrayNew,
+               _typedDelete, "An array of 32 bit floating point numbers.");
+  Handle* cls_int32_array =
+      NewClass(vm, "Int32Array", cls_typed_array, types, _int32ArrayNew,
+               _typedDelete, "An array of 32 bit signed integers.");
+  Handle* cls_uint8_array =
+      NewClass(vm, "Uint8Array", cls_typed_array, types, _uint8ArrayNew,
+               _typedDelete, "An array of 8 bit unsigned integers.");
+
+  releaseHandle(vm, cls_float64_array);
+  releaseHandle(vm, cls_float32_array);
+  releaseHandle(vm, cls_int32_array);
+  releaseHandle(vm, cls_uint8_array);
+  releaseHandle(vm, cls_typed_array);
+
   registerModule(vm, types);
   releaseHandle(vm, types);
 }
@@ -17,7 +17,10 @@ void registerModuleDummy(VM* vm);
 void registerModuleTerm(VM* vm);
 void registerModuleRegex(VM* vm);
 
+void cleanupModuleIO(VM* vm);
+void cleanupModulePath(VM* vm);
 void cleanupModuleTerm(VM* vm);
+void cleanupModuleRegex(VM* vm);
 
 // Registers the modules.
 void registerLibs(VM* vm) {
@@ -35,5 +38,20 @@ void registerLibs(VM* vm) {
 
 // Cleanup the modules.
 void cleanupLibs(VM* vm) {
+  cleanupModuleIO(vm);
+  cleanupModulePath(vm);
   cleanupModuleTerm(vm);
-}
\ No newline at end of file
+  cleanupModuleRegex(vm);
+}
+
+void* getNativeInstanceOf(Var value, DeleteInstanceFn delete_fn) {
+  if (!IS_OBJ_TYPE(value, OBJ_INST))
+    return NULL;
+
+  Instance* inst = (Instance*) AS_OBJ(value);
+  for (Class* cls = inst->cls; cls != NULL; cls = cls->super_class) {
+    if (cls->new_fn != NULL)
+      return (cls->delete_fn == delete_fn) ? inst->native : NULL;
+  }
+  return NULL;
+}
@@ -58,3 +58,20 @@ char* pathResolveImport(VM* vm, const char* from, const char* path);
 // Write the executable's path to the buffer and return true, if it failed
 // it'll return false.
 bool osGetExeFilePath(char* buff, int size);
+
+// Returns the native instance of [value] if it's an instance of the native
+// class deleted with [delete_fn] (or of a subclass of it), otherwise NULL.
+void* getNativeInstanceOf(Var value, DeleteInstanceFn delete_fn);
+
+// Returns the buffer of [value] if it's a types.ByteBuffer, otherwise NULL.
+ByteBuffer* typesGetByteBuffer(Var value);
+
+// If the [value] is an io.File returns true and set [fp] to its C file, or to
+// NULL with a runtime error set if it's closed or can't be read (written if
+// [write] is true). Returns false if it's not a file.
+bool ioGetFile(VM* vm, Var value, bool write, FILE** fp);
+
+// If the [value] is an io.Mapped file (see io.mmap()) returns true and set
+// [data] and [length] to its bytes, which aren't null terminated. Returns
+// false if it's not a mapped file.
+bool ioGetMapped(Var value, const char** data, uint64_t* length);
@@ -6,6 +6,7 @@
 #include "saynaa_core.h"
 
 #include "../utils/saynaa_debug.h"
+#include "../utils/saynaa_simd.h"
 #include "../utils/saynaa_utils.h"
 #include "saynaa_vm.h"
 
@@ -118,11 +119,22 @@ static inline bool validateCond(VM* vm, bool condition, const char* err) {
 VALIDATE_ARG_OBJ(String, OBJ_STRING, "string")
 VALIDATE_ARG_OBJ(List, OBJ_LIST, "list")
 VALIDATE_ARG_OBJ(Map, OBJ_MAP, "map")
+VALIDATE_ARG_OBJ(Set, OBJ_SET, "set")
 VALIDATE_ARG_OBJ(Closure, OBJ_CLOSURE, "closure")
 VALIDATE_ARG_OBJ(Fiber, OBJ_FIBER, "fiber")
 VALIDATE_ARG_OBJ(Class, OBJ_CLASS, "class")
 VALIDATE_ARG_OBJ(Module, OBJ_MODULE, "module")
 
+// Check if [key] can be a map key or a set element. If not set error and
+// return false.
+static bool _validateHashable(VM* vm, Var key) {
+  if (IS_OBJ(key) && !isObjectHashable(AS_OBJ(key)->type)) {
+    VM_SET_ERROR(vm, stringFormat(vm, "$ type is not hashable.", varTypeName(key)));
+    return false;
+  }
+  return true;
+}
+
 /*****************************************************************************/
 /* SHARED FUNCTIONS                                                          */
 /*****************************************************************************/
@@ -290,11 +302,13 @@ Var varSprintf(VM* vm, String* string, List* args) {
     if (index < args->elements.count) {
       if (specifier == 's') {
         str = varToString(vm, args->elements.data[index], false);
+        stringMaterialize(vm, str);
 
       } else {
         if (!isNumeric(args->elements.data[index], &num)) {
           if (IS_OBJ_TYPE(args->elements.data[index], OBJ_STRING)) {
             str = (String*) AS_OBJ(args->elements.data[index]);
+            stringMaterialize(vm, str);
             utilToNumber(str->data, &num);
           }
         }
@@ -414,6 +428,468 @@ static void _listJoinImpl(VM* vm, List* list, String* sep) {
   RET(VAR_OBJ(str));
 }
 
+// Collect the values of an iterable [seq] into a new list. Returns NULL and
+// set an error if it's not iterable.
+static List* _listFromIterable(VM* vm, Var seq) {
+  if (IS_OBJ_TYPE(seq, OBJ_LIST)) {
+    List* src = (List*) AS_OBJ(seq);
+    List* list = newList(vm, src->elements.count);
+    list->kind = src->kind;
+    if (src->elements.count > 0) {
+      memcpy(list->elements.data, src->elements.data, sizeof(Var) * src->elements.count);
+      list->elements.count = src->elements.count;
+    }
+    return list;
+  }
+
+  if (!IS_OBJ(seq)) {
+    VM_SET_ERROR(vm, stringFormat(vm, "$ is not iterable.", varTypeName(seq)));
+    return NULL;
+  }
+
+  List* list = newList(vm, 0);
+  vmPushTempRef(vm, &list->_super); // list.
+
+  Var iterator = VAR_NULL, value = VAR_NULL;
+  while (true) {
+    // The iterator of an instance is an object returned by a script method,
+    // keep it alive while the next one is computed.
+    bool rooted = IS_OBJ(iterator);
+    if (rooted)
+      vmPushTempRef(vm, AS_OBJ(iterator)); // iterator.
+    bool more = varIterate(vm, seq, &iterator, &value);
+    if (rooted)
+      vmPopTempRef(vm); // iterator.
+
+    if (!more || VM_HAS_ERROR(vm))
+      break;
+
+    rooted = IS_OBJ(iterator);
+    if (rooted)
+      vmPushTempRef(vm, AS_OBJ(iterator)); // iterator.
+    if (IS_OBJ(value))
+      vmPushTempRef(vm, AS_OBJ(value)); // value.
+    listAppend(vm, list, value);
+    if (IS_OBJ(value))
+      vmPopTempRef(vm); // value.
+    if (rooted)
+      vmPopTempRef(vm); // iterator.
+  }
+
+  vmPopTempRef(vm); // list.
+  if (VM_HAS_ERROR(vm))
+    return NULL;
+  return list;
+}
+
+// The sort is a stable merge sort: runs of SORT_RUN elements are sorted with
+// binary insertion sort and merged bottom up. Already ordered neighbour runs
+// aren't merged, so sorting a sorted list is linear. It's defined as a macro
+// and specialized for lists of numbers and strings which don't need to go
+// through varLesser().
+#define SORT_RUN 32
+
+// An element of the list and its key returned by the key function.
+typedef struct {
+  Var key;
+  Var value;
+} SortEntry;
+
+// The type of the values a list is sorted by.
+typedef enum {
+  SORT_NUMBERS,
+  SORT_STRINGS,
+  SORT_GENERIC,
+} SortKind;
+
+static SortKind _sortKind(const Var* values, uint32_t count) {
+  bool numbers = true, strings = true;
+  for (uint32_t i = 0; i < count && (numbers || strings); i++) {
+    numbers = numbers && IS_NUM(values[i]);
+    strings = strings && IS_OBJ_TYPE(values[i], OBJ_STRING);
+  }
+  if (numbers)
+    return SORT_NUMBERS;
+  if (strings)
+    return SORT_STRINGS;
+  return SORT_GENERIC;
+}
+
+static inline bool _sortLessString(Var v1, Var v2) {
+  String *s1 = (String*) AS_OBJ(v1), *s2 = (String*) AS_OBJ(v2);
+  uint32_t min = (s1->length < s2->length) ? s1->length : s2->length;
+  int result = memcmp(s1->data, s2->data, min);
+  if (result == 0)
+    return s1->length < s2->length;
+  return result < 0;
+}
+
+// Once the comparison sets an error every element is considered as equal, so
+// the sort finishes quickly without calling the script again.
+static bool _sortLessGeneric(VM* vm, Var v1, Var v2) {
+  if (VM_HAS_ERROR(vm))
+    return false;
+  Var lesser = varLesser(vm, v1, v2);
+  if (VM_HAS_ERROR(vm))
+    return false;
+  return toBool(lesser);
+}
+
+#define SORT_LESS_NUMBER(a, b) (AS_NUM(a) < AS_NUM(b))
+#define SORT_LESS_STRING(a, b) _sortLessString(a, b)
+#define SORT_LESS_GENERIC(a, b) _sortLessGeneric(vm, a, b)
+
+#define SORT_KEY_VALUE(e) (e)
+#define SORT_KEY_ENTRY(e) ((e).key)
+
+// Define a sort function [name] for an array of [type]. [key] returns the
+// value of an element to compare and [less] compares two of them.
+#define DEFINE_SORT(name, type, key, less) \
+  static void name(VM* vm, type* data, type* tmp, uint32_t count, bool reverse) { \
+    (void) vm; \
+    _DEFINE_SORT_BODY(type, key, less) \
+  }
+
+// Comparing in the reverse order instead of reversing the result keeps the
+// sort stable.
+#define _SORT_LT(key, less, a, b) \
+  (reverse ? less(key(b), key(a)) : less(key(a), key(b)))
+
+#define _DEFINE_SORT_BODY(type, key, less) \
+  for (uint32_t lo = 0; lo < count; lo += SORT_RUN) { \
+    uint32_t hi = (count - lo < SORT_RUN) ? count : lo + SORT_RUN; \
+    for (uint32_t i = lo + 1; i < hi; i++) { \
+      type elem = data[i]; \
+      uint32_t l = lo, r = i; \
+      while (l < r) { \
+        uint32_t m = l + (r - l) / 2; \
+        if (_SORT_LT(key, less, elem, data[m])) \
+          r = m; \
+        else \
+          l = m + 1; \
+      } \
+      memmove(data + l + 1, data + l, sizeof(type) * (i - l)); \
+      data[l] = elem; \
+    } \
+  } \
+  for (uint32_t width = SORT_RUN; width < count; width *= 2) { \
+    for (uint32_t lo = 0; lo + width < count; lo += 2 * width) { \
+      uint32_t mid = lo + width; \
+      uint32_t hi = (count - mid < width) ? count : mid + width; \
+      if (!_SORT_LT(key, less, data[mid], data[mid - 1])) \
+        continue; \
+      memcpy(tmp, data + lo, sizeof(type) * width); \
+      uint32_t i = 0, j = mid, k = lo; \
+      while (i < width && j < hi) { \
+        if (_SORT_LT(key, less, data[j], tmp[i])) \
+          data[k++] = data[j++]; \
+        else \
+          data[k++] = tmp[i++]; \
+      } \
+      memcpy(data + k, tmp + i, sizeof(type) * (width - i)); \
+    } \
+  }
+
+DEFINE_SORT(_sortNumbers, Var, SORT_KEY_VALUE, SORT_LESS_NUMBER)
+DEFINE_SORT(_sortStrings, Var, SORT_KEY_VALUE, SORT_LESS_STRING)
+DEFINE_SORT(_sortEntriesNumbers, SortEntry, SORT_KEY_ENTRY, SORT_LESS_NUMBER)
+DEFINE_SORT(_sortEntriesStrings, SortEntry, SORT_KEY_ENTRY, SORT_LESS_STRING)
+DEFINE_SORT(_sortEntriesGeneric, SortEntry, SORT_KEY_ENTRY, SORT_LESS_GENERIC)
+
+#undef DEFINE_SORT
+#undef _DEFINE_SORT_BODY
+#undef _SORT_LT
+#undef SORT_LESS_NUMBER
+#undef SORT_LESS_STRING
+#undef SORT_LESS_GENERIC
+#undef SORT_KEY_VALUE
+#undef SORT_KEY_ENTRY
+
+// Sort the [list] in place, the [key] function (if not NULL) is called once
+// for each element. Returns false if an error is set.
+static bool _listSortImpl(VM* vm, List* list, Closure* key, bool reverse) {
+  uint32_t count = list->elements.count;
+  if (count < 2)
+    return true;
+
+  // Numbers and strings are compared without running any script, so they
+  // are sorted in place.
+  if (key == NULL) {
+    SortKind kind = (list->kind == LIST_NUMBERS) ? SORT_NUMBERS
+                                                 : _sortKind(list->elements.data, count);
+    if (kind != SORT_GENERIC) {
+      Var* tmp = ALLOCATE_ARRAY(vm, Var, count);
+      if (kind == SORT_NUMBERS)
+        _sortNumbers(vm, list->elements.data, tmp, count, reverse);
+      else
+        _sortStrings(vm, list->elements.data, tmp, count, reverse);
+      DEALLOCATE_ARRAY(vm, tmp, Var, count);
+      return true;
+    }
+  }
+
+  // The key function and the comparison operators could modify the list or
+  // trigger a garbage collection, so the entries are sorted in a separate
+  // buffer, and kept alive by the values and keys lists.
+  List* values = _listFromIterable(vm, VAR_OBJ(list));
+  vmPushTempRef(vm, &values->_super); // values.
+
+  List* keys = values;
+  if (key != NULL) {
+    keys = newList(vm, count);
+    vmPushTempRef(vm, &keys->_super); // keys.
+    Fiber* fiber = vmNewCallFiber(vm, key);
+    vmPushTempRef(vm, &fiber->_super); // fiber.
+    for (uint32_t i = 0; i < count; i++) {
+      Var elem = values->elements.data[i], elem_key = VAR_NULL;
+      if (vmCallFiber(vm, fiber, 1, &elem, &elem_key) != RESULT_SUCCESS) {
+        vmPopTempRef(vm); // fiber.
+        vmPopTempRef(vm); // keys.
+        vmPopTempRef(vm); // values.
+        return false;
+      }
+      // The capacity is already reserved so it won't allocate.
+      listAppend(vm, keys, elem_key);
+    }
+    vmPopTempRef(vm); // fiber.
+  }
+
+  SortEntry* entries = ALLOCATE_ARRAY(vm, SortEntry, count);
+  SortEntry* tmp = ALLOCATE_ARRAY(vm, SortEntry, count);
+  for (uint32_t i = 0; i < count; i++) {
+    entries[i].key = keys->elements.data[i];
+    entries[i].value = values->elements.data[i];
+  }
+
+  switch (_sortKind(keys->elements.data, count)) {
+    case SORT_NUMBERS:
+      _sortEntriesNumbers(vm, entries, tmp, count, reverse);
+      break;
+    case SORT_STRINGS:
+      _sortEntriesStrings(vm, entries, tmp, count, reverse);
+      break;
+    case SORT_GENERIC:
+      _sortEntriesGeneric(vm, entries, tmp, count, reverse);
+      break;
+  }
+
+  bool modified = list->elements.count != count;
+  bool success = !VM_HAS_ERROR(vm) && !modified;
+  if (success) {
+    for (uint32_t i = 0; i < count; i++) {
+      list->elements.data[i] = entries[i].value;
+    }
+  }
+
+  DEALLOCATE_ARRAY(vm, entries, SortEntry, count);
+  DEALLOCATE_ARRAY(vm, tmp, SortEntry, count);
+  if (key != NULL)
+    vmPopTempRef(vm); // keys.
+  vmPopTempRef(vm); // values.
+
+  if (!VM_HAS_ERROR(vm) && modified) {
+    VM_SET_ERROR(vm, newString(vm, "List modified during sort."));
+  }
+  return success;
+}
+
+// Validate the optional key function and the reverse flag of sort() and
+// sorted() starting at the argument [arg].
+static bool _validateSortArgs(VM* vm, int arg, Closure** key, bool* reverse) {
+  *key = NULL;
+  *reverse = false;
+
+  if (ARGC >= arg && !IS_NULL(ARG(arg))) {
+    if (!validateArgClosure(vm, arg, key))
+      return false;
+  }
+  if (ARGC >= arg + 1)
+    *reverse = toBool(ARG(arg + 1));
+  return true;
+}
+
+// Returns true if the item with the key [k1] should be popped before the one
+// with [k2] from the [heap]. Numbers and strings are compared without
+// running any script.
+static inline bool _heapBefore(VM* vm, const Heap* heap, Var k1, Var k2) {
+  if (heap->reverse) {
+    Var tmp = k1;
+    k1 = k2;
+    k2 = tmp;
+  }
+  if (IS_NUM(k1) && IS_NUM(k2))
+    return AS_NUM(k1) < AS_NUM(k2);
+  if (IS_OBJ_TYPE(k1, OBJ_STRING) && IS_OBJ_TYPE(k2, OBJ_STRING))
+    return _sortLessString(k1, k2);
+  return _sortLessGeneric(vm, k1, k2);
+}
+
+// The comparison operators of instances could run a script which modifies
+// the heap, the items are accessed with indexes so it won't crash but the
+// heap order can't be maintained. Returns false and set an error if the
+// comparison failed or the heap of [count] items is modified.
+static bool _heapCheck(VM* vm, const Heap* heap, uint32_t count) {
+  if (VM_HAS_ERROR(vm))
+    return false;
+  if (heap->items.count != count) {
+    VM_SET_ERROR(vm, newString(vm, "Heap modified during comparison."));
+    return false;
+  }
+  return true;
+}
+
+static inline void _heapSwap(Heap* heap, uint32_t i, uint32_t j) {
+  Var tmp = heap->items.data[i];
+  heap->items.data[i] = heap->items.data[j];
+  heap->items.data[j] = tmp;
+  if (heap->key != NULL) {
+    tmp = heap->keys.data[i];
+    heap->keys.data[i] = heap->keys.data[j];
+    heap->keys.data[j] = tmp;
+  }
+}
+
+// Move the item at the [index] up till its parent is before it.
+static bool _heapSiftUp(VM* vm, Heap* heap, uint32_t index) {
+  uint32_t count = heap->items.count;
+  while (index > 0) {
+    uint32_t parent = (index - 1) / 2;
+    bool before = _heapBefore(vm, heap, HEAP_KEY(heap, index), HEAP_KEY(heap, parent));
+    if (!_heapCheck(vm, heap, count))
+      return false;
+    if (!before)
+      break;
+    _heapSwap(heap, index, parent);
+    index = parent;
+  }
+  return true;
+}
+
+// Move the item at the [index] down till it's before its children.
+static bool _heapSiftDown(VM* vm, Heap* heap, uint32_t index) {
+  uint32_t count = heap->items.count;
+  while (true) {
+    uint32_t first = index;
+    for (uint32_t child = 2 * index + 1; child <= 2 * index + 2 && child < count; child++) {
+      bool before = _heapBefore(vm, heap, HEAP_KEY(heap, child), HEAP_KEY(heap, first));
+      if (!_heapCheck(vm, heap, count))
+        return false;
+      if (before)
+        first = child;
+    }
+    if (first == index)
+      return true;
+    _heapSwap(heap, index, first);
+    index = first;
+  }
+}
+
+// Call the key function of the [heap] for the [item] and set the [key].
+// Returns false if the call failed.
+static bool _heapItemKey(VM* vm, Heap* heap, Var item, Var* key) {
+  if (heap->key == NULL) {
+    *key = item;
+    return true;
+  }
+  return vmCallFunction(vm, heap->key, 1, &item, key) == RESULT_SUCCESS;
+}
+
+// Push the [item] to the [heap]. Returns false if an error is set.
+static bool _heapPush(VM* vm, Heap* heap, Var item) {
+  // The key function runs before anything is written to the buffers, so
+  // the items and keys stay in sync even if it pushes to the same heap.
+  Var key;
+  if (!_heapItemKey(vm, heap, item, &key))
+    return false;
+
+  if (IS_OBJ(item))
+    vmPushTempRef(vm, AS_OBJ(item)); // item.
+  if (IS_OBJ(key))
+    vmPushTempRef(vm, AS_OBJ(key)); // key.
+  if (heap->key != NULL)
+    VarBufferWrite(&heap->keys, vm, key);
+  VarBufferWrite(&heap->items, vm, item);
+  if (IS_OBJ(key))
+    vmPopTempRef(vm); // key.
+  if (IS_OBJ(item))
+    vmPopTempRef(vm); // item.
+
+  return _heapSiftUp(vm, heap, heap->items.count - 1);
+}
+
+// Remove the first item of the (non empty) [heap] and set it to [item].
+// Returns false if an error is set.
+static bool _heapPop(VM* vm, Heap* heap, Var* item) {
+  uint32_t last = heap->items.count - 1;
+  *item = heap->items.data[0];
+  heap->items.data[0] = heap->items.data[last];
+  heap->items.count--;
+  if (heap->key != NULL) {
+    heap->keys.data[0] = heap->keys.data[last];
+    heap->keys.count--;
+  }
+
+  if (heap->items.count < 2)
+    return true;
+
+  if (IS_OBJ(*item))
+    vmPushTempRef(vm, AS_OBJ(*item)); // item.
+  bool success = _heapSiftDown(vm, heap, 0);
+  if (IS_OBJ(*item))
+    vmPopTempRef(vm); // item.
+  return success;
+}
+
+// Fill the empty [heap] with the values of the iterable [seq] in O(n) by
+// sifting down the first half of the items in the reverse order (Floyd's
+// method) instead of pushing them one by one. The [heap] should be kept
+// alive by the caller.
+static bool _heapFill(VM* vm, Heap* heap, Var seq) {
+  ASSERT(heap->items.count == 0, OOPS);
+
+  List* items = _listFromIterable(vm, seq);
+  if (items == NULL)
+    return false;
+  vmPushTempRef(vm, &items->_super); // items.
+
+  // The error of a failed key function call is reported by the call and not
+  // set to this fiber, so the result of the call is checked.
+  uint32_t count = items->elements.count;
+  bool success = true;
+  if (heap->key != NULL && count > 0) {
+    VarBufferReserve(&heap->keys, vm, count);
+    Fiber* fiber = vmNewCallFiber(vm, heap->key);
+    vmPushTempRef(vm, &fiber->_super); // fiber.
+    for (uint32_t i = 0; i < count; i++) {
+      Var key = VAR_NULL;
+      if (vmCallFiber(vm, fiber, 1, &items->elements.data[i], &key) != RESULT_SUCCESS) {
+        success = false;
+        break;
+      }
+      heap->keys.data[heap->keys.count++] = key;
+    }
+    vmPopTempRef(vm); // fiber.
+  }
+
+  if (!success || VM_HAS_ERROR(vm)) {
+    VarBufferClear(&heap->keys, vm);
+    vmPopTempRef(vm); // items.
+    return false;
+  }
+
+  // The heap takes the buffer of the items list.
+  VarBufferClear(&heap->items, vm);
+  heap->items = items->elements;
+  VarBufferInit(&items->elements);
+  vmPopTempRef(vm); // items.
+
+  for (uint32_t i = count / 2; i > 0; i--) {
+    if (!_heapSiftDown(vm, heap, i - 1))
+      return false;
+  }
+  return true;
+}
+
 /*****************************************************************************/
 /* CORE BUILTIN FUNCTIONS                                                    */
 /*****************************************************************************/
@@ -491,6 +967,9 @@ saynaa_function(coreDir, "dir(v:Var) -> List[String]",
     case vSTRING:
     case vLIST:
     case vMAP:
+    case vSET:
+    case vDEQUE:
+    case vHEAP:
     case vRANGE:
     case vCLOSURE:
     case vFIBER:
@@ -705,7 +1184,43 @@ saynaa_function(coreOrd, "ord(value:String) -> Number",
   }
 }
 
-saynaa_function(coreMin, "min(a:Var, b:Var) -> Bool", "Returns minimum of [a] and [b].") {
+// Returns the minimum (or the maximum if [max] is true) element of the non
+// empty [list]. Sets an error if the elements can't be compared.
+static Var _listMinMax(VM* vm, List* list, bool max) {
+  ASSERT(list->elements.count > 0, OOPS);
+
+#if VAR_NAN_TAGGING
+  if (list->kind == LIST_NUMBERS)
+    return VAR_NUM(simdMinMaxDoubles(LIST_DOUBLES(list), list->elements.count, max));
+#endif
+
+  Var result = list->elements.data[0];
+  for (uint32_t i = 1; i < list->elements.count; i++) {
+    Var elem = list->elements.data[i];
+    Var replace = max ? varLesser(vm, result, elem) : varLesser(vm, elem, result);
+    if (VM_HAS_ERROR(vm))
+      return VAR_NULL;
+    if (toBool(replace))
+      result = elem;
+  }
+  return result;
+}
+
+saynaa_function(coreMin, "min(a:Var [, b:Var]) -> Var",
+                "Returns minimum of [a] and [b]. If only [a] is given it should be a list "
+                "and its minimum element is returned.") {
+  if (!CheckArgcRange(vm, ARGC, 1, 2))
+    return;
+
+  if (ARGC == 1) {
+    List* list;
+    if (!validateArgList(vm, 1, &list))
+      return;
+    if (list->elements.count == 0)
+      RET_ERR(newString(vm, "min() of an empty list."));
+    RET(_listMinMax(vm, list, false));
+  }
+
   Var a = ARG(1), b = ARG(2);
   Var islesser = varLesser(vm, a, b);
   if (VM_HAS_ERROR(vm))
@@ -716,7 +1231,21 @@ saynaa_function(coreMin, "min(a:Var, b:Var) -> Bool", "Returns minimum of [a] an
   RET(b);
 }
 
-saynaa_function(coreMax, "max(a:var, b:var) -> Bool", "Returns maximum of [a] and [b].") {
+saynaa_function(coreMax, "max(a:Var [, b:Var]) -> Var",
+                "Returns maximum of [a] and [b]. If only [a] is given it should be a list "
+                "and its maximum element is returned.") {
+  if (!CheckArgcRange(vm, ARGC, 1, 2))
+    return;
+
+  if (ARGC == 1) {
+    List* list;
+    if (!validateArgList(vm, 1, &list))
+      return;
+    if (list->elements.count == 0)
+      RET_ERR(newString(vm, "max() of an empty list."));
+    RET(_listMinMax(vm, list, true));
+  }
+
   Var a = ARG(1), b = ARG(2);
   Var islesser = varLesser(vm, a, b);
   if (VM_HAS_ERROR(vm))
@@ -727,6 +1256,44 @@ saynaa_function(coreMax, "max(a:var, b:var) -> Bool", "Returns maximum of [a] an
   RET(a);
 }
 
+saynaa_function(coreSum, "sum(list:List [, start:Var=0]) -> Var",
+                "Returns the sum of [start] and the elements of the [list].") {
+  if (!CheckArgcRange(vm, ARGC, 1, 2))
+    return;
+
+  List* list;
+  if (!validateArgList(vm, 1, &list))
+    return;
+  Var sum = (ARGC == 2) ? ARG(2) : VAR_NUM(0);
+
+#if VAR_NAN_TAGGING
+  if (list->kind == LIST_NUMBERS && IS_NUM(sum)) {
+    double total = simdSumDoubles(LIST_DOUBLES(list), list->elements.count);
+    RET(VAR_NUM(AS_NUM(sum) + total));
+  }
+#endif
+
+  for (uint32_t i = 0; i < list->elements.count; i++) {
+    Var elem = list->elements.data[i];
+    if (IS_NUM(sum) && IS_NUM(elem)) {
+      sum = VAR_NUM(AS_NUM(sum) + AS_NUM(elem));
+      continue;
+    }
+
+    // The sum so far isn't reachable from anywhere else.
+    if (IS_OBJ(sum))
+      vmPushTempRef(vm, AS_OBJ(sum)); // sum.
+    Var result = varAdd(vm, sum, elem, false);
+    if (IS_OBJ(sum))
+      vmPopTempRef(vm); // sum.
+    if (VM_HAS_ERROR(vm))
+      return;
+    sum = result;
+  }
+
+  RET(sum);
+}
+
 saynaa_function(
     corePrint, "print(...) -> Null",
     "Write each argument as space seperated, to the stdout and ends with a "
@@ -742,6 +1309,7 @@ saynaa_function(
     String* str = varToString(vm, ARG(i), false);
     if (str == NULL)
       RET(VAR_NULL);
+    stringMaterialize(vm, str);
     vm->config.stdout_write(vm, str->data);
   }
 
@@ -765,6 +1333,7 @@ saynaa_function(
     String* str = varToString(vm, ARG(1), false);
     if (str == NULL)
       RET(VAR_NULL);
+    stringMaterialize(vm, str);
     vm->config.stdout_write(vm, str->data);
   }
 
@@ -804,6 +1373,7 @@ saynaa_function(coreCompile, "compile(code:String) -> Closure",
   String* code;
   if (!validateArgString(vm, 1, &code))
     return;
+  stringMaterialize(vm, code);
   vmPushTempRef(vm, &code->_super); // code.
 
   Module* module = newModule(vm);
@@ -846,6 +1416,9 @@ saynaa_function(coreEval, "eval(expression:String) -> Var",
     vmPushTempRef(vm, &new_module->_super); // new_module.
     {
       // let global variables become available
+      for (uint32_t i = 0; i < current_module->globals.count; i++) {
+        VAR_FREEZE(current_module->globals.data[i]);
+      }
       VarBufferConcat(&new_module->constants, vm, &current_module->constants);
       VarBufferConcat(&new_module->globals, vm, &current_module->globals);
       UintBufferConcat(&new_module->global_names, vm, &current_module->global_names);
@@ -918,6 +1491,30 @@ saynaa_function(
   _listJoinImpl(vm, list, sep);
 }
 
+saynaa_function(coreSorted, "sorted(seq:Var [, key:Closure, reverse:Bool=false]) -> List",
+                "Returns a new sorted list of the values of the iterable [seq]. "
+                "If the [key] function is given the values are ordered by the "
+                "value it returns for each of them. The sort is stable.") {
+  if (!CheckArgcRange(vm, ARGC, 1, 3))
+    return;
+
+  Closure* key;
+  bool reverse;
+  if (!_validateSortArgs(vm, 2, &key, &reverse))
+    return;
+
+  List* list = _listFromIterable(vm, ARG(1));
+  if (list == NULL)
+    return;
+
+  vmPushTempRef(vm, &list->_super); // list.
+  bool success = _listSortImpl(vm, list, key, reverse);
+  vmPopTempRef(vm); // list.
+
+  if (success)
+    RET(VAR_OBJ(list));
+}
+
 static void initializeBuiltinFN(VM* vm, Closure** bfn, const char* name, int length,
                                 int arity, nativeFn ptr, const char* docstring) {
   Function* fn = newFunction(vm, name, length, NULL, true, docstring, NULL);
@@ -944,8 +1541,9 @@ static void initializeBuiltinFunctions(VM* vm) {
   INITIALIZE_BUILTIN_FN("int", coreToInt, 1);
   INITIALIZE_BUILTIN_FN("chr", coreChr, 1);
   INITIALIZE_BUILTIN_FN("ord", coreOrd, 1);
-  INITIALIZE_BUILTIN_FN("min", coreMin, 2);
-  INITIALIZE_BUILTIN_FN("max", coreMax, 2);
+  INITIALIZE_BUILTIN_FN("min", coreMin, -1);
+  INITIALIZE_BUILTIN_FN("max", coreMax, -1);
+  INITIALIZE_BUILTIN_FN("sum", coreSum, -1);
   INITIALIZE_BUILTIN_FN("print", corePrint, -1);
   INITIALIZE_BUILTIN_FN("input", coreInput, -1);
   INITIALIZE_BUILTIN_FN("exit", coreExit, -1);
@@ -956,6 +1554,7 @@ static void initializeBuiltinFunctions(VM* vm) {
   // List functions.
   INITIALIZE_BUILTIN_FN("list_append", coreListAppend, 2);
   INITIALIZE_BUILTIN_FN("list_join", coreListJoin, -1);
+  INITIALIZE_BUILTIN_FN("sorted", coreSorted, -1);
 
 #undef INITIALIZE_BUILTIN_FN
 }
@@ -1008,6 +1607,89 @@ saynaa_function(stdLangGC, "lang.gc() -> Number",
   RET(VAR_NUM((double) garbage));
 }
 
+saynaa_function(stdLangGCStats, "lang.gcstats() -> Map",
+                "Returns the garbage collector statistics, the number of "
+                "collections, their total, max and last pause in "
+                "milliseconds, the bytes marked and swept by the last "
+                "collection, the live objects of each type and the history "
+                "of the last collections as [time, pause, heap_before, "
+                "heap_after] lists.") {
+  RET(VAR_OBJ(gcstatsToMap(vm)));
+}
+
+// Get the non negative integer [name] from the [config] map if it exists.
+static bool _gcConfigValue(VM* vm, Map* config, const char* name, int64_t* value,
+                           bool* found) {
+  String* key = newString(vm, name);
+  vmPushTempRef(vm, &key->_super); // key.
+  Var entry = mapGet(config, VAR_OBJ(key));
+  vmPopTempRef(vm); // key.
+
+  *found = !IS_UNDEF(entry);
+  if (!*found)
+    return true;
+  if (!validateInteger(vm, entry, value, name))
+    return false;
+  return validateCond(vm, *value >= 0, "GC config values cannot be negative.");
+}
+
+saynaa_function(stdLangGCConfig, "lang.gc_config([config:Map]) -> Map",
+                "Returns the garbage collector configuration { heap_fill_percent, "
+                "min_heap_size, max_heap_size } and update it with the "
+                "entries of the [config] map if given. A max_heap_size of 0 "
+                "means the heap isn't limited.") {
+  int argc = ARGC;
+  if (argc != 0 && argc != 1) {
+    RET_ERR(newString(vm, "Invalid argument count."));
+  }
+
+  if (argc == 1) {
+    Map* config;
+    if (!validateArgMap(vm, 1, &config))
+      return;
+
+    int64_t fill, min_size, max_size;
+    bool has_fill, has_min, has_max;
+    if (!_gcConfigValue(vm, config, "heap_fill_percent", &fill, &has_fill))
+      return;
+    if (!_gcConfigValue(vm, config, "min_heap_size", &min_size, &has_min))
+      return;
+    if (!_gcConfigValue(vm, config, "max_heap_size", &max_size, &has_max))
+      return;
+
+    if (has_fill) {
+      if (!validateCond(vm, fill > 0, "heap_fill_percent should be greater than 0."))
+        return;
+      vm->heap_fill_percent = (int) fill;
+    }
+    if (has_min)
+      vm->min_heap_size = (size_t) min_size;
+    if (has_max)
+      vm->max_heap_size = (size_t) max_size;
+
+    // Apply the new limits to the next collection.
+    if (vm->next_gc < vm->min_heap_size)
+      vm->next_gc = vm->min_heap_size;
+    if (vm->max_heap_size != 0 && vm->next_gc > vm->max_heap_size)
+      vm->next_gc = vm->max_heap_size;
+  }
+
+  Map* result = newMap(vm);
+  vmPushTempRef(vm, &result->_super); // result.
+  const char* names[] = { "heap_fill_percent", "min_heap_size", "max_heap_size" };
+  double values[] = { (double) vm->heap_fill_percent, (double) vm->min_heap_size,
+                      (double) vm->max_heap_size };
+  for (int i = 0; i < 3; i++) {
+    String* key = newString(vm, names[i]);
+    vmPushTempRef(vm, &key->_super); // key.
+    mapSet(vm, result, VAR_OBJ(key), VAR_NUM(values[i]));
+    vmPopTempRef(vm); // key.
+  }
+  vmPopTempRef(vm); // result.
+
+  RET(VAR_OBJ(result));
+}
+
 saynaa_function(stdLangDisas, "lang.disas(fn:Closure) -> String",
                 "Returns the disassembled opcode of the function [fn].") {
   // TODO: support dissasemble class constructors and module main body.
@@ -1091,6 +1773,116 @@ saynaa_function(stdLangModules, "lang.modules() -> List",
   RET(VAR_OBJ(list));
 }
 
+saynaa_function(stdLangProfileStart, "lang.profile_start([interval:Number]) -> Null",
+                "Start the sampling profiler, a sample of the call stack will be "
+                "recorded once in every [interval] loop iterations and function "
+                "calls.") {
+  int argc = ARGC;
+  if (argc != 0 && argc != 1) {
+    RET_ERR(newString(vm, "Invalid argument count."));
+  }
+
+  int64_t interval = 0;
+  if (argc == 1) {
+    if (!validateInteger(vm, ARG(1), &interval, "Argument 1"))
+      return;
+    if (!validateCond(vm, interval > 0 && interval <= INT_MAX,
+                      "Sample interval should be a positive integer."))
+      return;
+  }
+
+  if (!validateCond(vm, profilerStart(vm, (int) interval),
+                    "The profiler is already running."))
+    return;
+}
+
+saynaa_function(stdLangProfileStop, "lang.profile_stop([path:String]) -> String",
+                "Stop the profiler and write the samples in the collapsed stack "
+                "format (consumed by the flamegraph tools) to the file at "
+                "[path]. If [path] is not given, returns it as a string.") {
+  int argc = ARGC;
+  if (argc != 0 && argc != 1) {
+    RET_ERR(newString(vm, "Invalid argument count."));
+  }
+
+  if (!validateCond(vm, vm->profiler != NULL, "The profiler is not running."))
+    return;
+
+  if (argc == 1) {
+    String* path;
+    if (!validateArgString(vm, 1, &path))
+      return;
+    stringMaterialize(vm, path);
+    if (!profilerStop(vm, path->data)) {
+      RET_ERR(stringFormat(vm, "Cannot write the profile to \"@\".", path));
+    }
+    RET(VAR_NULL);
+  }
+
+  ByteBuffer bb;
+  ByteBufferInit(&bb);
+  profilerDump(vm, &bb);
+  profilerStop(vm, NULL);
+
+  String* collapsed = newStringLength(vm, (char*) bb.data, bb.count);
+  vmPushTempRef(vm, &collapsed->_super); // collapsed.
+  ByteBufferClear(&bb, vm);
+  vmPopTempRef(vm); // collapsed.
+
+  RET(VAR_OBJ(collapsed));
+}
+
+saynaa_function(stdLangMemtrack, "lang.memtrack(enable:Bool) -> Null",
+                "Enable or disable tracking the allocations by their object "
+                "type and call site. Disabling discards the statistics.") {
+  bool enable = toBool(ARG(1));
+  if (enable && vm->memtrack == NULL) {
+    memtrackStart(vm);
+  } else if (!enable && vm->memtrack != NULL) {
+    memtrackStop(vm, NULL);
+  }
+}
+
+saynaa_function(stdLangMemstats, "lang.memstats() -> Map",
+                "Returns the allocation statistics, the total allocated bytes "
+                "and the allocation rate, the allocated and live (after the "
+                "last garbage collection) objects of each type and the "
+                "objects and bytes allocated at each call site. The "
+                "allocation tracking should be enabled with lang.memtrack().") {
+  if (!validateCond(vm, vm->memtrack != NULL, "Allocation tracking is not enabled."))
+    return;
+  RET(VAR_OBJ(memtrackToMap(vm)));
+}
+
+#if OPCODE_STATS
+saynaa_function(stdLangOpstats, "lang.opstats() -> Map",
+                "Returns the opcode execution statistics as a map of "
+                "{ 'opcodes': { name: [count, cycles] }, 'pairs': "
+                "{ 'name name': count }, 'functions': { name: [count, cycles] } }. "
+                "Only available if compiled with OPCODE_STATS.") {
+  RET(VAR_OBJ(opstatsToMap(vm)));
+}
+
+saynaa_function(stdLangOpstatsTable, "lang.opstats_table() -> String",
+                "Returns the opcode execution statistics as sorted tables.") {
+  ByteBuffer bb;
+  ByteBufferInit(&bb);
+  opstatsDump(vm, &bb);
+
+  String* table = newStringLength(vm, (char*) bb.data, bb.count);
+  vmPushTempRef(vm, &table->_super); // table.
+  ByteBufferClear(&bb, vm);
+  vmPopTempRef(vm); // table.
+
+  RET(VAR_OBJ(table));
+}
+
+saynaa_function(stdLangOpstatsReset, "lang.opstats_reset() -> Null",
+                "Reset all the opcode execution counters.") {
+  opstatsReset(vm);
+}
+#endif
+
 #ifdef DEBUG
 saynaa_function(stdLangDebugBreak, "lang.debug_break() -> Null",
                 "A debug function for development (will be removed).") {
@@ -1104,6 +1896,7 @@ saynaa_function(stdModuleLoad, "module.load(name:String) -> Module",
   String* name;
   if (!validateArgString(vm, 1, &name))
     return;
+  stringMaterialize(vm, name);
 
   String* from = NULL;
   if (vm->fiber->frame_count > 0) {
@@ -1130,9 +1923,20 @@ static void initializeCoreModules(VM* vm) {
 
   NEW_MODULE(lang, "lang");
   MODULE_ADD_FN(lang, "gc", stdLangGC, 0);
+  MODULE_ADD_FN(lang, "gcstats", stdLangGCStats, 0);
+  MODULE_ADD_FN(lang, "gc_config", stdLangGCConfig, -1);
   MODULE_ADD_FN(lang, "disas", stdLangDisas, 1);
   MODULE_ADD_FN(lang, "backtrace", stdLangBackTrace, 0);
   MODULE_ADD_FN(lang, "modules", stdLangModules, 0);
+  MODULE_ADD_FN(lang, "profile_start", stdLangProfileStart, -1);
+  MODULE_ADD_FN(lang, "profile_stop", stdLangProfileStop, -1);
+  MODULE_ADD_FN(lang, "memtrack", stdLangMemtrack, 1);
+  MODULE_ADD_FN(lang, "memstats", stdLangMemstats, 0);
+#if OPCODE_STATS
+  MODULE_ADD_FN(lang, "opstats", stdLangOpstats, 0);
+  MODULE_ADD_FN(lang, "opstats_table", stdLangOpstatsTable, 0);
+  MODULE_ADD_FN(lang, "opstats_reset", stdLangOpstatsReset, 0);
+#endif
 #ifdef DEBUG
   MODULE_ADD_FN(lang, "debug_break", stdLangDebugBreak, 0);
 #endif
@@ -1171,6 +1975,7 @@ static void _ctorNumber(VM* vm) {
 
   if (IS_OBJ_TYPE(ARG(1), OBJ_STRING)) {
     String* str = (String*) AS_OBJ(ARG(1));
+    stringMaterialize(vm, str);
     const char* err = utilToNumber(str->data, &value);
     if (err == NULL)
       RET(VAR_NUM(value));
@@ -1222,6 +2027,96 @@ static void _ctorMap(VM* vm) {
   RET(VAR_OBJ(newMap(vm)));
 }
 
+static void _ctorSet(VM* vm) {
+  if (!CheckArgcRange(vm, ARGC, 0, 1))
+    return;
+  if (ARGC == 0) {
+    RET(VAR_OBJ(newSet(vm, 0)));
+  }
+
+  Var from = ARG(1);
+  if (!IS_OBJ(from) || IS_OBJ_TYPE(from, OBJ_INST)) {
+    RET_ERR(stringFormat(vm, "Cannot create a set from $.", varTypeName(from)));
+  }
+
+  // Lists are the common case (ex: Set(list) to remove duplicates), and the
+  // other sequences are added with the iteration protocol.
+  uint32_t size = 0;
+  if (IS_OBJ_TYPE(from, OBJ_LIST))
+    size = ((List*) AS_OBJ(from))->elements.count;
+  else if (IS_OBJ_TYPE(from, OBJ_SET))
+    size = ((Set*) AS_OBJ(from))->count;
+  else if (IS_OBJ_TYPE(from, OBJ_MAP))
+    size = ((Map*) AS_OBJ(from))->count;
+
+  Set* set = newSet(vm, size);
+  vmPushTempRef(vm, &set->_super); // set.
+
+  if (IS_OBJ_TYPE(from, OBJ_LIST)) {
+    List* list = (List*) AS_OBJ(from);
+    for (uint32_t i = 0; i < list->elements.count; i++) {
+      if (!_validateHashable(vm, list->elements.data[i]))
+        break;
+      setAdd(vm, set, list->elements.data[i]);
+    }
+
+  } else {
+    Var iterator = VAR_NULL, value = VAR_NULL;
+    while (varIterate(vm, from, &iterator, &value)) {
+      if (!_validateHashable(vm, value))
+        break;
+      setAdd(vm, set, value);
+    }
+  }
+
+  vmPopTempRef(vm); // set.
+  RET(VAR_OBJ(set));
+}
+
+static void _ctorDeque(VM* vm) {
+  if (!CheckArgcRange(vm, ARGC, 0, 1))
+    return;
+  if (ARGC == 0) {
+    RET(VAR_OBJ(newDeque(vm, 0)));
+  }
+
+  Var from = ARG(1);
+  List* list = IS_OBJ_TYPE(from, OBJ_LIST) ? (List*) AS_OBJ(from)
+                                           : _listFromIterable(vm, from);
+  if (list == NULL)
+    return;
+
+  vmPushTempRef(vm, &list->_super); // list.
+  Deque* deque = newDeque(vm, list->elements.count);
+  // The capacity is already reserved so it won't allocate.
+  for (uint32_t i = 0; i < list->elements.count; i++) {
+    dequePushBack(vm, deque, list->elements.data[i]);
+  }
+  vmPopTempRef(vm); // list.
+  RET(VAR_OBJ(deque));
+}
+
+static void _ctorHeap(VM* vm) {
+  if (!CheckArgcRange(vm, ARGC, 0, 3))
+    return;
+
+  Closure* key;
+  bool reverse;
+  if (!_validateSortArgs(vm, 2, &key, &reverse))
+    return;
+
+  Heap* heap = newHeap(vm, key, reverse);
+  if (ARGC == 0 || IS_NULL(ARG(1))) {
+    RET(VAR_OBJ(heap));
+  }
+
+  vmPushTempRef(vm, &heap->_super); // heap.
+  bool success = _heapFill(vm, heap, ARG(1));
+  vmPopTempRef(vm); // heap.
+  if (success)
+    RET(VAR_OBJ(heap));
+}
+
 static void _ctorRange(VM* vm) {
   double from, to;
   if (!validateNumeric(vm, ARG(1), &from, "Argument 1"))
@@ -1262,6 +2157,7 @@ saynaa_function(_objGetattr, "Object.getattr(name:String[, skipGetter: bool]) ->
   String* name;
   if (!validateArgString(vm, 1, &name))
     return;
+  stringMaterialize(vm, name);
 
   bool skipGetter = (ARGC >= 2 ? toBool(ARG(2)) : false);
   RET(varGetAttrib(vm, THIS, name, skipGetter, false));
@@ -1275,6 +2171,7 @@ saynaa_function(_objSetattr, "Object.setattr(name:String, value:Var[, skipSetter
   String* name;
   if (!validateArgString(vm, 1, &name))
     return;
+  stringMaterialize(vm, name);
 
   bool skipSetter = (ARGC >= 3 ? toBool(ARG(3)) : false);
   varSetAttrib(vm, THIS, name, ARG(2), skipSetter);
@@ -1291,13 +2188,17 @@ saynaa_function(
   if (!validateArgClosure(vm, 1, &closure))
     return;
 
+  Fiber* fiber = vmNewCallFiber(vm, closure);
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+
   for (int64_t i = 0; i < n; i++) {
     Var _i = VAR_NUM((double) i);
-    Result result = vmCallFunction(vm, closure, 1, &_i, NULL);
+    Result result = vmCallFiber(vm, fiber, 1, &_i, NULL);
     if (result != RESULT_SUCCESS)
       break;
   }
 
+  vmPopTempRef(vm); // fiber.
   RET(VAR_NULL);
 }
 
@@ -1344,7 +2245,7 @@ saynaa_function(_stringFind, "String.find(sub:String[, start:Number=0]) -> Numbe
   if (match == NULL)
     RET(VAR_NUM((double) -1));
 
-  ASSERT_INDEX(match - thiz->data, thiz->capacity);
+  ASSERT_INDEX(match - thiz->data, thiz->length);
   RET(VAR_NUM((double) (match - thiz->data)));
 }
 
@@ -1390,14 +2291,7 @@ saynaa_function(_stringRFind, "String.rfind(sub:String[, start:Number=0]) -> Num
     RET(VAR_NUM((double) thiz->length));
   }
 
-  const char* match = NULL;
-  // Naive reverse search
-  for (long i = (long) (haystack_len - needle_len); i >= 0; i--) {
-    if (memcmp(haystack + i, needle, needle_len) == 0) {
-      match = haystack + i;
-      break;
-    }
-  }
+  const char* match = simdMemRMem(haystack, haystack_len, needle, needle_len);
 
   if (match == NULL)
     RET(VAR_NUM((double) -1));
@@ -1536,86 +2430,365 @@ saynaa_function(_listAppend, "List.append(value:Var) -> List",
                 "Append the [value] to the list and return the List.") {
   ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
 
-  listAppend(vm, ((List*) AS_OBJ(THIS)), ARG(1));
-  RET(THIS);
+  listAppend(vm, ((List*) AS_OBJ(THIS)), ARG(1));
+  RET(THIS);
+}
+
+saynaa_function(_listInsert, "List.insert(index:Number, value:Var) -> Null",
+                "Insert the element at the given index. The index should be "
+                "0 <= index <= list.length.") {
+  List* thiz = (List*) AS_OBJ(THIS);
+
+  int64_t index;
+  if (!validateInteger(vm, ARG(1), &index, "Argument 1"))
+    return;
+
+  if (index < 0 || index > thiz->elements.count) {
+    RET_ERR(newString(vm, "List.insert index out of bounds."));
+  }
+
+  listInsert(vm, thiz, (uint32_t) index, ARG(2));
+}
+
+saynaa_function(_listPop, "List.pop(index:Number=-1) -> Var",
+                "Removes the last element of the list and return it.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* thiz = (List*) AS_OBJ(THIS);
+
+  if (!CheckArgcRange(vm, ARGC, 0, 1))
+    return;
+
+  if (thiz->elements.count == 0) {
+    RET_ERR(newString(vm, "Cannot pop from an empty list."));
+  }
+
+  int64_t index = -1;
+  if (ARGC == 1) {
+    if (!validateInteger(vm, ARG(1), &index, "Argument 1"))
+      return;
+  }
+  if (index < 0)
+    index = thiz->elements.count + index;
+
+  if (index < 0 || index >= thiz->elements.count) {
+    RET_ERR(newString(vm, "List.pop index out of bounds."));
+  }
+  RET(listRemoveAt(vm, thiz, (uint32_t) index));
+}
+
+saynaa_function(_listFind, "List.find(value:Var) -> Number",
+                "Find the value and return its index. If the vlaue not exists "
+                "it'll return -1.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* thiz = (List*) AS_OBJ(THIS);
+
+  Var* it = thiz->elements.data;
+  if (it == NULL)
+    RET(VAR_NUM(-1)); // Empty list.
+
+  for (; it < thiz->elements.data + thiz->elements.count; it++) {
+    if (isValuesEqual(*it, ARG(1))) {
+      RET(VAR_NUM((double) (it - thiz->elements.data)));
+    }
+  }
+
+  RET(VAR_NUM(-1));
+}
+
+saynaa_function(
+    _listJoin,
+    "List.join([sep:String="
+    "]) -> String",
+    "Concatinate the elements of the list and return as a string.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* list = (List*) AS_OBJ(THIS);
+  String* sep = NULL;
+
+  if (!CheckArgcRange(vm, ARGC, 0, 1))
+    return;
+  if (ARGC == 1)
+    sep = varToString(vm, ARG(1), false);
+
+  _listJoinImpl(vm, list, sep);
+}
+
+saynaa_function(_listSort, "List.sort([key:Closure, reverse:Bool=false]) -> List",
+                "Sort the list in place and return it. If the [key] function is "
+                "given the elements are ordered by the value it returns for each "
+                "of them. The sort is stable.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* thiz = (List*) AS_OBJ(THIS);
+
+  if (!CheckArgcRange(vm, ARGC, 0, 2))
+    return;
+
+  Closure* key;
+  bool reverse;
+  if (!_validateSortArgs(vm, 1, &key, &reverse))
+    return;
+
+  if (_listSortImpl(vm, thiz, key, reverse))
+    RET(VAR_OBJ(thiz));
+}
+
+saynaa_function(_listBisect, "List.bisect(value:Var) -> Number",
+                "Returns the index where the [value] should be inserted to keep "
+                "the list (sorted in ascending order) sorted, before any equal "
+                "elements.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* thiz = (List*) AS_OBJ(THIS);
+  Var value = ARG(1);
+
+  uint32_t lo = 0, hi = thiz->elements.count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    Var lesser = varLesser(vm, thiz->elements.data[mid], value);
+    if (VM_HAS_ERROR(vm))
+      return;
+
+    if (toBool(lesser))
+      lo = mid + 1;
+    else
+      hi = mid;
+
+    // The comparison could have modified the list.
+    if (hi > thiz->elements.count)
+      hi = thiz->elements.count;
+  }
+
+  RET(VAR_NUM((double) lo));
+}
+
+// Append the [value] returned by a script function to the [list], which isn't
+// reachable yet if the list needs to grow.
+static void _listAppendTemp(VM* vm, List* list, Var value) {
+  if (IS_OBJ(value)) {
+    vmPushTempRef(vm, AS_OBJ(value)); // value.
+    listAppend(vm, list, value);
+    vmPopTempRef(vm); // value.
+  } else {
+    listAppend(vm, list, value);
+  }
+}
+
+saynaa_function(_listMap, "List.map(fn:Closure) -> List",
+                "Returns a new list of the values returned by calling [fn] with "
+                "each element of the list.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* thiz = (List*) AS_OBJ(THIS);
+
+  Closure* fn;
+  if (!validateArgClosure(vm, 1, &fn))
+    return;
+
+  List* result = newList(vm, thiz->elements.count);
+  vmPushTempRef(vm, &result->_super); // result.
+  Fiber* fiber = vmNewCallFiber(vm, fn);
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+
+  bool success = true;
+  for (uint32_t i = 0; success && i < thiz->elements.count; i++) {
+    Var elem = thiz->elements.data[i], value;
+    success = vmCallFiber(vm, fiber, 1, &elem, &value) == RESULT_SUCCESS;
+    if (success)
+      _listAppendTemp(vm, result, value);
+  }
+
+  vmPopTempRef(vm); // fiber.
+  vmPopTempRef(vm); // result.
+  RET(success ? VAR_OBJ(result) : VAR_NULL);
 }
 
-saynaa_function(_listInsert, "List.insert(index:Number, value:Var) -> Null",
-                "Insert the element at the given index. The index should be "
-                "0 <= index <= list.length.") {
+saynaa_function(_listFilter, "List.filter(fn:Closure) -> List",
+                "Returns a new list of the elements of the list for which [fn] "
+                "returns true.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
   List* thiz = (List*) AS_OBJ(THIS);
 
-  int64_t index;
-  if (!validateInteger(vm, ARG(1), &index, "Argument 1"))
+  Closure* fn;
+  if (!validateArgClosure(vm, 1, &fn))
     return;
 
-  if (index < 0 || index > thiz->elements.count) {
-    RET_ERR(newString(vm, "List.insert index out of bounds."));
+  List* result = newList(vm, thiz->elements.count);
+  vmPushTempRef(vm, &result->_super); // result.
+  Fiber* fiber = vmNewCallFiber(vm, fn);
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+
+  bool success = true;
+  for (uint32_t i = 0; success && i < thiz->elements.count; i++) {
+    Var elem = thiz->elements.data[i], keep;
+    success = vmCallFiber(vm, fiber, 1, &elem, &keep) == RESULT_SUCCESS;
+    if (success && toBool(keep))
+      _listAppendTemp(vm, result, elem);
   }
+  listShrink(vm, result);
 
-  listInsert(vm, thiz, (uint32_t) index, ARG(2));
+  vmPopTempRef(vm); // fiber.
+  vmPopTempRef(vm); // result.
+  RET(success ? VAR_OBJ(result) : VAR_NULL);
 }
 
-saynaa_function(_listPop, "List.pop(index:Number=-1) -> Var",
-                "Removes the last element of the list and return it.") {
+saynaa_function(_listReduce, "List.reduce(fn:Closure [, initial:Var]) -> Var",
+                "Reduce the list to a single value by calling [fn] with the "
+                "accumulated value and each element, and returns the last value "
+                "it returned. If the [initial] value isn't given, the first "
+                "element is used instead.") {
   ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
   List* thiz = (List*) AS_OBJ(THIS);
 
-  if (!CheckArgcRange(vm, ARGC, 0, 1))
+  if (!CheckArgcRange(vm, ARGC, 1, 2))
     return;
 
-  if (thiz->elements.count == 0) {
-    RET_ERR(newString(vm, "Cannot pop from an empty list."));
+  Closure* fn;
+  if (!validateArgClosure(vm, 1, &fn))
+    return;
+
+  uint32_t start = 0;
+  Var acc = VAR_NULL;
+  if (ARGC == 2) {
+    acc = ARG(2);
+  } else if (thiz->elements.count == 0) {
+    RET_ERR(newString(vm, "Cannot reduce an empty list without an initial value."));
+  } else {
+    acc = thiz->elements.data[0];
+    start = 1;
   }
 
-  int64_t index = -1;
-  if (ARGC == 1) {
-    if (!validateInteger(vm, ARG(1), &index, "Argument 1"))
-      return;
+  Fiber* fiber = vmNewCallFiber(vm, fn);
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+
+  for (uint32_t i = start; i < thiz->elements.count; i++) {
+    // The accumulated value isn't reachable from anywhere else.
+    Var args[2] = {acc, thiz->elements.data[i]};
+    if (IS_OBJ(acc))
+      vmPushTempRef(vm, AS_OBJ(acc)); // acc.
+    Result result = vmCallFiber(vm, fiber, 2, args, &acc);
+    if (IS_OBJ(args[0]))
+      vmPopTempRef(vm); // acc.
+
+    if (result != RESULT_SUCCESS) {
+      acc = VAR_NULL;
+      break;
+    }
   }
-  if (index < 0)
-    index = thiz->elements.count + index;
 
-  if (index < 0 || index >= thiz->elements.count) {
-    RET_ERR(newString(vm, "List.pop index out of bounds."));
+  vmPopTempRef(vm); // fiber.
+  RET(acc);
+}
+
+// Returns true if [fn] (or the truthiness of the element if it's NULL)
+// returns [expected] for any of the elements of the [list]. Used for both
+// any() and all().
+static bool _listAnyIs(VM* vm, List* list, Closure* fn, bool expected) {
+  if (fn == NULL) {
+    for (uint32_t i = 0; i < list->elements.count; i++) {
+      if (toBool(list->elements.data[i]) == expected)
+        return true;
+    }
+    return false;
   }
-  RET(listRemoveAt(vm, thiz, (uint32_t) index));
+
+  Fiber* fiber = vmNewCallFiber(vm, fn);
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+
+  bool found = false;
+  for (uint32_t i = 0; i < list->elements.count; i++) {
+    Var elem = list->elements.data[i], value;
+    if (vmCallFiber(vm, fiber, 1, &elem, &value) != RESULT_SUCCESS)
+      break;
+    if (toBool(value) == expected) {
+      found = true;
+      break;
+    }
+  }
+
+  vmPopTempRef(vm); // fiber.
+  return found;
 }
 
-saynaa_function(_listFind, "List.find(value:Var) -> Number",
-                "Find the value and return its index. If the vlaue not exists "
-                "it'll return -1.") {
+saynaa_function(_listAny, "List.any([fn:Closure]) -> Bool",
+                "Returns true if [fn] returns true for any element of the list. "
+                "Without [fn] the elements themselves are tested.") {
   ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
-  List* thiz = (List*) AS_OBJ(THIS);
+  if (!CheckArgcRange(vm, ARGC, 0, 1))
+    return;
 
-  Var* it = thiz->elements.data;
-  if (it == NULL)
-    RET(VAR_NUM(-1)); // Empty list.
+  Closure* fn = NULL;
+  if (ARGC == 1 && !validateArgClosure(vm, 1, &fn))
+    return;
+  RET(VAR_BOOL(_listAnyIs(vm, (List*) AS_OBJ(THIS), fn, true)));
+}
 
-  for (; it < thiz->elements.data + thiz->elements.count; it++) {
-    if (isValuesEqual(*it, ARG(1))) {
-      RET(VAR_NUM((double) (it - thiz->elements.data)));
+saynaa_function(_listAll, "List.all([fn:Closure]) -> Bool",
+                "Returns true if [fn] returns true for all the elements of the "
+                "list. Without [fn] the elements themselves are tested.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  if (!CheckArgcRange(vm, ARGC, 0, 1))
+    return;
+
+  Closure* fn = NULL;
+  if (ARGC == 1 && !validateArgClosure(vm, 1, &fn))
+    return;
+  RET(VAR_BOOL(!_listAnyIs(vm, (List*) AS_OBJ(THIS), fn, false)));
+}
+
+saynaa_function(_listCount, "List.count(value:Var) -> Number",
+                "Returns the number of elements equal to the [value]. If the "
+                "[value] is a function, returns the number of elements it "
+                "returns true for.") {
+  ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
+  List* thiz = (List*) AS_OBJ(THIS);
+  Var value = ARG(1);
+
+  uint32_t count = 0;
+  if (!IS_OBJ_TYPE(value, OBJ_CLOSURE)) {
+    for (uint32_t i = 0; i < thiz->elements.count; i++) {
+      if (isValuesEqual(thiz->elements.data[i], value))
+        count++;
     }
+    RET(VAR_NUM((double) count));
   }
 
-  RET(VAR_NUM(-1));
+  Fiber* fiber = vmNewCallFiber(vm, (Closure*) AS_OBJ(value));
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+
+  for (uint32_t i = 0; i < thiz->elements.count; i++) {
+    Var elem = thiz->elements.data[i], matched;
+    if (vmCallFiber(vm, fiber, 1, &elem, &matched) != RESULT_SUCCESS)
+      break;
+    if (toBool(matched))
+      count++;
+  }
+
+  vmPopTempRef(vm); // fiber.
+  RET(VAR_NUM((double) count));
 }
 
-saynaa_function(
-    _listJoin,
-    "List.join([sep:String="
-    "]) -> String",
-    "Concatinate the elements of the list and return as a string.") {
+saynaa_function(_listEnumerate, "List.enumerate([start:Number=0]) -> List",
+                "Returns a new list of [index, element] pairs of the list, "
+                "where the indexes are counted from [start].") {
   ASSERT(IS_OBJ_TYPE(THIS, OBJ_LIST), OOPS);
-  List* list = (List*) AS_OBJ(THIS);
-  String* sep = NULL;
+  List* thiz = (List*) AS_OBJ(THIS);
 
   if (!CheckArgcRange(vm, ARGC, 0, 1))
     return;
-  if (ARGC == 1)
-    sep = varToString(vm, ARG(1), false);
 
-  _listJoinImpl(vm, list, sep);
+  int64_t start = 0;
+  if (ARGC == 1 && !validateInteger(vm, ARG(1), &start, "Argument 1"))
+    return;
+
+  List* result = newList(vm, thiz->elements.count);
+  vmPushTempRef(vm, &result->_super); // result.
+
+  for (uint32_t i = 0; i < thiz->elements.count; i++) {
+    List* pair = newList(vm, 2);
+    listAppend(vm, pair, VAR_NUM((double) (start + i)));
+    listAppend(vm, pair, thiz->elements.data[i]);
+    _listAppendTemp(vm, result, VAR_OBJ(pair));
+  }
+
+  vmPopTempRef(vm); // result.
+  RET(VAR_OBJ(result));
 }
 
 saynaa_function(_listClear, "List.clear() -> Null", "Removes all the entries in the list.") {
@@ -1647,6 +2820,7 @@ saynaa_function(_listResize, "List.resize(length:Number) -> List",
     listClear(vm, thiz);
 
   } else if (len > thiz->elements.count) {
+    LIST_TRACK_KIND(thiz, VAR_NULL);
     VarBufferFill(&thiz->elements, vm, VAR_NULL, len - thiz->elements.count);
 
   } else if (len < thiz->elements.count) {
@@ -1689,6 +2863,192 @@ saynaa_function(_mapPop, "Map.pop(key:Var) -> Var", "Pops the value at the key a
   RET(value);
 }
 
+saynaa_function(_setAdd, "Set.add(value:Var) -> Bool",
+                "Adds the [value] to the set. Returns true if it wasn't already "
+                "in the set.") {
+  Set* thiz = (Set*) AS_OBJ(THIS);
+  if (!_validateHashable(vm, ARG(1)))
+    return;
+  RET(VAR_BOOL(setAdd(vm, thiz, ARG(1))));
+}
+
+saynaa_function(_setRemove, "Set.remove(value:Var) -> Bool",
+                "Removes the [value] from the set. Returns true if it was in "
+                "the set.") {
+  Set* thiz = (Set*) AS_OBJ(THIS);
+  Var value = ARG(1);
+  if (IS_OBJ(value) && !isObjectHashable(AS_OBJ(value)->type)) {
+    RET(VAR_FALSE);
+  }
+  RET(VAR_BOOL(setRemove(vm, thiz, value)));
+}
+
+saynaa_function(_setHas, "Set.has(value:Var) -> Bool",
+                "Returns true if the [value] is in the set.") {
+  RET(VAR_BOOL(varContains(vm, ARG(1), THIS)));
+}
+
+saynaa_function(_setClear, "Set.clear() -> Null", "Removes all the values in the set.") {
+  setClear(vm, (Set*) AS_OBJ(THIS));
+}
+
+// Add the values of [src] to [dst] if [in] is NULL, otherwise the values
+// which are in [in] (if [contains] is true) or not in [in].
+static void _setAddAll(VM* vm, Set* dst, Set* src, Set* in, bool contains) {
+  for (uint32_t i = 0; i < src->capacity; i++) {
+    Var value = src->entries[i];
+    if (!SET_ENTRY_USED(value))
+      continue;
+    if (in != NULL && setHas(in, value) != contains)
+      continue;
+    setAdd(vm, dst, value);
+  }
+}
+
+saynaa_function(_setUnion, "Set.union(other:Set) -> Set",
+                "Returns a new set of the values which are in the set or in "
+                "[other].") {
+  Set *thiz = (Set*) AS_OBJ(THIS), *other;
+  if (!validateArgSet(vm, 1, &other))
+    return;
+
+  Set* result = newSet(vm, thiz->count + other->count);
+  vmPushTempRef(vm, &result->_super); // result.
+  _setAddAll(vm, result, thiz, NULL, false);
+  _setAddAll(vm, result, other, NULL, false);
+  vmPopTempRef(vm); // result.
+  RET(VAR_OBJ(result));
+}
+
+saynaa_function(_setIntersection, "Set.intersection(other:Set) -> Set",
+                "Returns a new set of the values which are in both the set and "
+                "[other].") {
+  Set *thiz = (Set*) AS_OBJ(THIS), *other;
+  if (!validateArgSet(vm, 1, &other))
+    return;
+
+  // Iterate over the smaller set and look up in the other one.
+  Set* small = (thiz->count <= other->count) ? thiz : other;
+  Set* large = (small == thiz) ? other : thiz;
+
+  Set* result = newSet(vm, small->count);
+  vmPushTempRef(vm, &result->_super); // result.
+  _setAddAll(vm, result, small, large, true);
+  vmPopTempRef(vm); // result.
+  RET(VAR_OBJ(result));
+}
+
+saynaa_function(_setDifference, "Set.difference(other:Set) -> Set",
+                "Returns a new set of the values which are in the set but not "
+                "in [other].") {
+  Set *thiz = (Set*) AS_OBJ(THIS), *other;
+  if (!validateArgSet(vm, 1, &other))
+    return;
+
+  Set* result = newSet(vm, thiz->count);
+  vmPushTempRef(vm, &result->_super); // result.
+  _setAddAll(vm, result, thiz, other, false);
+  vmPopTempRef(vm); // result.
+  RET(VAR_OBJ(result));
+}
+
+saynaa_function(_setList, "Set.list() -> List", "Returns a list of the values in the set.") {
+  Set* thiz = (Set*) AS_OBJ(THIS);
+  List* list = newList(vm, thiz->count);
+  for (uint32_t i = 0; i < thiz->capacity; i++) {
+    if (SET_ENTRY_USED(thiz->entries[i]))
+      listAppend(vm, list, thiz->entries[i]);
+  }
+  RET(VAR_OBJ(list));
+}
+
+saynaa_function(_dequeAppend, "Deque.append(value:Var) -> Null",
+                "Adds the [value] at the back of the deque.") {
+  dequePushBack(vm, (Deque*) AS_OBJ(THIS), ARG(1));
+}
+
+saynaa_function(_dequeAppendLeft, "Deque.appendleft(value:Var) -> Null",
+                "Adds the [value] at the front of the deque.") {
+  dequePushFront(vm, (Deque*) AS_OBJ(THIS), ARG(1));
+}
+
+saynaa_function(_dequePop, "Deque.pop() -> Var",
+                "Removes the element at the back of the deque and return it.") {
+  Deque* thiz = (Deque*) AS_OBJ(THIS);
+  if (thiz->count == 0) {
+    RET_ERR(newString(vm, "Cannot pop from an empty deque."));
+  }
+  RET(dequePopBack(vm, thiz));
+}
+
+saynaa_function(_dequePopLeft, "Deque.popleft() -> Var",
+                "Removes the element at the front of the deque and return it.") {
+  Deque* thiz = (Deque*) AS_OBJ(THIS);
+  if (thiz->count == 0) {
+    RET_ERR(newString(vm, "Cannot pop from an empty deque."));
+  }
+  RET(dequePopFront(vm, thiz));
+}
+
+saynaa_function(_dequeClear, "Deque.clear() -> Null", "Removes all the elements in the deque.") {
+  dequeClear(vm, (Deque*) AS_OBJ(THIS));
+}
+
+saynaa_function(_dequeList, "Deque.list() -> List",
+                "Returns a list of the elements in the deque from the front to "
+                "the back.") {
+  Deque* thiz = (Deque*) AS_OBJ(THIS);
+  List* list = newList(vm, thiz->count);
+  for (uint32_t i = 0; i < thiz->count; i++) {
+    listAppend(vm, list, DEQUE_AT(thiz, i));
+  }
+  RET(VAR_OBJ(list));
+}
+
+saynaa_function(_heapPushMethod, "Heap.push(item:Var) -> Null",
+                "Adds the [item] to the heap.") {
+  _heapPush(vm, (Heap*) AS_OBJ(THIS), ARG(1));
+}
+
+saynaa_function(_heapPopMethod, "Heap.pop() -> Var",
+                "Removes the first item of the heap (the smallest one, or the "
+                "largest if it's reversed) and return it.") {
+  Heap* thiz = (Heap*) AS_OBJ(THIS);
+  if (thiz->items.count == 0) {
+    RET_ERR(newString(vm, "Cannot pop from an empty heap."));
+  }
+  Var item;
+  if (_heapPop(vm, thiz, &item))
+    RET(item);
+}
+
+saynaa_function(_heapPeek, "Heap.peek() -> Var",
+                "Returns the first item of the heap without removing it.") {
+  Heap* thiz = (Heap*) AS_OBJ(THIS);
+  if (thiz->items.count == 0) {
+    RET_ERR(newString(vm, "Cannot peek an empty heap."));
+  }
+  RET(thiz->items.data[0]);
+}
+
+saynaa_function(_heapClear, "Heap.clear() -> Null", "Removes all the items in the heap.") {
+  Heap* thiz = (Heap*) AS_OBJ(THIS);
+  VarBufferClear(&thiz->items, vm);
+  VarBufferClear(&thiz->keys, vm);
+}
+
+saynaa_function(_heapList, "Heap.list() -> List",
+                "Returns a list of the items in the heap, in the heap order (the "
+                "first item is the one pop() returns but the rest aren't "
+                "sorted).") {
+  Heap* thiz = (Heap*) AS_OBJ(THIS);
+  List* list = newList(vm, thiz->items.count);
+  for (uint32_t i = 0; i < thiz->items.count; i++) {
+    listAppend(vm, list, thiz->items.data[i]);
+  }
+  RET(VAR_OBJ(list));
+}
+
 saynaa_function(
     _methodBindBind, "MethodBind.bind(instance:Var) -> MethodBind",
     "Bind the method to the instance and the method bind will be returned. The "
@@ -1748,6 +3108,7 @@ saynaa_function(
     if (moduleGetStringAt(thiz, thiz->global_names.data[i])->data[0] == SPECIAL_NAME_CHAR) {
       continue;
     }
+    VAR_FREEZE(thiz->globals.data[i]);
     listAppend(vm, list, thiz->globals.data[i]);
   }
   vmPopTempRef(vm); // list.
@@ -1824,6 +3185,9 @@ static void initializePrimitiveClasses(VM* vm) {
   ADD_CTOR(vRANGE, "@ctorRange", _ctorRange, 2);
   ADD_CTOR(vLIST, "@ctorList", _ctorList, -1);
   ADD_CTOR(vMAP, "@ctorMap", _ctorMap, 0);
+  ADD_CTOR(vSET, "@ctorSet", _ctorSet, -1);
+  ADD_CTOR(vDEQUE, "@ctorDeque", _ctorDeque, -1);
+  ADD_CTOR(vHEAP, "@ctorHeap", _ctorHeap, -1);
   ADD_CTOR(vFIBER, "@ctorFiber", _ctorFiber, 1);
   ADD_CTOR(vPOINTER, "@ctorPointer", _ctorPointer, 1);
 #undef ADD_CTOR
@@ -1868,12 +3232,43 @@ static void initializePrimitiveClasses(VM* vm) {
   ADD_METHOD(vLIST, "insert", _listInsert, 2);
   ADD_METHOD(vLIST, "join", _listJoin, -1);
   ADD_METHOD(vLIST, "resize", _listResize, 1);
+  ADD_METHOD(vLIST, "sort", _listSort, -1);
+  ADD_METHOD(vLIST, "bisect", _listBisect, 1);
+  ADD_METHOD(vLIST, "map", _listMap, 1);
+  ADD_METHOD(vLIST, "filter", _listFilter, 1);
+  ADD_METHOD(vLIST, "reduce", _listReduce, -1);
+  ADD_METHOD(vLIST, "any", _listAny, -1);
+  ADD_METHOD(vLIST, "all", _listAll, -1);
+  ADD_METHOD(vLIST, "count", _listCount, 1);
+  ADD_METHOD(vLIST, "enumerate", _listEnumerate, -1);
 
   ADD_METHOD(vMAP, "clear", _mapClear, 0);
   ADD_METHOD(vMAP, "get", _mapGet, -1);
   ADD_METHOD(vMAP, "has", _mapHas, 1);
   ADD_METHOD(vMAP, "pop", _mapPop, 1);
 
+  ADD_METHOD(vSET, "add", _setAdd, 1);
+  ADD_METHOD(vSET, "remove", _setRemove, 1);
+  ADD_METHOD(vSET, "has", _setHas, 1);
+  ADD_METHOD(vSET, "clear", _setClear, 0);
+  ADD_METHOD(vSET, "union", _setUnion, 1);
+  ADD_METHOD(vSET, "intersection", _setIntersection, 1);
+  ADD_METHOD(vSET, "difference", _setDifference, 1);
+  ADD_METHOD(vSET, "list", _setList, 0);
+
+  ADD_METHOD(vDEQUE, "append", _dequeAppend, 1);
+  ADD_METHOD(vDEQUE, "appendleft", _dequeAppendLeft, 1);
+  ADD_METHOD(vDEQUE, "pop", _dequePop, 0);
+  ADD_METHOD(vDEQUE, "popleft", _dequePopLeft, 0);
+  ADD_METHOD(vDEQUE, "clear", _dequeClear, 0);
+  ADD_METHOD(vDEQUE, "list", _dequeList, 0);
+
+  ADD_METHOD(vHEAP, "push", _heapPushMethod, 1);
+  ADD_METHOD(vHEAP, "pop", _heapPopMethod, 0);
+  ADD_METHOD(vHEAP, "peek", _heapPeek, 0);
+  ADD_METHOD(vHEAP, "clear", _heapClear, 0);
+  ADD_METHOD(vHEAP, "list", _heapList, 0);
+
   ADD_METHOD(vMETHOD_BIND, "bind", _methodBindBind, 1);
 
   ADD_METHOD(vCLASS, "methods", _classMethods, 0);
@@ -1906,6 +3301,9 @@ Var preConstructThis(VM* vm, Class* cls) {
     case vSTRING:
     case vLIST:
     case vMAP:
+    case vSET:
+    case vDEQUE:
+    case vHEAP:
     case vPOINTER:
     case vRANGE:
       return VAR_NULL; // Constructor will override the null.
@@ -1947,6 +3345,10 @@ void bindMethod(VM* vm, Class* cls, Closure* method) {
     cls->magic_methods[METHOD_SETTER] = method;
   } else if (strcmp(method->fn->name, LITS__call) == 0) {
     cls->magic_methods[METHOD_CALL] = method;
+  } else if (strcmp(method->fn->name, LITS__next) == 0) {
+    cls->magic_methods[METHOD_NEXT] = method;
+  } else if (strcmp(method->fn->name, LITS__value) == 0) {
+    cls->magic_methods[METHOD_VALUE] = method;
   }
 
   ClosureBufferWrite(&cls->methods, vm, method);
@@ -2177,6 +3579,7 @@ Var varAdd(VM* vm, Var v1, Var v2, bool inplace) {
           Object* o2 = AS_OBJ(v2);
           if (o2->type == OBJ_LIST) {
             if (inplace) {
+              ((List*) o1)->kind |= ((List*) o2)->kind;
               VarBufferConcat(&((List*) o1)->elements, vm, &((List*) o2)->elements);
               return v1;
             } else {
@@ -2256,14 +3659,13 @@ Var varMultiply(VM* vm, Var v1, Var v2, bool inplace) {
         return VAR_NULL;
       }
 
-      String* str = newStringLength(vm, "", left->length * (uint32_t) right);
+      String* str = newStringLength(vm, NULL, left->length * (uint32_t) right);
       char* buff = str->data;
       for (int i = 0; i < (int) right; i++) {
         memcpy(buff, left->data, left->length);
         buff += left->length;
       }
       ASSERT(buff == str->data + str->length, OOPS);
-      str->hash = utilHashString(str->data);
       return VAR_OBJ(str);
     } else {
       VM_SET_ERROR(
@@ -2425,6 +3827,37 @@ bool varContains(VM* vm, Var elem, Var container) {
       }
       break;
 
+    case OBJ_SET:
+      {
+        // An unhashable value can't be in a set.
+        if (IS_OBJ(elem) && !isObjectHashable(AS_OBJ(elem)->type))
+          return false;
+        return setHas((Set*) AS_OBJ(container), elem);
+      }
+      break;
+
+    case OBJ_DEQUE:
+      {
+        Deque* deque = (Deque*) AS_OBJ(container);
+        for (uint32_t i = 0; i < deque->count; i++) {
+          if (isValuesEqual(elem, DEQUE_AT(deque, i)))
+            return true;
+        }
+        return false;
+      }
+      break;
+
+    case OBJ_HEAP:
+      {
+        Heap* heap = (Heap*) AS_OBJ(container);
+        for (uint32_t i = 0; i < heap->items.count; i++) {
+          if (isValuesEqual(elem, heap->items.data[i]))
+            return true;
+        }
+        return false;
+      }
+      break;
+
     default:
       break;
   }
@@ -2464,7 +3897,7 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
   VM_SET_ERROR(vm, stringFormat(vm, "'$' object has no attribute named '$'.", \
                                 varTypeName(on), attrib->data))
 
-  if (attrib->hash == CHECK_HASH("_class", 0xa2d93eae)) {
+  if (STRING_HASH(attrib) == CHECK_HASH("_class", 0x55d1e6fe)) {
     return VAR_OBJ(getClass(vm, on));
   }
 
@@ -2478,8 +3911,8 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
     case OBJ_STRING:
       {
         String* str = (String*) obj;
-        switch (attrib->hash) {
-          case CHECK_HASH("length", 0x83d03615):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("length", 0x1ede0aa3):
             return VAR_NUM((double) (str->length));
         }
       }
@@ -2488,8 +3921,8 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
     case OBJ_LIST:
       {
         List* list = (List*) obj;
-        switch (attrib->hash) {
-          case CHECK_HASH("length", 0x83d03615):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("length", 0x1ede0aa3):
             return VAR_NUM((double) (list->elements.count));
         }
       }
@@ -2498,11 +3931,11 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
     case OBJ_MAP:
       {
         Map* map = (Map*) obj;
-        switch (attrib->hash) {
-          case CHECK_HASH("length", 0x83d03615):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("length", 0x1ede0aa3):
             return VAR_NUM((double) (map->count));
 
-          case CHECK_HASH("keys", 0xF94A08CD):
+          case CHECK_HASH("keys", 0x7ab90c12):
             {
               List* list = newList(vm, map->count);
               vmPushTempRef(vm, &list->_super); // list.
@@ -2515,7 +3948,7 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
               return VAR_OBJ(list);
             }
 
-          case CHECK_HASH("values", 0x34474C3B):
+          case CHECK_HASH("values", 0x6ba6913a):
             {
               List* list = newList(vm, map->count);
               vmPushTempRef(vm, &list->_super); // list.
@@ -2536,24 +3969,54 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
       }
       break;
 
+    case OBJ_SET:
+      {
+        Set* set = (Set*) obj;
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("length", 0x1ede0aa3):
+            return VAR_NUM((double) (set->count));
+        }
+      }
+      break;
+
+    case OBJ_DEQUE:
+      {
+        Deque* deque = (Deque*) obj;
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("length", 0x1ede0aa3):
+            return VAR_NUM((double) (deque->count));
+        }
+      }
+      break;
+
+    case OBJ_HEAP:
+      {
+        Heap* heap = (Heap*) obj;
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("length", 0x1ede0aa3):
+            return VAR_NUM((double) (heap->items.count));
+        }
+      }
+      break;
+
     case OBJ_RANGE:
       {
         Range* range = (Range*) obj;
-        switch (attrib->hash) {
-          case CHECK_HASH("as_list", 0x1562c22):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("as_list", 0x7a81b8cb):
             return VAR_OBJ(rangeAsList(vm, range));
 
-          case CHECK_HASH("length", 0x83d03615):
+          case CHECK_HASH("length", 0x1ede0aa3):
             return VAR_NUM(rangeLength(vm, range));
 
             // We can't use 'start', 'end' since 'end' is a
             // keyword. Also we can't use 'from', 'to' since 'from' is a keyword
             // too. So, we're using 'first' and 'last' to access the range limits.
 
-          case CHECK_HASH("first", 0x4881d841):
+          case CHECK_HASH("first", 0x6f39499e):
             return VAR_NUM(range->from);
 
-          case CHECK_HASH("last", 0x63e1d819):
+          case CHECK_HASH("last", 0x5371770d):
             return VAR_NUM(range->to);
         }
       }
@@ -2567,6 +4030,7 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
         int index = moduleGetGlobalIndex(module, attrib->data, attrib->length);
         if (index != -1) {
           ASSERT_INDEX((uint32_t) index, module->globals.count);
+          VAR_FREEZE(module->globals.data[index]);
           return module->globals.data[index];
         }
       }
@@ -2578,18 +4042,18 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
     case OBJ_CLOSURE:
       {
         Closure* closure = (Closure*) obj;
-        switch (attrib->hash) {
-          case CHECK_HASH("name", 0x8d39bde6):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("name", 0x72c564c0):
             return VAR_OBJ(newString(vm, closure->fn->name));
 
-          case CHECK_HASH("_docs", 0x8fb536a9):
+          case CHECK_HASH("_docs", 0xc05a13e7):
             if (closure->fn->docstring) {
               return VAR_OBJ(newString(vm, closure->fn->docstring));
             } else {
               return VAR_OBJ(newString(vm, ""));
             }
 
-          case CHECK_HASH("arity", 0x3e96bd7a):
+          case CHECK_HASH("arity", 0x06e588a4):
             return VAR_NUM((double) (closure->fn->arity));
         }
       }
@@ -2599,23 +4063,23 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
       {
         MethodBind* mb = (MethodBind*) obj;
 
-        switch (attrib->hash) {
-          case CHECK_HASH("_docs", 0x8fb536a9):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("_docs", 0xc05a13e7):
             if (mb->method->fn->docstring) {
               return VAR_OBJ(newString(vm, mb->method->fn->docstring));
             } else {
               return VAR_OBJ(newString(vm, ""));
             }
 
-          case CHECK_HASH("name", 0x8d39bde6):
+          case CHECK_HASH("name", 0x72c564c0):
             return VAR_OBJ(newString(vm, mb->method->fn->name));
 
-          case CHECK_HASH("instance", 0xb86d992):
+          case CHECK_HASH("instance", 0x652c07b9):
             if (IS_UNDEF(mb->instance))
               return VAR_NULL;
             return mb->instance;
 
-          case CHECK_HASH("arity", 0x3e96bd7a):
+          case CHECK_HASH("arity", 0x06e588a4):
             return VAR_NUM((double) (mb->method->fn->arity));
         }
       }
@@ -2628,11 +4092,11 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
     case OBJ_FIBER:
       {
         Fiber* fb = (Fiber*) obj;
-        switch (attrib->hash) {
-          case CHECK_HASH("is_done", 0x789c2706):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("is_done", 0x47c982b5):
             return VAR_BOOL(fb->state == FIBER_DONE);
 
-          case CHECK_HASH("function", 0x9ed64249):
+          case CHECK_HASH("function", 0x755e6444):
             return VAR_OBJ(fb->closure);
         }
       }
@@ -2642,18 +4106,18 @@ Var varGetAttrib(VM* vm, Var on, String* attrib, bool skipGetter, bool callable)
       {
         Class* cls = (Class*) obj;
 
-        switch (attrib->hash) {
-          case CHECK_HASH("_docs", 0x8fb536a9):
+        switch (STRING_HASH(attrib)) {
+          case CHECK_HASH("_docs", 0xc05a13e7):
             if (cls->docstring) {
               return VAR_OBJ(newString(vm, cls->docstring));
             } else {
               return VAR_OBJ(newString(vm, ""));
             }
 
-          case CHECK_HASH("name", 0x8d39bde6):
+          case CHECK_HASH("name", 0x72c564c0):
             return VAR_OBJ(newString(vm, cls->name->data));
 
-          case CHECK_HASH("parent", 0xeacdfcfd):
+          case CHECK_HASH("parent", 0xac8ab342):
             if (cls->super_class != NULL) {
               return VAR_OBJ(cls->super_class);
             } else {
@@ -2847,16 +4311,16 @@ static String* _sliceString(VM* vm, String* str, Range* range) {
 
   // TODO: check if length is 1 and return pre allocated character string.
 
-  String* slice = newStringLength(vm, str->data + start, length);
   if (!reversed)
-    return slice;
+    return newStringView(vm, str, start, length);
+
+  String* slice = newStringLength(vm, str->data + start, length);
 
   for (int32_t i = 0; i < length / 2; i++) {
     char tmp = slice->data[i];
     slice->data[i] = slice->data[length - i - 1];
     slice->data[length - i - 1] = tmp;
   }
-  slice->hash = utilHashString(slice->data);
   return slice;
 }
 
@@ -2959,6 +4423,24 @@ Var varGetSubscript(VM* vm, Var on, Var key) {
       }
       break;
 
+    case OBJ_DEQUE:
+      {
+        int64_t index;
+        Deque* deque = (Deque*) obj;
+        if (!validateInteger(vm, key, &index, "Deque index"))
+          return VAR_NULL;
+
+        // Normalize index.
+        if (index < 0)
+          index = deque->count + index;
+        if (index >= deque->count || index < 0) {
+          VM_SET_ERROR(vm, newString(vm, "Deque index out of bound."));
+          return VAR_NULL;
+        }
+        return DEQUE_AT(deque, index);
+      }
+      break;
+
     case OBJ_FUNC:
     case OBJ_UPVALUE:
       UNREACHABLE(); // Not first class objects.
@@ -3016,7 +4498,6 @@ void varsetSubscript(VM* vm, Var on, Var key, Var value) {
         if (objValue->type == OBJ_STRING) {
           String* strReplace = ((String*) objValue);
           str = replaceSubstring(vm, index, str, strReplace);
-          str->hash = utilHashString(str->data);
 
           on = VAR_OBJ(str);
 
@@ -3040,10 +4521,15 @@ void varsetSubscript(VM* vm, Var on, Var key, Var value) {
           return;
         }
 
+        List* list = (List*) obj;
         if (index >= elems->count) {
+          // The elements between the last and the [index] are null.
+          if (index > elems->count)
+            LIST_TRACK_KIND(list, VAR_NULL);
           VarBufferFill(elems, vm, VAR_NULL, (index + 1) - elems->count);
         }
 
+        LIST_TRACK_KIND(list, value);
         elems->data[index] = value;
         return;
       }
@@ -3060,6 +4546,25 @@ void varsetSubscript(VM* vm, Var on, Var key, Var value) {
       }
       break;
 
+    case OBJ_DEQUE:
+      {
+        int64_t index;
+        Deque* deque = (Deque*) obj;
+        if (!validateInteger(vm, key, &index, "Deque index"))
+          return;
+
+        // Normalize index, unlike lists a deque won't grow by the subscript.
+        if (index < 0)
+          index = deque->count + index;
+        if (index >= deque->count || index < 0) {
+          VM_SET_ERROR(vm, newString(vm, "Deque index out of bound."));
+          return;
+        }
+        DEQUE_AT(deque, index) = value;
+        return;
+      }
+      break;
+
     case OBJ_FUNC:
     case OBJ_UPVALUE:
       UNREACHABLE();
@@ -3144,6 +4649,54 @@ bool varIterate(VM* vm, Var seq, Var* iterator, Var* value) {
         return true;
       }
 
+    case OBJ_SET:
+      {
+        if (IS_NULL(*iterator))
+          *iterator = VAR_NUM((double) 0);
+        uint32_t iter = (uint32_t) AS_NUM(*iterator);
+
+        Set* set = (Set*) obj;
+        for (; iter < set->capacity; iter++) {
+          if (SET_ENTRY_USED(set->entries[iter]))
+            break;
+        }
+        if (iter >= set->capacity)
+          return false;
+
+        *value = set->entries[iter];
+        *iterator = VAR_NUM((double) iter + 1);
+        return true;
+      }
+
+    case OBJ_DEQUE:
+      {
+        if (IS_NULL(*iterator))
+          *iterator = VAR_NUM((double) 0);
+        uint32_t iter = (uint32_t) AS_NUM(*iterator);
+
+        Deque* deque = (Deque*) obj;
+        if (iter >= deque->count)
+          return false;
+        *value = DEQUE_AT(deque, iter);
+        *iterator = VAR_NUM((double) iter + 1);
+        return true;
+      }
+
+    case OBJ_HEAP:
+      {
+        if (IS_NULL(*iterator))
+          *iterator = VAR_NUM((double) 0);
+        uint32_t iter = (uint32_t) AS_NUM(*iterator);
+
+        // Iterated in the heap order.
+        VarBuffer* items = &((Heap*) obj)->items;
+        if (iter >= items->count)
+          return false;
+        *value = items->data[iter];
+        *iterator = VAR_NUM((double) iter + 1);
+        return true;
+      }
+
     case OBJ_RANGE:
       {
         if (IS_NULL(*iterator))
@@ -3169,17 +4722,20 @@ bool varIterate(VM* vm, Var seq, Var* iterator, Var* value) {
 
     case OBJ_INST:
       {
-        for (;;) {
-          if (!_callBinaryOpMethod(vm, seq, *iterator, LITS__next, iterator))
-            break;
-          if (IS_NULL(*iterator))
-            return false;
+        // The iteration methods are cached in the class like the other
+        // magic methods, since they're called for each step of the loop.
+        Class* cls = ((Instance*) obj)->cls;
+        Closure* next = getMagicMethod(cls, METHOD_NEXT);
+        Closure* value_fn = getMagicMethod(cls, METHOD_VALUE);
+        if (next == NULL || value_fn == NULL)
+          goto _default;
+
+        vmCallMethod(vm, seq, next, 1, iterator, iterator);
+        if (VM_HAS_ERROR(vm) || IS_NULL(*iterator))
+          return false;
 
-          if (!_callBinaryOpMethod(vm, seq, *iterator, LITS__value, value))
-            break;
-          return true;
-        }
-        goto _default;
+        vmCallMethod(vm, seq, value_fn, 1, iterator, value);
+        return !VM_HAS_ERROR(vm);
       }
 
     case OBJ_FIBER:
@@ -77,6 +77,10 @@ void* vmRealloc(VM* vm, void* memory, size_t old_size, size_t new_size) {
     vm->bytes_allocated += new_size - old_size;
   }
 
+  if (vm->memtrack != NULL && new_size > old_size) {
+    memtrackAllocation(vm, new_size - old_size);
+  }
+
   // If we're garbage collecting no new allocation is allowed.
   ASSERT(!vm->collecting_garbage || new_size == 0,
          "No new allocation is allowed while garbage collection is running.");
@@ -86,6 +90,14 @@ void* vmRealloc(VM* vm, void* memory, size_t old_size, size_t new_size) {
     vm->collecting_garbage = true;
     vmCollectGarbage(vm);
     vm->collecting_garbage = false;
+
+    // The heap limit is reported as a runtime error of the running fiber, the
+    // allocation itself will succeed and the fiber will be unwound at the next
+    // error check of the interpreter.
+    if (vm->max_heap_size != 0 && vm->bytes_allocated > vm->max_heap_size
+        && vm->fiber != NULL && !VM_HAS_ERROR(vm)) {
+      VM_SET_ERROR(vm, newString(vm, "Out of memory, the heap limit exceeded."));
+    }
   }
 
   return vm->config.realloc_fn(memory, new_size, vm->config.user_data);
@@ -123,6 +135,14 @@ Module* vmGetModule(VM* vm, String* key) {
 }
 
 void vmCollectGarbage(VM* vm) {
+  GCStats* stats = &vm->gc_stats;
+  nanotime_t start_time = nanotime();
+  size_t heap_before = vm->bytes_allocated;
+
+  // The sampled functions could be freed bellow.
+  if (vm->profiler != NULL)
+    profilerFlush(vm);
+
   // Mark builtin functions.
   for (int i = 0; i < vm->builtins_count; i++) {
     markObject(vm, &vm->builtins_funcs[i]->_super);
@@ -144,12 +164,16 @@ void vmCollectGarbage(VM* vm) {
 
   // Mark temp references.
   for (int i = 0; i < vm->temp_reference_count; i++) {
-    markObject(vm, vm->temp_reference[i]);
+    Object* obj = vm->temp_reference[i];
+    markObject(vm, obj);
+    if (obj->type == OBJ_STRING && STRING_PARENT((String*) obj) != NULL)
+      ((String*) obj)->is_rooted = true;
   }
 
   // Mark the handles.
   for (Handle* h = vm->handles; h != NULL; h = h->next) {
     markValue(vm, h->value);
+    MARK_VIEW_ROOTED(h->value);
   }
 
   // Garbage collection triggered at the middle of a compilation.
@@ -165,10 +189,14 @@ void vmCollectGarbage(VM* vm) {
   // required to know the size of each object that'll be freeing.
   vm->bytes_allocated = 0;
 
+  if (vm->memtrack != NULL)
+    memtrackBeginGC(vm);
+
   // Pop the marked objects from the working set and push all of it's
   // referenced objects. This will repeat till no more objects left in the
   // working set.
   popMarkedObjects(vm);
+  markStringViews(vm);
 
   // Now [vm->bytes_allocated] is equal to the number of bytes allocated for
   // the root objects which are marked above. Since we're garbage collecting
@@ -183,6 +211,7 @@ void vmCollectGarbage(VM* vm) {
 
   // [ptr] is an Object* reference that should be equal to the next
   // non-garbage Object*.
+  memset(stats->live_objects, 0, sizeof(stats->live_objects));
   Object** ptr = &vm->first;
   while (*ptr != NULL) {
     // If the object the pointer points to wasn't marked it's unreachable.
@@ -195,6 +224,7 @@ void vmCollectGarbage(VM* vm) {
     } else {
       // Unmark the object for the next garbage collection.
       (*ptr)->is_marked = false;
+      stats->live_objects[(*ptr)->type]++;
       ptr = &(*ptr)->next;
     }
   }
@@ -208,6 +238,37 @@ void vmCollectGarbage(VM* vm) {
   vm->next_gc = vm->bytes_allocated + ((vm->bytes_allocated * vm->heap_fill_percent) / 100);
   if (vm->next_gc < vm->min_heap_size)
     vm->next_gc = vm->min_heap_size;
+
+  // Collect before the heap limit is reached, unless we're already above it
+  // in which case the allocation will fail with an error (see vmRealloc) and
+  // collecting at every allocation till then would be pointless.
+  if (vm->max_heap_size != 0 && vm->next_gc > vm->max_heap_size
+      && vm->bytes_allocated < vm->max_heap_size) {
+    vm->next_gc = vm->max_heap_size;
+  }
+
+  if (vm->memtrack != NULL)
+    memtrackEndGC(vm);
+
+  nanotime_t end_time = nanotime();
+  double pause = millitime(start_time, end_time);
+
+  GCRecord* record = &stats->history[stats->collections % GC_HISTORY_SIZE];
+  record->time = (double) (end_time - stats->start_time) / 1e9;
+  record->pause = pause;
+  record->heap_before = heap_before;
+  record->heap_after = vm->bytes_allocated;
+
+  stats->collections++;
+  stats->last_pause = pause;
+  stats->total_pause += pause;
+  if (pause > stats->max_pause)
+    stats->max_pause = pause;
+  stats->bytes_marked = vm->bytes_allocated;
+  stats->bytes_swept = (heap_before > vm->bytes_allocated)
+                         ? heap_before - vm->bytes_allocated
+                         : 0;
+  stats->total_swept += stats->bytes_swept;
 }
 
 #define _ERR_FAIL(msg) \
@@ -338,21 +399,9 @@ void vmYieldFiber(VM* vm, Var* value) {
   vm->fiber = caller;
 }
 
-Result vmCallMethod(VM* vm, Var thiz, Closure* fn, int argc, Var* argv, Var* ret) {
-  ASSERT(argc >= 0, "argc cannot be negative.");
-  ASSERT(argc == 0 || argv != NULL, "argv was NULL when argc > 0.");
-
-  Fiber* fiber = newFiber(vm, fn);
-  fiber->thiz = thiz;
-  fiber->native = vm->fiber;
-  vmPushTempRef(vm, &fiber->_super); // fiber.
-  bool success = vmPrepareFiber(vm, fiber, argc, argv);
-
-  if (!success) {
-    vmPopTempRef(vm); // fiber.
-    return RESULT_RUNTIME_ERROR;
-  }
-
+// Run a prepared [fiber] of a function called from a native function and
+// switch back to the current fiber.
+static Result _runCalledFiber(VM* vm, Fiber* fiber, Var* ret) {
   Result result;
 
   Fiber* last = vm->fiber;
@@ -378,7 +427,6 @@ Result vmCallMethod(VM* vm, Var thiz, Closure* fn, int argc, Var* argv, Var* ret
 
   if (last != NULL)
     vmPopTempRef(vm); // last.
-  vmPopTempRef(vm);   // fiber.
 
   vm->fiber = last;
 
@@ -388,12 +436,66 @@ Result vmCallMethod(VM* vm, Var thiz, Closure* fn, int argc, Var* argv, Var* ret
   return result;
 }
 
+Result vmCallMethod(VM* vm, Var thiz, Closure* fn, int argc, Var* argv, Var* ret) {
+  ASSERT(argc >= 0, "argc cannot be negative.");
+  ASSERT(argc == 0 || argv != NULL, "argv was NULL when argc > 0.");
+
+  Fiber* fiber = newFiber(vm, fn);
+  fiber->thiz = thiz;
+  fiber->native = vm->fiber;
+  vmPushTempRef(vm, &fiber->_super); // fiber.
+  bool success = vmPrepareFiber(vm, fiber, argc, argv);
+
+  if (!success) {
+    vmPopTempRef(vm); // fiber.
+    return RESULT_RUNTIME_ERROR;
+  }
+
+  Result result = _runCalledFiber(vm, fiber, ret);
+  vmPopTempRef(vm); // fiber.
+  return result;
+}
+
 Result vmCallFunction(VM* vm, Closure* fn, int argc, Var* argv, Var* ret) {
   // Calling functions and methods are the same, except for the methods have
   // this defined, and for functions it'll be VAR_UNDEFINED.
   return vmCallMethod(vm, VAR_UNDEFINED, fn, argc, argv, ret);
 }
 
+Fiber* vmNewCallFiber(VM* vm, Closure* fn) {
+  Fiber* fiber = newFiber(vm, fn);
+  fiber->native = vm->fiber;
+  return fiber;
+}
+
+Result vmCallFiber(VM* vm, Fiber* fiber, int argc, Var* argv, Var* ret) {
+  ASSERT(argc >= 0, "argc cannot be negative.");
+  ASSERT(argc == 0 || argv != NULL, "argv was NULL when argc > 0.");
+  ASSERT(fiber->caller == NULL, OOPS);
+
+  // Reset the fiber to the state newFiber() returns it, the stack and the
+  // call frames are reused. The upvalues of the last call are closed when it
+  // returned.
+  fiber->state = FIBER_NEW;
+  fiber->ret = fiber->stack;
+  fiber->sp = fiber->stack + 1;
+  fiber->open_upvalues = NULL;
+  fiber->thiz = VAR_UNDEFINED;
+  fiber->error = NULL;
+  *fiber->ret = VAR_NULL;
+
+  if (!fiber->closure->fn->is_native) {
+    fiber->frame_count = 1;
+    fiber->frames[0].closure = fiber->closure;
+    fiber->frames[0].ip = fiber->closure->fn->fn->opcodes.data;
+    fiber->frames[0].rbp = fiber->ret;
+  }
+
+  if (!vmPrepareFiber(vm, fiber, argc, argv))
+    return RESULT_RUNTIME_ERROR;
+  return _runCalledFiber(vm, fiber, ret);
+}
+
 #ifndef NO_DL
 
 // Returns true if the path ends with ".dll" or ".so".
@@ -549,7 +651,6 @@ static Module* _importResolved(VM* vm, String* resolved, String* name) {
       if (*c == '/')
         *c = '.';
     }
-    _name->hash = utilHashString(_name->data);
     vmPushTempRef(vm, &_name->_super); // _name.
 
 #ifndef NO_DL
@@ -913,6 +1014,34 @@ static void vmReportError(VM* vm) {
  * RUNTIME                                                                    *
  *****************************************************************************/
 
+#if OPCODE_STATS
+// Record the execution of the instruction [op] of the function [fn]. Called
+// by the interpreter before dispatching every instruction.
+static inline void opstatsRecord(VM* vm, const Function* fn, int op) {
+  OpcodeStats* stats = vm->opstats;
+  uint64_t now = opstatsCycles();
+
+  if (stats->last_op >= 0) {
+    uint64_t elapsed = now - stats->last_cycles;
+    stats->cycles[stats->last_op] += elapsed;
+    stats->functions[stats->last_fn].cycles += elapsed;
+    stats->pairs[stats->last_op][op]++;
+  }
+
+  int index = fn->fn->stats_index;
+  if (index < 0)
+    index = opstatsFunction(vm, fn);
+
+  stats->counts[op]++;
+  stats->functions[index].count++;
+  stats->last_op = op;
+  stats->last_fn = index;
+
+  // Don't count the time spent in here to the instruction.
+  stats->last_cycles = opstatsCycles();
+}
+#endif // OPCODE_STATS
+
 Result vmRunFiber(VM* vm, Fiber* fiber_) {
   // Set the fiber as the VM's current fiber (another root object) to prevent
   // it from garbage collection and get the reference from native functions.
@@ -995,6 +1124,17 @@ Result vmRunFiber(VM* vm, Fiber* fiber_) {
 // Update the frame's execution variables before pushing another call frame.
 #define UPDATE_FRAME() frame->ip = ip
 
+// Count down a LOOP / CALL event for the sampling profiler and record a sample
+// once it reaches zero. When the profiler isn't running this is a single
+// (well predicted) NULL check.
+#define PROFILER_TICK() \
+  do { \
+    if (vm->profiler != NULL && --vm->profiler->countdown <= 0) { \
+      UPDATE_FRAME(); \
+      profilerSample(vm); \
+    } \
+  } while (false)
+
 #ifdef OPCODE
 #error "OPCODE" should not be deifined here.
 #endif
@@ -1027,6 +1167,16 @@ L_vm_main_loop:
 #endif
 #undef _DUMP_STACK
 
+#if OPCODE_STATS
+  opstatsRecord(vm, frame->closure->fn, *ip);
+#endif
+
+  // The allocation tracker attributes an allocation to the line of the
+  // instruction before the frame's ip, so point it past the current opcode
+  // since any instruction could allocate (by calling a native or a magic
+  // method). A plain store is cheaper here than checking vm->memtrack first.
+  frame->ip = ip + 1;
+
   SWITCH() {
     OPCODE(PUSH_CONSTANT) : {
       uint16_t index = READ_SHORT();
@@ -1080,7 +1230,7 @@ L_vm_main_loop:
       Var elem = PEEK(-1); // Don't pop yet, we need the reference for gc.
       Var list = PEEK(-2);
       ASSERT(IS_OBJ_TYPE(list, OBJ_LIST), OOPS);
-      VarBufferWrite(&((List*) AS_OBJ(list))->elements, vm, elem);
+      listAppend(vm, ((List*) AS_OBJ(list)), elem);
       DROP(); // elem
       DISPATCH();
     }
@@ -1111,12 +1261,14 @@ L_vm_main_loop:
         OPCODE(PUSH_LOCAL_5) :
         OPCODE(PUSH_LOCAL_6) : OPCODE(PUSH_LOCAL_7) : OPCODE(PUSH_LOCAL_8) : {
       int index = (int) (instruction - OP_PUSH_LOCAL_0);
-      PUSH(rbp[index + 1]); // +1: rbp[0] is return value.
+      VAR_FREEZE(rbp[index + 1]); // +1: rbp[0] is return value.
+      PUSH(rbp[index + 1]);
       DISPATCH();
     }
     OPCODE(PUSH_LOCAL_N) : {
       uint8_t index = READ_BYTE();
-      PUSH(rbp[index + 1]); // +1: rbp[0] is return value.
+      VAR_FREEZE(rbp[index + 1]); // +1: rbp[0] is return value.
+      PUSH(rbp[index + 1]);
       DISPATCH();
     }
 
@@ -1141,6 +1293,7 @@ L_vm_main_loop:
     OPCODE(PUSH_GLOBAL) : {
       uint8_t index = READ_BYTE();
       ASSERT_INDEX(index, module->globals.count);
+      VAR_FREEZE(module->globals.data[index]);
       PUSH(module->globals.data[index]);
       DISPATCH();
     }
@@ -1152,6 +1305,31 @@ L_vm_main_loop:
       DISPATCH();
     }
 
+    OPCODE(PUSH_LOCAL_BLDR) : {
+      uint8_t index = READ_BYTE();
+      PUSH(rbp[index + 1]); // +1: rbp[0] is return value.
+      DISPATCH();
+    }
+
+    OPCODE(PUSH_GLOBAL_BLDR) : {
+      uint8_t index = READ_BYTE();
+      ASSERT_INDEX(index, module->globals.count);
+      Var value = module->globals.data[index];
+
+      // Unlike a local, a function called by the right hand side can append
+      // to the same global. Then the builder is frozen so that append won't
+      // change this pending left operand (ADD clears the flag).
+      if (IS_OBJ_TYPE(value, OBJ_STRING)) {
+        String* str = (String*) AS_OBJ(value);
+        if (str->is_appending)
+          VAR_FREEZE(value);
+        else if (str->is_builder)
+          str->is_appending = true;
+      }
+      PUSH(value);
+      DISPATCH();
+    }
+
     OPCODE(PUSH_BUILTIN_FN) : {
       uint8_t index = READ_BYTE();
       ASSERT_INDEX(index, vm->builtins_count);
@@ -1170,6 +1348,7 @@ L_vm_main_loop:
 
     OPCODE(PUSH_UPVALUE) : {
       uint8_t index = READ_BYTE();
+      VAR_FREEZE(*(frame->closure->upvalues[index]->ptr));
       PUSH(*(frame->closure->upvalues[index]->ptr));
       DISPATCH();
     }
@@ -1347,6 +1526,7 @@ L_vm_main_loop:
           // Re-fetch the global value from the module's globals buffer
           // Note: The index in 'globals' matches the index in 'global_names' (j)
           Var value = imported->globals.data[j];
+          VAR_FREEZE(value);
           moduleSetGlobal(vm, module, name->data, name->length, value);
         }
       }
@@ -1435,6 +1615,8 @@ L_vm_main_loop:
       // class citizens.
       ASSERT(!IS_OBJ_TYPE(callable, OBJ_FUNC), OOPS);
 
+      PROFILER_TICK();
+
       *(fiber->ret) = VAR_NULL; //< Set the return value to null.
 
       if (IS_OBJ_TYPE(callable, OBJ_CLOSURE)) {
@@ -1608,6 +1790,7 @@ L_vm_main_loop:
 
     OPCODE(LOOP) : {
       uint16_t offset = READ_SHORT();
+      PROFILER_TICK();
       ip -= offset;
       DISPATCH();
     }
@@ -1807,8 +1990,16 @@ L_vm_main_loop:
       // Don't pop yet, we need the reference for gc.
       Var r = PEEK(-1), l = PEEK(-2);
       uint8_t inplace = READ_BYTE();
-      ASSERT(inplace <= 1, OOPS);
-      Var result = varAdd(vm, l, r, inplace);
+      ASSERT(inplace <= 2, OOPS);
+      Var result;
+      if (inplace == 2 && IS_OBJ_TYPE(l, OBJ_STRING)) {
+        ((String*) AS_OBJ(l))->is_appending = false;
+      }
+      if (inplace == 2 && IS_OBJ_TYPE(l, OBJ_STRING) && IS_OBJ_TYPE(r, OBJ_STRING)) {
+        result = VAR_OBJ(stringAppend(vm, (String*) AS_OBJ(l), (String*) AS_OBJ(r)));
+      } else {
+        result = varAdd(vm, l, r, inplace != 0);
+      }
       DROP();
       DROP(); // r, l
       PUSH(result);
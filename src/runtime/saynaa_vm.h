@@ -6,6 +6,7 @@
 #pragma once
 
 #include "../compiler/saynaa_compiler.h"
+#include "../utils/saynaa_profiler.h"
 #include "saynaa_core.h"
 
 #ifdef __cplusplus
@@ -31,6 +32,9 @@ struct Handle {
   Handle* next;
 };
 
+// Defined by the optional re module.
+typedef struct RegexContext RegexContext;
+
 //  Virtual Machine. It'll contain the state of the execution, stack,
 // heap, and manage memory allocations.
 struct VM {
@@ -54,6 +58,13 @@ struct VM {
   // allocated so far plus the fill factor of it.
   int heap_fill_percent;
 
+  // If not zero, a runtime error is raised when the live bytes after a garbage
+  // collection exceed this limit.
+  size_t max_heap_size;
+
+  // Garbage collector statistics.
+  GCStats gc_stats;
+
   // In the tri coloring scheme gray is the working list. We recursively pop
   // from the list color it black and add it's referenced objects to gray_list.
 
@@ -65,6 +76,13 @@ struct VM {
   int working_set_count;
   int working_set_capacity;
 
+  // The string views marked in the current garbage collection. Their parents
+  // are marked once all the other reachable objects are marked, see
+  // markStringViews().
+  String** views;
+  int views_count;
+  int views_capacity;
+
   // A stack of temporary object references to ensure that the object
   // doesn't garbage collected.
   Object* temp_reference[MAX_TEMP_REFERENCE];
@@ -110,6 +128,21 @@ struct VM {
 
   // Current fiber.
   Fiber* fiber;
+
+  // The sampling profiler, NULL if the profiler isn't running.
+  Profiler* profiler;
+
+  // The allocation tracker, NULL if the allocations aren't tracked.
+  MemTracker* memtrack;
+
+  // The state of the re module (the compiled pattern cache and the shared
+  // match data, see saynaa_opt_re.c), NULL if the module isn't registered.
+  RegexContext* regex;
+
+#if OPCODE_STATS
+  // Opcode execution statistics.
+  OpcodeStats* opstats;
+#endif
 };
 
 // A realloc() function wrapper which handles memory allocations of the VM.
@@ -220,6 +253,17 @@ Result vmCallFunction(VM* vm, Closure* fn, int argc, Var* argv, Var* ret);
 // arguments in an array.
 Result vmCallMethod(VM* vm, Var thiz, Closure* fn, int argc, Var* argv, Var* ret);
 
+// Create a fiber to call the closure [fn] many times from a native function
+// with vmCallFiber(). It's cheaper than vmCallFunction() for each call since
+// the fiber, its stack and call frames are allocated only once. The fiber
+// should be kept alive with vmPushTempRef() while it's used.
+Fiber* vmNewCallFiber(VM* vm, Closure* fn);
+
+// Call the closure of the [fiber] created by vmNewCallFiber() with the
+// arguments and if the [ret] is not NULL, the return value will be set. If
+// the call fails the fiber shouldn't be called again.
+Result vmCallFiber(VM* vm, Fiber* fiber, int argc, Var* argv, Var* ret);
+
 // Import a module with the [path] and return it. The path sepearation should
 // be '/' example: to import module "a.b" the [path] should be "a/b".
 // If the [from] is not NULL, it'll be used for relative path search.
@@ -88,6 +88,14 @@
 // Dump the stack values and the globals.
 #define DUMP_STACK 0
 
+// Set this to count the executed instructions per opcode, opcode pair and
+// function with their cycle timings (see saynaa_profiler.h). It's a compile
+// time option (make OPSTATS=enable) since counting every single instruction
+// isn't free, when it's 0 the interpreter loop is not touched at all.
+#ifndef OPCODE_STATS
+#define OPCODE_STATS 0
+#endif
+
 // Nan-Tagging could be disable for debugging/portability purposes. See "var.h"
 // header for more information on Nan-tagging.
 #define VAR_NAN_TAGGING 1
@@ -136,14 +144,34 @@
 // allocated so far plus the fill factor of it.
 #define HEAP_FILL_PERCENT 75
 
-// Here we're switching the FNV-1a hash value of the name (cstring). Which is
+// The number of the last garbage collections kept in the heap growth history
+// of the GC statistics.
+#define GC_HISTORY_SIZE 32
+
+// Substrings (slice, split, strip etc) shorter than this are copied instead of
+// referencing their parent string (see newStringView()), since the copy is
+// about the size of a view.
+#define STRING_VIEW_MIN_LENGTH 32
+
+// If a string is only referenced by its views and the views together are less
+// than 1/STRING_VIEW_PIN_RATIO of its length, the garbage collector copies
+// the views and frees the string. So small views won't keep a huge string
+// alive.
+#define STRING_VIEW_PIN_RATIO 4
+
+// The default number of LOOP and CALL instructions the VM executes between two
+// samples of the profiler. Smaller values give more precise profiles at the
+// cost of more overhead.
+#define PROFILER_SAMPLE_INTERVAL 1000
+
+// Here we're switching the hash value of the name (cstring). Which is
 // an efficient way than having multiple if (attrib == "name"). From O(n) * k
 // to O(1) where n is the length of the string and k is the number of string
 // comparison.
 //
 // ex:
-//     switch (attrib->hash) { // str = "length"
-//       case CHECK_HASH("length", 0x83d03615) : { return string->length; }
+//     switch (STRING_HASH(attrib)) { // str = "length"
+//       case CHECK_HASH("length", 0x1ede0aa3) : { return string->length; }
 //     }
 //
 #define CHECK_HASH(name, hash) hash
@@ -90,6 +90,14 @@ OPCODE(PUSH_GLOBAL, 1, 1)
 // params: 1 byte index.
 OPCODE(STORE_GLOBAL, 1, 0)
 
+// Same as PUSH_LOCAL_N and PUSH_GLOBAL but if the value is a string builder
+// it won't be frozen, used by the `name += expr` statement to append to the
+// builder in place (see stringAppend()). A global builder which is already
+// the left operand of a pending `+=` is frozen.
+// params: 1 byte index.
+OPCODE(PUSH_LOCAL_BLDR, 1, 1)
+OPCODE(PUSH_GLOBAL_BLDR, 1, 1)
+
 // Push a built in function.
 // params: 1 bytes index.
 OPCODE(PUSH_BUILTIN_FN, 1, 1)
@@ -243,7 +251,8 @@ OPCODE(NOT, 0, 0)      //< boolean not.
 OPCODE(BIT_NOT, 0, 0)  //< bitwise not.
 
 // Pop binary operands and push value.
-// for parameter 1 byte is boolean inplace?.
+// for parameter 1 byte is boolean inplace?. ADD could also be 2 which means
+// the `name += expr` statement of a local or global string (see above).
 OPCODE(ADD, 1, -1)
 OPCODE(SUBTRACT, 1, -1)
 OPCODE(MULTIPLY, 1, -1)
@@ -6,6 +6,7 @@
 #include "saynaa_value.h"
 
 #include "../runtime/saynaa_vm.h"
+#include "../utils/saynaa_simd.h"
 #include "../utils/saynaa_utils.h"
 
 #include <ctype.h>
@@ -64,6 +65,9 @@ void varInitObject(Object* thiz, VM* vm, ObjectType type) {
   thiz->is_marked = false;
   thiz->next = vm->first;
   vm->first = thiz;
+
+  if (vm->memtrack != NULL)
+    memtrackObject(vm, type);
 }
 
 void markObject(VM* vm, Object* thiz) {
@@ -118,8 +122,32 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
   switch (obj->type) {
     case OBJ_STRING:
       {
+        String* str = (String*) obj;
         vm->bytes_allocated += sizeof(String);
-        vm->bytes_allocated += ((size_t) ((String*) obj)->capacity);
+        vm->bytes_allocated += ((size_t) str->capacity);
+        if (str->is_external)
+          vm->bytes_allocated += sizeof(String*);
+
+        // The parents of the views are marked after everything else, see
+        // markStringViews().
+        if (STRING_PARENT(str) != NULL) {
+          if (vm->views_count >= vm->views_capacity) {
+            int capacity = (vm->views_capacity == 0) ? MIN_CAPACITY
+                                                     : vm->views_capacity * 2;
+            String** views = (String**) vm->config.realloc_fn(
+                vm->views, capacity * sizeof(String*), vm->config.user_data);
+
+            // If the view can't be recorded, its parent is kept alive as is
+            // since it won't be materialized.
+            if (views == NULL) {
+              markObject(vm, &STRING_PARENT(str)->_super);
+              break;
+            }
+            vm->views = views;
+            vm->views_capacity = capacity;
+          }
+          vm->views[vm->views_count++] = str;
+        }
       }
       break;
 
@@ -146,6 +174,42 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
       }
       break;
 
+    case OBJ_SET:
+      {
+        Set* set = (Set*) obj;
+        for (uint32_t i = 0; i < set->capacity; i++) {
+          if (SET_ENTRY_USED(set->entries[i]))
+            markValue(vm, set->entries[i]);
+        }
+        vm->bytes_allocated += sizeof(Set);
+        vm->bytes_allocated += sizeof(Var) * set->capacity;
+      }
+      break;
+
+    case OBJ_DEQUE:
+      {
+        Deque* deque = (Deque*) obj;
+        for (uint32_t i = 0; i < deque->count; i++) {
+          markValue(vm, DEQUE_AT(deque, i));
+        }
+        vm->bytes_allocated += sizeof(Deque);
+        vm->bytes_allocated += sizeof(Var) * deque->capacity;
+      }
+      break;
+
+    case OBJ_HEAP:
+      {
+        Heap* heap = (Heap*) obj;
+        markVarBuffer(vm, &heap->items);
+        markVarBuffer(vm, &heap->keys);
+        if (heap->key != NULL)
+          markObject(vm, &heap->key->_super);
+        vm->bytes_allocated += sizeof(Heap);
+        vm->bytes_allocated += sizeof(Var) * heap->items.capacity;
+        vm->bytes_allocated += sizeof(Var) * heap->keys.capacity;
+      }
+      break;
+
     case OBJ_RANGE:
       {
         vm->bytes_allocated += sizeof(Range);
@@ -235,9 +299,11 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
 
         markObject(vm, &fiber->closure->_super);
 
-        // Mark the stack.
+        // Mark the stack. The views on the stack could be in use by a native
+        // function, so they won't be materialized by markStringViews().
         for (Var* local = fiber->stack; local < fiber->sp; local++) {
           markValue(vm, *local);
+          MARK_VIEW_ROOTED(*local);
         }
         vm->bytes_allocated += sizeof(Var) * fiber->stack_size;
 
@@ -245,6 +311,7 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
         for (int i = 0; i < fiber->frame_count; i++) {
           markObject(vm, (Object*) &fiber->frames[i].closure->_super);
           markValue(vm, fiber->frames[i].thiz);
+          MARK_VIEW_ROOTED(fiber->frames[i].thiz);
         }
         vm->bytes_allocated += sizeof(CallFrame) * fiber->frame_capacity;
 
@@ -253,6 +320,7 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
         markObject(vm, &fiber->error->_super);
 
         markValue(vm, fiber->thiz);
+        MARK_VIEW_ROOTED(fiber->thiz);
       }
       break;
 
@@ -263,7 +331,13 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
         markObject(vm, &cls->owner->_super);
         markObject(vm, &cls->name->_super);
         markObject(vm, &cls->static_attribs->_super);
-        // don't need to mark magic_methods, they are all in cls->methods.
+        // The magic methods of the script classes are all in cls->methods
+        // but the constructors of the builtin classes are only referenced
+        // from here, (Closure*) -1 means it's not looked up yet.
+        for (int i = 0; i < MAX_MAGIC_METHODS; i++) {
+          if (cls->magic_methods[i] != (Closure*) -1)
+            markObject(vm, (Object*) cls->magic_methods[i]);
+        }
 
         markClosureBuffer(vm, &cls->methods);
         vm->bytes_allocated += sizeof(Closure) * cls->methods.capacity;
@@ -282,12 +356,94 @@ static void popMarkedObjectsInternal(Object* obj, VM* vm) {
 }
 
 void popMarkedObjects(VM* vm) {
+  MemTracker* mt = vm->memtrack;
   while (vm->working_set_count > 0) {
     Object* marked_obj = vm->working_set[--vm->working_set_count];
+
+    // Recount the live bytes of each type for the allocation tracker.
+    if (mt != NULL) {
+      size_t bytes = vm->bytes_allocated;
+      popMarkedObjectsInternal(marked_obj, vm);
+      mt->live_bytes[marked_obj->type] += vm->bytes_allocated - bytes;
+      continue;
+    }
+
     popMarkedObjectsInternal(marked_obj, vm);
   }
 }
 
+static int _compareViewParents(const void* a, const void* b) {
+  const String* p1 = STRING_PARENT(*(const String**) a);
+  const String* p2 = STRING_PARENT(*(const String**) b);
+  return (p1 < p2) ? -1 : (p1 > p2) ? 1 : 0;
+}
+
+// Copy the characters of the view [str] while garbage collecting. The buffer
+// is allocated with the host allocator since vmRealloc() cannot be called
+// here, and counted to the live bytes of the VM. Returns false if the
+// allocation failed.
+static bool _materializeViewGC(VM* vm, String* str) {
+  char* buff = (char*) vm->config.realloc_fn(NULL, str->length + 1, vm->config.user_data);
+  if (buff == NULL)
+    return false;
+
+  memcpy(buff, str->data, str->length);
+  buff[str->length] = '\0';
+  str->data = buff;
+  *(String**) str->chars = NULL;
+  str->capacity = str->length + 1;
+
+  vm->bytes_allocated += str->capacity;
+  if (vm->memtrack != NULL)
+    vm->memtrack->live_bytes[OBJ_STRING] += str->capacity;
+  return true;
+}
+
+void markStringViews(VM* vm) {
+  if (vm->views_count == 0)
+    return;
+
+  // Group the views by their parents.
+  qsort(vm->views, vm->views_count, sizeof(String*), _compareViewParents);
+
+  int start = 0;
+  while (start < vm->views_count) {
+    String* parent = STRING_PARENT(vm->views[start]);
+
+    int end = start;
+    bool rooted = false;
+    uint64_t length = 0;
+    while (end < vm->views_count && STRING_PARENT(vm->views[end]) == parent) {
+      rooted = rooted || vm->views[end]->is_rooted;
+      length += vm->views[end]->length;
+      end++;
+    }
+
+    // If the parent is only reachable through small views, which aren't used
+    // by a native function, copy them and let the parent die. The parent is
+    // still marked this time, since a native may have a pointer to its
+    // characters, and it'll be freed at the next garbage collection.
+    if (!parent->_super.is_marked && !rooted
+        && length * STRING_VIEW_PIN_RATIO < parent->length) {
+      for (int i = start; i < end; i++) {
+        if (!_materializeViewGC(vm, vm->views[i]))
+          break;
+      }
+    }
+
+    markObject(vm, &parent->_super);
+    start = end;
+  }
+
+  for (int i = 0; i < vm->views_count; i++) {
+    vm->views[i]->is_rooted = false;
+  }
+  vm->views_count = 0;
+
+  // The parents aren't views, they don't reference other objects.
+  popMarkedObjects(vm);
+}
+
 Var doubleToVar(double value) {
 #if VAR_NAN_TAGGING
   return utilDoubleToBits(value);
@@ -307,20 +463,24 @@ double varToDouble(Var value) {
 static String* _allocateString(VM* vm, size_t length) {
   String* string = ALLOCATE_DYNAMIC(vm, String, length + 1, char);
   varInitObject(&string->_super, vm, OBJ_STRING);
+  string->hash = 0;
   string->length = (uint32_t) length;
+  string->data = string->chars;
   string->data[length] = '\0';
   string->capacity = (uint32_t) (length + 1);
+  string->is_builder = false;
+  string->is_appending = false;
+  string->is_rooted = false;
+  string->is_external = false;
   return string;
 }
 
 String* newStringLength(VM* vm, const char* text, uint32_t length) {
-  ASSERT(length == 0 || text != NULL, "Unexpected NULL string.");
-
   String* string = _allocateString(vm, length);
 
-  if (length != 0 && text != NULL)
+  // If the [text] is NULL the caller will fill the characters.
+  if (text != NULL && length != 0)
     memcpy(string->data, text, length);
-  string->hash = utilHashString(string->data);
 
   return string;
 }
@@ -333,15 +493,44 @@ String* newStringVaArgs(VM* vm, const char* fmt, va_list args) {
 
   String* string = _allocateString(vm, (size_t) length);
   vsnprintf(string->data, string->capacity, fmt, args);
-  string->hash = utilHashString(string->data);
 
   return string;
 }
 
+String* newStringView(VM* vm, String* str, uint32_t offset, uint32_t length) {
+  ASSERT((uint64_t) offset + length <= str->length, OOPS);
+
+  if (offset == 0 && length == str->length)
+    return str;
+
+  if (length < STRING_VIEW_MIN_LENGTH)
+    return newStringLength(vm, str->data + offset, length);
+
+  String* view = ALLOCATE_DYNAMIC(vm, String, 1, String*);
+  varInitObject(&view->_super, vm, OBJ_STRING);
+
+  // The [str] could be materialized by the above allocation, so the data
+  // pointer is only taken after it. A view of a view references the same
+  // parent, so the parents never have a parent.
+  String* parent = STRING_PARENT(str);
+  view->data = str->data + offset;
+  *(String**) view->chars = (parent != NULL) ? parent : str;
+  view->length = length;
+  view->capacity = 0;
+  view->is_builder = false;
+  view->is_appending = false;
+  view->is_rooted = false;
+  view->is_external = true;
+  view->hash = 0;
+
+  return view;
+}
+
 List* newList(VM* vm, uint32_t size) {
   List* list = ALLOCATE(vm, List);
   vmPushTempRef(vm, &list->_super); // list.
   varInitObject(&list->_super, vm, OBJ_LIST);
+  list->kind = LIST_NUMBERS;
   VarBufferInit(&list->elements);
   if (size > 0) {
     VarBufferFill(&list->elements, vm, VAR_NULL, size);
@@ -360,6 +549,60 @@ Map* newMap(VM* vm) {
   return map;
 }
 
+Set* newSet(VM* vm, uint32_t size) {
+  Set* set = ALLOCATE(vm, Set);
+  varInitObject(&set->_super, vm, OBJ_SET);
+  set->capacity = 0;
+  set->count = 0;
+  set->entries = NULL;
+
+  if (size > 0) {
+    // The capacity that [size] keys won't exceed the load factor.
+    uint32_t capacity = (uint32_t) ((uint64_t) size * 100 / MAP_LOAD_PERCENT) + 1;
+    if (capacity < MIN_CAPACITY)
+      capacity = MIN_CAPACITY;
+
+    vmPushTempRef(vm, &set->_super); // set.
+    set->entries = ALLOCATE_ARRAY(vm, Var, capacity);
+    set->capacity = capacity;
+    for (uint32_t i = 0; i < capacity; i++)
+      set->entries[i] = VAR_UNDEFINED;
+    vmPopTempRef(vm); // set.
+  }
+  return set;
+}
+
+Deque* newDeque(VM* vm, uint32_t size) {
+  Deque* deque = ALLOCATE(vm, Deque);
+  varInitObject(&deque->_super, vm, OBJ_DEQUE);
+  deque->capacity = 0;
+  deque->head = 0;
+  deque->count = 0;
+  deque->data = NULL;
+
+  if (size > 0) {
+    uint32_t capacity = utilPowerOf2Ceil((int) size);
+    if (capacity < MIN_CAPACITY)
+      capacity = MIN_CAPACITY;
+
+    vmPushTempRef(vm, &deque->_super); // deque.
+    deque->data = ALLOCATE_ARRAY(vm, Var, capacity);
+    deque->capacity = capacity;
+    vmPopTempRef(vm); // deque.
+  }
+  return deque;
+}
+
+Heap* newHeap(VM* vm, Closure* key, bool reverse) {
+  Heap* heap = ALLOCATE(vm, Heap);
+  varInitObject(&heap->_super, vm, OBJ_HEAP);
+  VarBufferInit(&heap->items);
+  VarBufferInit(&heap->keys);
+  heap->key = key;
+  heap->reverse = reverse;
+  return heap;
+}
+
 Range* newRange(VM* vm, double from, double to) {
   Range* range = ALLOCATE(vm, Range);
   varInitObject(&range->_super, vm, OBJ_RANGE);
@@ -416,6 +659,9 @@ Function* newFunction(VM* vm, const char* name, int length, Module* owner,
       ByteBufferInit(&fn->opcodes);
       UintBufferInit(&fn->oplines);
       fn->stack_size = 0;
+#if OPCODE_STATS
+      fn->stats_index = -1;
+#endif
       func->fn = fn;
     }
   }
@@ -648,46 +894,28 @@ double rangeLength(VM* vm, Range* thiz) {
 
 String* stringLower(VM* vm, String* thiz) {
   // If the string itself is already lower, don't allocate new string.
-  uint32_t index = 0;
-  for (const char* c = thiz->data; *c != '\0'; c++, index++) {
-    if (isupper(*c)) {
-      // It contain upper case letters, allocate new lower case string .
-      String* lower = newStringLength(vm, thiz->data, thiz->length);
-
-      // Start where the first upper case letter found.
-      char* _c = lower->data + (c - thiz->data);
-      for (; *_c != '\0'; _c++)
-        *_c = (char) tolower(*_c);
-
-      // Since the string is modified re-hash it.
-      lower->hash = utilHashString(lower->data);
-      return lower;
-    }
-  }
-  // If we reached here the string itself is lower, return it.
-  return thiz;
+  size_t index = simdFindCase(thiz->data, thiz->length, true);
+  if (index == thiz->length)
+    return thiz;
+
+  // It contain upper case letters, allocate new lower case string and
+  // convert it from where the first upper case letter found.
+  String* lower = newStringLength(vm, thiz->data, thiz->length);
+  simdConvertCase(lower->data + index, lower->length - index, false);
+  return lower;
 }
 
 String* stringUpper(VM* vm, String* thiz) {
   // If the string itself is already upper don't allocate new string.
-  uint32_t index = 0;
-  for (const char* c = thiz->data; *c != '\0'; c++, index++) {
-    if (islower(*c)) {
-      // It contain lower case letters, allocate new upper case string .
-      String* upper = newStringLength(vm, thiz->data, thiz->length);
-
-      // Start where the first lower case letter found.
-      char* _c = upper->data + (c - thiz->data);
-      for (; *_c != '\0'; _c++)
-        *_c = (char) toupper(*_c);
-
-      // Since the string is modified re-hash it.
-      upper->hash = utilHashString(upper->data);
-      return upper;
-    }
-  }
-  // If we reached here the string itself is lower, return it.
-  return thiz;
+  size_t index = simdFindCase(thiz->data, thiz->length, false);
+  if (index == thiz->length)
+    return thiz;
+
+  // It contain lower case letters, allocate new upper case string and
+  // convert it from where the first lower case letter found.
+  String* upper = newStringLength(vm, thiz->data, thiz->length);
+  simdConvertCase(upper->data + index, upper->length - index, true);
+  return upper;
 }
 
 String* stringStrip(VM* vm, String* thiz) {
@@ -696,48 +924,26 @@ String* stringStrip(VM* vm, String* thiz) {
   // "     a string with leading and trailing white space    "
   //  ^start >>                                       << end^
   //
-  // These 'start' and 'end' pointers will move respectively right and left
-  // while it's a white space and return an allocated string from 'start' with
-  // length of (end - start + 1). For already trimmed string it'll not
+  // These 'start' and 'end' indexes will move respectively right and left
+  // while it's a white space and return a view of the string from 'start'
+  // with length of (end - start). For already trimmed string it'll not
   // allocate a new string, instead returns the same string provided.
 
-  const char* start = thiz->data;
-  while (*start && isspace(*start))
+  uint32_t start = 0, end = thiz->length;
+  while (start < end && isspace(thiz->data[start]))
     start++;
 
   // If we reached the end of the string, it's all white space, return
   // an empty string.
-  if (*start == '\0') {
+  if (start == end) {
     return newStringLength(vm, NULL, 0);
   }
 
-  const char* end = thiz->data + thiz->length - 1;
-  while (isspace(*end))
+  while (isspace(thiz->data[end - 1]))
     end--;
 
-  // If the string is already trimmed, return the same string.
-  if (start == thiz->data && end == thiz->data + thiz->length - 1) {
-    return thiz;
-  }
-
-  return newStringLength(vm, start, (uint32_t) (end - start + 1));
-}
-
-static const char* _memFind(const char* haystack, uint32_t haystack_len,
-                            const char* needle, uint32_t needle_len) {
-  if (needle_len == 0)
-    return haystack;
-  if (haystack_len < needle_len)
-    return NULL;
-
-  const char* end = haystack + haystack_len - needle_len;
-  for (const char* p = haystack; p <= end; p++) {
-    if (*p == *needle) {
-      if (memcmp(p, needle, needle_len) == 0)
-        return p;
-    }
-  }
-  return NULL;
+  // If the string is already trimmed, newStringView() returns the same string.
+  return newStringView(vm, thiz, start, end - start);
 }
 
 String* stringReplace(VM* vm, String* thiz, String* old, String* new_, int32_t count) {
@@ -788,14 +994,14 @@ String* stringReplace(VM* vm, String* thiz, String* old, String* new_, int32_t c
       break;
 
     uint32_t remaining = thiz->length - (uint32_t) (s - thiz->data);
-    const char* match = _memFind(s, remaining, old->data, old->length);
+    const char* match = simdMemMem(s, remaining, old->data, old->length);
     if (match == NULL)
       break;
 
     // Note that since we're not allocating anything else here, this string
     // doesn't needs to pushed to VM's temp references.
     if (replacedc == 0) {
-      replaced = newStringLength(vm, "", length);
+      replaced = newStringLength(vm, NULL, length);
       d = replaced->data;
     }
 
@@ -822,7 +1028,6 @@ String* stringReplace(VM* vm, String* thiz, String* old, String* new_, int32_t c
     replaced->length = (int32_t) (d - replaced->data);
     ASSERT(replaced->length < replaced->capacity, OOPS);
     replaced->data[replaced->length] = '\0';
-    replaced->hash = utilHashString(replaced->data);
 
   } else {
     ASSERT(thiz == replaced, OOPS);
@@ -831,33 +1036,6 @@ String* stringReplace(VM* vm, String* thiz, String* old, String* new_, int32_t c
   return replaced;
 }
 
-void* _memmem(const void* l, size_t l_len, const void* s, size_t s_len) {
-  register char *cur, *last;
-  const char* cl = (const char*) l;
-  const char* cs = (const char*) s;
-
-  /* we need something to compare */
-  if (l_len == 0 || s_len == 0)
-    return NULL;
-
-  /* "s" must be smaller or equal to "l" */
-  if (l_len < s_len)
-    return NULL;
-
-  /* special case where s_len == 1 */
-  if (s_len == 1)
-    return (void*) memchr(l, (int) *cs, l_len);
-
-  /* the last position where its possible to find "s" in "l" */
-  last = (char*) cl + l_len - s_len;
-
-  for (cur = (char*) cl; cur <= last; cur++)
-    if (cur[0] == cs[0] && memcmp(cur, cs, s_len) == 0)
-      return cur;
-
-  return NULL;
-}
-
 List* stringSplit(VM* vm, String* thiz, String* sep) {
   List* list = newList(vm, 0);
   vmPushTempRef(vm, &list->_super); // list.
@@ -870,33 +1048,25 @@ List* stringSplit(VM* vm, String* thiz, String* sep) {
       vmPopTempRef(vm); // ch
     }
   } else {
-    const char* s = thiz->data; // Current position in thiz.
+    // Current position in thiz. It's an index since the data of thiz could
+    // change if it's a view and get materialized by the garbage collector.
+    uint32_t pos = 0;
     do {
-      const char* match = (char*) _memmem(s, thiz->length - (s - thiz->data),
-                                          sep->data, sep->length);
-
-      if (match == NULL) {
-        // Add the tail string from [s] till the end. Optimize case: if
-        // the string doesn't have any match we can reuse thiz.
-        if (s == thiz->data) {
-          listAppend(vm, list, VAR_OBJ(thiz));
-
-        } else {
-          String* tail = newStringLength(vm, s, (uint32_t) (thiz->length - (s - thiz->data)));
-          vmPushTempRef(vm, &tail->_super); // tail.
-          listAppend(vm, list, VAR_OBJ(tail));
-          vmPopTempRef(vm); // tail.
-        }
+      const char* match =
+          simdMemMem(thiz->data + pos, thiz->length - pos, sep->data, sep->length);
 
-        break; // We're done.
-      }
-
-      String* split = newStringLength(vm, s, (uint32_t) (match - s));
+      // Add the tail string from [pos] till the end. If the string doesn't
+      // have any match newStringView() returns thiz.
+      uint32_t end = (match == NULL) ? thiz->length : (uint32_t) (match - thiz->data);
+      String* split = newStringView(vm, thiz, pos, end - pos);
       vmPushTempRef(vm, &split->_super); // split.
       listAppend(vm, list, VAR_OBJ(split));
       vmPopTempRef(vm); // split.
 
-      s = match + sep->length;
+      if (match == NULL)
+        break; // We're done.
+
+      pos = end + sep->length;
 
     } while (true);
   }
@@ -960,7 +1130,6 @@ String* stringFormat(VM* vm, const char* fmt, ...) {
   }
   va_end(arg_list);
 
-  result->hash = utilHashString(result->data);
   return result;
 }
 
@@ -978,13 +1147,87 @@ String* stringJoin(VM* vm, String* str1, String* str2) {
   memcpy(string->data + str1->length, str2->data, str2->length);
   // Null byte already existed. From _allocateString.
 
-  string->hash = utilHashString(string->data);
   return string;
 }
 
+String* stringAppend(VM* vm, String* thiz, String* str) {
+  if (str->length == 0)
+    return thiz;
+
+  size_t length = (size_t) thiz->length + (size_t) str->length;
+  if (thiz->is_builder && length < thiz->capacity) {
+    memcpy(thiz->data + thiz->length, str->data, str->length);
+    thiz->length = (uint32_t) length;
+    thiz->data[length] = '\0';
+    return thiz;
+  }
+
+  // The object cannot be reallocated since it's in the VM's linked list of
+  // objects, so a new builder is allocated and the old one will be garbage
+  // collected.
+  size_t capacity = length * 2 + 1;
+  if (capacity > UINT32_MAX)
+    capacity = length + 1;
+
+  String* builder = ALLOCATE_DYNAMIC(vm, String, capacity, char);
+  varInitObject(&builder->_super, vm, OBJ_STRING);
+  builder->hash = 0;
+  builder->length = (uint32_t) length;
+  builder->capacity = (uint32_t) capacity;
+  builder->is_builder = true;
+  builder->is_appending = false;
+  builder->is_rooted = false;
+  builder->is_external = false;
+  builder->data = builder->chars;
+
+  memcpy(builder->data, thiz->data, thiz->length);
+  memcpy(builder->data + thiz->length, str->data, str->length);
+  builder->data[length] = '\0';
+
+  return builder;
+}
+
+void stringMaterialize(VM* vm, String* thiz) {
+  if (STRING_PARENT(thiz) == NULL)
+    return;
+
+  vmPushTempRef(vm, &thiz->_super); // thiz.
+  char* buff = ALLOCATE_ARRAY(vm, char, thiz->length + 1);
+  vmPopTempRef(vm); // thiz.
+
+  // The garbage collection triggered by the above allocation could have
+  // materialized it already.
+  if (STRING_PARENT(thiz) == NULL) {
+    DEALLOCATE_ARRAY(vm, buff, char, thiz->length + 1);
+    return;
+  }
+
+  memcpy(buff, thiz->data, thiz->length);
+  buff[thiz->length] = '\0';
+  thiz->data = buff;
+  *(String**) thiz->chars = NULL;
+  thiz->capacity = thiz->length + 1;
+}
+
+void stringFreeze(String* thiz) {
+  ASSERT(thiz->is_builder && thiz->hash == 0, OOPS);
+  thiz->is_builder = false;
+}
+
+uint32_t stringHash(String* thiz) {
+  ASSERT(!thiz->is_builder, "A string builder shouldn't be hashed.");
+  thiz->hash = utilHashString(thiz->data, thiz->length);
+  return thiz->hash;
+}
+
 String* replaceSubstring(VM* vm, uint32_t index, String* str, String* replace) {
+  // Don't modify the parent of a view.
+  stringMaterialize(vm, str);
   char* stringValue = str->data;
   strncpy(stringValue + index, replace->data, replace->length);
+
+  // Since the string is modified re-hash it once needed.
+  str->hash = 0;
   return str;
 }
 
@@ -1002,6 +1245,7 @@ void listInsert(VM* vm, List* thiz, uint32_t index, Var value) {
   }
 
   // Insert the new element.
+  LIST_TRACK_KIND(thiz, value);
   thiz->elements.data[index] = value;
 }
 
@@ -1037,6 +1281,7 @@ Var listRemoveAt(VM* vm, List* thiz, uint32_t index) {
 
 void listClear(VM* vm, List* thiz) {
   VarBufferClear(&thiz->elements, vm);
+  thiz->kind = LIST_NUMBERS;
 }
 
 List* listAdd(VM* vm, List* l1, List* l2) {
@@ -1050,6 +1295,7 @@ List* listAdd(VM* vm, List* l1, List* l2) {
   List* list = newList(vm, size);
 
   vmPushTempRef(vm, &list->_super); // list.
+  list->kind = l1->kind | l2->kind;
   VarBufferConcat(&list->elements, vm, &l1->elements);
   VarBufferConcat(&list->elements, vm, &l2->elements);
   vmPopTempRef(vm); // list.
@@ -1065,7 +1311,7 @@ static uint32_t _hashObject(Object* obj) {
 
   switch (obj->type) {
     case OBJ_STRING:
-      return ((String*) obj)->hash;
+      return STRING_HASH((String*) obj);
 
     case OBJ_RANGE:
       {
@@ -1114,60 +1360,105 @@ uint32_t varHashValue(Var v) {
 #endif
 }
 
-// Find the entry with the [key]. Returns true if found and set [result] to
-// point to the entry, return false otherwise and points [result] to where
-// the entry should be inserted.
-static bool _mapFindEntry(Map* thiz, Var key, MapEntry** result) {
-  // An empty map won't contain the key.
-  if (thiz->capacity == 0)
-    return false;
-
-  // The [start_index] is where the entry supposed to be if there wasn't any
-  // collision occurred. It'll be the start index for the linear probing.
-  uint32_t start_index = varHashValue(key) % thiz->capacity;
-  uint32_t index = start_index;
-
-  // Keep track of the first tombstone after the [start_index] if we don't
-  // find the key anywhere. The tombstone would be the entry at where we will
-  // have to insert the key/value pair.
-  MapEntry* tombstone = NULL;
-
-  do {
-    MapEntry* entry = &thiz->entries[index];
-
-    if (IS_UNDEF(entry->key)) {
-      ASSERT(IS_BOOL(entry->value), OOPS);
-
-      if (IS_TRUE(entry->value)) {
-        // We've found a tombstone, if we haven't found one [tombstone] should
-        // be updated. We still need to keep search for if the key exists.
-        if (tombstone == NULL)
-          tombstone = entry;
-
-      } else {
-        // We've found a new empty slot and the key isn't found. If
-        // we've found a tombstone along the sequence we could use that
-        // entry otherwise the entry at the current index.
-
-        *result = (tombstone != NULL) ? tombstone : entry;
-        return false;
-      }
-
-    } else if (isValuesEqual(entry->key, key)) {
-      // We've found the key.
-      *result = entry;
-      return true;
-    }
-
-    index = (index + 1) % thiz->capacity;
-
-  } while (index != start_index);
+// Linear probing of the hash tables of maps and sets, defines a function
+// [name] which finds the entry with the [key] in the [entries] of [Table].
+// It returns true if found and set [result] to point to the entry, return
+// false otherwise and points [result] to where the entry should be inserted.
+// [IS_EMPTY] and [IS_TOMBSTONE] check an entry (tombstones are checked only
+// if it's not empty) and [KEY] is the key of a used entry.
+#define DEFINE_HASH_FIND(name, Table, Entry, IS_EMPTY, IS_TOMBSTONE, KEY) \
+  static bool name(Table* thiz, Var key, Entry** result) { \
+    /* An empty table won't contain the key. */ \
+    if (thiz->capacity == 0) \
+      return false; \
+\
+    /* The [start_index] is where the entry supposed to be if there wasn't \
+     * any collision occurred. It'll be the start index for the linear \
+     * probing. */ \
+    uint32_t start_index = varHashValue(key) % thiz->capacity; \
+    uint32_t index = start_index; \
+\
+    /* Keep track of the first tombstone after the [start_index] if we don't \
+     * find the key anywhere. The tombstone would be the entry at where we \
+     * will have to insert the key. */ \
+    Entry* tombstone = NULL; \
+\
+    do { \
+      Entry* entry = &thiz->entries[index]; \
+\
+      if (IS_EMPTY(entry)) { \
+        /* We've found a new empty slot and the key isn't found. If we've \
+         * found a tombstone along the sequence we could use that entry \
+         * otherwise the entry at the current index. */ \
+        *result = (tombstone != NULL) ? tombstone : entry; \
+        return false; \
+\
+      } else if (IS_TOMBSTONE(entry)) { \
+        /* We've found a tombstone, if we haven't found one [tombstone] \
+         * should be updated. We still need to keep search for if the key \
+         * exists. */ \
+        if (tombstone == NULL) \
+          tombstone = entry; \
+\
+      } else if (isValuesEqual(KEY(entry), key)) { \
+        /* We've found the key. */ \
+        *result = entry; \
+        return true; \
+      } \
+\
+      index = (index + 1) % thiz->capacity; \
+\
+    } while (index != start_index); \
+\
+    /* If we reach here means the table is filled with tombstone. Set the \
+     * first tombstone as result for the next insertion and return false. */ \
+    ASSERT(tombstone != NULL, OOPS); \
+    *result = tombstone; \
+    return false; \
+  }
 
-  // If we reach here means the map is filled with tombstone. Set the first
-  // tombstone as result for the next insertion and return false.
-  ASSERT(tombstone != NULL, OOPS);
-  *result = tombstone;
-  return false;
+// The key of an unused map entry is VAR_UNDEFINED, and its value is false if
+// the entry is empty or true if it's a tombstone.
+#define MAP_ENTRY_EMPTY(entry) (IS_UNDEF((entry)->key) && IS_FALSE((entry)->value))
+#define MAP_ENTRY_TOMBSTONE(entry) IS_UNDEF((entry)->key)
+#define MAP_ENTRY_KEY(entry) ((entry)->key)
+
+#define SET_ENTRY_EMPTY(entry) IS_UNDEF(*(entry))
+#define SET_ENTRY_TOMBSTONE(entry) IS_VOID(*(entry))
+#define SET_ENTRY_KEY(entry) (*(entry))
+
+DEFINE_HASH_FIND(_mapFindEntry, Map, MapEntry, MAP_ENTRY_EMPTY, MAP_ENTRY_TOMBSTONE,
+                 MAP_ENTRY_KEY)
+DEFINE_HASH_FIND(_setFindEntry, Set, Var, SET_ENTRY_EMPTY, SET_ENTRY_TOMBSTONE,
+                 SET_ENTRY_KEY)
+
+// Returns the capacity of a hash table to grow to before inserting a key to
+// it when it has [count] keys, or 0 if it doesn't need to grow.
+static uint32_t _hashGrowCapacity(uint32_t capacity, uint32_t count) {
+  if (count + 1 <= capacity * MAP_LOAD_PERCENT / 100)
+    return 0;
+  uint32_t new_capacity = capacity * GROW_FACTOR;
+  if (new_capacity < MIN_CAPACITY)
+    new_capacity = MIN_CAPACITY;
+  return new_capacity;
+}
+
+// Returns the capacity of a hash table to shrink to after a key removed from
+// it and now it has [count] (> 0) keys, or 0 if it doesn't need to shrink.
+static uint32_t _hashShrinkCapacity(uint32_t capacity, uint32_t count) {
+  // We grow the table when it's filled 75% (MAP_LOAD_PERCENT) by 2
+  // (GROW_FACTOR) but we're not shrink it when it's half filled (ie. half of
+  // the capacity is 75%). Instead we wait till it'll become 1/4 is filled
+  // (1/4 = 1/(GROW_FACTOR*GROW_FACTOR)) to minimize the reallocations and
+  // which is more faster.
+  if (capacity <= MIN_CAPACITY
+      || (capacity / (GROW_FACTOR * GROW_FACTOR)) <= ((count * 100) / MAP_LOAD_PERCENT))
+    return 0;
+
+  uint32_t new_capacity = capacity / (GROW_FACTOR * GROW_FACTOR);
+  if (new_capacity < MIN_CAPACITY)
+    new_capacity = MIN_CAPACITY;
+  return new_capacity;
 }
 
 // Add the key, value pair to the entries array of the map. Returns true if
@@ -1220,12 +1511,9 @@ Var mapGet(Map* thiz, Var key) {
 
 void mapSet(VM* vm, Map* thiz, Var key, Var value) {
   // If map is about to fill, resize it first.
-  if (thiz->count + 1 > thiz->capacity * MAP_LOAD_PERCENT / 100) {
-    uint32_t capacity = thiz->capacity * GROW_FACTOR;
-    if (capacity < MIN_CAPACITY)
-      capacity = MIN_CAPACITY;
+  uint32_t capacity = _hashGrowCapacity(thiz->capacity, thiz->count);
+  if (capacity != 0)
     _mapResize(vm, thiz, capacity);
-  }
 
   if (_mapInsertEntry(thiz, key, value)) {
     thiz->count++; //< A new key added.
@@ -1259,28 +1547,178 @@ Var mapRemoveKey(VM* vm, Map* thiz, Var key) {
     // Clear the map if it's empty.
     mapClear(vm, thiz);
 
-  } else if ((thiz->capacity > MIN_CAPACITY)
-             && (thiz->capacity / (GROW_FACTOR * GROW_FACTOR))
-                    > ((thiz->count * 100) / MAP_LOAD_PERCENT)) {
-    // We grow the map when it's filled 75% (MAP_LOAD_PERCENT) by 2
-    // (GROW_FACTOR) but we're not shrink the map when it's half filled (ie.
-    // half of the capacity is 75%). Instead we wait till it'll become 1/4 is
-    // filled (1/4 = 1/(GROW_FACTOR*GROW_FACTOR)) to minimize the
-    // reallocations and which is more faster.
+  } else {
+    uint32_t capacity = _hashShrinkCapacity(thiz->capacity, thiz->count);
+    if (capacity != 0)
+      _mapResize(vm, thiz, capacity);
+  }
 
-    uint32_t capacity = thiz->capacity / (GROW_FACTOR * GROW_FACTOR);
-    if (capacity < MIN_CAPACITY)
-      capacity = MIN_CAPACITY;
+  if (IS_OBJ(value))
+    vmPopTempRef(vm);
 
-    _mapResize(vm, thiz, capacity);
+  return value;
+}
+
+// Resize the set's size to the given [capacity].
+static void _setResize(VM* vm, Set* thiz, uint32_t capacity) {
+  Var* old_entries = thiz->entries;
+  uint32_t old_capacity = thiz->capacity;
+
+  thiz->entries = ALLOCATE_ARRAY(vm, Var, capacity);
+  thiz->capacity = capacity;
+  for (uint32_t i = 0; i < capacity; i++) {
+    thiz->entries[i] = VAR_UNDEFINED;
   }
 
+  // Insert the old keys to the new entries, they're all unique.
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    if (!SET_ENTRY_USED(old_entries[i]))
+      continue;
+
+    Var* result = NULL;
+    _setFindEntry(thiz, old_entries[i], &result);
+    *result = old_entries[i];
+  }
+
+  DEALLOCATE_ARRAY(vm, old_entries, Var, old_capacity);
+}
+
+bool setHas(Set* thiz, Var key) {
+  Var* entry;
+  return _setFindEntry(thiz, key, &entry);
+}
+
+bool setAdd(VM* vm, Set* thiz, Var key) {
+  // If set is about to fill, resize it first.
+  // The key may not be reachable yet (ex: a value of an iteration) and the
+  // resize can trigger a garbage collection.
+  uint32_t capacity = _hashGrowCapacity(thiz->capacity, thiz->count);
+  if (capacity != 0) {
+    if (IS_OBJ(key))
+      vmPushTempRef(vm, AS_OBJ(key));
+    _setResize(vm, thiz, capacity);
+    if (IS_OBJ(key))
+      vmPopTempRef(vm);
+  }
+
+  Var* entry = NULL;
+  if (_setFindEntry(thiz, key, &entry))
+    return false;
+
+  *entry = key;
+  thiz->count++;
+  return true;
+}
+
+bool setRemove(VM* vm, Set* thiz, Var key) {
+  Var* entry;
+  if (!_setFindEntry(thiz, key, &entry))
+    return false;
+
+  *entry = VAR_VOID; // Tombstone.
+  thiz->count--;
+
+  if (thiz->count == 0) {
+    setClear(vm, thiz);
+  } else {
+    uint32_t capacity = _hashShrinkCapacity(thiz->capacity, thiz->count);
+    if (capacity != 0)
+      _setResize(vm, thiz, capacity);
+  }
+
+  return true;
+}
+
+void setClear(VM* vm, Set* thiz) {
+  DEALLOCATE_ARRAY(vm, thiz->entries, Var, thiz->capacity);
+  thiz->entries = NULL;
+  thiz->capacity = 0;
+  thiz->count = 0;
+}
+
+// Resize the deque to the [capacity] (a power of 2 which is enough for all
+// the elements), the elements are moved to the start of the new buffer.
+static void _dequeResize(VM* vm, Deque* thiz, uint32_t capacity) {
+  Var* data = ALLOCATE_ARRAY(vm, Var, capacity);
+  for (uint32_t i = 0; i < thiz->count; i++) {
+    data[i] = DEQUE_AT(thiz, i);
+  }
+  DEALLOCATE_ARRAY(vm, thiz->data, Var, thiz->capacity);
+  thiz->data = data;
+  thiz->capacity = capacity;
+  thiz->head = 0;
+}
+
+// Grow the deque if it's full before pushing the [value] to it.
+static void _dequeReserve(VM* vm, Deque* thiz, Var value) {
+  if (thiz->count < thiz->capacity)
+    return;
+
+  uint32_t capacity = thiz->capacity * GROW_FACTOR;
+  if (capacity < MIN_CAPACITY)
+    capacity = MIN_CAPACITY;
+
+  // The value isn't reachable from the deque yet.
   if (IS_OBJ(value))
+    vmPushTempRef(vm, AS_OBJ(value));
+  _dequeResize(vm, thiz, capacity);
+  if (IS_OBJ(value))
+    vmPopTempRef(vm);
+}
+
+// Shrink the deque after an element removed from it, the same way as lists
+// but only when it's 1/4 filled, so pushing and popping at the boundary
+// won't reallocate every time.
+static void _dequeShrink(VM* vm, Deque* thiz, Var removed) {
+  if (thiz->capacity <= MIN_CAPACITY
+      || thiz->count > thiz->capacity / (GROW_FACTOR * GROW_FACTOR))
+    return;
+
+  if (IS_OBJ(removed))
+    vmPushTempRef(vm, AS_OBJ(removed));
+  _dequeResize(vm, thiz, thiz->capacity / GROW_FACTOR);
+  if (IS_OBJ(removed))
     vmPopTempRef(vm);
+}
 
+void dequePushBack(VM* vm, Deque* thiz, Var value) {
+  _dequeReserve(vm, thiz, value);
+  thiz->count++;
+  DEQUE_AT(thiz, thiz->count - 1) = value;
+}
+
+void dequePushFront(VM* vm, Deque* thiz, Var value) {
+  _dequeReserve(vm, thiz, value);
+  thiz->head = (thiz->head - 1) & (thiz->capacity - 1);
+  thiz->count++;
+  thiz->data[thiz->head] = value;
+}
+
+Var dequePopBack(VM* vm, Deque* thiz) {
+  ASSERT(thiz->count > 0, OOPS);
+  Var value = DEQUE_AT(thiz, thiz->count - 1);
+  thiz->count--;
+  _dequeShrink(vm, thiz, value);
   return value;
 }
 
+Var dequePopFront(VM* vm, Deque* thiz) {
+  ASSERT(thiz->count > 0, OOPS);
+  Var value = thiz->data[thiz->head];
+  thiz->head = (thiz->head + 1) & (thiz->capacity - 1);
+  thiz->count--;
+  _dequeShrink(vm, thiz, value);
+  return value;
+}
+
+void dequeClear(VM* vm, Deque* thiz) {
+  DEALLOCATE_ARRAY(vm, thiz->data, Var, thiz->capacity);
+  thiz->data = NULL;
+  thiz->capacity = 0;
+  thiz->head = 0;
+  thiz->count = 0;
+}
+
 bool fiberHasError(Fiber* fiber) {
   return fiber->error != NULL;
 }
@@ -1298,6 +1736,16 @@ void freeObject(VM* vm, Object* thiz) {
     case OBJ_STRING:
       {
         String* str = (String*) thiz;
+
+        // The tail array of a view is its parent, and once it's materialized
+        // it has its own buffer.
+        if (str->is_external) {
+          if (STRING_PARENT(str) == NULL)
+            DEALLOCATE_ARRAY(vm, str->data, char, str->capacity);
+          DEALLOCATE_DYNAMIC(vm, str, String, 1, String*);
+          return;
+        }
+
         DEALLOCATE_DYNAMIC(vm, str, String, str->capacity, char);
         return;
       };
@@ -1317,6 +1765,31 @@ void freeObject(VM* vm, Object* thiz) {
         return;
       }
 
+    case OBJ_SET:
+      {
+        Set* set = (Set*) thiz;
+        DEALLOCATE_ARRAY(vm, set->entries, Var, set->capacity);
+        DEALLOCATE(vm, thiz, Set);
+        return;
+      }
+
+    case OBJ_DEQUE:
+      {
+        Deque* deque = (Deque*) thiz;
+        DEALLOCATE_ARRAY(vm, deque->data, Var, deque->capacity);
+        DEALLOCATE(vm, thiz, Deque);
+        return;
+      }
+
+    case OBJ_HEAP:
+      {
+        Heap* heap = (Heap*) thiz;
+        VarBufferClear(&heap->items, vm);
+        VarBufferClear(&heap->keys, vm);
+        DEALLOCATE(vm, thiz, Heap);
+        return;
+      }
+
     case OBJ_RANGE:
       {
         DEALLOCATE(vm, thiz, Range);
@@ -1340,6 +1813,8 @@ void freeObject(VM* vm, Object* thiz) {
     case OBJ_FUNC:
       {
         Function* func = (Function*) thiz;
+        if (vm->memtrack != NULL)
+          memtrackFreeFunction(vm, func);
         if (!func->is_native) {
           ByteBufferClear(&func->fn->opcodes, vm);
           UintBufferClear(&func->fn->oplines, vm);
@@ -1531,6 +2006,12 @@ VarType getObjVarType(ObjectType type) {
       return vLIST;
     case OBJ_MAP:
       return vMAP;
+    case OBJ_SET:
+      return vSET;
+    case OBJ_DEQUE:
+      return vDEQUE;
+    case OBJ_HEAP:
+      return vHEAP;
     case OBJ_RANGE:
       return vRANGE;
     case OBJ_MODULE:
@@ -1571,6 +2052,12 @@ ObjectType getVarObjType(VarType type) {
       return OBJ_LIST;
     case vMAP:
       return OBJ_MAP;
+    case vSET:
+      return OBJ_SET;
+    case vDEQUE:
+      return OBJ_DEQUE;
+    case vHEAP:
+      return OBJ_HEAP;
     case vRANGE:
       return OBJ_RANGE;
     case vMODULE:
@@ -1619,6 +2106,12 @@ const char* getObjectTypeName(ObjectType type) {
       return "List";
     case OBJ_MAP:
       return "Map";
+    case OBJ_SET:
+      return "Set";
+    case OBJ_DEQUE:
+      return "Deque";
+    case OBJ_HEAP:
+      return "Heap";
     case OBJ_RANGE:
       return "Range";
     case OBJ_MODULE:
@@ -1722,8 +2215,7 @@ bool isValuesEqual(Var v1, Var v2) {
     case OBJ_STRING:
       {
         String *s1 = (String*) o1, *s2 = (String*) o2;
-        return s1->hash == s2->hash && s1->length == s2->length
-               && memcmp(s1->data, s2->data, s1->length) == 0;
+        return IS_STR_EQ(s1, s2);
       }
 
     case OBJ_LIST:
@@ -1764,6 +2256,30 @@ bool isValuesEqual(Var v1, Var v2) {
         return true;
       }
 
+    case OBJ_SET:
+      {
+        Set *s1 = (Set*) o1, *s2 = (Set*) o2;
+        if (s1->count != s2->count)
+          return false;
+        for (uint32_t i = 0; i < s1->capacity; i++) {
+          if (SET_ENTRY_USED(s1->entries[i]) && !setHas(s2, s1->entries[i]))
+            return false;
+        }
+        return true;
+      }
+
+    case OBJ_DEQUE:
+      {
+        Deque *d1 = (Deque*) o1, *d2 = (Deque*) o2;
+        if (d1->count != d2->count)
+          return false;
+        for (uint32_t i = 0; i < d1->count; i++) {
+          if (!isValuesEqual(DEQUE_AT(d1, i), DEQUE_AT(d2, i)))
+            return false;
+        }
+        return true;
+      }
+
     default:
       return false;
   }
@@ -1778,16 +2294,26 @@ bool isObjectHashable(ObjectType type) {
 // checking if the current sequence is in the outer sequence linked list.
 struct OuterSequence {
   struct OuterSequence* outer;
-  // If false it'll be map. If we have multiple sequence we should use an enum
-  // here but we only ever support list and map as builtin sequence (so bool).
-  bool is_list;
-  union {
-    const List* list;
-    const Map* map;
-  };
+  const Object* seq; //< The list, map, deque or heap being converted.
 };
 typedef struct OuterSequence OuterSequence;
 
+// Returns true if the sequence [seq] is being converted to string (ie. it's
+// in the [outer] sequence linked list), so it's recursive.
+static bool _isOuterSequence(const OuterSequence* outer, const Object* seq) {
+  for (; outer != NULL; outer = outer->outer) {
+    if (outer->seq == seq)
+      return true;
+  }
+  return false;
+}
+
+// Write the [count] [values] separated by a comma, which are the elements of
+// the sequence [seq_obj] to the buffer.
+static void _toStringValues(VM* vm, ByteBuffer* buff, OuterSequence* outer,
+                            const Object* seq_obj, const Var* values, uint32_t count,
+                            uint32_t mask, uint32_t start);
+
 static void _toStringInternal(VM* vm, const Var v, ByteBuffer* buff,
                               OuterSequence* outer, bool repr) {
   ASSERT(outer == NULL || repr, OOPS);
@@ -1887,25 +2413,14 @@ static void _toStringInternal(VM* vm, const Var v, ByteBuffer* buff,
           }
 
           // Check if the list is recursive.
-          OuterSequence* seq = outer;
-          while (seq != NULL) {
-            if (seq->is_list && seq->list == list) {
-              ByteBufferAddString(buff, vm, "[...]", 5);
-              return;
-            }
-            seq = seq->outer;
+          if (_isOuterSequence(outer, obj)) {
+            ByteBufferAddString(buff, vm, "[...]", 5);
+            return;
           }
-          OuterSequence seq_list;
-          seq_list.outer = outer;
-          seq_list.is_list = true;
-          seq_list.list = list;
 
           ByteBufferWrite(buff, vm, '[');
-          for (uint32_t i = 0; i < list->elements.count; i++) {
-            if (i != 0)
-              ByteBufferAddString(buff, vm, ", ", 2);
-            _toStringInternal(vm, list->elements.data[i], buff, &seq_list, true);
-          }
+          _toStringValues(vm, buff, outer, obj, list->elements.data,
+                          list->elements.count, UINT32_MAX, 0);
           ByteBufferWrite(buff, vm, ']');
           return;
         }
@@ -1919,18 +2434,13 @@ static void _toStringInternal(VM* vm, const Var v, ByteBuffer* buff,
           }
 
           // Check if the map is recursive.
-          OuterSequence* seq = outer;
-          while (seq != NULL) {
-            if (!seq->is_list && seq->map == map) {
-              ByteBufferAddString(buff, vm, "{...}", 5);
-              return;
-            }
-            seq = seq->outer;
+          if (_isOuterSequence(outer, obj)) {
+            ByteBufferAddString(buff, vm, "{...}", 5);
+            return;
           }
           OuterSequence seq_map;
           seq_map.outer = outer;
-          seq_map.is_list = false;
-          seq_map.map = map;
+          seq_map.seq = obj;
 
           ByteBufferWrite(buff, vm, '{');
           uint32_t i = 0;     // Index of the current entry to iterate.
@@ -1962,6 +2472,55 @@ static void _toStringInternal(VM* vm, const Var v, ByteBuffer* buff,
           return;
         }
 
+      case OBJ_SET:
+        {
+          // Sets can't be recursive since they only contain hashable values.
+          const Set* set = (const Set*) obj;
+          if (set->count == 0) {
+            ByteBufferAddString(buff, vm, "Set()", 5);
+            return;
+          }
+
+          ByteBufferWrite(buff, vm, '{');
+          bool first = true;
+          for (uint32_t i = 0; i < set->capacity; i++) {
+            if (!SET_ENTRY_USED(set->entries[i]))
+              continue;
+            if (!first)
+              ByteBufferAddString(buff, vm, ", ", 2);
+            _toStringInternal(vm, set->entries[i], buff, outer, true);
+            first = false;
+          }
+          ByteBufferWrite(buff, vm, '}');
+          return;
+        }
+
+      case OBJ_DEQUE:
+      case OBJ_HEAP:
+        {
+          // Written as the constructor call which creates the same sequence,
+          // ex: Deque([1, 2]), the elements of a heap are in the heap order.
+          const char* name = getObjectTypeName(obj->type);
+          ByteBufferAddString(buff, vm, name, (uint32_t) strlen(name));
+          if (_isOuterSequence(outer, obj)) {
+            ByteBufferAddString(buff, vm, "(...)", 5);
+            return;
+          }
+
+          ByteBufferAddString(buff, vm, "([", 2);
+          if (obj->type == OBJ_DEQUE) {
+            const Deque* deque = (const Deque*) obj;
+            _toStringValues(vm, buff, outer, obj, deque->data, deque->count,
+                            deque->capacity - 1, deque->head);
+          } else {
+            const Heap* heap = (const Heap*) obj;
+            _toStringValues(vm, buff, outer, obj, heap->items.data,
+                            heap->items.count, UINT32_MAX, 0);
+          }
+          ByteBufferAddString(buff, vm, "])", 2);
+          return;
+        }
+
       case OBJ_RANGE:
         {
           const Range* range = (const Range*) obj;
@@ -2139,6 +2698,22 @@ static void _toStringInternal(VM* vm, const Var v, ByteBuffer* buff,
   return;
 }
 
+// The [index]th value is at [values][([start] + [index]) & [mask]], so the
+// ring buffer of a deque can be written without copying it.
+static void _toStringValues(VM* vm, ByteBuffer* buff, OuterSequence* outer,
+                            const Object* seq_obj, const Var* values, uint32_t count,
+                            uint32_t mask, uint32_t start) {
+  OuterSequence seq;
+  seq.outer = outer;
+  seq.seq = seq_obj;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (i != 0)
+      ByteBufferAddString(buff, vm, ", ", 2);
+    _toStringInternal(vm, values[(start + i) & mask], buff, &seq, true);
+  }
+}
+
 String* toString(VM* vm, const Var value) {
   // If it's already a string don't allocate a new string.
   if (IS_OBJ_TYPE(value, OBJ_STRING)) {
@@ -2179,6 +2754,12 @@ bool toBool(Var v) {
       return ((List*) o)->elements.count != 0;
     case OBJ_MAP:
       return ((Map*) o)->count != 0;
+    case OBJ_SET:
+      return ((Set*) o)->count != 0;
+    case OBJ_DEQUE:
+      return ((Deque*) o)->count != 0;
+    case OBJ_HEAP:
+      return ((Heap*) o)->items.count != 0;
     case OBJ_RANGE: // [[FALLTHROUGH]]
     case OBJ_MODULE:
     case OBJ_FUNC:
@@ -122,6 +122,7 @@ typedef struct Var Var;
 #define IS_CONST(value) ((value & _MASK_CONST) == _MASK_CONST)
 #define IS_NULL(value) ((value) == VAR_NULL)
 #define IS_UNDEF(value) ((value) == VAR_UNDEFINED)
+#define IS_VOID(value) ((value) == VAR_VOID)
 #define IS_FALSE(value) ((value) == VAR_FALSE)
 #define IS_TRUE(value) ((value) == VAR_TRUE)
 #define IS_BOOL(value) (IS_TRUE(value) || IS_FALSE(value))
@@ -133,9 +134,11 @@ typedef struct Var Var;
 #define IS_OBJ_TYPE(var, obj_type) \
   (IS_OBJ(var) && (AS_OBJ(var)->type == (obj_type)))
 
-// Check if the 2 strings are equal.
+// Check if the 2 strings are equal. The hashes are only compared if both of
+// them are already computed.
 #define IS_STR_EQ(s1, s2) \
-  (((s1)->hash == (s2)->hash) && ((s1)->length == (s2)->length) \
+  (((s1)->length == (s2)->length) \
+   && ((s1)->hash == 0 || (s2)->hash == 0 || (s1)->hash == (s2)->hash) \
    && (memcmp((const void*) (s1)->data, (const void*) (s2)->data, (s1)->length) == 0))
 
 // Compare string with C string.
@@ -190,6 +193,7 @@ struct Var {
 
 #define IS_NULL(value) ((value).type == VAL_NULL)
 #define IS_UNDEF(value) ((value).type == VAL_UNDEF)
+#define IS_VOID(value) ((value).type == VAL_VOID)
 #define IS_FALSE(value) ((value).type == VAL_FALSE)
 #define IS_TRUE(value) ((value).type == VAL_TRUE)
 #define IS_BOOL(value) ((value).type == VAL_TRUE || (value).type == VAL_FALSE)
@@ -211,9 +215,11 @@ struct Var {
 #define IS_OBJ_TYPE(var, obj_type) \
   (IS_OBJ(var) && (AS_OBJ(var)->type == (obj_type)))
 
-// Check if the 2 strings are equal.
+// Check if the 2 strings are equal. The hashes are only compared if both of
+// them are already computed.
 #define IS_STR_EQ(s1, s2) \
-  (((s1)->hash == (s2)->hash) && ((s1)->length == (s2)->length) \
+  (((s1)->length == (s2)->length) \
+   && ((s1)->hash == 0 || (s2)->hash == 0 || (s1)->hash == (s2)->hash) \
    && (memcmp((const void*) (s1)->data, (const void*) (s2)->data, (s1)->length) == 0))
 
 // Compare string with C string.
@@ -234,6 +240,9 @@ typedef struct Object Object;
 typedef struct String String;
 typedef struct List List;
 typedef struct Map Map;
+typedef struct Set Set;
+typedef struct Deque Deque;
+typedef struct Heap Heap;
 typedef struct Range Range;
 typedef struct Module Module;
 typedef struct Function Function;
@@ -263,6 +272,9 @@ typedef enum {
   OBJ_STRING = 0,
   OBJ_LIST,
   OBJ_MAP,
+  OBJ_SET,
+  OBJ_DEQUE,
+  OBJ_HEAP,
   OBJ_RANGE,
   OBJ_MODULE,
   OBJ_FUNC,
@@ -282,21 +294,56 @@ struct Object {
   Object* next;    //< Next object in the heap allocated link list.
 };
 
+// The characters of a string are allocated at the end of the struct (the
+// [chars] tail array) and [data] points to them. A view (substring) doesn't
+// have characters of its own but [data] points to the characters of its
+// parent string (see STRING_PARENT()), and it's not null terminated. Before
+// passing the [data] to a function which expects a null terminated string the
+// view should be materialized with stringMaterialize(), which copies the
+// characters to a new buffer.
 struct String {
   Object _super;
 
-  uint32_t hash;     //< 32 bit hash value of the string.
+  uint32_t hash;     //< 32 bit hash value or 0 if not computed yet (see STRING_HASH()).
   uint32_t length;   //< Length of the string in \ref data.
-  uint32_t capacity; //< Size of allocated \ref data.
-  char data[DYNAMIC_TAIL_ARRAY];
+  uint32_t capacity; //< Size of allocated \ref data (0 for views).
+  bool is_builder;   //< True if it's a string builder (see stringAppend()).
+  bool is_appending; //< True while it's the left operand of a global `+=`.
+  bool is_rooted;    //< Set by the GC if a view is on a stack (see markStringViews()).
+  bool is_external;  //< True if \ref data isn't the \ref chars (views).
+  char* data;        //< The characters of the string.
+  char chars[DYNAMIC_TAIL_ARRAY];
 };
 
+// The kind of the elements of a list, similar to the "elements kinds" of V8.
+// A list which only held numbers so far is LIST_NUMBERS, and since numbers
+// are NaN-boxed doubles its elements are a packed array of doubles (see
+// LIST_DOUBLES()) which can be processed without checking their types.
+// Storing any other value transitions it to LIST_MIXED, and it'll stay mixed
+// till the list is cleared.
+typedef enum {
+  LIST_NUMBERS = 0,
+  LIST_MIXED = 1,
+} ListKind;
+
 struct List {
   Object _super;
 
+  ListKind kind;      //< Kind of the elements (see ListKind).
   VarBuffer elements; //< Elements of the array.
 };
 
+// Update the kind of the [list] before storing the [value] to it. Every write
+// to the elements of a list should go through it (listAppend(), listInsert()
+// and the subscript set do).
+#define LIST_TRACK_KIND(list, value) \
+  ((list)->kind |= (IS_NUM(value) ? LIST_NUMBERS : LIST_MIXED))
+
+// The elements of a LIST_NUMBERS list as an array of doubles.
+#if VAR_NAN_TAGGING
+#define LIST_DOUBLES(list) ((const double*) (list)->elements.data)
+#endif
+
 typedef struct {
   // If the key is VAR_UNDEFINED it's an empty slot and if the value is false
   // the entry is new and available, if true it's a tombstone - the entry
@@ -314,6 +361,53 @@ struct Map {
   MapEntry* entries; //< Pointer to the contiguous array.
 };
 
+// A set is a hash table of keys without values, it's hashed and probed the
+// same way as maps. An entry is VAR_UNDEFINED if it's empty and VAR_VOID if
+// it's a tombstone (void is never a value of a variable).
+struct Set {
+  Object _super;
+
+  uint32_t capacity; //< Allocated entry's count.
+  uint32_t count;    //< Number of keys in the set.
+  Var* entries;      //< Pointer to the contiguous array.
+};
+
+// Evaluates to true if the set entry [key] is neither empty nor a tombstone.
+#define SET_ENTRY_USED(key) (!IS_UNDEF(key) && !IS_VOID(key))
+
+// A double ended queue, its elements are stored in a ring buffer so pushing
+// and popping at both the ends doesn't shift the other elements. The
+// capacity is always 0 or a power of 2 to wrap the indexes with a mask.
+struct Deque {
+  Object _super;
+
+  uint32_t capacity; //< Allocated element's count.
+  uint32_t head;     //< Index of the first element in \ref data.
+  uint32_t count;    //< Number of elements in the deque.
+  Var* data;         //< Pointer to the ring buffer.
+};
+
+// The element at the [index] (from the front) of the [deque].
+#define DEQUE_AT(deque, index) \
+  ((deque)->data[((deque)->head + (index)) & ((deque)->capacity - 1)])
+
+// A binary min heap (priority queue). If the [key] function is set it's
+// called once for each pushed item and the items are ordered by the keys,
+// which are stored at the same index of the [keys] buffer, otherwise by the
+// items themselves. If [reverse] is true it's a max heap.
+struct Heap {
+  Object _super;
+
+  VarBuffer items; //< Items of the heap in the heap order.
+  VarBuffer keys;  //< Keys of the items if the key function is set.
+  Closure* key;    //< The key function or NULL.
+  bool reverse;    //< True if it's a max heap.
+};
+
+// The value which the item at [index] of the [heap] is ordered by.
+#define HEAP_KEY(heap, index) \
+  (((heap)->key != NULL) ? (heap)->keys.data[index] : (heap)->items.data[index])
+
 struct Range {
   Object _super;
 
@@ -371,6 +465,9 @@ typedef struct {
   ByteBuffer opcodes; //< Buffer of opcodes.
   UintBuffer oplines; //< Line number of opcodes for debug (1 based).
   int stack_size;     //< Maximum size of stack required.
+#if OPCODE_STATS
+  int stats_index; //< Index of the function in the opcode stats or -1.
+#endif
 } Fn;
 
 #define ARITY_VARIADIC -1
@@ -572,6 +669,8 @@ typedef enum {
   METHOD_GETTER,
   METHOD_SETTER,
   METHOD_CALL,
+  METHOD_NEXT,
+  METHOD_VALUE,
   MAX_MAGIC_METHODS,
 } MagicMethod;
 
@@ -649,10 +748,17 @@ struct Instance {
 
 void varInitObject(Object* thiz, VM* vm, ObjectType type);
 
+// If [text] is NULL the characters are left uninitialized, and the caller
+// should write them and then compute the hash.
 String* newStringLength(VM* vm, const char* text, uint32_t length);
 
 String* newStringVaArgs(VM* vm, const char* fmt, va_list args);
 
+// Returns the substring of [str] from [offset] with [length] characters. If
+// the substring is long enough it'll be a view referencing the characters of
+// [str] instead of a copy (see STRING_VIEW_MIN_LENGTH).
+String* newStringView(VM* vm, String* str, uint32_t offset, uint32_t length);
+
 // An inline function/macro implementation of newString(). Set below 0 to 1, to
 // make the implementation a static inline function, it's totally okey to
 // define a function inside a header as long as it's static (but not a fan).
@@ -672,6 +778,17 @@ List* newList(VM* vm, uint32_t size);
 
 Map* newMap(VM* vm);
 
+// Allocate a new set with enough capacity to add [size] keys without
+// resizing.
+Set* newSet(VM* vm, uint32_t size);
+
+// Allocate a new deque with enough capacity to push [size] elements without
+// resizing.
+Deque* newDeque(VM* vm, uint32_t size);
+
+// Allocate a new empty heap, the [key] function could be NULL.
+Heap* newHeap(VM* vm, Closure* key, bool reverse);
+
 Range* newRange(VM* vm, double from, double to);
 
 Module* newModule(VM* vm);
@@ -729,6 +846,13 @@ void markVarBuffer(VM* vm, VarBuffer* thiz);
 // all the reachable objects.
 void popMarkedObjects(VM* vm);
 
+// Mark the parents of the string views marked by popMarkedObjects(). If a
+// parent isn't reachable otherwise, and its views are small compared to it,
+// the views which aren't on a stack will be materialized instead. The parent
+// itself will be freed at the next garbage collection, since a native function
+// may still be using a pointer to its characters.
+void markStringViews(VM* vm);
+
 // Returns a number list from the range. starts with range.from and ends with
 List* rangeAsList(VM* vm, Range* thiz);
 
@@ -766,6 +890,54 @@ String* stringFormat(VM* vm, const char* fmt, ...);
 // Which would be faster than using "@@" format.
 String* stringJoin(VM* vm, String* str1, String* str2);
 
+// Append the string [str] to [thiz] and return the result, used by the
+// `name += expr` statement of a local or global variable. If [thiz] is a
+// string builder with enough capacity [str] is appended in place, otherwise
+// a new builder is allocated with twice the required capacity, so building a
+// string in a loop is amortized O(1) per append instead of copying (and
+// hashing) the whole string every time. The hash of a builder isn't computed
+// and it's only referenced by the variable it's assigned to, it must be
+// frozen with VAR_FREEZE() before the variable is read.
+String* stringAppend(VM* vm, String* thiz, String* str);
+
+// Make the string builder [thiz] a regular (immutable) string, its hash will
+// be computed once it's needed.
+void stringFreeze(String* thiz);
+
+// Compute the hash of the string [thiz] and cache it, should be called only
+// through STRING_HASH().
+uint32_t stringHash(String* thiz);
+
+// Returns the hash of the string [str]. Strings are hashed lazily since most
+// of them are never used as a map key or compared with a different string.
+#define STRING_HASH(str) (((str)->hash != 0) ? (str)->hash : stringHash(str))
+
+// If [thiz] is a view copy its characters to a new buffer, so it'll be null
+// terminated and won't reference its parent anymore.
+void stringMaterialize(VM* vm, String* thiz);
+
+// Returns the string the view [str] is referencing or NULL if it isn't a view.
+// Since a view doesn't have characters of its own its parent is stored in the
+// [chars] tail array, which is set to NULL once it's materialized.
+#define STRING_PARENT(str) ((str)->is_external ? *(String**) (str)->chars : NULL)
+
+// Flag the [value] if it's a view referenced by a stack or a temporary
+// reference while garbage collecting, since a native function could be using
+// its characters (see markStringViews()).
+#define MARK_VIEW_ROOTED(value) \
+  do { \
+    if (IS_OBJ_TYPE(value, OBJ_STRING) && STRING_PARENT((String*) AS_OBJ(value)) != NULL) \
+      ((String*) AS_OBJ(value))->is_rooted = true; \
+  } while (false)
+
+// Freeze the [value] if it's a string builder (see stringAppend()). Should be
+// used everywhere a local or global variable is read.
+#define VAR_FREEZE(value) \
+  do { \
+    if (IS_OBJ_TYPE(value, OBJ_STRING) && ((String*) AS_OBJ(value))->is_builder) \
+      stringFreeze((String*) AS_OBJ(value)); \
+  } while (false)
+
 // You replace a string by specifying the place you want to replace and
 // you replace one or more strings, if it is one, it will be replaced
 // by the index you specified, otherwise the index you specified and
@@ -780,10 +952,16 @@ String* replaceSubstring(VM* vm, uint32_t index, String* str, String* replace);
 // define a function inside a header as long as it's static (but not a fan).
 #if 0 // Function implementation.
   static inline void listAppend(VM* vm, List* thiz, Var value) {
+    LIST_TRACK_KIND(thiz, value);
     VarBufferWrite(&thiz->elements, vm, value);
   }
 #else // Macro implementation.
-#define listAppend(vm, thiz, value) VarBufferWrite(&thiz->elements, vm, value)
+#define listAppend(vm, thiz, value) \
+  do { \
+    Var _value = (value); \
+    LIST_TRACK_KIND(thiz, _value); \
+    VarBufferWrite(&(thiz)->elements, vm, _value); \
+  } while (false)
 #endif
 
 // Insert [value] to the list at [index] and shift down the rest of the
@@ -816,6 +994,33 @@ void mapClear(VM* vm, Map* thiz);
 // otherwise return VAR_UNDEFINED.
 Var mapRemoveKey(VM* vm, Map* thiz, Var key);
 
+// Returns true if the [key] is in the set.
+bool setHas(Set* thiz, Var key);
+
+// Add the [key] to the set. Returns true if it wasn't already in the set.
+bool setAdd(VM* vm, Set* thiz, Var key);
+
+// Remove the [key] from the set. Returns true if it was in the set.
+bool setRemove(VM* vm, Set* thiz, Var key);
+
+// Remove all the keys from the set.
+void setClear(VM* vm, Set* thiz);
+
+// Push the [value] at the back of the deque.
+void dequePushBack(VM* vm, Deque* thiz, Var value);
+
+// Push the [value] at the front of the deque.
+void dequePushFront(VM* vm, Deque* thiz, Var value);
+
+// Remove and return the element at the back of the (non empty) deque.
+Var dequePopBack(VM* vm, Deque* thiz);
+
+// Remove and return the element at the front of the (non empty) deque.
+Var dequePopFront(VM* vm, Deque* thiz);
+
+// Remove all the elements from the deque.
+void dequeClear(VM* vm, Deque* thiz);
+
 // Returns true if the fiber has error, and if it has any the fiber cannot be
 // resumed anymore.
 bool fiberHasError(Fiber* fiber);
@@ -350,7 +350,7 @@ void dumpFunctionCode(VM* vm, Function* func) {
     const char* op_name = op_names[opcodes[i]];
     uint32_t op_length = (uint32_t) strlen(op_name);
     PRINT(op_name);
-    for (uint32_t j = 0; j < 16 - op_length; j++) { // Padding.
+    for (uint32_t j = op_length; j < 16; j++) { // Padding.
       PRINT(" ");
     }
 
@@ -400,9 +400,10 @@ void dumpFunctionCode(VM* vm, Function* func) {
       case OP_PUSH_LOCAL_7:
       case OP_PUSH_LOCAL_8:
       case OP_PUSH_LOCAL_N:
+      case OP_PUSH_LOCAL_BLDR:
         {
           int arg;
-          if (op == OP_PUSH_LOCAL_N) {
+          if (op == OP_PUSH_LOCAL_N || op == OP_PUSH_LOCAL_BLDR) {
             arg = READ_BYTE();
             PRINT_INT(arg);
 
@@ -457,6 +458,7 @@ void dumpFunctionCode(VM* vm, Function* func) {
         break;
 
       case OP_PUSH_GLOBAL:
+      case OP_PUSH_GLOBAL_BLDR:
       case OP_STORE_GLOBAL:
         {
           int index = READ_BYTE();
@@ -667,9 +669,12 @@ void dumpFunctionCode(VM* vm, Function* func) {
           uint8_t inplace = READ_BYTE();
           if (inplace == 1) {
             PRINT("(inplace)\n");
+          } else if (inplace == 2) {
+            ASSERT(op == OP_ADD, "Only add could be an append.");
+            PRINT("(append)\n");
           } else {
             PRINT("\n");
-            ASSERT(inplace == 0, "inplace should be either 0 or 1");
+            ASSERT(inplace == 0, "inplace should be either 0, 1 or 2");
           }
           break;
         }
@@ -0,0 +1,901 @@
+/*
+ * Copyright (c) 2022-2026 Mohamed Abdifatah. All rights reserved.
+ * Distributed Under The MIT License
+ */
+
+#include "saynaa_profiler.h"
+
+#include "../runtime/saynaa_vm.h"
+#include "saynaa_utils.h"
+
+#include <stdio.h>
+
+// The profiler's memory is allocated directly with the host allocator and not
+// with vmRealloc(), otherwise profiling would change the heap size and the
+// garbage collection frequency of the profiled script.
+static void* _profilerRealloc(VM* vm, void* memory, size_t new_size) {
+  return vm->config.realloc_fn(memory, new_size, vm->config.user_data);
+}
+
+// Append [length] bytes of [str] to the scratch buffer of the profiler.
+static void _scratchAdd(VM* vm, Profiler* prof, const char* str, uint32_t length) {
+  // +1 for the null byte.
+  if (prof->scratch_length + length + 1 > prof->scratch_capacity) {
+    uint32_t capacity = utilPowerOf2Ceil(prof->scratch_length + length + 1);
+    if (capacity < 256)
+      capacity = 256;
+    prof->scratch = (char*) _profilerRealloc(vm, prof->scratch, capacity);
+    prof->scratch_capacity = capacity;
+  }
+  memcpy(prof->scratch + prof->scratch_length, str, length);
+  prof->scratch_length += length;
+  prof->scratch[prof->scratch_length] = '\0';
+}
+
+// Append the frames of the [fiber] to the frames of the current sample. The
+// fibers which called (or natively run) this fiber are added first so that
+// the root of the stack is always the first frame.
+static void _sampleFiber(VM* vm, Profiler* prof, Fiber* fiber) {
+  Fiber* parent = (fiber->caller != NULL) ? fiber->caller : fiber->native;
+  if (parent != NULL)
+    _sampleFiber(vm, prof, parent);
+
+  uint32_t count = prof->frames_count + (uint32_t) fiber->frame_count;
+  if (count > prof->frames_capacity) {
+    uint32_t capacity = utilPowerOf2Ceil(count);
+    if (capacity < 64)
+      capacity = 64;
+    prof->frames = (ProfileFrame*) _profilerRealloc(vm, prof->frames,
+                                                    sizeof(ProfileFrame) * capacity);
+    prof->frames_capacity = capacity;
+  }
+
+  for (int i = 0; i < fiber->frame_count; i++) {
+    const CallFrame* frame = &fiber->frames[i];
+    const Function* fn = frame->closure->fn;
+
+    int index = (int) (frame->ip - fn->fn->opcodes.data) - 1;
+    if (index < 0)
+      index = 0;
+
+    ProfileFrame* sample = &prof->frames[prof->frames_count++];
+    sample->fn = fn;
+    sample->line = (uintptr_t) fn->fn->oplines.data[index];
+  }
+}
+
+// Write the collapsed stack of the [frames] to the scratch buffer.
+static void _formatStack(VM* vm, Profiler* prof, const ProfileFrame* frames,
+                         uint32_t depth) {
+  prof->scratch_length = 0;
+
+  char label[256];
+  for (uint32_t i = 0; i < depth; i++) {
+    const Function* fn = frames[i].fn;
+
+    const char* path = "<?>";
+    if (fn->owner->path != NULL)
+      path = fn->owner->path->data;
+    else if (fn->owner->name != NULL)
+      path = fn->owner->name->data;
+    const char* fn_name = (fn->name) ? fn->name : "<?>";
+
+    int length = snprintf(label, sizeof(label), "%s (%s:%i)", fn_name, path,
+                          (int) frames[i].line);
+    if (length < 0)
+      continue;
+    if (length >= (int) sizeof(label))
+      length = (int) sizeof(label) - 1;
+
+    if (prof->scratch_length != 0)
+      _scratchAdd(vm, prof, ";", 1);
+    _scratchAdd(vm, prof, label, (uint32_t) length);
+  }
+}
+
+// Returns the entry of the [stack] or an empty slot to insert it.
+static ProfileEntry* _findEntry(ProfileEntry* entries, uint32_t capacity,
+                                const char* stack, uint32_t length, uint32_t hash) {
+  uint32_t index = hash & (capacity - 1);
+  for (;;) {
+    ProfileEntry* entry = &entries[index];
+    if (entry->stack == NULL)
+      return entry;
+    if (entry->hash == hash && entry->length == length
+        && memcmp(entry->stack, stack, length) == 0) {
+      return entry;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+}
+
+static void _growEntries(VM* vm, Profiler* prof) {
+  uint32_t capacity = (prof->capacity == 0) ? 64 : prof->capacity * GROW_FACTOR;
+  size_t size = sizeof(ProfileEntry) * capacity;
+  ProfileEntry* entries = (ProfileEntry*) _profilerRealloc(vm, NULL, size);
+  memset(entries, 0, size);
+
+  for (uint32_t i = 0; i < prof->capacity; i++) {
+    ProfileEntry* old = &prof->entries[i];
+    if (old->stack == NULL)
+      continue;
+    *_findEntry(entries, capacity, old->stack, old->length, old->hash) = *old;
+  }
+
+  _profilerRealloc(vm, prof->entries, 0);
+  prof->entries = entries;
+  prof->capacity = capacity;
+}
+
+// Returns the pending sample of the [frames] or an empty slot to insert it.
+static ProfilePending* _findPending(ProfilePending* pending, uint32_t capacity,
+                                    const ProfileFrame* frames, uint32_t depth,
+                                    uint32_t hash) {
+  uint32_t index = hash & (capacity - 1);
+  for (;;) {
+    ProfilePending* entry = &pending[index];
+    if (entry->frames == NULL)
+      return entry;
+    if (entry->hash == hash && entry->depth == depth
+        && memcmp(entry->frames, frames, sizeof(ProfileFrame) * depth) == 0) {
+      return entry;
+    }
+    index = (index + 1) & (capacity - 1);
+  }
+}
+
+static void _growPending(VM* vm, Profiler* prof) {
+  uint32_t capacity = (prof->pending_capacity == 0) ? 64
+                                                    : prof->pending_capacity * GROW_FACTOR;
+  size_t size = sizeof(ProfilePending) * capacity;
+  ProfilePending* pending = (ProfilePending*) _profilerRealloc(vm, NULL, size);
+  memset(pending, 0, size);
+
+  for (uint32_t i = 0; i < prof->pending_capacity; i++) {
+    ProfilePending* old = &prof->pending[i];
+    if (old->frames == NULL)
+      continue;
+    *_findPending(pending, capacity, old->frames, old->depth, old->hash) = *old;
+  }
+
+  _profilerRealloc(vm, prof->pending, 0);
+  prof->pending = pending;
+  prof->pending_capacity = capacity;
+}
+
+// Release the pending samples, without formating them if [format] is false.
+static void _clearPending(VM* vm, Profiler* prof, bool format) {
+  for (uint32_t i = 0; i < prof->pending_capacity; i++) {
+    ProfilePending* pending = &prof->pending[i];
+    if (pending->frames == NULL)
+      continue;
+
+    if (format) {
+      _formatStack(vm, prof, pending->frames, pending->depth);
+
+      // Keep the load factor bellow 75% (same as the Map).
+      if ((prof->count + 1) * 4 > prof->capacity * 3)
+        _growEntries(vm, prof);
+
+      uint32_t hash = utilHashString(prof->scratch, prof->scratch_length);
+      ProfileEntry* entry = _findEntry(prof->entries, prof->capacity, prof->scratch,
+                                       prof->scratch_length, hash);
+      if (entry->stack == NULL) {
+        entry->stack = (char*) _profilerRealloc(vm, NULL, prof->scratch_length + 1);
+        memcpy(entry->stack, prof->scratch, prof->scratch_length + 1);
+        entry->length = prof->scratch_length;
+        entry->hash = hash;
+        entry->count = 0;
+        prof->count++;
+      }
+      entry->count += pending->count;
+    }
+
+    _profilerRealloc(vm, pending->frames, 0);
+    pending->frames = NULL;
+  }
+  prof->pending_count = 0;
+}
+
+bool profilerStart(VM* vm, int interval) {
+  if (vm->profiler != NULL)
+    return false;
+
+  Profiler* prof = (Profiler*) _profilerRealloc(vm, NULL, sizeof(Profiler));
+  memset(prof, 0, sizeof(Profiler));
+  prof->interval = (interval > 0) ? interval : PROFILER_SAMPLE_INTERVAL;
+  prof->countdown = prof->interval;
+
+  vm->profiler = prof;
+  return true;
+}
+
+void profilerSample(VM* vm) {
+  Profiler* prof = vm->profiler;
+  ASSERT(prof != NULL, OOPS);
+  prof->countdown = prof->interval;
+
+  if (vm->fiber == NULL)
+    return;
+
+  prof->frames_count = 0;
+  _sampleFiber(vm, prof, vm->fiber);
+  uint32_t depth = prof->frames_count;
+  if (depth == 0)
+    return;
+
+  if ((prof->pending_count + 1) * 4 > prof->pending_capacity * 3)
+    _growPending(vm, prof);
+
+  uint32_t hash = utilHashString((const char*) prof->frames,
+                                 sizeof(ProfileFrame) * depth);
+  ProfilePending* pending = _findPending(prof->pending, prof->pending_capacity,
+                                         prof->frames, depth, hash);
+  if (pending->frames == NULL) {
+    pending->frames = (ProfileFrame*) _profilerRealloc(vm, NULL,
+                                                       sizeof(ProfileFrame) * depth);
+    memcpy(pending->frames, prof->frames, sizeof(ProfileFrame) * depth);
+    pending->depth = depth;
+    pending->hash = hash;
+    pending->count = 0;
+    prof->pending_count++;
+  }
+
+  pending->count++;
+  prof->samples++;
+}
+
+void profilerFlush(VM* vm) {
+  Profiler* prof = vm->profiler;
+  ASSERT(prof != NULL, OOPS);
+  _clearPending(vm, prof, true);
+}
+
+void profilerDump(VM* vm, ByteBuffer* buff) {
+  Profiler* prof = vm->profiler;
+  ASSERT(prof != NULL, OOPS);
+
+  profilerFlush(vm);
+  for (uint32_t i = 0; i < prof->capacity; i++) {
+    ProfileEntry* entry = &prof->entries[i];
+    if (entry->stack == NULL)
+      continue;
+    ByteBufferAddString(buff, vm, entry->stack, entry->length);
+    ByteBufferAddStringFmt(buff, vm, " %llu\n", (unsigned long long) entry->count);
+  }
+}
+
+bool profilerStop(VM* vm, const char* path) {
+  Profiler* prof = vm->profiler;
+  if (prof == NULL)
+    return false;
+
+  // The samples are discarded without a [path] (and the VM could be freeing
+  // the sampled functions).
+  _clearPending(vm, prof, path != NULL);
+
+  bool success = true;
+  if (path != NULL) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+      success = false;
+    } else {
+      for (uint32_t i = 0; i < prof->capacity; i++) {
+        ProfileEntry* entry = &prof->entries[i];
+        if (entry->stack == NULL)
+          continue;
+        fprintf(file, "%s %llu\n", entry->stack, (unsigned long long) entry->count);
+      }
+      fclose(file);
+    }
+  }
+
+  for (uint32_t i = 0; i < prof->capacity; i++) {
+    if (prof->entries[i].stack != NULL)
+      _profilerRealloc(vm, prof->entries[i].stack, 0);
+  }
+  _profilerRealloc(vm, prof->entries, 0);
+  _profilerRealloc(vm, prof->pending, 0);
+  _profilerRealloc(vm, prof->frames, 0);
+  _profilerRealloc(vm, prof->scratch, 0);
+  _profilerRealloc(vm, prof, 0);
+
+  vm->profiler = NULL;
+  return success;
+}
+
+/*****************************************************************************/
+/* ALLOCATION TRACKER                                                        */
+/*****************************************************************************/
+
+// The maximum number of rows written to the allocation sites report.
+#define MEMTRACK_MAX_SITES 32
+
+static uint32_t _siteHash(const Function* fn, int line) {
+  return utilHashBits((uint64_t) (uintptr_t) fn ^ ((uint64_t) line << 48));
+}
+
+// Returns the site map slot of the [fn] at [line]. The slot is either zero
+// (empty) or the index + 1 of the site.
+static uint32_t* _findSiteSlot(MemTracker* mt, const Function* fn, int line) {
+  uint32_t index = _siteHash(fn, line) & (mt->site_map_capacity - 1);
+  for (;;) {
+    uint32_t* slot = &mt->site_map[index];
+    if (*slot == 0)
+      return slot;
+    AllocationSite* site = &mt->sites[*slot - 1];
+    if (site->fn == fn && site->line == line)
+      return slot;
+    index = (index + 1) & (mt->site_map_capacity - 1);
+  }
+}
+
+// Append a new site with the [label] (takes the ownership) and return its
+// index.
+static uint32_t _addSite(VM* vm, MemTracker* mt, const Function* fn, int line,
+                         char* label) {
+  if (mt->sites_count == mt->sites_capacity) {
+    uint32_t capacity = (mt->sites_capacity == 0) ? MIN_CAPACITY
+                                                  : mt->sites_capacity * GROW_FACTOR;
+    mt->sites = (AllocationSite*) _profilerRealloc(vm, mt->sites,
+                                                   sizeof(AllocationSite) * capacity);
+    mt->sites_capacity = capacity;
+  }
+
+  AllocationSite* site = &mt->sites[mt->sites_count];
+  site->fn = fn;
+  site->line = line;
+  site->label = label;
+  site->count = 0;
+  site->bytes = 0;
+  return mt->sites_count++;
+}
+
+static void _growSiteMap(VM* vm, MemTracker* mt) {
+  uint32_t capacity = (mt->site_map_capacity == 0) ? 64
+                                                   : mt->site_map_capacity * GROW_FACTOR;
+  uint32_t* old_map = mt->site_map;
+  uint32_t old_capacity = mt->site_map_capacity;
+
+  mt->site_map = (uint32_t*) _profilerRealloc(vm, NULL, sizeof(uint32_t) * capacity);
+  memset(mt->site_map, 0, sizeof(uint32_t) * capacity);
+  mt->site_map_capacity = capacity;
+
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    if (old_map[i] == 0)
+      continue;
+    AllocationSite* site = &mt->sites[old_map[i] - 1];
+    if (site->fn == NULL)
+      continue; // The function was freed.
+    *_findSiteSlot(mt, site->fn, site->line) = old_map[i];
+  }
+  _profilerRealloc(vm, old_map, 0);
+}
+
+// Returns the site of the currently running script frame.
+static AllocationSite* _currentSite(VM* vm, MemTracker* mt) {
+  Fiber* fiber = vm->fiber;
+  if (fiber == NULL || fiber->frame_count == 0)
+    return &mt->sites[0];
+
+  const CallFrame* frame = &fiber->frames[fiber->frame_count - 1];
+  const Function* fn = frame->closure->fn;
+  if (fn->fn->oplines.count == 0)
+    return &mt->sites[0];
+
+  int index = (int) (frame->ip - fn->fn->opcodes.data) - 1;
+  if (index < 0)
+    index = 0;
+  int line = fn->fn->oplines.data[index];
+
+  uint32_t* slot = _findSiteSlot(mt, fn, line);
+  if (*slot != 0)
+    return &mt->sites[*slot - 1];
+
+  const char* path = "<?>";
+  if (fn->owner->path != NULL)
+    path = fn->owner->path->data;
+  else if (fn->owner->name != NULL)
+    path = fn->owner->name->data;
+  const char* fn_name = (fn->name) ? fn->name : "<?>";
+
+  int length = snprintf(NULL, 0, "%s (%s:%i)", fn_name, path, line);
+  char* label = (char*) _profilerRealloc(vm, NULL, length + 1);
+  snprintf(label, length + 1, "%s (%s:%i)", fn_name, path, line);
+
+  uint32_t site = _addSite(vm, mt, fn, line, label);
+  *slot = site + 1;
+
+  // Keep the load factor bellow 75%.
+  if (mt->sites_count * 4 > mt->site_map_capacity * 3)
+    _growSiteMap(vm, mt);
+
+  return &mt->sites[site];
+}
+
+bool memtrackStart(VM* vm) {
+  if (vm->memtrack != NULL)
+    return false;
+
+  MemTracker* mt = (MemTracker*) _profilerRealloc(vm, NULL, sizeof(MemTracker));
+  memset(mt, 0, sizeof(MemTracker));
+  mt->start_time = nanotime();
+  mt->last_gc_time = mt->start_time;
+
+  const char* vm_label = "<vm>";
+  char* label = (char*) _profilerRealloc(vm, NULL, strlen(vm_label) + 1);
+  strcpy(label, vm_label);
+  _addSite(vm, mt, NULL, 0, label);
+  _growSiteMap(vm, mt);
+
+  vm->memtrack = mt;
+  return true;
+}
+
+void memtrackAllocation(VM* vm, size_t bytes) {
+  MemTracker* mt = vm->memtrack;
+  mt->total_bytes += bytes;
+  _currentSite(vm, mt)->bytes += bytes;
+}
+
+void memtrackObject(VM* vm, ObjectType type) {
+  MemTracker* mt = vm->memtrack;
+  mt->allocated[type]++;
+  _currentSite(vm, mt)->count++;
+}
+
+void memtrackBeginGC(VM* vm) {
+  MemTracker* mt = vm->memtrack;
+  memset(mt->live_bytes, 0, sizeof(mt->live_bytes));
+}
+
+void memtrackEndGC(VM* vm) {
+  MemTracker* mt = vm->memtrack;
+  nanotime_t now = nanotime();
+  double seconds = (double) (now - mt->last_gc_time) / 1e9;
+  if (seconds > 0)
+    mt->gc_rate = (double) (mt->total_bytes - mt->last_gc_bytes) / seconds;
+  mt->last_gc_time = now;
+  mt->last_gc_bytes = mt->total_bytes;
+  mt->gc_count++;
+}
+
+void memtrackFreeFunction(VM* vm, const Function* fn) {
+  MemTracker* mt = vm->memtrack;
+  for (uint32_t i = 1; i < mt->sites_count; i++) {
+    if (mt->sites[i].fn == fn)
+      mt->sites[i].fn = NULL;
+  }
+}
+
+// Returns the allocation rate (bytes per second) since the tracking started.
+static double _allocationRate(MemTracker* mt) {
+  double seconds = (double) (nanotime() - mt->start_time) / 1e9;
+  if (seconds <= 0)
+    return 0;
+  return (double) mt->total_bytes / seconds;
+}
+
+// Sort the sites by their allocated bytes descending.
+static int _compareSites(const void* a, const void* b) {
+  const AllocationSite* s1 = *(const AllocationSite**) a;
+  const AllocationSite* s2 = *(const AllocationSite**) b;
+  if (s1->bytes != s2->bytes)
+    return (s1->bytes < s2->bytes) ? 1 : -1;
+  if (s1->count != s2->count)
+    return (s1->count < s2->count) ? 1 : -1;
+  return 0;
+}
+
+void memtrackDump(VM* vm, ByteBuffer* buff) {
+  MemTracker* mt = vm->memtrack;
+
+  // Pause the tracking so the growth of the [buff] won't be counted (and the
+  // sites won't be reallocated while we hold pointers to them).
+  vm->memtrack = NULL;
+
+  ByteBufferAddStringFmt(buff, vm,
+                         "allocated: %llu bytes (%.0f bytes/s), heap: %llu bytes, "
+                         "collections: %llu (last %.0f bytes/s)\n\n",
+                         (unsigned long long) mt->total_bytes, _allocationRate(mt),
+                         (unsigned long long) vm->bytes_allocated,
+                         (unsigned long long) mt->gc_count, mt->gc_rate);
+
+  ByteBufferAddStringFmt(buff, vm, "%-16s %12s %12s %14s\n", "type", "allocated",
+                         "live", "live bytes");
+  for (int i = 0; i <= OBJ_INST; i++) {
+    if (mt->allocated[i] == 0 && vm->gc_stats.live_objects[i] == 0)
+      continue;
+    ByteBufferAddStringFmt(buff, vm, "%-16s %12llu %12llu %14llu\n",
+                           getObjectTypeName((ObjectType) i),
+                           (unsigned long long) mt->allocated[i],
+                           (unsigned long long) vm->gc_stats.live_objects[i],
+                           (unsigned long long) mt->live_bytes[i]);
+  }
+
+  AllocationSite** sorted = (AllocationSite**) _profilerRealloc(
+      vm, NULL, sizeof(AllocationSite*) * mt->sites_count);
+  for (uint32_t i = 0; i < mt->sites_count; i++)
+    sorted[i] = &mt->sites[i];
+  qsort(sorted, mt->sites_count, sizeof(AllocationSite*), _compareSites);
+
+  ByteBufferAddStringFmt(buff, vm, "\n%-48s %12s %14s\n", "site", "objects", "bytes");
+  for (uint32_t i = 0; i < mt->sites_count && i < MEMTRACK_MAX_SITES; i++) {
+    if (sorted[i]->bytes == 0 && sorted[i]->count == 0)
+      break;
+    ByteBufferAddStringFmt(buff, vm, "%-48s %12llu %14llu\n", sorted[i]->label,
+                           (unsigned long long) sorted[i]->count,
+                           (unsigned long long) sorted[i]->bytes);
+  }
+  _profilerRealloc(vm, sorted, 0);
+
+  vm->memtrack = mt;
+}
+
+// Set the [value] with the cstring [key] in the [map].
+static void _mapSetCStr(VM* vm, Map* map, const char* key, Var value) {
+  if (IS_OBJ(value))
+    vmPushTempRef(vm, AS_OBJ(value)); // value.
+  String* name = newString(vm, key);
+  vmPushTempRef(vm, &name->_super); // name.
+  mapSet(vm, map, VAR_OBJ(name), value);
+  vmPopTempRef(vm); // name.
+  if (IS_OBJ(value))
+    vmPopTempRef(vm); // value.
+}
+
+Map* memtrackToMap(VM* vm) {
+  MemTracker* mt = vm->memtrack;
+
+  Map* result = newMap(vm);
+  vmPushTempRef(vm, &result->_super); // result.
+
+  _mapSetCStr(vm, result, "allocated_bytes", VAR_NUM((double) mt->total_bytes));
+  _mapSetCStr(vm, result, "allocation_rate", VAR_NUM(_allocationRate(mt)));
+  _mapSetCStr(vm, result, "heap_bytes", VAR_NUM((double) vm->bytes_allocated));
+  _mapSetCStr(vm, result, "collections", VAR_NUM((double) mt->gc_count));
+  _mapSetCStr(vm, result, "gc_allocation_rate", VAR_NUM(mt->gc_rate));
+
+  Map* types = newMap(vm);
+  _mapSetCStr(vm, result, "types", VAR_OBJ(types));
+  for (int i = 0; i <= OBJ_INST; i++) {
+    if (mt->allocated[i] == 0 && vm->gc_stats.live_objects[i] == 0)
+      continue;
+    Map* type = newMap(vm);
+    _mapSetCStr(vm, types, getObjectTypeName((ObjectType) i), VAR_OBJ(type));
+    _mapSetCStr(vm, type, "allocated", VAR_NUM((double) mt->allocated[i]));
+    _mapSetCStr(vm, type, "live", VAR_NUM((double) vm->gc_stats.live_objects[i]));
+    _mapSetCStr(vm, type, "live_bytes", VAR_NUM((double) mt->live_bytes[i]));
+  }
+
+  Map* sites = newMap(vm);
+  _mapSetCStr(vm, result, "sites", VAR_OBJ(sites));
+  for (uint32_t i = 0; i < mt->sites_count; i++) {
+    uint64_t count = mt->sites[i].count, bytes = mt->sites[i].bytes;
+    if (bytes == 0 && count == 0)
+      continue;
+
+    // Note that the allocations below are tracked as well, which could
+    // reallocate the sites, so don't hold a pointer to the site.
+    List* counter = newList(vm, 2);
+    vmPushTempRef(vm, &counter->_super); // counter.
+    listAppend(vm, counter, VAR_NUM((double) count));
+    listAppend(vm, counter, VAR_NUM((double) bytes));
+    _mapSetCStr(vm, sites, mt->sites[i].label, VAR_OBJ(counter));
+    vmPopTempRef(vm); // counter.
+  }
+
+  vmPopTempRef(vm); // result.
+  return result;
+}
+
+bool memtrackStop(VM* vm, const char* path) {
+  MemTracker* mt = vm->memtrack;
+  if (mt == NULL)
+    return false;
+
+  bool success = true;
+  if (path != NULL) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+      success = false;
+    } else {
+      ByteBuffer bb;
+      ByteBufferInit(&bb);
+      memtrackDump(vm, &bb);
+      fwrite(bb.data, 1, bb.count, file);
+      ByteBufferClear(&bb, vm);
+      fclose(file);
+    }
+  }
+
+  // Disable tracking before releasing the memory.
+  vm->memtrack = NULL;
+
+  for (uint32_t i = 0; i < mt->sites_count; i++) {
+    _profilerRealloc(vm, mt->sites[i].label, 0);
+  }
+  _profilerRealloc(vm, mt->sites, 0);
+  _profilerRealloc(vm, mt->site_map, 0);
+  _profilerRealloc(vm, mt, 0);
+  return success;
+}
+
+#undef MEMTRACK_MAX_SITES
+
+Map* gcstatsToMap(VM* vm) {
+  GCStats* stats = &vm->gc_stats;
+
+  Map* result = newMap(vm);
+  vmPushTempRef(vm, &result->_super); // result.
+
+  _mapSetCStr(vm, result, "collections", VAR_NUM((double) stats->collections));
+  _mapSetCStr(vm, result, "total_pause", VAR_NUM(stats->total_pause));
+  _mapSetCStr(vm, result, "max_pause", VAR_NUM(stats->max_pause));
+  _mapSetCStr(vm, result, "last_pause", VAR_NUM(stats->last_pause));
+  _mapSetCStr(vm, result, "bytes_marked", VAR_NUM((double) stats->bytes_marked));
+  _mapSetCStr(vm, result, "bytes_swept", VAR_NUM((double) stats->bytes_swept));
+  _mapSetCStr(vm, result, "total_swept", VAR_NUM((double) stats->total_swept));
+  _mapSetCStr(vm, result, "heap_bytes", VAR_NUM((double) vm->bytes_allocated));
+  _mapSetCStr(vm, result, "next_gc", VAR_NUM((double) vm->next_gc));
+
+  Map* types = newMap(vm);
+  _mapSetCStr(vm, result, "types", VAR_OBJ(types));
+  for (int i = 0; i <= OBJ_INST; i++) {
+    if (stats->live_objects[i] == 0)
+      continue;
+    _mapSetCStr(vm, types, getObjectTypeName((ObjectType) i),
+                VAR_NUM((double) stats->live_objects[i]));
+  }
+
+  // The history from the oldest to the latest collection.
+  List* history = newList(vm, GC_HISTORY_SIZE);
+  _mapSetCStr(vm, result, "history", VAR_OBJ(history));
+  uint64_t first = 0;
+  if (stats->collections > GC_HISTORY_SIZE)
+    first = stats->collections - GC_HISTORY_SIZE;
+  for (uint64_t i = first; i < stats->collections; i++) {
+    GCRecord* record = &stats->history[i % GC_HISTORY_SIZE];
+    List* entry = newList(vm, 4);
+    vmPushTempRef(vm, &entry->_super); // entry.
+    listAppend(vm, entry, VAR_NUM(record->time));
+    listAppend(vm, entry, VAR_NUM(record->pause));
+    listAppend(vm, entry, VAR_NUM((double) record->heap_before));
+    listAppend(vm, entry, VAR_NUM((double) record->heap_after));
+    listAppend(vm, history, VAR_OBJ(entry));
+    vmPopTempRef(vm); // entry.
+  }
+
+  vmPopTempRef(vm); // result.
+  return result;
+}
+
+#if OPCODE_STATS
+
+static const char* op_names[] = {
+#define OPCODE(name, params, stack) #name,
+#include "../shared/saynaa_opcodes.h"
+#undef OPCODE
+};
+
+// An entry of the sorted tables.
+typedef struct {
+  int index;
+  uint64_t count;
+  uint64_t cycles;
+} _StatsRow;
+
+// Sort the rows by their cycles (and count if they're equal) descending.
+static int _compareRows(const void* a, const void* b) {
+  const _StatsRow* r1 = (const _StatsRow*) a;
+  const _StatsRow* r2 = (const _StatsRow*) b;
+  if (r1->cycles != r2->cycles)
+    return (r1->cycles < r2->cycles) ? 1 : -1;
+  if (r1->count != r2->count)
+    return (r1->count < r2->count) ? 1 : -1;
+  return r1->index - r2->index;
+}
+
+// The maximum number of rows written for the pairs and functions tables.
+#define OPSTATS_MAX_ROWS 32
+
+void opstatsInit(VM* vm) {
+  OpcodeStats* stats = (OpcodeStats*) _profilerRealloc(vm, NULL, sizeof(OpcodeStats));
+  memset(stats, 0, sizeof(OpcodeStats));
+  stats->last_op = -1;
+  vm->opstats = stats;
+}
+
+int opstatsFunction(VM* vm, const Function* fn) {
+  OpcodeStats* stats = vm->opstats;
+
+  if (stats->functions_count == stats->functions_capacity) {
+    int capacity = (stats->functions_capacity == 0)
+                       ? MIN_CAPACITY
+                       : stats->functions_capacity * GROW_FACTOR;
+    stats->functions = (FunctionStats*) _profilerRealloc(
+        vm, stats->functions, sizeof(FunctionStats) * capacity);
+    stats->functions_capacity = capacity;
+  }
+
+  const char* path = "<?>";
+  if (fn->owner->path != NULL)
+    path = fn->owner->path->data;
+  else if (fn->owner->name != NULL)
+    path = fn->owner->name->data;
+  const char* fn_name = (fn->name) ? fn->name : "<?>";
+
+  int length = snprintf(NULL, 0, "%s (%s)", fn_name, path);
+  char* label = (char*) _profilerRealloc(vm, NULL, length + 1);
+  snprintf(label, length + 1, "%s (%s)", fn_name, path);
+
+  int index = stats->functions_count++;
+  stats->functions[index].label = label;
+  stats->functions[index].count = 0;
+  stats->functions[index].cycles = 0;
+
+  fn->fn->stats_index = index;
+  return index;
+}
+
+void opstatsDump(VM* vm, ByteBuffer* buff) {
+  OpcodeStats* stats = vm->opstats;
+
+  uint64_t total_count = 0, total_cycles = 0;
+  for (int i = 0; i < OPCODE_STATS_COUNT; i++) {
+    total_count += stats->counts[i];
+    total_cycles += stats->cycles[i];
+  }
+  if (total_count == 0)
+    total_count = 1;
+  if (total_cycles == 0)
+    total_cycles = 1;
+
+  _StatsRow rows[OPCODE_STATS_COUNT];
+  int count = 0;
+  for (int i = 0; i < OPCODE_STATS_COUNT; i++) {
+    if (stats->counts[i] == 0)
+      continue;
+    rows[count++] = (_StatsRow){i, stats->counts[i], stats->cycles[i]};
+  }
+  qsort(rows, count, sizeof(_StatsRow), _compareRows);
+
+  ByteBufferAddStringFmt(buff, vm, "%-24s %14s %7s %16s %7s %10s\n", "opcode",
+                         "count", "count%", "cycles", "cycles%", "cycles/op");
+  for (int i = 0; i < count; i++) {
+    ByteBufferAddStringFmt(buff, vm, "%-24s %14llu %6.2f%% %16llu %6.2f%% %10.1f\n",
+                           op_names[rows[i].index],
+                           (unsigned long long) rows[i].count,
+                           100.0 * rows[i].count / total_count,
+                           (unsigned long long) rows[i].cycles,
+                           100.0 * rows[i].cycles / total_cycles,
+                           (double) rows[i].cycles / rows[i].count);
+  }
+
+  // Opcode pairs, sorted by their count. The row index is (first * N + second).
+  _StatsRow pairs[OPSTATS_MAX_ROWS];
+  int pairs_count = 0;
+  for (int i = 0; i < OPCODE_STATS_COUNT; i++) {
+    for (int j = 0; j < OPCODE_STATS_COUNT; j++) {
+      uint64_t c = stats->pairs[i][j];
+      if (c == 0)
+        continue;
+      _StatsRow row = {i * OPCODE_STATS_COUNT + j, c, c};
+      if (pairs_count < OPSTATS_MAX_ROWS) {
+        pairs[pairs_count++] = row;
+      } else if (_compareRows(&row, &pairs[pairs_count - 1]) < 0) {
+        pairs[pairs_count - 1] = row;
+      } else {
+        continue;
+      }
+      qsort(pairs, pairs_count, sizeof(_StatsRow), _compareRows);
+    }
+  }
+
+  ByteBufferAddStringFmt(buff, vm, "\n%-49s %14s %7s\n", "opcode pair", "count", "count%");
+  for (int i = 0; i < pairs_count; i++) {
+    int first = pairs[i].index / OPCODE_STATS_COUNT;
+    int second = pairs[i].index % OPCODE_STATS_COUNT;
+    ByteBufferAddStringFmt(buff, vm, "%-24s %-24s %14llu %6.2f%%\n", op_names[first],
+                           op_names[second], (unsigned long long) pairs[i].count,
+                           100.0 * pairs[i].count / total_count);
+  }
+
+  // Functions, sorted by their cycles.
+  _StatsRow* fns = (_StatsRow*) _profilerRealloc(
+      vm, NULL, sizeof(_StatsRow) * (stats->functions_count + 1));
+  for (int i = 0; i < stats->functions_count; i++) {
+    FunctionStats* fs = &stats->functions[i];
+    fns[i] = (_StatsRow){i, fs->count, fs->cycles};
+  }
+  qsort(fns, stats->functions_count, sizeof(_StatsRow), _compareRows);
+
+  ByteBufferAddStringFmt(buff, vm, "\n%-40s %14s %16s %7s\n", "function", "instructions",
+                         "cycles", "cycles%");
+  for (int i = 0; i < stats->functions_count && i < OPSTATS_MAX_ROWS; i++) {
+    ByteBufferAddStringFmt(buff, vm, "%-40s %14llu %16llu %6.2f%%\n",
+                           stats->functions[fns[i].index].label,
+                           (unsigned long long) fns[i].count,
+                           (unsigned long long) fns[i].cycles,
+                           100.0 * fns[i].cycles / total_cycles);
+  }
+  _profilerRealloc(vm, fns, 0);
+}
+
+// Returns a new list of [count, cycles].
+static List* _newCounter(VM* vm, uint64_t count, uint64_t cycles) {
+  List* counter = newList(vm, 2);
+  vmPushTempRef(vm, &counter->_super); // counter.
+  listAppend(vm, counter, VAR_NUM((double) count));
+  listAppend(vm, counter, VAR_NUM((double) cycles));
+  vmPopTempRef(vm); // counter.
+  return counter;
+}
+
+Map* opstatsToMap(VM* vm) {
+  OpcodeStats* stats = vm->opstats;
+
+  Map* result = newMap(vm);
+  vmPushTempRef(vm, &result->_super); // result.
+
+  Map* opcodes = newMap(vm);
+  _mapSetCStr(vm, result, "opcodes", VAR_OBJ(opcodes));
+  for (int i = 0; i < OPCODE_STATS_COUNT; i++) {
+    if (stats->counts[i] == 0)
+      continue;
+    List* counter = _newCounter(vm, stats->counts[i], stats->cycles[i]);
+    _mapSetCStr(vm, opcodes, op_names[i], VAR_OBJ(counter));
+  }
+
+  Map* pairs = newMap(vm);
+  _mapSetCStr(vm, result, "pairs", VAR_OBJ(pairs));
+  for (int i = 0; i < OPCODE_STATS_COUNT; i++) {
+    for (int j = 0; j < OPCODE_STATS_COUNT; j++) {
+      if (stats->pairs[i][j] == 0)
+        continue;
+      String* name = stringFormat(vm, "$ $", op_names[i], op_names[j]);
+      vmPushTempRef(vm, &name->_super); // name.
+      mapSet(vm, pairs, VAR_OBJ(name), VAR_NUM((double) stats->pairs[i][j]));
+      vmPopTempRef(vm); // name.
+    }
+  }
+
+  Map* functions = newMap(vm);
+  _mapSetCStr(vm, result, "functions", VAR_OBJ(functions));
+  for (int i = 0; i < stats->functions_count; i++) {
+    FunctionStats* fs = &stats->functions[i];
+    List* counter = _newCounter(vm, fs->count, fs->cycles);
+    _mapSetCStr(vm, functions, fs->label, VAR_OBJ(counter));
+  }
+
+  vmPopTempRef(vm); // result.
+  return result;
+}
+
+void opstatsReset(VM* vm) {
+  OpcodeStats* stats = vm->opstats;
+  memset(stats->counts, 0, sizeof(stats->counts));
+  memset(stats->cycles, 0, sizeof(stats->cycles));
+  memset(stats->pairs, 0, sizeof(stats->pairs));
+  for (int i = 0; i < stats->functions_count; i++) {
+    stats->functions[i].count = 0;
+    stats->functions[i].cycles = 0;
+  }
+  stats->last_op = -1;
+}
+
+void opstatsFree(VM* vm) {
+  OpcodeStats* stats = vm->opstats;
+  if (stats == NULL)
+    return;
+  for (int i = 0; i < stats->functions_count; i++) {
+    _profilerRealloc(vm, stats->functions[i].label, 0);
+  }
+  _profilerRealloc(vm, stats->functions, 0);
+  _profilerRealloc(vm, stats, 0);
+  vm->opstats = NULL;
+}
+
+#undef OPSTATS_MAX_ROWS
+
+#endif // OPCODE_STATS
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2022-2026 Mohamed Abdifatah. All rights reserved.
+ * Distributed Under The MIT License
+ */
+
+#pragma once
+
+#include "../compiler/saynaa_compiler.h"
+#include "../shared/saynaa_internal.h"
+#include "../shared/saynaa_value.h"
+
+#include "saynaa_utils.h"
+
+#if OPCODE_STATS
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+// A single aggregated entry of the sampling profiler. The [stack] is the
+// "collapsed" call stack of the sample (root first, frames separated by ';')
+// which is the input format of the flamegraph tools.
+typedef struct {
+  char* stack;
+  uint32_t length;
+  uint32_t hash;
+  uint64_t count;
+} ProfileEntry;
+
+// A frame of a sampled stack before it's formated.
+typedef struct {
+  const Function* fn;
+  uintptr_t line;
+} ProfileFrame;
+
+// A sampled stack which isn't formated yet, keyed by its frames.
+typedef struct {
+  ProfileFrame* frames; //< NULL if the slot is empty.
+  uint32_t depth;
+  uint32_t hash;
+  uint64_t count;
+} ProfilePending;
+
+// The sampling profiler. Instead of a timer signal (which isn't portable and
+// can't safely walk the fiber from a signal handler) the VM decrements the
+// [countdown] at every LOOP and CALL instruction, and once it reaches zero
+// the current fiber's frame stack is recorded.
+//
+// A sample only copies the (function, line) pairs of the frames into the
+// [pending] table. Formating them into collapsed stacks is done once per
+// unique stack when the pending samples are flushed into the [entries] (at
+// every garbage collection, since the functions could be freed after it, and
+// when the samples are written).
+typedef struct Profiler {
+  // Number of LOOP / CALL events left till the next sample.
+  int countdown;
+
+  // Number of events between two samples.
+  int interval;
+
+  // Total number of samples recorded so far.
+  uint64_t samples;
+
+  // The hash table of the aggregated stacks.
+  ProfileEntry* entries;
+  uint32_t count;
+  uint32_t capacity;
+
+  // The hash table of the samples which aren't formated yet.
+  ProfilePending* pending;
+  uint32_t pending_count;
+  uint32_t pending_capacity;
+
+  // Frames of the current sample.
+  ProfileFrame* frames;
+  uint32_t frames_count;
+  uint32_t frames_capacity;
+
+  // Scratch buffer used to build the collapsed stack of a sample.
+  char* scratch;
+  uint32_t scratch_length;
+  uint32_t scratch_capacity;
+} Profiler;
+
+// Start the sampling profiler on the [vm], a sample will be recorded once in
+// every [interval] LOOP / CALL events (if [interval] <= 0 the default
+// PROFILER_SAMPLE_INTERVAL will be used). Returns false if the profiler is
+// already running.
+bool profilerStart(VM* vm, int interval);
+
+// Record the current fiber's frame stack. This is called by the interpreter
+// once the countdown reached zero, and the top frame's ip must be updated
+// before calling this.
+void profilerSample(VM* vm);
+
+// Format the pending samples and add them to the aggregated stacks. This
+// must be called before a garbage collection frees the sampled functions.
+void profilerFlush(VM* vm);
+
+// Write the aggregated samples of the profiler in the collapsed stack format
+// ("frame;frame;frame count\n" per line) to the [buff].
+void profilerDump(VM* vm, ByteBuffer* buff);
+
+// Stop the profiler and release all of its resources. If [path] is not NULL
+// the collapsed stacks will be written to the file at [path], on failure to
+// open the file it'll return false.
+bool profilerStop(VM* vm, const char* path);
+
+// A script call site (function and line) where objects were allocated.
+typedef struct {
+  const Function* fn; //< NULL if not a script site or the function is freed.
+  int line;
+  char* label; //< Formated as "name (path:line)".
+  uint64_t count; //< Number of objects allocated.
+  uint64_t bytes; //< Number of bytes allocated (including buffer growth).
+} AllocationSite;
+
+// The allocation tracker. When it's enabled every allocation of the VM is
+// attributed to the call site (function and line of the running frame) and
+// every object to its type. The live bytes of each type are recounted by the
+// garbage collector while marking the objects.
+typedef struct MemTracker {
+  // Number of objects allocated of each type since the tracking started.
+  uint64_t allocated[OBJ_INST + 1];
+
+  // Bytes of the objects of each type alive after the last garbage
+  // collection (the live counts are in the VM's GCStats).
+  uint64_t live_bytes[OBJ_INST + 1];
+
+  // Total number of bytes allocated since the tracking started.
+  uint64_t total_bytes;
+
+  // Number of garbage collections since the tracking started, and the
+  // allocation rate (bytes per second) between the last two of them.
+  uint64_t gc_count;
+  double gc_rate;
+
+  nanotime_t start_time;
+  nanotime_t last_gc_time;
+  uint64_t last_gc_bytes;
+
+  // The allocation sites. The first site (index 0) is for allocations made
+  // outside of any script frame (compiler, core initialization etc). The
+  // [site_map] is an open addressing hash table of site indexes + 1 (zero
+  // for empty slots).
+  AllocationSite* sites;
+  uint32_t sites_count;
+  uint32_t sites_capacity;
+  uint32_t* site_map;
+  uint32_t site_map_capacity;
+} MemTracker;
+
+// Enable allocation tracking on the [vm], returns false if already enabled.
+bool memtrackStart(VM* vm);
+
+// Called by vmRealloc() for every allocation of [bytes] bytes.
+void memtrackAllocation(VM* vm, size_t bytes);
+
+// Called by varInitObject() for every new object.
+void memtrackObject(VM* vm, ObjectType type);
+
+// Called by the garbage collector before marking and after sweeping.
+void memtrackBeginGC(VM* vm);
+void memtrackEndGC(VM* vm);
+
+// Forget the sites of the function [fn] since it's being freed.
+void memtrackFreeFunction(VM* vm, const Function* fn);
+
+// Write the allocation report to the [buff].
+void memtrackDump(VM* vm, ByteBuffer* buff);
+
+// Returns the allocation statistics as a map.
+Map* memtrackToMap(VM* vm);
+
+// Disable allocation tracking and release the tracker. If [path] is not NULL
+// the report will be written to the file at [path], on failure to open the
+// file it'll return false.
+bool memtrackStop(VM* vm, const char* path);
+
+// A single garbage collection in the heap growth history of the GCStats.
+typedef struct {
+  double time;        //< Seconds since the VM was created.
+  double pause;       //< Milliseconds the collection took.
+  size_t heap_before; //< Bytes allocated before the collection.
+  size_t heap_after;  //< Bytes alive after the collection.
+} GCRecord;
+
+// Garbage collector statistics, always updated by vmCollectGarbage() since
+// it costs only a couple of counters per collection.
+typedef struct {
+  uint64_t collections;
+
+  // Pause times of the collections in milliseconds.
+  double total_pause;
+  double max_pause;
+  double last_pause;
+
+  // Bytes marked (alive) and swept (freed) by the last collection, and the
+  // total swept bytes of all the collections.
+  size_t bytes_marked;
+  size_t bytes_swept;
+  uint64_t total_swept;
+
+  // Number of objects of each type alive after the last collection.
+  uint64_t live_objects[OBJ_INST + 1];
+
+  // Ring buffer of the last GC_HISTORY_SIZE collections, the oldest one is at
+  // index [collections % GC_HISTORY_SIZE] once the buffer is full.
+  GCRecord history[GC_HISTORY_SIZE];
+
+  nanotime_t start_time;
+} GCStats;
+
+// Returns the garbage collector statistics of the [vm] as a map.
+Map* gcstatsToMap(VM* vm);
+
+#if OPCODE_STATS
+
+// The number of opcodes (OP_END is the last one).
+#define OPCODE_STATS_COUNT (OP_END + 1)
+
+// Execution counters of a single compiled function. The [label] is formated
+// as "name (path)" when the function first executed, so the counters will
+// outlive the function itself.
+typedef struct {
+  char* label;
+  uint64_t count;
+  uint64_t cycles;
+} FunctionStats;
+
+// Opcode execution statistics, only available if compiled with OPCODE_STATS.
+// The cycles of an instruction is the time till the next instruction
+// dispatched, which includes the native functions it called.
+typedef struct OpcodeStats {
+  uint64_t counts[OPCODE_STATS_COUNT];
+  uint64_t cycles[OPCODE_STATS_COUNT];
+  uint64_t pairs[OPCODE_STATS_COUNT][OPCODE_STATS_COUNT];
+
+  FunctionStats* functions;
+  int functions_count;
+  int functions_capacity;
+
+  // The last dispatched instruction, it's function and timestamp.
+  int last_op;
+  int last_fn;
+  uint64_t last_cycles;
+} OpcodeStats;
+
+// Returns the current timestamp in cycles (in nanoseconds if the platform
+// doesn't have a cycle counter).
+static inline uint64_t opstatsCycles(void) {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return (uint64_t) __rdtsc();
+#else
+  return (uint64_t) nanotime();
+#endif
+}
+
+// Allocate the opcode stats of the vm.
+void opstatsInit(VM* vm);
+
+// Returns the index of [fn] in the function stats, register if it's not.
+int opstatsFunction(VM* vm, const Function* fn);
+
+// Write the statistics as sorted tables to the [buff].
+void opstatsDump(VM* vm, ByteBuffer* buff);
+
+// Returns the statistics as a map of
+// { "opcodes": { name: [count, cycles] },
+//   "pairs": { "name name": count },
+//   "functions": { label: [count, cycles] } }.
+Map* opstatsToMap(VM* vm);
+
+// Reset all the counters.
+void opstatsReset(VM* vm);
+
+// Release the opcode stats of the vm.
+void opstatsFree(VM* vm);
+
+#endif // OPCODE_STATS
@@ -0,0 +1,1168 @@
+/*
+ * Copyright (c) 2022-2026 Mohamed Abdifatah. All rights reserved.
+ * Distributed Under The MIT License
+ */
+
+#include "saynaa_simd.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE2 0
+#endif
+
+// The AVX2 kernels are compiled with the target attribute, so the rest of the
+// sources doesn't need -mavx2 and they're only called if the CPU supports it.
+#if SIMD_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_AVX2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest and the highest set bit of a non zero [mask].
+static inline int _lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int) index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+static inline int _highestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, mask);
+  return (int) index;
+#else
+  return 31 - __builtin_clz(mask);
+#endif
+}
+
+// The SIMD substring search checks the first and the last characters of the
+// needle at every position of a block at once, and only compares the middle
+// characters of the positions where both of them matched. See:
+// http://0x80.pl/articles/simd-strfind.html
+#define MIDDLE_MATCH(p, needle, needle_len) \
+  ((needle_len) <= 2 || memcmp((p) + 1, (needle) + 1, (needle_len) - 2) == 0)
+
+// A letter is in the range [from, from + 26). Adding (128 - from) to the byte
+// moves the range to the smallest signed chars [-128, -102), so it can be
+// checked with a single signed comparison.
+#define CASE_SHIFT(from) ((char) (128 - (from)))
+#define CASE_BOUND ((char) (-128 + 26))
+
+/*****************************************************************************/
+/* SCALAR                                                                    */
+/*****************************************************************************/
+
+// The scalar kernels also used for the tails of the vectorized ones. The
+// search expects 1 <= needle_len <= haystack_len.
+
+static const char* _memMemScalar(const char* haystack, size_t haystack_len,
+                                 const char* needle, size_t needle_len) {
+  const char* last = haystack + haystack_len - needle_len;
+  const char* cur = haystack;
+
+  // memchr() is vectorized by most of the C libraries.
+  while (cur <= last) {
+    cur = (const char*) memchr(cur, needle[0], (size_t) (last - cur) + 1);
+    if (cur == NULL)
+      return NULL;
+    if (memcmp(cur + 1, needle + 1, needle_len - 1) == 0)
+      return cur;
+    cur++;
+  }
+  return NULL;
+}
+
+static const char* _memRMemScalar(const char* haystack, size_t haystack_len,
+                                  const char* needle, size_t needle_len) {
+  for (const char* cur = haystack + haystack_len - needle_len;; cur--) {
+    if (*cur == needle[0] && memcmp(cur + 1, needle + 1, needle_len - 1) == 0)
+      return cur;
+    if (cur == haystack)
+      return NULL;
+  }
+}
+
+static size_t _findCaseScalar(const char* str, size_t length, bool upper) {
+  const char from = upper ? 'A' : 'a';
+  for (size_t i = 0; i < length; i++) {
+    if ((unsigned char) (str[i] - from) < 26)
+      return i;
+  }
+  return length;
+}
+
+static void _convertCaseScalar(char* str, size_t length, bool upper) {
+  const char from = upper ? 'a' : 'A';
+  for (size_t i = 0; i < length; i++) {
+    if ((unsigned char) (str[i] - from) < 26)
+      str[i] ^= 0x20;
+  }
+}
+
+#define JSON_SPECIAL(c) ((c) == '"' || (c) == '\\' || (unsigned char) (c) < 0x20)
+#define JSON_SPACE(c) ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+
+static size_t _findJsonSpecialScalar(const char* str, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (JSON_SPECIAL(str[i]))
+      return i;
+  }
+  return length;
+}
+
+static size_t _skipJsonSpaceScalar(const char* str, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (!JSON_SPACE(str[i]))
+      return i;
+  }
+  return length;
+}
+
+// A value only replaces the current one if it's lesser (or greater), so the
+// lanes of the vectorized versions are started with the first value and the
+// result is the same as this one.
+#define MINMAX_SELECT(current, value, max) \
+  (((max) ? (current) < (value) : (value) < (current)) ? (value) : (current))
+
+// Apply the arithmetic operator [op] ('+', '-', '*' or '/') to the doubles of
+// [a] from the index [i] and the matching doubles of [b] (or [b] itself if
+// it's a scalar). The switch is outside of the loops to keep them tight.
+#define ARITH_LOOPS(i, count, expr) \
+  switch (op) { \
+    case '+': \
+      for (; i < count; i++) \
+        dst[i] = expr(+); \
+      break; \
+    case '-': \
+      for (; i < count; i++) \
+        dst[i] = expr(-); \
+      break; \
+    case '*': \
+      for (; i < count; i++) \
+        dst[i] = expr(*); \
+      break; \
+    case '/': \
+      for (; i < count; i++) \
+        dst[i] = expr(/); \
+      break; \
+  }
+
+#define ARITH_ARRAY(o) (a[i] o b[i])
+#define ARITH_SCALAR(o) (a[i] o b)
+
+static void _arithDoublesScalar(double* dst, const double* a, const double* b, size_t i,
+                                size_t count, char op) {
+  ARITH_LOOPS(i, count, ARITH_ARRAY)
+}
+
+static void _arithScalarDoublesScalar(double* dst, const double* a, double b, size_t i,
+                                      size_t count, char op) {
+  ARITH_LOOPS(i, count, ARITH_SCALAR)
+}
+
+// The floats are computed as doubles and rounded back, so the results are the
+// same as converting them to doubles first (as the other kinds do).
+#define ARITH_FLOAT_ARRAY(o) ((float) ((double) a[i] o (double) b[i]))
+#define ARITH_FLOAT_SCALAR(o) ((float) ((double) a[i] o b))
+
+static void _arithFloatsScalar(float* dst, const float* a, const float* b, size_t i,
+                               size_t count, char op) {
+  ARITH_LOOPS(i, count, ARITH_FLOAT_ARRAY)
+}
+
+static void _arithScalarFloatsScalar(float* dst, const float* a, double b, size_t i,
+                                     size_t count, char op) {
+  ARITH_LOOPS(i, count, ARITH_FLOAT_SCALAR)
+}
+
+// The integers are added as unsigned (the signed overflow is undefined) and
+// wrap around, which is the same as storing the exact sums to the arrays.
+static void _addInt32sScalar(int32_t* dst, const int32_t* a, const int32_t* b, size_t i,
+                             size_t count, bool subtract) {
+  for (; i < count; i++) {
+    uint32_t x = (uint32_t) a[i], y = (uint32_t) b[i];
+    dst[i] = (int32_t) (subtract ? x - y : x + y);
+  }
+}
+
+static void _addScalarInt32sScalar(int32_t* dst, const int32_t* a, uint32_t b, size_t i,
+                                   size_t count) {
+  for (; i < count; i++)
+    dst[i] = (int32_t) ((uint32_t) a[i] + b);
+}
+
+static void _addBytesScalar(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t i,
+                            size_t count, bool subtract) {
+  for (; i < count; i++)
+    dst[i] = (uint8_t) (subtract ? a[i] - b[i] : a[i] + b[i]);
+}
+
+static void _addScalarBytesScalar(uint8_t* dst, const uint8_t* a, uint8_t b, size_t i,
+                                  size_t count) {
+  for (; i < count; i++)
+    dst[i] = (uint8_t) (a[i] + b);
+}
+
+static uint64_t _sumBytesScalar(const uint8_t* values, size_t i, size_t count) {
+  uint64_t total = 0;
+  for (; i < count; i++)
+    total += values[i];
+  return total;
+}
+
+static uint64_t _dotBytesScalar(const uint8_t* a, const uint8_t* b, size_t i, size_t count) {
+  uint64_t total = 0;
+  for (; i < count; i++)
+    total += (uint32_t) a[i] * b[i];
+  return total;
+}
+
+// The vectorized versions handle the tails themselves.
+#if !SIMD_SSE2
+
+static double _sumDoublesScalar(const double* values, size_t count) {
+  double sum[4] = {0.0, 0.0, 0.0, 0.0};
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    sum[0] += values[i];
+    sum[1] += values[i + 1];
+    sum[2] += values[i + 2];
+    sum[3] += values[i + 3];
+  }
+  double total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+  for (; i < count; i++)
+    total += values[i];
+  return total;
+}
+
+static double _dotDoublesScalar(const double* a, const double* b, size_t count) {
+  double sum[4] = {0.0, 0.0, 0.0, 0.0};
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    sum[0] += a[i] * b[i];
+    sum[1] += a[i + 1] * b[i + 1];
+    sum[2] += a[i + 2] * b[i + 2];
+    sum[3] += a[i + 3] * b[i + 3];
+  }
+  double total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+  for (; i < count; i++)
+    total += a[i] * b[i];
+  return total;
+}
+
+static double _minMaxDoublesScalar(const double* values, size_t count, bool max) {
+  double result = values[0];
+  for (size_t i = 1; i < count; i++)
+    result = MINMAX_SELECT(result, values[i], max);
+  return result;
+}
+
+// The floats and the int32s are summed as doubles the same way as the
+// doubles, so they're exact unless the (partial) sums exceed 2^53.
+#define SUM_AS_DOUBLES(count, term) \
+  double sum[4] = {0.0, 0.0, 0.0, 0.0}; \
+  size_t i = 0; \
+  for (; i + 4 <= count; i += 4) { \
+    sum[0] += term(i); \
+    sum[1] += term(i + 1); \
+    sum[2] += term(i + 2); \
+    sum[3] += term(i + 3); \
+  } \
+  double total = (sum[0] + sum[1]) + (sum[2] + sum[3]); \
+  for (; i < count; i++) \
+    total += term(i); \
+  return total
+
+#define VALUE_TERM(i) ((double) values[i])
+#define DOT_TERM(i) ((double) a[i] * (double) b[i])
+
+static double _sumFloatsScalar(const float* values, size_t count) {
+  SUM_AS_DOUBLES(count, VALUE_TERM);
+}
+
+static double _dotFloatsScalar(const float* a, const float* b, size_t count) {
+  SUM_AS_DOUBLES(count, DOT_TERM);
+}
+
+static double _sumInt32sScalar(const int32_t* values, size_t count) {
+  SUM_AS_DOUBLES(count, VALUE_TERM);
+}
+
+static double _dotInt32sScalar(const int32_t* a, const int32_t* b, size_t count) {
+  SUM_AS_DOUBLES(count, DOT_TERM);
+}
+
+static float _minMaxFloatsScalar(const float* values, size_t count, bool max) {
+  float result = values[0];
+  for (size_t i = 1; i < count; i++)
+    result = MINMAX_SELECT(result, values[i], max);
+  return result;
+}
+
+static int32_t _minMaxInt32sScalar(const int32_t* values, size_t count, bool max) {
+  int32_t result = values[0];
+  for (size_t i = 1; i < count; i++)
+    result = MINMAX_SELECT(result, values[i], max);
+  return result;
+}
+
+static uint8_t _minMaxBytesScalar(const uint8_t* values, size_t count, bool max) {
+  uint8_t result = values[0];
+  for (size_t i = 1; i < count; i++)
+    result = MINMAX_SELECT(result, values[i], max);
+  return result;
+}
+
+#endif // !SIMD_SSE2
+
+/*****************************************************************************/
+/* SSE2                                                                      */
+/*****************************************************************************/
+
+#if SIMD_SSE2
+
+static const char* _memMemSSE2(const char* haystack, size_t haystack_len,
+                               const char* needle, size_t needle_len) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+
+  // Number of positions the needle could start at.
+  size_t count = haystack_len - needle_len + 1;
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const char* block = haystack + i;
+    __m128i block_first = _mm_loadu_si128((const __m128i*) block);
+    __m128i block_last = _mm_loadu_si128((const __m128i*) (block + needle_len - 1));
+    uint32_t mask = (uint32_t) _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+
+    while (mask != 0) {
+      const char* p = block + _lowestBit(mask);
+      if (MIDDLE_MATCH(p, needle, needle_len))
+        return p;
+      mask &= mask - 1;
+    }
+  }
+
+  if (i == count)
+    return NULL;
+  return _memMemScalar(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+static const char* _memRMemSSE2(const char* haystack, size_t haystack_len,
+                                const char* needle, size_t needle_len) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+
+  // The positions [0, count) are yet to be searched.
+  size_t count = haystack_len - needle_len + 1;
+
+  for (; count >= 16; count -= 16) {
+    const char* block = haystack + count - 16;
+    __m128i block_first = _mm_loadu_si128((const __m128i*) block);
+    __m128i block_last = _mm_loadu_si128((const __m128i*) (block + needle_len - 1));
+    uint32_t mask = (uint32_t) _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+
+    while (mask != 0) {
+      int bit = _highestBit(mask);
+      const char* p = block + bit;
+      if (MIDDLE_MATCH(p, needle, needle_len))
+        return p;
+      mask &= ~(1u << bit);
+    }
+  }
+
+  if (count == 0)
+    return NULL;
+  return _memRMemScalar(haystack, count + needle_len - 1, needle, needle_len);
+}
+
+static size_t _findCaseSSE2(const char* str, size_t length, bool upper) {
+  const __m128i shift = _mm_set1_epi8(CASE_SHIFT(upper ? 'A' : 'a'));
+  const __m128i bound = _mm_set1_epi8(CASE_BOUND);
+
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chars = _mm_add_epi8(_mm_loadu_si128((const __m128i*) (str + i)), shift);
+    uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmplt_epi8(chars, bound));
+    if (mask != 0)
+      return i + _lowestBit(mask);
+  }
+  return i + _findCaseScalar(str + i, length - i, upper);
+}
+
+static void _convertCaseSSE2(char* str, size_t length, bool upper) {
+  const __m128i shift = _mm_set1_epi8(CASE_SHIFT(upper ? 'a' : 'A'));
+  const __m128i bound = _mm_set1_epi8(CASE_BOUND);
+  const __m128i flip = _mm_set1_epi8(0x20);
+
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*) (str + i));
+    __m128i letters = _mm_cmplt_epi8(_mm_add_epi8(chars, shift), bound);
+    chars = _mm_xor_si128(chars, _mm_and_si128(letters, flip));
+    _mm_storeu_si128((__m128i*) (str + i), chars);
+  }
+  _convertCaseScalar(str + i, length - i, upper);
+}
+
+// The control characters are the bytes which are unchanged by an unsigned
+// max with 0x1f.
+static size_t _findJsonSpecialSSE2(const char* str, size_t length) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*) (str + i));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chars, quote),
+                                   _mm_cmpeq_epi8(chars, backslash));
+    special = _mm_or_si128(special,
+                           _mm_cmpeq_epi8(_mm_max_epu8(chars, control), control));
+    uint32_t mask = (uint32_t) _mm_movemask_epi8(special);
+    if (mask != 0)
+      return i + _lowestBit(mask);
+  }
+  return i + _findJsonSpecialScalar(str + i, length - i);
+}
+
+static size_t _skipJsonSpaceSSE2(const char* str, size_t length) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*) (str + i));
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                                 _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+    space = _mm_or_si128(space, _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')));
+    space = _mm_or_si128(space, _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+    uint32_t mask = (uint32_t) _mm_movemask_epi8(space) ^ 0xffff;
+    if (mask != 0)
+      return i + _lowestBit(mask);
+  }
+  return i + _skipJsonSpaceScalar(str + i, length - i);
+}
+
+static double _sumDoublesSSE2(const double* values, size_t count) {
+  __m128d sum01 = _mm_setzero_pd(), sum23 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    sum01 = _mm_add_pd(sum01, _mm_loadu_pd(values + i));
+    sum23 = _mm_add_pd(sum23, _mm_loadu_pd(values + i + 2));
+  }
+
+  double sum[4];
+  _mm_storeu_pd(sum, sum01);
+  _mm_storeu_pd(sum + 2, sum23);
+  double total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+  for (; i < count; i++)
+    total += values[i];
+  return total;
+}
+
+static double _dotDoublesSSE2(const double* a, const double* b, size_t count) {
+  __m128d sum01 = _mm_setzero_pd(), sum23 = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    sum01 = _mm_add_pd(sum01, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    sum23 = _mm_add_pd(sum23, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+  }
+
+  double sum[4];
+  _mm_storeu_pd(sum, sum01);
+  _mm_storeu_pd(sum + 2, sum23);
+  double total = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+  for (; i < count; i++)
+    total += a[i] * b[i];
+  return total;
+}
+
+static double _minMaxDoublesSSE2(const double* values, size_t count, bool max) {
+  // _mm_min_pd(a, b) is (a < b) ? a : b and _mm_max_pd(a, b) is (a > b) ? a : b
+  // which are the same as MINMAX_SELECT(b, a, max).
+  __m128d result01 = _mm_set1_pd(values[0]), result23 = result01;
+  size_t i = 0;
+  if (max) {
+    for (; i + 4 <= count; i += 4) {
+      result01 = _mm_max_pd(_mm_loadu_pd(values + i), result01);
+      result23 = _mm_max_pd(_mm_loadu_pd(values + i + 2), result23);
+    }
+  } else {
+    for (; i + 4 <= count; i += 4) {
+      result01 = _mm_min_pd(_mm_loadu_pd(values + i), result01);
+      result23 = _mm_min_pd(_mm_loadu_pd(values + i + 2), result23);
+    }
+  }
+
+  double lanes[4];
+  _mm_storeu_pd(lanes, result01);
+  _mm_storeu_pd(lanes + 2, result23);
+  double result = lanes[0];
+  for (int lane = 1; lane < 4; lane++)
+    result = MINMAX_SELECT(result, lanes[lane], max);
+  for (; i < count; i++)
+    result = MINMAX_SELECT(result, values[i], max);
+  return result;
+}
+
+// Vector version of ARITH_LOOPS(), the tails are done by the scalar kernels.
+#define ARITH_LOOPS_SSE2(load_b) \
+  switch (op) { \
+    case '+': \
+      for (; i + 2 <= count; i += 2) \
+        _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(a + i), load_b)); \
+      break; \
+    case '-': \
+      for (; i + 2 <= count; i += 2) \
+        _mm_storeu_pd(dst + i, _mm_sub_pd(_mm_loadu_pd(a + i), load_b)); \
+      break; \
+    case '*': \
+      for (; i + 2 <= count; i += 2) \
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i), load_b)); \
+      break; \
+    case '/': \
+      for (; i + 2 <= count; i += 2) \
+        _mm_storeu_pd(dst + i, _mm_div_pd(_mm_loadu_pd(a + i), load_b)); \
+      break; \
+  }
+
+static void _arithDoublesSSE2(double* dst, const double* a, const double* b, size_t count,
+                              char op) {
+  size_t i = 0;
+  ARITH_LOOPS_SSE2(_mm_loadu_pd(b + i))
+  _arithDoublesScalar(dst, a, b, i, count, op);
+}
+
+static void _arithScalarDoublesSSE2(double* dst, const double* a, double b, size_t count,
+                                    char op) {
+  const __m128d scalar = _mm_set1_pd(b);
+  size_t i = 0;
+  ARITH_LOOPS_SSE2(scalar)
+  _arithScalarDoublesScalar(dst, a, b, i, count, op);
+}
+
+// The floats and the int32s are converted to doubles 2 at a time and summed
+// in the same partial sums as _sumDoublesSSE2().
+#define SUM_AS_DOUBLES_SSE2(count, load_lo, load_hi, term) \
+  __m128d sum01 = _mm_setzero_pd(), sum23 = _mm_setzero_pd(); \
+  size_t i = 0; \
+  for (; i + 4 <= count; i += 4) { \
+    sum01 = _mm_add_pd(sum01, load_lo); \
+    sum23 = _mm_add_pd(sum23, load_hi); \
+  } \
+  double sum[4]; \
+  _mm_storeu_pd(sum, sum01); \
+  _mm_storeu_pd(sum + 2, sum23); \
+  double total = (sum[0] + sum[1]) + (sum[2] + sum[3]); \
+  for (; i < count; i++) \
+    total += term(i); \
+  return total
+
+// Load 2 floats (or int32s) from [p] and convert them to doubles.
+#define LOAD_FLOATS_PD(p) \
+  _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (p))))
+#define LOAD_INT32S_PD(p) _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*) (p)))
+
+#define VALUE_TERM(i) ((double) values[i])
+#define DOT_TERM(i) ((double) a[i] * (double) b[i])
+
+static double _sumFloatsSSE2(const float* values, size_t count) {
+  SUM_AS_DOUBLES_SSE2(count, LOAD_FLOATS_PD(values + i), LOAD_FLOATS_PD(values + i + 2),
+                      VALUE_TERM);
+}
+
+static double _dotFloatsSSE2(const float* a, const float* b, size_t count) {
+  SUM_AS_DOUBLES_SSE2(count,
+                      _mm_mul_pd(LOAD_FLOATS_PD(a + i), LOAD_FLOATS_PD(b + i)),
+                      _mm_mul_pd(LOAD_FLOATS_PD(a + i + 2), LOAD_FLOATS_PD(b + i + 2)),
+                      DOT_TERM);
+}
+
+static double _sumInt32sSSE2(const int32_t* values, size_t count) {
+  SUM_AS_DOUBLES_SSE2(count, LOAD_INT32S_PD(values + i), LOAD_INT32S_PD(values + i + 2),
+                      VALUE_TERM);
+}
+
+static double _dotInt32sSSE2(const int32_t* a, const int32_t* b, size_t count) {
+  SUM_AS_DOUBLES_SSE2(count,
+                      _mm_mul_pd(LOAD_INT32S_PD(a + i), LOAD_INT32S_PD(b + i)),
+                      _mm_mul_pd(LOAD_INT32S_PD(a + i + 2), LOAD_INT32S_PD(b + i + 2)),
+                      DOT_TERM);
+}
+
+static float _minMaxFloatsSSE2(const float* values, size_t count, bool max) {
+  // Same as _minMaxDoublesSSE2() with 4 floats per vector.
+  __m128 result = _mm_set1_ps(values[0]);
+  size_t i = 0;
+  if (max) {
+    for (; i + 4 <= count; i += 4)
+      result = _mm_max_ps(_mm_loadu_ps(values + i), result);
+  } else {
+    for (; i + 4 <= count; i += 4)
+      result = _mm_min_ps(_mm_loadu_ps(values + i), result);
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, result);
+  float value = lanes[0];
+  for (int lane = 1; lane < 4; lane++)
+    value = MINMAX_SELECT(value, lanes[lane], max);
+  for (; i < count; i++)
+    value = MINMAX_SELECT(value, values[i], max);
+  return value;
+}
+
+static int32_t _minMaxInt32sSSE2(const int32_t* values, size_t count, bool max) {
+  // SSE2 doesn't have the int32 min and max (pminsd is SSE4.1), so the lanes
+  // are selected with the mask of the comparison.
+  __m128i result = _mm_set1_epi32(values[0]);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*) (values + i));
+    __m128i mask = max ? _mm_cmpgt_epi32(chunk, result) : _mm_cmpgt_epi32(result, chunk);
+    result = _mm_or_si128(_mm_and_si128(mask, chunk), _mm_andnot_si128(mask, result));
+  }
+
+  int32_t lanes[4];
+  _mm_storeu_si128((__m128i*) lanes, result);
+  int32_t value = lanes[0];
+  for (int lane = 1; lane < 4; lane++)
+    value = MINMAX_SELECT(value, lanes[lane], max);
+  for (; i < count; i++)
+    value = MINMAX_SELECT(value, values[i], max);
+  return value;
+}
+
+static uint8_t _minMaxBytesSSE2(const uint8_t* values, size_t count, bool max) {
+  __m128i result = _mm_set1_epi8((char) values[0]);
+  size_t i = 0;
+  if (max) {
+    for (; i + 16 <= count; i += 16)
+      result = _mm_max_epu8(result, _mm_loadu_si128((const __m128i*) (values + i)));
+  } else {
+    for (; i + 16 <= count; i += 16)
+      result = _mm_min_epu8(result, _mm_loadu_si128((const __m128i*) (values + i)));
+  }
+
+  uint8_t lanes[16];
+  _mm_storeu_si128((__m128i*) lanes, result);
+  uint8_t value = lanes[0];
+  for (int lane = 1; lane < 16; lane++)
+    value = MINMAX_SELECT(value, lanes[lane], max);
+  for (; i < count; i++)
+    value = MINMAX_SELECT(value, values[i], max);
+  return value;
+}
+
+static uint64_t _sumBytesSSE2(const uint8_t* values, size_t count) {
+  // psadbw against zero sums each half of the 16 bytes to a 64 bit lane.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum = zero;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*) (values + i));
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(chunk, zero));
+  }
+
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*) lanes, sum);
+  return lanes[0] + lanes[1] + _sumBytesScalar(values, i, count);
+}
+
+static uint64_t _dotBytesSSE2(const uint8_t* a, const uint8_t* b, size_t count) {
+  // The bytes are widened to int16 and pmaddwd sums the products of each pair
+  // to an int32 (at most 2 * 255 * 255), which are widened again to 64 bits
+  // so the sum can't overflow.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum = zero;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+    __m128i products = _mm_add_epi32(
+        _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero)),
+        _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero)));
+    sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(products, zero));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(products, zero));
+  }
+
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*) lanes, sum);
+  return lanes[0] + lanes[1] + _dotBytesScalar(a, b, i, count);
+}
+
+// Vector version of ARITH_LOOPS() for the floats, 4 of them are converted to
+// 2 vectors of doubles and the results are rounded back.
+#define ARITH_FLOATS_SSE2(op_pd, b_lo, b_hi) \
+  for (; i + 4 <= count; i += 4) { \
+    __m128 chunk = _mm_loadu_ps(a + i); \
+    __m128d lo = op_pd(_mm_cvtps_pd(chunk), b_lo); \
+    __m128d hi = op_pd(_mm_cvtps_pd(_mm_movehl_ps(chunk, chunk)), b_hi); \
+    _mm_storeu_ps(dst + i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi))); \
+  }
+
+#define ARITH_FLOATS_LOOPS_SSE2(b_lo, b_hi) \
+  switch (op) { \
+    case '+': \
+      ARITH_FLOATS_SSE2(_mm_add_pd, b_lo, b_hi) \
+      break; \
+    case '-': \
+      ARITH_FLOATS_SSE2(_mm_sub_pd, b_lo, b_hi) \
+      break; \
+    case '*': \
+      ARITH_FLOATS_SSE2(_mm_mul_pd, b_lo, b_hi) \
+      break; \
+    case '/': \
+      ARITH_FLOATS_SSE2(_mm_div_pd, b_lo, b_hi) \
+      break; \
+  }
+
+static void _arithFloatsSSE2(float* dst, const float* a, const float* b, size_t count,
+                             char op) {
+  size_t i = 0;
+  ARITH_FLOATS_LOOPS_SSE2(LOAD_FLOATS_PD(b + i), LOAD_FLOATS_PD(b + i + 2))
+  _arithFloatsScalar(dst, a, b, i, count, op);
+}
+
+static void _arithScalarFloatsSSE2(float* dst, const float* a, double b, size_t count,
+                                   char op) {
+  const __m128d scalar = _mm_set1_pd(b);
+  size_t i = 0;
+  ARITH_FLOATS_LOOPS_SSE2(scalar, scalar)
+  _arithScalarFloatsScalar(dst, a, b, i, count, op);
+}
+
+static void _addInt32sSSE2(int32_t* dst, const int32_t* a, const int32_t* b, size_t count,
+                           bool subtract) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+    _mm_storeu_si128((__m128i*) (dst + i),
+                     subtract ? _mm_sub_epi32(x, y) : _mm_add_epi32(x, y));
+  }
+  _addInt32sScalar(dst, a, b, i, count, subtract);
+}
+
+static void _addScalarInt32sSSE2(int32_t* dst, const int32_t* a, uint32_t b, size_t count) {
+  const __m128i scalar = _mm_set1_epi32((int32_t) b);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_add_epi32(x, scalar));
+  }
+  _addScalarInt32sScalar(dst, a, b, i, count);
+}
+
+static void _addBytesSSE2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t count,
+                          bool subtract) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+    _mm_storeu_si128((__m128i*) (dst + i),
+                     subtract ? _mm_sub_epi8(x, y) : _mm_add_epi8(x, y));
+  }
+  _addBytesScalar(dst, a, b, i, count, subtract);
+}
+
+static void _addScalarBytesSSE2(uint8_t* dst, const uint8_t* a, uint8_t b, size_t count) {
+  const __m128i scalar = _mm_set1_epi8((char) b);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_add_epi8(x, scalar));
+  }
+  _addScalarBytesScalar(dst, a, b, i, count);
+}
+
+#endif // SIMD_SSE2
+
+/*****************************************************************************/
+/* AVX2                                                                      */
+/*****************************************************************************/
+
+#if SIMD_AVX2
+
+static bool _hasAVX2(void) {
+  static int has_avx2 = -1;
+  if (has_avx2 < 0) {
+    __builtin_cpu_init();
+    has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return has_avx2 == 1;
+}
+
+TARGET_AVX2
+static const char* _memMemAVX2(const char* haystack, size_t haystack_len,
+                               const char* needle, size_t needle_len) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+
+  size_t count = haystack_len - needle_len + 1;
+
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    const char* block = haystack + i;
+    __m256i block_first = _mm256_loadu_si256((const __m256i*) block);
+    __m256i block_last = _mm256_loadu_si256((const __m256i*) (block + needle_len - 1));
+    uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+
+    while (mask != 0) {
+      const char* p = block + _lowestBit(mask);
+      if (MIDDLE_MATCH(p, needle, needle_len))
+        return p;
+      mask &= mask - 1;
+    }
+  }
+
+  if (i == count)
+    return NULL;
+  return _memMemSSE2(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+TARGET_AVX2
+static const char* _memRMemAVX2(const char* haystack, size_t haystack_len,
+                                const char* needle, size_t needle_len) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+
+  size_t count = haystack_len - needle_len + 1;
+
+  for (; count >= 32; count -= 32) {
+    const char* block = haystack + count - 32;
+    __m256i block_first = _mm256_loadu_si256((const __m256i*) block);
+    __m256i block_last = _mm256_loadu_si256((const __m256i*) (block + needle_len - 1));
+    uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+
+    while (mask != 0) {
+      int bit = _highestBit(mask);
+      const char* p = block + bit;
+      if (MIDDLE_MATCH(p, needle, needle_len))
+        return p;
+      mask &= ~(1u << bit);
+    }
+  }
+
+  if (count == 0)
+    return NULL;
+  return _memRMemSSE2(haystack, count + needle_len - 1, needle, needle_len);
+}
+
+TARGET_AVX2
+static size_t _findCaseAVX2(const char* str, size_t length, bool upper) {
+  const __m256i shift = _mm256_set1_epi8(CASE_SHIFT(upper ? 'A' : 'a'));
+  const __m256i bound = _mm256_set1_epi8(CASE_BOUND);
+
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i chars = _mm256_add_epi8(_mm256_loadu_si256((const __m256i*) (str + i)), shift);
+    uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpgt_epi8(bound, chars));
+    if (mask != 0)
+      return i + _lowestBit(mask);
+  }
+  return i + _findCaseSSE2(str + i, length - i, upper);
+}
+
+TARGET_AVX2
+static void _convertCaseAVX2(char* str, size_t length, bool upper) {
+  const __m256i shift = _mm256_set1_epi8(CASE_SHIFT(upper ? 'a' : 'A'));
+  const __m256i bound = _mm256_set1_epi8(CASE_BOUND);
+  const __m256i flip = _mm256_set1_epi8(0x20);
+
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i chars = _mm256_loadu_si256((const __m256i*) (str + i));
+    __m256i letters = _mm256_cmpgt_epi8(bound, _mm256_add_epi8(chars, shift));
+    chars = _mm256_xor_si256(chars, _mm256_and_si256(letters, flip));
+    _mm256_storeu_si256((__m256i*) (str + i), chars);
+  }
+  _convertCaseSSE2(str + i, length - i, upper);
+}
+
+TARGET_AVX2
+static size_t _findJsonSpecialAVX2(const char* str, size_t length) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i control = _mm256_set1_epi8(0x1f);
+
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i chars = _mm256_loadu_si256((const __m256i*) (str + i));
+    __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(chars, quote),
+                                      _mm256_cmpeq_epi8(chars, backslash));
+    special = _mm256_or_si256(
+        special, _mm256_cmpeq_epi8(_mm256_max_epu8(chars, control), control));
+    uint32_t mask = (uint32_t) _mm256_movemask_epi8(special);
+    if (mask != 0)
+      return i + _lowestBit(mask);
+  }
+  return i + _findJsonSpecialSSE2(str + i, length - i);
+}
+
+#endif // SIMD_AVX2
+
+/*****************************************************************************/
+/* DISPATCH                                                                  */
+/*****************************************************************************/
+
+const char* simdMemMem(const char* haystack, size_t haystack_len, const char* needle,
+                       size_t needle_len) {
+  if (needle_len == 0 || haystack_len < needle_len)
+    return NULL;
+  if (needle_len == 1)
+    return (const char*) memchr(haystack, needle[0], haystack_len);
+
+#if SIMD_AVX2
+  if (_hasAVX2())
+    return _memMemAVX2(haystack, haystack_len, needle, needle_len);
+#endif
+#if SIMD_SSE2
+  return _memMemSSE2(haystack, haystack_len, needle, needle_len);
+#else
+  return _memMemScalar(haystack, haystack_len, needle, needle_len);
+#endif
+}
+
+const char* simdMemRMem(const char* haystack, size_t haystack_len, const char* needle,
+                        size_t needle_len) {
+  if (needle_len == 0 || haystack_len < needle_len)
+    return NULL;
+
+#if SIMD_AVX2
+  if (_hasAVX2())
+    return _memRMemAVX2(haystack, haystack_len, needle, needle_len);
+#endif
+#if SIMD_SSE2
+  return _memRMemSSE2(haystack, haystack_len, needle, needle_len);
+#else
+  return _memRMemScalar(haystack, haystack_len, needle, needle_len);
+#endif
+}
+
+size_t simdFindCase(const char* str, size_t length, bool upper) {
+#if SIMD_AVX2
+  if (_hasAVX2())
+    return _findCaseAVX2(str, length, upper);
+#endif
+#if SIMD_SSE2
+  return _findCaseSSE2(str, length, upper);
+#else
+  return _findCaseScalar(str, length, upper);
+#endif
+}
+
+void simdConvertCase(char* str, size_t length, bool upper) {
+#if SIMD_AVX2
+  if (_hasAVX2()) {
+    _convertCaseAVX2(str, length, upper);
+    return;
+  }
+#endif
+#if SIMD_SSE2
+  _convertCaseSSE2(str, length, upper);
+#else
+  _convertCaseScalar(str, length, upper);
+#endif
+}
+
+size_t simdFindJsonSpecial(const char* str, size_t length) {
+#if SIMD_AVX2
+  if (_hasAVX2())
+    return _findJsonSpecialAVX2(str, length);
+#endif
+#if SIMD_SSE2
+  return _findJsonSpecialSSE2(str, length);
+#else
+  return _findJsonSpecialScalar(str, length);
+#endif
+}
+
+// The white space runs of a json are mostly short indentations, so there is
+// no AVX2 version.
+size_t simdSkipJsonSpace(const char* str, size_t length) {
+#if SIMD_SSE2
+  return _skipJsonSpaceSSE2(str, length);
+#else
+  return _skipJsonSpaceScalar(str, length);
+#endif
+}
+
+double simdSumDoubles(const double* values, size_t count) {
+#if SIMD_SSE2
+  return _sumDoublesSSE2(values, count);
+#else
+  return _sumDoublesScalar(values, count);
+#endif
+}
+
+double simdDotDoubles(const double* a, const double* b, size_t count) {
+#if SIMD_SSE2
+  return _dotDoublesSSE2(a, b, count);
+#else
+  return _dotDoublesScalar(a, b, count);
+#endif
+}
+
+double simdMinMaxDoubles(const double* values, size_t count, bool max) {
+#if SIMD_SSE2
+  return _minMaxDoublesSSE2(values, count, max);
+#else
+  return _minMaxDoublesScalar(values, count, max);
+#endif
+}
+
+void simdArithDoubles(double* dst, const double* a, const double* b, size_t count, char op) {
+#if SIMD_SSE2
+  _arithDoublesSSE2(dst, a, b, count, op);
+#else
+  _arithDoublesScalar(dst, a, b, 0, count, op);
+#endif
+}
+
+void simdArithScalarDoubles(double* dst, const double* a, double b, size_t count, char op) {
+#if SIMD_SSE2
+  _arithScalarDoublesSSE2(dst, a, b, count, op);
+#else
+  _arithScalarDoublesScalar(dst, a, b, 0, count, op);
+#endif
+}
+
+double simdSumFloats(const float* values, size_t count) {
+#if SIMD_SSE2
+  return _sumFloatsSSE2(values, count);
+#else
+  return _sumFloatsScalar(values, count);
+#endif
+}
+
+double simdDotFloats(const float* a, const float* b, size_t count) {
+#if SIMD_SSE2
+  return _dotFloatsSSE2(a, b, count);
+#else
+  return _dotFloatsScalar(a, b, count);
+#endif
+}
+
+float simdMinMaxFloats(const float* values, size_t count, bool max) {
+#if SIMD_SSE2
+  return _minMaxFloatsSSE2(values, count, max);
+#else
+  return _minMaxFloatsScalar(values, count, max);
+#endif
+}
+
+void simdArithFloats(float* dst, const float* a, const float* b, size_t count, char op) {
+#if SIMD_SSE2
+  _arithFloatsSSE2(dst, a, b, count, op);
+#else
+  _arithFloatsScalar(dst, a, b, 0, count, op);
+#endif
+}
+
+void simdArithScalarFloats(float* dst, const float* a, double b, size_t count, char op) {
+#if SIMD_SSE2
+  _arithScalarFloatsSSE2(dst, a, b, count, op);
+#else
+  _arithScalarFloatsScalar(dst, a, b, 0, count, op);
+#endif
+}
+
+double simdSumInt32s(const int32_t* values, size_t count) {
+#if SIMD_SSE2
+  return _sumInt32sSSE2(values, count);
+#else
+  return _sumInt32sScalar(values, count);
+#endif
+}
+
+double simdDotInt32s(const int32_t* a, const int32_t* b, size_t count) {
+#if SIMD_SSE2
+  return _dotInt32sSSE2(a, b, count);
+#else
+  return _dotInt32sScalar(a, b, count);
+#endif
+}
+
+int32_t simdMinMaxInt32s(const int32_t* values, size_t count, bool max) {
+#if SIMD_SSE2
+  return _minMaxInt32sSSE2(values, count, max);
+#else
+  return _minMaxInt32sScalar(values, count, max);
+#endif
+}
+
+void simdAddInt32s(int32_t* dst, const int32_t* a, const int32_t* b, size_t count,
+                   bool subtract) {
+#if SIMD_SSE2
+  _addInt32sSSE2(dst, a, b, count, subtract);
+#else
+  _addInt32sScalar(dst, a, b, 0, count, subtract);
+#endif
+}
+
+void simdAddScalarInt32s(int32_t* dst, const int32_t* a, uint32_t b, size_t count) {
+#if SIMD_SSE2
+  _addScalarInt32sSSE2(dst, a, b, count);
+#else
+  _addScalarInt32sScalar(dst, a, b, 0, count);
+#endif
+}
+
+uint64_t simdSumBytes(const uint8_t* values, size_t count) {
+#if SIMD_SSE2
+  return _sumBytesSSE2(values, count);
+#else
+  return _sumBytesScalar(values, 0, count);
+#endif
+}
+
+uint64_t simdDotBytes(const uint8_t* a, const uint8_t* b, size_t count) {
+#if SIMD_SSE2
+  return _dotBytesSSE2(a, b, count);
+#else
+  return _dotBytesScalar(a, b, 0, count);
+#endif
+}
+
+uint8_t simdMinMaxBytes(const uint8_t* values, size_t count, bool max) {
+#if SIMD_SSE2
+  return _minMaxBytesSSE2(values, count, max);
+#else
+  return _minMaxBytesScalar(values, count, max);
+#endif
+}
+
+void simdAddBytes(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t count,
+                  bool subtract) {
+#if SIMD_SSE2
+  _addBytesSSE2(dst, a, b, count, subtract);
+#else
+  _addBytesScalar(dst, a, b, 0, count, subtract);
+#endif
+}
+
+void simdAddScalarBytes(uint8_t* dst, const uint8_t* a, uint8_t b, size_t count) {
+#if SIMD_SSE2
+  _addScalarBytesSSE2(dst, a, b, count);
+#else
+  _addScalarBytesScalar(dst, a, b, 0, count);
+#endif
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2022-2026 Mohamed Abdifatah. All rights reserved.
+ * Distributed Under The MIT License
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Vectorized kernels of the string and list operations. On x86 they process
+// 16 bytes at a time with SSE2 (always available on x86-64), or 32 bytes with
+// AVX2 if the CPU supports it (detected at runtime, only with GCC and Clang).
+// On the other platforms the scalar fallbacks are used. The string kernels
+// work on raw bytes (ASCII for the case mapping) and don't expect null
+// terminated strings.
+
+// Returns a pointer to the first occurrence of the [needle] in the
+// [haystack], or NULL if it's not found or the [needle] is empty.
+const char* simdMemMem(const char* haystack, size_t haystack_len, const char* needle,
+                       size_t needle_len);
+
+// Returns a pointer to the last occurrence of the [needle] in the [haystack],
+// or NULL if it's not found or the [needle] is empty.
+const char* simdMemRMem(const char* haystack, size_t haystack_len, const char* needle,
+                        size_t needle_len);
+
+// Returns the index of the first upper case (if [upper] is true) or lower
+// case ASCII letter in the [length] bytes of [str], or [length] if there
+// isn't any.
+size_t simdFindCase(const char* str, size_t length, bool upper);
+
+// Convert the ASCII letters of the [length] bytes of [str] to upper case (if
+// [upper] is true) or lower case, in place.
+void simdConvertCase(char* str, size_t length, bool upper);
+
+// Returns the index of the first double quote, backslash or control
+// character (< 0x20) in the [length] bytes of [str], or [length] if there
+// isn't any. These are the bytes that end a plain run of a json string.
+size_t simdFindJsonSpecial(const char* str, size_t length);
+
+// Returns the index of the first byte of [str] which isn't a json white space
+// (space, tab, line feed or carriage return), or [length] if there isn't any.
+size_t simdSkipJsonSpace(const char* str, size_t length);
+
+// Returns the sum of the [count] doubles of [values]. They're added in 4
+// interleaved partial sums which are added together at the end, the same way
+// on every platform so the result doesn't depend on the CPU.
+double simdSumDoubles(const double* values, size_t count);
+
+// Returns the dot product of the [count] doubles of [a] and [b], added the
+// same way as simdSumDoubles().
+double simdDotDoubles(const double* a, const double* b, size_t count);
+
+// Returns the minimum (or the maximum if [max] is true) of the [count] (> 0)
+// doubles of [values]. A NaN is only returned if it's the first value.
+double simdMinMaxDoubles(const double* values, size_t count, bool max);
+
+// Set each of the [count] doubles of [dst] to the matching double of [a]
+// [op] the one of [b], where [op] is one of '+', '-', '*' or '/'. [dst] can
+// be the same as [a] or [b] but they shouldn't overlap otherwise.
+void simdArithDoubles(double* dst, const double* a, const double* b, size_t count, char op);
+
+// Same as simdArithDoubles() with the scalar [b] as the right operand.
+void simdArithScalarDoubles(double* dst, const double* a, double b, size_t count, char op);
+
+// The float kernels are the same as the double ones. The floats are converted
+// to doubles, and the arithmetic results are rounded back to floats, so they
+// match converting each value to a double.
+double simdSumFloats(const float* values, size_t count);
+double simdDotFloats(const float* a, const float* b, size_t count);
+float simdMinMaxFloats(const float* values, size_t count, bool max);
+void simdArithFloats(float* dst, const float* a, const float* b, size_t count, char op);
+void simdArithScalarFloats(float* dst, const float* a, double b, size_t count, char op);
+
+// The int32 sums and dot products are added as doubles the same way as
+// simdSumDoubles(). The additions (and the subtractions if [subtract] is
+// true) wrap around on overflow. Subtracting a scalar is adding its negation.
+double simdSumInt32s(const int32_t* values, size_t count);
+double simdDotInt32s(const int32_t* a, const int32_t* b, size_t count);
+int32_t simdMinMaxInt32s(const int32_t* values, size_t count, bool max);
+void simdAddInt32s(int32_t* dst, const int32_t* a, const int32_t* b, size_t count,
+                   bool subtract);
+void simdAddScalarInt32s(int32_t* dst, const int32_t* a, uint32_t b, size_t count);
+
+// Same as the int32 kernels for the bytes, the sums and the dot products are
+// exact.
+uint64_t simdSumBytes(const uint8_t* values, size_t count);
+uint64_t simdDotBytes(const uint8_t* a, const uint8_t* b, size_t count);
+uint8_t simdMinMaxBytes(const uint8_t* values, size_t count, bool max);
+void simdAddBytes(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t count,
+                  bool subtract);
+void simdAddScalarBytes(uint8_t* dst, const uint8_t* a, uint8_t b, size_t count);
@@ -4,6 +4,7 @@
  */
 
 #include "saynaa_utils.h"
+#include "saynaa_simd.h"
 
 #include <assert.h>
 #include <ctype.h>
@@ -88,25 +89,7 @@ double millitime(nanotime_t tstart, nanotime_t tend) {
 }
 
 const void* utilMemMem(const void* l, size_t l_len, const void* s, size_t s_len) {
-  const char* cl = (const char*) l;
-  const char* cs = (const char*) s;
-  const char* cur;
-  const char* last;
-
-  if (l_len == 0 || s_len == 0)
-    return NULL;
-  if (l_len < s_len)
-    return NULL;
-  if (s_len == 1)
-    return memchr(l, (int) *cs, l_len);
-
-  last = cl + l_len - s_len;
-
-  for (cur = cl; cur <= last; cur++) {
-    if (cur[0] == cs[0] && memcmp(cur, cs, s_len) == 0)
-      return cur;
-  }
-  return NULL;
+  return simdMemMem((const char*) l, l_len, (const char*) s, s_len);
 }
 
 // Function implementation, see utils.h for description.
@@ -217,7 +200,7 @@ uint32_t utilHashNumber(double num) {
 }
 
 // Function implementation, see utils.h for description.
-uint32_t utilHashString(const char* string) {
+uint32_t utilHashStringFNV(const char* string, uint32_t length) {
   // FNV-1a hash. See: http://www.isthe.com/chongo/tech/comp/fnv/
 
 #define FNV_prime_32_bit 16777619u
@@ -225,7 +208,7 @@ uint32_t utilHashString(const char* string) {
 
   uint32_t hash = FNV_offset_basis_32_bit;
 
-  for (const char* c = string; *c != '\0'; c++) {
+  for (const char* c = string; c < string + length; c++) {
     hash ^= *c;
     hash *= FNV_prime_32_bit;
   }
@@ -236,6 +219,61 @@ uint32_t utilHashString(const char* string) {
 #undef FNV_offset_basis_32_bit
 }
 
+// Read 8 bytes at [p] as a little endian word, so the string hashes are the
+// same on every platform. Compilers turn it into a single load.
+static inline uint64_t _readWord(const uint8_t* p) {
+  return (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16)
+         | ((uint64_t) p[3] << 24) | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40)
+         | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+// Function implementation, see utils.h for description.
+uint32_t utilHashString(const char* string, uint32_t length) {
+  // MurmurHash64A (public domain) which hashes 8 bytes at a time.
+  // See: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp
+  // Note that the CHECK_HASH() values are computed with this function (and
+  // util/check.py verifies them), update them if it's changed.
+
+#define MURMUR_M 0xc6a4a7935bd1e995ull
+#define MURMUR_R 47
+
+  const uint8_t* data = (const uint8_t*) string;
+  const uint8_t* end = data + (length & ~7u);
+  uint64_t hash = (uint64_t) length * MURMUR_M;
+
+  for (; data < end; data += 8) {
+    uint64_t word = _readWord(data);
+    word *= MURMUR_M;
+    word ^= word >> MURMUR_R;
+    word *= MURMUR_M;
+    hash ^= word;
+    hash *= MURMUR_M;
+  }
+
+  switch (length & 7) {
+    case 7: hash ^= (uint64_t) data[6] << 48; // fallthrough
+    case 6: hash ^= (uint64_t) data[5] << 40; // fallthrough
+    case 5: hash ^= (uint64_t) data[4] << 32; // fallthrough
+    case 4: hash ^= (uint64_t) data[3] << 24; // fallthrough
+    case 3: hash ^= (uint64_t) data[2] << 16; // fallthrough
+    case 2: hash ^= (uint64_t) data[1] << 8;  // fallthrough
+    case 1:
+      hash ^= (uint64_t) data[0];
+      hash *= MURMUR_M;
+  }
+
+  hash ^= hash >> MURMUR_R;
+  hash *= MURMUR_M;
+  hash ^= hash >> MURMUR_R;
+
+  // Zero is reserved for the strings that aren't hashed yet.
+  uint32_t result = (uint32_t) (hash ^ (hash >> 32));
+  return (result != 0) ? result : 1;
+
+#undef MURMUR_M
+#undef MURMUR_R
+}
+
 const char* utilToNumber(const char* str, double* num) {
 #define IS_HEX_CHAR(c) \
   (('0' <= (c) && (c) <= '9') || ('a' <= (c) && (c) <= 'f'))
@@ -417,7 +455,7 @@ int utf8_encodeValue(int value, uint8_t* bytes) {
   // first 5 bit write to first byte
   if (value <= 0x7ff) {
     *(bytes++) = (uint8_t) (0b11000000 | ((value & 0b11111000000) >> 6));
-    *(bytes) = (uint8_t) (0b10000000 | ((value & 111111)));
+    *(bytes) = (uint8_t) (0b10000000 | ((value & 0b111111)));
     return 2;
   }
 
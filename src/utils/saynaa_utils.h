@@ -83,8 +83,14 @@ uint32_t utilHashBits(uint64_t hash);
 // Generates a hash code for [num].
 uint32_t utilHashNumber(double num);
 
-// Generate a hash code for [string].
-uint32_t utilHashString(const char* string);
+// Generate a hash code for the [length] bytes of the [string], which is never
+// zero.
+uint32_t utilHashString(const char* string, uint32_t length);
+
+// Generate the FNV-1a hash of the [length] bytes of the [string]. It's slower
+// than utilHashString() and only used for the hash values exposed to the
+// scripts (types.hash()), which should stay the same between versions.
+uint32_t utilHashStringFNV(const char* string, uint32_t length);
 
 // Convert the string to number. On success it'll return NULL and set the
 // [num] value. Otherwise it'll return a C literal string containing the error
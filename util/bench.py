@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+
+import sys
+import os
+import json
+import platform
+import argparse
+import statistics
+import subprocess
+import time
+from pathlib import Path
+
+# -----------------------------------------------------------------------------
+# Configuration
+# -----------------------------------------------------------------------------
+DEFAULT_RUNS = 5           # Measured runs per benchmark
+DEFAULT_WARMUP = 1         # Unmeasured runs before measuring
+DEFAULT_THRESHOLD = 5.0    # Percent slower than the baseline to be a regression
+DEFAULT_TIMEOUT = 120.0    # Seconds per run
+
+# -----------------------------------------------------------------------------
+# Colors and formatting
+# -----------------------------------------------------------------------------
+class Colors:
+    HEADER = '\033[95m'
+    OKGREEN = '\033[92m'
+    WARNING = '\033[93m'
+    FAIL = '\033[91m'
+    ENDC = '\033[0m'
+    BOLD = '\033[1m'
+
+    # Disable colors if not a TTY or explicitly disabled
+    if not sys.stdout.isatty() or os.environ.get('NO_COLOR'):
+        HEADER = OKGREEN = WARNING = FAIL = ENDC = BOLD = ''
+
+# -----------------------------------------------------------------------------
+# Benchmark
+# -----------------------------------------------------------------------------
+def parse_expected(filepath):
+    """Returns the '# expect: <line>' lines of the benchmark, the same format
+    used by the tests (see util/test.py)."""
+    expected = []
+    with open(filepath, 'r', encoding='utf-8') as f:
+        for line in f:
+            if '#' not in line:
+                continue
+            comment = line.split('#', 1)[1].strip()
+            if comment.startswith('expect:'):
+                expected.append(comment[7:].strip())
+    return expected
+
+def check_output(stdout, expected):
+    """Returns the first expected line missing from the output (in order)
+    or None if all of them are found."""
+    out_lines = [l.strip() for l in stdout.splitlines()]
+    idx = 0
+    for eline in expected:
+        while idx < len(out_lines) and out_lines[idx] != eline:
+            idx += 1
+        if idx == len(out_lines):
+            return eline
+        idx += 1
+    return None
+
+class BenchResult:
+    def __init__(self, name):
+        self.name = name
+        self.times = []
+        self.error = None
+
+    @property
+    def median(self):
+        return statistics.median(self.times)
+
+    @property
+    def spread(self):
+        """The min-max range as a percentage of the median."""
+        if len(self.times) < 2 or self.median == 0:
+            return 0.0
+        return (max(self.times) - min(self.times)) / self.median * 100
+
+    def to_json(self):
+        return {
+            "median": self.median,
+            "min": min(self.times),
+            "max": max(self.times),
+            "stdev": statistics.stdev(self.times) if len(self.times) > 1 else 0.0,
+            "runs": len(self.times),
+        }
+
+def run_benchmark(bench_file, interpreter, runs, warmup, timeout):
+    result = BenchResult(bench_file.stem)
+    expected = parse_expected(bench_file)
+
+    for i in range(warmup + runs):
+        start = time.perf_counter()
+        try:
+            proc = subprocess.run([str(interpreter), str(bench_file)],
+                                  stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                  stdin=subprocess.DEVNULL, text=True, timeout=timeout)
+        except subprocess.TimeoutExpired:
+            result.error = "Timed out"
+            return result
+        elapsed = time.perf_counter() - start
+
+        if proc.returncode != 0:
+            result.error = f"Exit code {proc.returncode}\n{proc.stderr}"
+            return result
+
+        # The output is the same for every run, verify it once.
+        if i == 0:
+            missing = check_output(proc.stdout, expected)
+            if missing is not None:
+                result.error = f"Missing expected output: '{missing}'"
+                return result
+
+        if i >= warmup:
+            result.times.append(elapsed)
+
+    return result
+
+# -----------------------------------------------------------------------------
+# Main Entry Point
+# -----------------------------------------------------------------------------
+def scan_benchmarks(bench_dir):
+    return sorted(Path(bench_dir).glob('*.sa'))
+
+def main():
+    root_dir = Path(__file__).parent.parent.resolve()
+
+    parser = argparse.ArgumentParser(description="Saynaa Benchmark Runner")
+    parser.add_argument('--app', default=None, help="Path to Saynaa executable")
+    parser.add_argument('benchmarks', nargs='*',
+                        help="Benchmark names (ex: fib) or files, default all in bench/")
+    parser.add_argument('-n', '--runs', type=int, default=DEFAULT_RUNS,
+                        help="Number of measured runs per benchmark")
+    parser.add_argument('-w', '--warmup', type=int, default=DEFAULT_WARMUP,
+                        help="Number of unmeasured runs before measuring")
+    parser.add_argument('-b', '--baseline', default=str(root_dir / 'bench' / 'baseline.json'),
+                        help="Baseline JSON file to compare against")
+    parser.add_argument('-s', '--save', action='store_true',
+                        help="Save the results as the new baseline")
+    parser.add_argument('-t', '--threshold', type=float, default=DEFAULT_THRESHOLD,
+                        help="Percent slower than the baseline reported as a regression")
+    args = parser.parse_args()
+
+    # Determine interpreter path
+    interpreter = args.app
+    if not interpreter:
+        exe_name = "saynaa.exe" if platform.system() == "Windows" else "saynaa"
+        interpreter = root_dir / exe_name
+
+    interpreter = Path(interpreter).resolve()
+    if not interpreter.exists():
+        print(f"{Colors.FAIL}Error: Saynaa binary not found at: {interpreter}{Colors.ENDC}")
+        print(f"Please build the project first (make MODE=RELEASE) or specify --app")
+        sys.exit(1)
+
+    # Collect benchmarks
+    bench_files = []
+    if args.benchmarks:
+        for b in args.benchmarks:
+            p = Path(b)
+            if not p.is_file():
+                p = root_dir / 'bench' / (b if b.endswith('.sa') else b + '.sa')
+            if p.is_file():
+                bench_files.append(p.resolve())
+            else:
+                print(f"{Colors.WARNING}Warning: Benchmark not found: {b}{Colors.ENDC}")
+    else:
+        bench_files = scan_benchmarks(root_dir / 'bench')
+
+    baseline = {}
+    baseline_path = Path(args.baseline)
+    if baseline_path.exists():
+        with open(baseline_path, 'r', encoding='utf-8') as f:
+            baseline = json.load(f).get('benchmarks', {})
+
+    print(f"{Colors.HEADER}Saynaa Benchmark Runner{Colors.ENDC}")
+    print(f"Interpreter: {Colors.BOLD}{interpreter}{Colors.ENDC}")
+    print(f"Runs: {args.runs} (+{args.warmup} warmup), "
+          f"baseline: {baseline_path if baseline else 'none'}\n")
+
+    print(f"{'benchmark':<16} {'median':>10} {'spread':>8} {'baseline':>10} {'change':>9}")
+
+    results = []
+    failed = 0
+    regressed = 0
+    for bench_file in bench_files:
+        res = run_benchmark(bench_file, interpreter, args.runs, args.warmup, DEFAULT_TIMEOUT)
+        results.append(res)
+
+        if res.error is not None:
+            failed += 1
+            print(f"{res.name:<16} {Colors.FAIL}FAIL{Colors.ENDC}")
+            continue
+
+        line = f"{res.name:<16} {res.median * 1000:>8.1f}ms {res.spread:>7.1f}%"
+        base = baseline.get(res.name)
+        if base is not None:
+            change = (res.median - base['median']) / base['median'] * 100
+            color = ''
+            if change > args.threshold:
+                color = Colors.FAIL
+                regressed += 1
+            elif change < -args.threshold:
+                color = Colors.OKGREEN
+            line += f" {base['median'] * 1000:>8.1f}ms {color}{change:>+8.1f}%{Colors.ENDC}"
+        print(line)
+
+    # Summary
+    print("\n" + "=" * 60)
+    if failed > 0:
+        print(f"\n{Colors.BOLD}Failure Details:{Colors.ENDC}")
+        for res in results:
+            if res.error is not None:
+                print(f"\n{Colors.FAIL}>>> {res.name}{Colors.ENDC}")
+                print(res.error)
+
+    if args.save:
+        saved = {res.name: res.to_json() for res in results if res.error is None}
+        # Keep the baseline of the benchmarks that weren't run this time.
+        for name, value in baseline.items():
+            saved.setdefault(name, value)
+        with open(baseline_path, 'w', encoding='utf-8') as f:
+            json.dump({
+                "platform": platform.platform(),
+                "interpreter": str(interpreter),
+                "benchmarks": dict(sorted(saved.items())),
+            }, f, indent=2)
+            f.write('\n')
+        print(f"Baseline saved to {baseline_path}")
+
+    print(f"Summary: {len(results) - failed} measured, "
+          f"{Colors.FAIL}{failed} failed{Colors.ENDC}, "
+          f"{Colors.FAIL if regressed else ''}{regressed} regressed{Colors.ENDC} "
+          f"(threshold {args.threshold:.1f}%)")
+
+    sys.exit(1 if failed > 0 or regressed > 0 else 0)
+
+if __name__ == '__main__':
+    main()
@@ -89,19 +89,39 @@ class CheckResult:
     def has_errors(self):
         return any(i.is_error for i in self.issues)
 
-# --- FNV-1a Hash Checker ---
-
-def fnv1a_hash(string):
-    """Computes the FNV-1a hash of a string."""
-    FNV_prime_32_bit = 16777619
-    FNV_offset_basis_32_bit = 2166136261
-    
-    hash_value = FNV_offset_basis_32_bit
-    for char in string:
-        hash_value ^= ord(char)
-        hash_value *= FNV_prime_32_bit
-        hash_value &= 0xffffffff
-    return hash_value
+# --- String Hash Checker ---
+
+def string_hash(string):
+    """Computes the hash of a string, the same as utilHashString() of
+    src/utils/saynaa_utils.c (MurmurHash64A folded to 32 bits)."""
+    M = 0xc6a4a7935bd1e995
+    R = 47
+    MASK = 0xffffffffffffffff
+
+    data = string.encode('utf-8')
+    length = len(data)
+    hash_value = (length * M) & MASK
+
+    words = length // 8
+    for i in range(words):
+        word = int.from_bytes(data[i * 8:i * 8 + 8], 'little')
+        word = (word * M) & MASK
+        word ^= word >> R
+        word = (word * M) & MASK
+        hash_value ^= word
+        hash_value = (hash_value * M) & MASK
+
+    tail = data[words * 8:]
+    if tail:
+        hash_value ^= int.from_bytes(tail, 'little')
+        hash_value = (hash_value * M) & MASK
+
+    hash_value ^= hash_value >> R
+    hash_value = (hash_value * M) & MASK
+    hash_value ^= hash_value >> R
+
+    result = (hash_value ^ (hash_value >> 32)) & 0xffffffff
+    return result if result != 0 else 1
 
 def check_hashes(file_path):
     result = CheckResult(file_path)
@@ -118,7 +138,7 @@ def check_hashes(file_path):
                 matches = pattern.findall(line)
                 for name, expected_hash_str in matches:
                     expected_hash = int(expected_hash_str, 16)
-                    computed_hash = fnv1a_hash(name)
+                    computed_hash = string_hash(name)
                     
                     if expected_hash != computed_hash:
                         result.add_error(line_no, 